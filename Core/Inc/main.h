@@ -46,6 +46,7 @@ extern ADC_HandleTypeDef  hadc1;
 extern ADC_HandleTypeDef  hadc2;
 extern I2C_HandleTypeDef hi2c2;
 extern SPI_HandleTypeDef hspi2;
+extern TIM_HandleTypeDef htim6;
 /* USER CODE END EC */
 
 /* Exported macro ------------------------------------------------------------*/
@@ -2,6 +2,7 @@
 #define __U_ADC_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "u_pedals.h"
 #include "u_efuses.h"
 
@@ -9,7 +10,20 @@
 
 /* API */
 int adc_init(void);
-int adc_switchMuxState(void); /* "Switches" the multiplexer (if it's currently HIGH, it will become LOW; if it's currently LOW, it will become HIGH). Then, updates the mux buffer accordingly. */
+void adc_sequenceCallback(void); /* Called from the ADC1 DMA complete interrupt. Switches the multiplexer every other sequence, and updates the mux buffer from the sequence in between. */
+
+/* Pedal analog watchdogs. */
+/* ADC2's analog watchdogs compare every pedal conversion against its fault window (see u_pedals.h) in hardware, so a
+*  sensor that opens or shorts is caught on the conversion it happens, instead of on the pedals thread's next read. */
+typedef enum {
+    PEDAL_WATCHDOG_APPS1, // AWD1, APPS_1_ADC
+    PEDAL_WATCHDOG_APPS2, // AWD2, APPS_2_ADC
+    PEDAL_WATCHDOG_BRAKE, // AWD3, BSE_1_ADC and BSE_2_ADC
+    NUM_PEDAL_WATCHDOGS
+} pedal_watchdog_t;
+void adc_watchdogCallback(uint32_t watchdog);                           /* Called from the ADC2 interrupt when an analog watchdog (ADC_ANALOGWATCHDOG_x) trips. */
+bool adc_takePedalWatchdog(pedal_watchdog_t watchdog, uint32_t *tick);  /* Gets whether a pedal watchdog tripped since the last call, and the tick it tripped at. */
+void adc_rearmPedalWatchdog(pedal_watchdog_t watchdog);                 /* Rearms a pedal watchdog that tripped. Only call it once the reading is back in its window. */
 
 /* Get raw EFuse ADC Data. */
 typedef struct { uint16_t data[NUM_EFUSES]; } raw_efuse_adc_t; // Struct to store the data.
@@ -33,6 +47,6 @@ typedef struct {
     float voltage; 
 } lvread_adc_t; // Struct to store the data.
 lvread_adc_t adc_getLVData(void); // Gets LV_BATT Voltage ADC data, and does conversions based on ideal circuit component values.
-lvread_adc_t adc_getLVData_2(void); // Gets LV_BATT Voltage ADC data, and does all conversions based on a f(x) found experimentally based on readings from VCU 001. Should be more accurate than adc_getLVData().
+lvread_adc_t adc_getLVData_2(void); // Gets LV_BATT Voltage ADC data, and converts it with this board's calibration (see u_calibration.h). Should be more accurate than adc_getLVData().
 
 #endif /* u_adc.h */
\ No newline at end of file
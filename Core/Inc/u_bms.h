@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "fdcan.h"
 
 /* API */
 
@@ -14,7 +15,10 @@ typedef enum {
 } precharge_state_t;
 
 int bms_init(void);                     // Initializes the BMS fault timer.
-int bms_handleDclMessage(void);         // Restarts the BMS Fault Timer.
+int bms_handleDclMessage(can_msg_t *message); // Records the discharge current limit and restarts the BMS Fault Timer.
+void bms_handleCclMessage(can_msg_t *message); // Records the charge current limit.
+bool bms_getDischargeLimit(float *discharge, uint32_t *timestamp); // Gets the DCL (Amps) and the tick it was received at. Returns false until the BMS has sent it.
+bool bms_getChargeLimit(float *charge, uint32_t *timestamp);       // Gets the CCL (Amps) and the tick it was received at. Returns false until the BMS has sent it.
 float bms_getBattboxTemp(void);      // Returns the battbox temperature.
 void bms_setBattboxTemp(float temp); // Sets the battbox temperature. The "temp" parameter should be taken from the 'BMS/Cells/Temp_Avg_Value' CAN message.
 
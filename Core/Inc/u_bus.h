@@ -0,0 +1,95 @@
+#ifndef __U_BUS_H
+#define __U_BUS_H
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* This file includes the VCU's bus manager, which runs every transaction on a physical bus (I2C2, SPI2)
+*  through that bus's own request queue.
+*
+*  Transactions are interrupt (I2C) or DMA (SPI) driven. The queue is started when a transaction is submitted to
+*  an idle bus, and each completion interrupt starts the next, so nothing ever blocks on a bus. Buses never wait
+*  on each other, so a slow temperature sensor on I2C2 can't hold up the IMU on SPI2.
+*
+*  bus_submit() queues a transaction and returns straight away. Its callback runs in interrupt context when the
+*  transaction finishes. bus_transfer() is the blocking version for threads, and gives up after the transaction's
+*  timeout. A transaction that times out is aborted and the bus peripheral is reset, so a hung bus fails fast.
+*
+*  A transaction is owned by the bus from bus_submit() until its callback, so it must not be reused before then.
+*/
+
+typedef enum {
+    BUS_I2C,
+    BUS_SPI
+} bus_type_t;
+
+typedef enum {
+    BUS_I2C_WRITE,      // Writes tx to the device
+    BUS_I2C_READ,       // Reads rx from the device
+    BUS_I2C_MEM_READ,   // Writes the command/register in mem_address, then reads rx from the device
+    BUS_SPI_TXRX        // Selects the device, and clocks tx out while clocking rx in (both length bytes)
+} bus_op_t;
+
+typedef enum {
+    BUS_PENDING,        // Queued, or on the bus
+    BUS_DONE,
+    BUS_FAILED,         // The HAL refused it, or the peripheral reported an error
+    BUS_TIMED_OUT       // Aborted after its timeout
+} bus_status_t;
+
+typedef struct bus_txn bus_txn_t;
+typedef void (*bus_callback_t)(bus_txn_t *txn);
+
+struct bus_txn {
+    bus_op_t op;
+    uint16_t address;         // I2C: Device address (already shifted, as the HAL takes it)
+    uint16_t mem_address;     // BUS_I2C_MEM_READ: Command or register
+    uint16_t mem_size;        // BUS_I2C_MEM_READ: I2C_MEMADD_SIZE_8BIT or I2C_MEMADD_SIZE_16BIT
+    GPIO_TypeDef *cs_port;    // SPI: Chip select, held low for the transaction
+    uint16_t cs_pin;
+    const uint8_t *tx;
+    uint8_t *rx;
+    uint16_t length;
+    uint32_t timeout;         // Ticks the transaction can take on the bus before it is aborted
+    bus_callback_t callback;  // Called from interrupt context when the transaction finishes. Optional.
+    void *context;            // For the callback
+
+    /* Owned by the bus. */
+    volatile bus_status_t status;
+    uint32_t start;           // Tick the transaction went on the bus
+    bus_txn_t *next;
+};
+
+typedef struct {
+    uint32_t done;
+    uint32_t failed;
+    uint32_t timed_out;
+} bus_stats_t;
+
+typedef struct {
+    const char *name;
+    bus_type_t type;
+    void *handle;             // I2C_HandleTypeDef or SPI_HandleTypeDef
+
+    /* Owned by the bus. */
+    bus_txn_t *head;          // On the bus, if busy
+    bus_txn_t *tail;
+    volatile bool busy;
+    volatile bool aborting;   // Completion interrupts are ignored while a timed out transaction is aborted
+    bus_stats_t stats;
+} bus_t;
+
+/* Bus List */
+extern bus_t i2c2_bus; // Temperature sensor
+extern bus_t spi2_bus; // IMU
+
+/* API */
+int bus_submit(bus_t *bus, bus_txn_t *txn);                   /* Queues a transaction. Its callback runs when it finishes. */
+int bus_transfer(bus_t *bus, bus_txn_t *txn);                 /* Queues a transaction and waits (up to its timeout, once on the bus) for it to finish. */
+void bus_expire(bus_t *bus);                                  /* Aborts the transaction on the bus if it has been there longer than its timeout. */
+void bus_completeCallback(bus_t *bus);                        /* Called from the bus's transfer complete interrupts. */
+void bus_errorCallback(bus_t *bus);                           /* Called from the bus's error interrupts. */
+bus_stats_t bus_getStats(const bus_t *bus);                   /* Gets a bus's transaction counters. */
+
+#endif /* u_bus.h */
@@ -0,0 +1,45 @@
+#ifndef __U_CALIBRATION_H
+#define __U_CALIBRATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* This file includes the VCU's per-board ADC calibration.
+*
+*  Each calibrated input turns its raw 12-bit reading into its unit with one gain and offset pair
+*  (value = raw * gain + offset). The pair folds in everything between the sensor and the ADC (dividers,
+*  VREF, current sense ratios), so a reading is converted with a single multiply-add.
+*
+*  The pairs are measured on the bench for each board, and stored in their own reserved flash sector
+*  (see u_flash.h), with a CRC and the serial (96-bit unique ID) of the board they were measured on. They're
+*  loaded once by calibration_init(). A record that is missing, corrupt, or from another board is ignored,
+*  and the nominal pairs (from VCU 001) are used instead.
+*
+*  calibration_set() changes a pair straight away, so a bench run can check it, and calibration_save() stores
+*  the pairs for the next boot. ADC2's pedal watchdogs are set up from the pairs in adc_init(), so they only
+*  follow a pedal change after a reboot.
+*/
+
+typedef enum {
+    CAL_LFIU_1,     // LFIU_1 current (A)
+    CAL_LFIU_2,     // LFIU_2 current (A)
+    CAL_LV,         // LV_BATT voltage (V)
+    CAL_APPS_1,     // APPS1 travel (0 at rest, 1 fully pressed)
+    CAL_APPS_2,     // APPS2 travel (0 at rest, 1 fully pressed)
+    NUM_CAL_CHANNELS
+} cal_channel_t;
+
+typedef struct {
+    float gain;     // Units per raw count
+    float offset;   // Units at a raw reading of 0
+} cal_pair_t;
+
+/* API */
+int calibration_init(void);                                            /* Loads this board's calibration from flash, or the nominal one. */
+float calibration_apply(cal_channel_t channel, uint16_t raw);          /* Converts a raw reading into the channel's unit. */
+float calibration_toRaw(cal_channel_t channel, float value);           /* Gets the raw reading a value converts from. */
+cal_pair_t calibration_get(cal_channel_t channel);                     /* Gets a channel's gain and offset. */
+int calibration_set(cal_channel_t channel, const cal_pair_t *pair);    /* Changes a channel's gain and offset, until the next boot. */
+int calibration_save(void);                                            /* Stores the current pairs in flash, for this board. */
+
+#endif /* u_calibration.h */
@@ -48,13 +48,20 @@ extern can_t can1;
 /* Calypso RTDS State Command CAN IDs */
 #define CANID_CALYPSO_RTDS_STATE 0xDB1
 
+/* Calypso TC Tire Curve Select CAN ID */
+#define CANID_CALYPSO_TC_CURVE 0xCAC00
+
+/* Calypso TC Gain Schedule CAN ID */
+#define CANID_CALYPSO_TC_GAINS 0xCAC01
+
 /* Misc CAN IDs */
 #define CANID_FAULT_MSG	       0x502
 #define CANID_SHUTDOWN_MSG     0x123
 #define CANID_PEDALS_VOLTS_MSG 0x504
 #define CAN_ID_PEDALS_NORM_MSG 0x505
 #define CANID_BMS_CELL_TEMPS   0x84
-#define CANID_BMS_DCL_MSG      0x156
+#define CANID_BMS_DCL_MSG      0x156 // DTI "set max DC current" frame, sent by the BMS with its DCL
+#define CANID_BMS_CCL_MSG      0x176 // DTI "set max DC brake current" frame, sent by the BMS with its CCL
 #define LIGHT_BOARD_CAN_MSG_ID 0xCA
 #define CANID_LIGHTNING_PULSE  0xAAE
 #define CANID_VCU_TEST_MESSAGE 0xBAD
@@ -62,6 +69,12 @@ extern can_t can1;
 #define CANID_WHEEL_BUTTONS    0x680
 #define CANID_SHUTDOWN 0x95
 
+/* MSB (mechanical sensor board) CAN IDs. Unverified against the Odyssey definitions, so only used with SUSPENSION_LOAD_CEILING (see u_suspension.h). */
+#define CANID_FRONT_SHOCKPOT    0x705
+#define CANID_FRONT_RIDE_HEIGHT 0x706
+#define CANID_BACK_SHOCKPOT     0x715
+#define CANID_BACK_RIDE_HEIGHT  0x716
+
 /* Peripheral CAN IDs. */
 #define CANID_IMU_ACCEL	  0x506
 #define CANID_IMU_GYRO	  0x507
@@ -19,6 +19,27 @@
 #define GEAR_RATIO    (39.0f / 13.0f) /* unitless */
 #define POLE_PAIRS    10 /* unitless */
 
+/* Pack power caps. */
+#define DTI_POWER_LIMIT_MAX	  80000.0f /* W, EV.3.3.1 */
+#define DTI_POWER_LIMIT_ENDURANCE 50000.0f /* W, protects the cells during endurance */
+#define DTI_POWER_LIMIT_MIN	  5000.0f  /* W */
+
+#define DERATE_TABLE_POINTS_MAX 8
+
+/* Temperatures that derate the torque. */
+typedef enum {
+	DERATE_MOTOR,
+	DERATE_CONTROLLER,
+	DERATE_BATTBOX,
+	NUM_DERATE_SOURCES
+} derate_source_t;
+
+/* A point in a derating table. */
+typedef struct {
+	float temp;	/* degC */
+	float fraction; /* Max torque fraction at this temperature, 0-1 */
+} derate_point_t;
+
 /**
  * @brief Initialize DTI interface.
  *
@@ -60,7 +81,8 @@ uint16_t dti_get_input_voltage(void);
 
 /**
  * @brief Send CAN message to command torque from the motor controller. The torque to command is
- * smoothed with a moving average before being send to the motor controller.
+ * smoothed with a moving average, derated by temperature and held under the pack power cap
+ * before being send to the motor controller.
  *
  * @param torque The torque target.
  */
@@ -137,6 +159,81 @@ uint16_t dti_get_controller_temp(void);
  */
 void dti_record_currents(can_msg_t* msg);
 
+/**
+ * @brief Get the DC bus current.
+ *
+ * @return uint16_t DC current multiplied by 10
+ */
 uint16_t dti_get_dc_current(void);
 
+/**
+ * @brief Get the pack power drawn by the motor controller, P = V_dc * I_dc.
+ *
+ * @return float Power in watts, negative while regenerating
+ */
+float dti_get_dc_power(void);
+
+/**
+ * @brief Set the functional mode's pack power cap. The state machine calls this on every
+ * mode change. It only applies while no runtime cap is set with dti_set_power_limit().
+ *
+ * @param power Cap in watts, between DTI_POWER_LIMIT_MIN and DTI_POWER_LIMIT_MAX
+ * @return int U_SUCCESS, or U_ERROR if the cap is out of range
+ */
+int dti_set_default_power_limit(float power);
+
+/**
+ * @brief Set the pack power cap that dti_set_torque() holds the motor under, in place of the
+ * mode's cap. It stays in force across mode changes until dti_clear_power_limit().
+ *
+ * @param power Cap in watts, between DTI_POWER_LIMIT_MIN and DTI_POWER_LIMIT_MAX
+ * @return int U_SUCCESS, or U_ERROR if the cap is out of range
+ */
+int dti_set_power_limit(float power);
+
+/**
+ * @brief Drop the cap set with dti_set_power_limit(), going back to the mode's cap.
+ */
+void dti_clear_power_limit(void);
+
+/**
+ * @brief Get the pack power cap in force: the runtime cap if one is set, else the mode's.
+ *
+ * @return float Cap in watts
+ */
+float dti_get_power_limit(void);
+
+/**
+ * @brief Check whether the power limiter reduced the last torque command.
+ */
+bool dti_is_power_limited(void);
+
+/**
+ * @brief Replace a temperature derating table, until the next boot. Between points the fraction is
+ * interpolated linearly, and outside the table the end values are held. Safe to call while the torque
+ * path is running. The VCU/Commands/Derate MQTT command calls it.
+ *
+ * @param source The temperature the table applies to
+ * @param points Points in increasing temperature order
+ * @param num_points Number of points, 1 to DERATE_TABLE_POINTS_MAX
+ * @return int U_SUCCESS, or U_ERROR if the table is invalid
+ */
+int dti_set_derate_table(derate_source_t source, const derate_point_t *points,
+			 uint8_t num_points);
+
+/**
+ * @brief Get the torque fraction the temperatures allowed on the last torque command. This is the
+ * smallest of the motor, controller and battbox tables.
+ *
+ * @return float Fraction from 0-1
+ */
+float dti_get_thermal_derate(void);
+
+/**
+ * @brief Get the fraction of the time spent commanding torque that the power limiter was active.
+ *
+ * @return float Fraction from 0-1
+ */
+float dti_get_power_limited_fraction(void);
+
 #endif
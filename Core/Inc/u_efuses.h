@@ -42,6 +42,40 @@ typedef struct {
     efuse_control_state_t control_state[NUM_EFUSES]; // The eFuse's control state as tracked by VCU. Calypso is the source of truth for these values; VCU is simply responding to Calypso's commanded state values.
 } efuse_data_t;
 
+/* Sensors an eFuse's AUTO mode can follow. */
+typedef enum {
+    EFUSE_SOURCE_NONE,            // No sensor. AUTO does the same thing as ON.
+    EFUSE_SOURCE_MOTOR_TEMP,      // Motor temperature, from the DTI (C).
+    EFUSE_SOURCE_CONTROLLER_TEMP, // Motor controller temperature, from the DTI (C).
+    EFUSE_SOURCE_BATTBOX_TEMP,    // Battbox temperature, from the BMS (C).
+    EFUSE_SOURCE_BRAKE,           // Brake state (1 = pressed, 0 = not pressed).
+
+    /* Total number of sources. */
+    NUM_EFUSE_SOURCES
+} efuse_source_t;
+
+/* What an eFuse in AUTO does while its source is faulted. */
+typedef enum {
+    EFUSE_FALLBACK_HOLD,  // Stay as it is.
+    EFUSE_FALLBACK_ON,    // Turn on.
+    EFUSE_FALLBACK_OFF    // Turn off.
+} efuse_fallback_t;
+
+/* How an eFuse in AUTO follows its source. The eFuse turns on at or above 'on', turns off at or below 'off', and stays as it is in between. */
+typedef struct {
+    efuse_source_t source;      // Sensor the eFuse follows.
+    float on;                   // Reading the eFuse turns on at. Must be above 'off'.
+    float off;                  // Reading the eFuse turns off at.
+    uint32_t dwell;             // Least time (ms) between two AUTO switches, so a pump or fan isn't cycled too quickly.
+    efuse_fallback_t fallback;  // What the eFuse does while the source is faulted.
+} efuse_policy_t;
+
+/* Latest sensor readings, for efuse_control(). */
+typedef struct {
+    float value[NUM_EFUSE_SOURCES];     // Each source's reading.
+    bool faulted[NUM_EFUSE_SOURCES];    // Whether each source's reading can't be trusted.
+} efuse_inputs_t;
+
 /* API */
 efuse_data_t efuse_getData(void);  // Returns an instance of efuse_data_t with all current eFuse data.
 void efuse_enable(efuse_t efuse);  // Enables an eFuse.
@@ -49,5 +83,8 @@ void efuse_disable(efuse_t efuse); // Disables an eFuse.
 void efuse_update_state(efuse_t efuse, efuse_control_state_t state); // Updates an eFuse's control state. Intended to be called when the relevant commands from Calypso are received.
 int efuse_init(void); // Inititialize the _efuse_control_state array to the values configured in the efuses[] table.
 efuse_control_state_t efuse_get_state(efuse_t efuse); // Gets the control state of the eFuse. 
+void efuse_control(const efuse_data_t *data, const efuse_inputs_t *inputs); // Drives every eFuse as its control state (and, in AUTO, its policy) says. Only writes the EN pins that change.
+efuse_policy_t efuse_get_policy(efuse_t efuse); // Gets an eFuse's AUTO policy.
+int efuse_set_policy(efuse_t efuse, const efuse_policy_t *policy); // Changes an eFuse's AUTO policy, until the next boot.
 
 #endif /* u_efuses.h */
\ No newline at end of file
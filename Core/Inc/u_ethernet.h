@@ -15,6 +15,20 @@ UINT ethernet1_init(void);
  * Send a protobuf message over MQTT
  */
 UINT ethernet1_mqtt_send(char* topic, uint8_t topic_size, char* unit, uint8_t unit_size, float* values, uint8_t values_len, uint64_t time_us);
+/**
+ * Send one TC debug stream datagram over UDP (see u_tc_stream.h). Never blocks.
+ * Returns NX_NOT_ENABLED until ethernet has been initialized.
+ */
+UINT ethernet1_tc_stream_send(const uint8_t *data, uint16_t size);
+/**
+ * Get the IP instance ethernet1_init() created (NX_IP), for opening sockets on it.
+ * Returns NULL until ethernet has been initialized.
+ */
+struct NX_IP_STRUCT *ethernet1_get_ip(void);
+/**
+ * Get the packet pool of that IP instance (NX_PACKET_POOL). Returns NULL until ethernet has been initialized.
+ */
+struct NX_PACKET_POOL_STRUCT *ethernet1_get_packet_pool(void);
 
 typedef struct {
     uint8_t type;
@@ -0,0 +1,24 @@
+#ifndef __U_FLASH_H
+#define __U_FLASH_H
+
+#include <stdint.h>
+
+/* This file includes helpers for the VCU's reserved internal flash sectors (see the .ld files).
+*
+*  The STM32H563's flash is erased in 8 KB sectors and written in 16 byte quad-words, once per erase.
+*  The reserved sectors are at the end of bank 2, so they can be written while the code runs from
+*  bank 1. Writing a sector stalls any reads from bank 2 for a few ms, and erasing it for longer, so
+*  none of this should be called from a control thread.
+*/
+
+#define FLASH_QUADWORD_SIZE 16U
+
+/* Reserved sectors. */
+extern const uint8_t _calibration_store[]; /* This board's ADC calibration, see u_calibration.h. */
+extern const uint8_t _tire_curve_store[]; /* A tire curve uploaded at runtime, see tc_load_curve(). */
+
+/* API */
+int flash_eraseSector(const void *sector);                                 /* Erases the 8 KB sector that starts at `sector`. */
+int flash_write(const void *address, const void *data, uint32_t size);     /* Writes to erased flash. `address` must be quad-word aligned; the last quad-word is padded with 0xFF. */
+
+#endif /* u_flash.h */
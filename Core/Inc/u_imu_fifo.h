@@ -0,0 +1,48 @@
+#ifndef __U_IMU_FIFO_H
+#define __U_IMU_FIFO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "u_peripherals.h"
+
+/* This file includes the VCU's IMU sample ring, filled from the LSM6DSV's hardware FIFO.
+*
+*  The IMU batches tagged accelerometer and gyroscope words into its FIFO at IMU_FIFO_ODR_HZ. When the FIFO
+*  reaches its watermark, IMU_INT2 starts one SPI DMA burst that drains it (see u_peripherals.c), and
+*  imu_fifo_parse() pairs the words back up into samples in the ring. The IMU does not timestamp the words
+*  itself, so each sample's time is counted back from the watermark interrupt in ODR periods.
+*
+*  The IMU's sensor fusion (SFLP) batches its game rotation vector and gravity vector words in between, at
+*  IMU_FIFO_SFLP_HZ. They aren't samples of their own. Each sample carries the newest of them instead.
+*
+*  imu_fifo_parse() is called from the SPI DMA complete interrupt. imu_fifo_pop() has a single consumer (the TC
+*  thread), and imu_fifo_latest() can be called from any thread. Both rely on the parser running in an interrupt,
+*  so it is never preempted by a reader.
+*/
+
+#define IMU_FIFO_ODR_HZ    960  // Accelerometer and gyroscope data rate, and batch rate into the FIFO
+#define IMU_FIFO_SFLP_HZ   480  // Sensor fusion data rate, and batch rate into the FIFO. At most IMU_FIFO_ODR_HZ.
+#define IMU_FIFO_WATERMARK 4    // Samples (accelerometer + gyroscope word pairs) per watermark interrupt
+#define IMU_FIFO_WATERMARK_WORDS (IMU_FIFO_WATERMARK * (2 * IMU_FIFO_ODR_HZ + 2 * IMU_FIFO_SFLP_HZ) / IMU_FIFO_ODR_HZ) // The same, plus the SFLP's words
+#define IMU_FIFO_WORD_SIZE 7    // Tag byte + 3 x 16-bit axes
+#define IMU_FIFO_BURST_MAX 32   // Most FIFO words drained in one burst
+#define IMU_FIFO_RING_SIZE 64   // Samples held for the consumers. Must be a power of two.
+#define IMU_FIFO_ANCHOR_NEWEST 0xFFFF // imu_fifo_parse() anchor for a burst whose newest sample was taken at anchor_us
+
+typedef struct {
+    uint32_t samples;  // Samples added to the ring
+    uint32_t dropped;  // Samples overwritten before imu_fifo_pop() got to them
+    uint32_t unpaired; // FIFO words thrown away without a matching word from the other sensor
+    uint32_t overruns; // Times the IMU's FIFO filled up before it was drained
+    uint32_t fusion;   // SFLP words (game rotation and gravity vectors) read
+} imu_fifo_stats_t;
+
+/* API */
+void imu_fifo_reset(void);                                                             /* Empties the ring, and forgets any half-paired word. */
+uint16_t imu_fifo_parse(const uint8_t *words, uint16_t count, uint64_t anchor_us, uint16_t anchor); /* Adds a burst of FIFO words to the ring, with its anchor'th sample (or IMU_FIFO_ANCHOR_NEWEST) taken at anchor_us. Returns the samples added. */
+void imu_fifo_overrun(void);                                                           /* Counts an IMU FIFO overrun. */
+bool imu_fifo_pop(imu_sample_t *sample);                                               /* Gets the oldest sample imu_fifo_pop() has not returned yet. */
+bool imu_fifo_latest(imu_sample_t *sample);                                            /* Gets the newest sample. */
+imu_fifo_stats_t imu_fifo_getStats(void);                                              /* Gets the ring's counters. */
+
+#endif /* u_imu_fifo.h */
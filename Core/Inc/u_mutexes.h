@@ -8,7 +8,7 @@
 #include <stdbool.h>
 
 /* Mutex List */
-extern mutex_t peripherals_mutex;  // Peripherals Mutex
+extern mutex_t peripherals_mutex;  // Peripherals Mutex (temperature sensor). The buses themselves are serialised by u_bus.c.
 // add more as necessary...
 
 /* API */
@@ -3,6 +3,8 @@
 #ifndef __U_PEDALS_H
 #define __U_PEDALS_H
 
+#include "u_calibration.h"
+
 static uint16_t regen_limits[2] = { 0, 150 }; // [PERFORMANCE, ENDURANCE]
 static const float MPH_TO_KMH = 1.609;       // Factor for converting MPH to KMH
 
@@ -23,10 +25,7 @@ static const float MPH_TO_KMH = 1.609;       // Factor for converting MPH to KMH
 #define MAX_VOLTS_UNSCALED 5.0  // (Volts). Actual sensor voltage before voltage divider scaling.
 
 /* Pedal Tuning */
-#define MAX_APPS1_VOLTS		    3.4 // (Volts). Upper bound on APPS1 voltage range.
-#define MIN_APPS1_VOLTS		    2.1 // (Volts). Lower bound on APPS1 voltage range.
-#define MAX_APPS2_VOLTS		    2.2 // (Volts). Upper bound on APPS2 voltage range.
-#define MIN_APPS2_VOLTS		    1.1 // (Volts). Lower bound on APPS2 voltage range.
+/* The APPS voltage ranges are calibrated per board (see u_calibration.h). */
 #define PEDAL_BRAKE_THRESH	    0.15 // (Percantage). Pedal position above which the system registers the brake pedal as "pressed".
 #define PEDAL_HARD_BRAKE_THRESH 0.20 // (Percentage). Pedal position above which a "hard brake" is detected.
 
@@ -50,6 +49,18 @@ static const float MPH_TO_KMH = 1.609;       // Factor for converting MPH to KMH
 #define APPS_THRESHOLD_TOLERANCE    0.20 // (Volts). Tolerance margin around the accelerator pedal.
 #define BRAKE_THRESHOLD_TOLERANCE   0.25 // (Volts). Tolerance margin around the brake pedal.
 
+/* Fault Windows */
+/* A sensor voltage above its window is an open circuit fault, and one below it is a short circuit fault. ADC2's analog watchdogs are set up with the same windows. */
+#define APPS1_FAULT_HIGH (MAX_VOLTS_UNSCALED - APPS_THRESHOLD_TOLERANCE)          // (Volts).
+#define APPS1_FAULT_LOW  (APPS_REST_VOLTS(CAL_APPS_1) - APPS_THRESHOLD_TOLERANCE)    // (Volts).
+#define APPS2_FAULT_HIGH (MAX_VOLTS_UNSCALED - APPS_THRESHOLD_TOLERANCE)          // (Volts).
+#define APPS2_FAULT_LOW  (APPS_REST_VOLTS(CAL_APPS_2) - APPS_THRESHOLD_TOLERANCE)    // (Volts).
+#define BRAKE_FAULT_HIGH (BRAKE_SENSOR_IRREGULAR_HIGH + BRAKE_THRESHOLD_TOLERANCE) // (Volts).
+#define BRAKE_FAULT_LOW  (BRAKE_SENSOR_IRREGULAR_LOW - BRAKE_THRESHOLD_TOLERANCE)  // (Volts).
+#define PEDAL_DIVIDER    (3000.0 / (2000.0 + 3000.0))                              // 2k + 3k voltage divider on the pedal lines.
+#define PEDAL_VOLTS_TO_ADC(volts) ((uint16_t)((volts) * PEDAL_DIVIDER / MAX_VOLTS * MAX_ADC_VAL_12b)) // Sensor voltage to the raw ADC reading.
+#define APPS_REST_VOLTS(channel) (calibration_toRaw((channel), 0.0f) * MAX_VOLTS / MAX_ADC_VAL_12b / PEDAL_DIVIDER) // (Volts). An APPS sensor's calibrated voltage at rest.
+
 /* Pedal sensors. This enum is ordered based on the order of the sensors' ADC
  * indexes, as set up in u_adc.c  */
 typedef enum {
@@ -13,11 +13,38 @@ typedef struct {
     float z;
 } vector3_t;
 
+typedef struct {
+    float w;
+    float x;
+    float y;
+    float z;
+} quaternion_t;
+
+typedef struct {
+    vector3_t accel; /* Acceleration (mg). */
+    vector3_t gyro;  /* Angular rate (mdps). */
+    uint64_t time_us; /* When the sample was taken (see time_getMicros() and u_imu_fifo.h). */
+    quaternion_t orientation; /* Game rotation vector from the IMU's sensor fusion (SFLP). Unit quaternion, in the IMU's frame. */
+    vector3_t gravity;        /* Gravity in the IMU's frame, from the SFLP (mg). Reads like the accelerometer would at rest. */
+    bool fused;               /* Whether orientation and gravity hold SFLP output yet. */
+} imu_sample_t;
+
+typedef struct {
+    float temperature; /* Temperature (C). */
+    float humidity;    /* Relative humidity (%). */
+    uint32_t tick;     /* When the reading was fetched (HAL_GetTick()). */
+} tempsensor_reading_t;
+
 /* API */
 int peripherals_init(void);                                                    /* Initializes I2C/SPI devices. */
 int tempsensor_toggleHeater(bool enable);                                      /* Toggles the status of the temperature sensor's internal heater. */
-int tempsensor_getTemperatureAndHumidity(float *temperature, float *humidity); /* Gets the temp sensor's temperature and humidity readings. */
-int imu_getAcceleration(vector3_t* data);                                      /* Gets the IMU's acceleration reading. */
-int imu_getAngularRate(vector3_t* data);                                       /* Gets the IMU's angular rate reading. */
+int tempsensor_getReading(tempsensor_reading_t *reading);                      /* Gets the temp sensor's latest cached reading. Fails if there isn't one, or it's stale. */
+int tempsensor_getTemperatureAndHumidity(float *temperature, float *humidity); /* Gets the temp sensor's latest cached temperature and humidity readings. */
+int imu_getAcceleration(vector3_t* data);                                      /* Gets the IMU's newest acceleration reading. */
+int imu_getAngularRate(vector3_t* data);                                       /* Gets the IMU's newest angular rate reading. */
+int imu_getOrientation(quaternion_t* data);                                    /* Gets the IMU's newest orientation (game rotation vector). */
+int imu_getLinearAcceleration(vector3_t* data);                                /* Gets the IMU's newest acceleration with gravity taken out (mg). */
+void imu_watermarkCallback(void);                                              /* Called from the IMU_INT2 FIFO threshold interrupt. Starts draining the FIFO. */
+int imu_waitForSample(imu_sample_t *sample, uint32_t timeout);                 /* Waits (up to timeout ticks) for the IMU's next sample from the FIFO. */
 
 #endif /* u_peripherals.h */
\ No newline at end of file
@@ -17,6 +17,7 @@ extern queue_t can_incoming; // Incoming CAN Queue
 extern queue_t can_outgoing; // Outgoing CAN Queue
 extern queue_t faults;       // Faults Queue
 extern queue_t state_transition_queue; // State Transition Queue
+extern queue_t imu_data_ready; // IMU Data Ready Queue
 // add more as necessary
 
 /* API */
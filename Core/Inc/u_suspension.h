@@ -0,0 +1,31 @@
+#ifndef __U_SUSPENSION_H
+#define __U_SUSPENSION_H
+
+// #define SUSPENSION_LOAD_CEILING // Uncomment to scale TC's torque by the rear load. Leave it off until the MSB CAN IDs in u_can.h and the vehicle parameters in u_suspension.c are checked.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* This file includes the VCU's axle normal load estimate, from the MSBs' shock pots and ride height sensors.
+*
+*  Each axle's load is its static load plus the wheel rate times how far its wheels have moved from
+*  where they sat at boot. The first readings from each sensor are taken as the static position, so
+*  the car must be at rest on its wheels when the MSBs come up (as for the IMU calibration in TC).
+*  While an axle has no fresh readings, its load falls back to the longitudinal weight transfer from ax.
+*
+*  The setters are called from the CAN thread, and the getters from the TC thread.
+*/
+
+typedef enum {
+    SUSPENSION_FRONT,
+    SUSPENSION_REAR,
+    NUM_SUSPENSION_AXLES
+} suspension_axle_t;
+
+/* API */
+void suspension_setShockpot(suspension_axle_t axle, float travel);           /* Records a shock pot reading (mm of shock compression). */
+void suspension_setRideHeight(suspension_axle_t axle, float height);         /* Records a ride height reading (mm). */
+float suspension_getAxleLoad(suspension_axle_t axle, float ax);              /* Gets an axle's normal load (N). ax (m/s^2, forwards) is only used without fresh readings. */
+bool suspension_isMeasured(suspension_axle_t axle);                          /* Gets whether an axle's load comes from its sensors, rather than from ax. */
+
+#endif /* u_suspension.h */
@@ -2,6 +2,29 @@
 #define __U_TC_H
 
 #include "fdcan.h"
+#include "u_peripherals.h"
+
+#define TC_SURFACE_ID_SIZE 16 /* Including the terminator, when shorter */
+#define TC_GAIN_POINTS     4  /* Points in the gain schedule */
+#define TC_CURVE_SIZE      1627 /* Size of a tire curve blob, as written by tmg/fetch.py */
+
+/* One point of the gain schedule. TC interpolates between points by vehicle speed. */
+typedef struct {
+  float speed;      /* mph */
+  float kp;
+  float ki;
+  float slip_ratio; /* Target slip, as a fraction of the tire curve's peak slip */
+} tc_gains_t;
+
+/* Longitudinal velocity estimate (see tc_get_velocity_estimate()). */
+typedef struct {
+  float velocity;         /* m/s */
+  float ax_bias;          /* Accelerometer bias, including road grade unless the IMU's sensor fusion is running (m/s^2) */
+  float pitch;            /* Nose up (rad). From the IMU's sensor fusion, when it's running. */
+  float covariance[3][3]; /* Over (velocity, ax_bias, pitch) */
+  uint32_t rejected;      /* Front wheel speeds rejected as outliers since calibration */
+  uint32_t wheel_age;     /* Time since the last front wheel speed message (ms) */
+} tc_velocity_estimate_t;
 
 /**
  * @brief Initializes the TC module. Loads the tire curve from flash and checks
@@ -11,6 +34,63 @@
  */
 int tc_init(void);
 
+/**
+ * @brief Selects the tire curve TC runs on, by surface_id. The curve is checked (CRC, magic,
+ * version, point count) and swapped in at the start of the next control cycle, replacing any
+ * selection that has not been swapped in yet.
+ *
+ * @param surface_id The surface_id of a curve in the linked curve bank
+ * @return int U_SUCCESS, or U_ERROR if the curve is not found or invalid, or another selection is in progress
+ */
+int tc_select_curve(const char *surface_id);
+
+/**
+ * @brief Loads a tire curve that did not come from flash (e.g. uploaded over the network). The curve
+ * is checked (CRC, magic, version, point count, increasing slip) and swapped in at the start of the
+ * next control cycle, like a selection. A persisted curve replaces the default curve at boot, and
+ * any curve in the bank with the same surface_id.
+ *
+ * @param data The tire curve blob, TC_CURVE_SIZE bytes
+ * @param size Size of the blob in bytes
+ * @param crc32 CRC32 (IEEE 802.3, as zlib.crc32) the sender computed over the blob
+ * @param persist Also write the curve to flash, so it survives a reboot. Takes tens of ms.
+ * @return int U_SUCCESS, or U_ERROR if the curve is invalid, could not be stored, or another selection is in progress
+ */
+int tc_load_curve(const uint8_t *data, uint32_t size, uint32_t crc32, bool persist);
+
+/**
+ * @brief Gets the surface_id of the tire curve TC is running on.
+ *
+ * @return const char* The surface_id (not necessarily terminated if it is TC_SURFACE_ID_SIZE long)
+ */
+const char *tc_get_surface_id(void);
+
+/**
+ * @brief Sets one point of the gain schedule, at runtime. Takes effect on the next TC cycle
+ * without a bump in the torque scale.
+ *
+ * @param index The point to set, in [0, TC_GAIN_POINTS)
+ * @param gains The new gains. Points must stay in increasing order of speed.
+ * @return int U_SUCCESS, or U_ERROR if the gains are invalid or another update is in progress
+ */
+int tc_set_gains(uint8_t index, const tc_gains_t *gains);
+
+/**
+ * @brief Gets one point of the gain schedule.
+ *
+ * @param index The point to get, in [0, TC_GAIN_POINTS)
+ * @param gains Filled in with the point's gains
+ * @return int U_SUCCESS, or U_ERROR if the index is out of range
+ */
+int tc_get_gains(uint8_t index, tc_gains_t *gains);
+
+/**
+ * @brief Sets a point of the gain schedule from a CAN message.
+ * Expected format: byte 0 = index, byte 1 = speed (mph), then kp, ki and slip_ratio as
+ * big-endian uint16s in thousandths.
+ */
+void tc_record_gains(can_msg_t msg);
+
 /**
  * @brief Enables traction control.
  * 
@@ -45,15 +125,37 @@ bool tc_isEnabled(void);
  */
 void tc_record_front_rpm(can_msg_t msg);
 
+/**
+ * @brief Gets the velocity estimator's state and covariance. The estimator fuses the front wheel
+ * speeds with the IMU's longitudinal acceleration (with gravity taken out by the IMU's sensor fusion,
+ * or corrected by its pitch rate without it), and runs whether or not TC is on.
+ *
+ * @param estimate Filled in with the latest estimate
+ * @return bool false until the estimator has calibrated the accelerometer bias
+ */
+bool tc_get_velocity_estimate(tc_velocity_estimate_t *estimate);
+
+/**
+ * @brief Gets the torque the rear tires can take at their peak force, from the rear axle's normal
+ * load (see u_suspension.h). TC scales the tire curve's normalized force by this, so its authority
+ * follows weight transfer. Updated every TC cycle, whether or not TC is on. MAX_TORQUE without
+ * SUSPENSION_LOAD_CEILING.
+ *
+ * @return float Torque at the motor (Nm)
+ */
+float tc_get_torque_ceiling(void);
+
 /**
  * @brief Runs one iteration of the traction control algorithm.
  * Updates the internal torque scale factor based on current slip.
+ * Called from the TC thread on every IMU sample, or with NULL when the IMU times out.
  */
-void tc_process(void);
+void tc_process(const imu_sample_t *sample);
 
 /**
  * @brief Returns the current TC torque scale factor in [0.0, 1.0].
  * Multiply the requested torque by this value before sending to the DTI.
+ * Lock-free, so the torque path never waits on the TC thread.
  */
 float tc_get_torque_scale(void);
 
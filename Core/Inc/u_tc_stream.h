@@ -0,0 +1,56 @@
+#ifndef __U_TC_STREAM_H
+#define __U_TC_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* This file includes the traction control debug stream.
+*
+*  When enabled, TC records one sample per control cycle into a ring. A low priority thread drains the
+*  ring into UDP datagrams (see ethernet1_tc_stream_send()), so the controller never waits on the
+*  network. If the drain falls behind, new samples are dropped and counted, never old ones overwritten.
+*
+*  Datagram (little-endian): a tc_stream_header_t, then `count` samples with consecutive sequence numbers,
+*  starting at first_seq. A jump in first_seq between datagrams is samples the VCU dropped, and should
+*  match the increase in `dropped`. A jump in datagram_seq is datagrams lost on the network.
+*/
+
+#define TC_STREAM_MAGIC     0x5354 /* "TS" */
+#define TC_STREAM_VERSION   1
+#define TC_STREAM_PORT      5005   /* UDP destination port */
+#define TC_STREAM_BATCH_MAX 40     /* Samples per datagram. 16 + 40 * 32 bytes fits a 1500 byte MTU. */
+
+typedef struct __attribute__((__packed__)) {
+    uint32_t time_us;      /* Low 32 bits of time_getMicros() */
+    float slip;            /* Rear slip ratio TC computed */
+    float velocity;        /* Velocity estimate (m/s) */
+    float omega_fl;        /* Front left wheel speed (rad/s) */
+    float omega_fr;        /* Front right wheel speed (rad/s) */
+    float ax;              /* Raw longitudinal acceleration (m/s^2) */
+    float integral;        /* PI integral term, as a contribution to the torque scale */
+    float torque_scale;    /* Torque scale published this cycle */
+} tc_stream_sample_t;
+
+typedef struct __attribute__((__packed__)) {
+    uint16_t magic;        /* TC_STREAM_MAGIC */
+    uint8_t version;       /* TC_STREAM_VERSION */
+    uint8_t count;         /* Samples in this datagram */
+    uint32_t datagram_seq; /* Increments every datagram */
+    uint32_t first_seq;    /* Sequence number of the first sample */
+    uint32_t dropped;      /* Samples dropped by the ring since boot */
+} tc_stream_header_t;
+
+typedef struct {
+    uint32_t recorded;     /* Samples recorded into the ring */
+    uint32_t dropped;      /* Samples dropped because the ring was full */
+    uint32_t datagrams;    /* Datagrams packed */
+} tc_stream_stats_t;
+
+/* API */
+void tc_stream_enable(bool enabled);                    /* Starts or stops recording. Off at boot. */
+bool tc_stream_isEnabled(void);                         /* Gets whether the stream is recording. */
+void tc_stream_record(const tc_stream_sample_t *sample); /* Records a sample, if enabled. Only called from the TC thread. */
+uint16_t tc_stream_pack(uint8_t *buffer, uint16_t size); /* Packs the oldest samples into a datagram. Returns its length, or 0 if there is nothing to send. Only called from the stream thread. */
+tc_stream_stats_t tc_stream_getStats(void);             /* Gets the stream's counters. */
+
+#endif /* u_tc_stream.h */
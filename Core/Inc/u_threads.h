@@ -18,6 +18,7 @@ uint8_t threads_init(TX_BYTE_POOL *byte_pool);
 /* Thread Functions */
 void vDefault(ULONG thread_input);
 void vEthernet1Manager(ULONG thread_input);
+void vTireCurveServer(ULONG thread_input);
 void vCANIncoming(ULONG thread_input);
 void vCANOutgoing(ULONG thread_input);
 void vFaults(ULONG thread_input);
@@ -25,8 +26,9 @@ void vFaultsQueue(ULONG thread_input);
 void vShutdown(ULONG thread_input);
 void vStatemachine(ULONG thread_input);
 void vPedals(ULONG thread_input);
+void vTractionControl(ULONG thread_input);
+void vTCStream(ULONG thread_input);
 void vEFuses(ULONG thread_input);
-void vMux(ULONG thread_input);
 void vPeripherals(ULONG thread_input);
 void vTest(ULONG thread_input);
 void vRTDS(ULONG thread_input);
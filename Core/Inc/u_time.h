@@ -0,0 +1,19 @@
+#ifndef __U_TIME_H
+#define __U_TIME_H
+
+#include <stdint.h>
+
+/* This file includes the VCU's monotonic time base, for dt computations in the control code.
+*
+*  Built on the DWT cycle counter, extended to 64 bits so it never wraps. Every function here can be
+*  called from threads and ISRs. HAL_GetTick() is still fine for timeouts.
+*/
+
+/* API */
+void time_init(void);                          /* Starts the cycle counter. Call once, right after the system clock is configured. */
+void time_tickCallback(void);                  /* Called from the 1 ms HAL tick, so the counter is extended at least once per wrap. */
+uint64_t time_getCycles(void);                 /* Gets the number of core clock cycles since time_init(). */
+uint64_t time_getMicros(void);                 /* Gets the number of microseconds since time_init(). */
+float time_getElapsedSeconds(uint64_t *since); /* Gets the seconds since *since (us), and sets *since to now. 0 the first time (*since == 0). */
+
+#endif /* u_time.h */
@@ -25,6 +25,7 @@
 /* USER CODE BEGIN Includes */
 #include "u_adc.h"
 #include "u_bms.h"
+#include "u_calibration.h"
 #include "u_ethernet.h"
 #include "u_faults.h"
 #include "u_lightning.h"
@@ -89,6 +90,7 @@ UINT App_ThreadX_Init(VOID *memory_ptr)
   CATCH_ERROR(faults_init(), U_SUCCESS);
   CATCH_ERROR(mutexes_init(), U_SUCCESS);
   CATCH_ERROR(rtds_init(), U_SUCCESS);
+  CATCH_ERROR(calibration_init(), U_SUCCESS);
   CATCH_ERROR(efuse_init(), U_SUCCESS);
   CATCH_ERROR(pedals_init(), U_SUCCESS);
   CATCH_ERROR(bms_init(), U_SUCCESS);
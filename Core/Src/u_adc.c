@@ -1,8 +1,10 @@
 #include <stdint.h>
+#include <stdbool.h>
 #include "u_tx_debug.h"
 #include "main.h"
 #include "u_mutexes.h"
 #include "u_adc.h"
+#include "u_calibration.h"
 #include "serial.h"
 
 /* ADC1 Config. */
@@ -62,58 +64,199 @@ typedef enum {
 } _mux_t;
 static volatile uint16_t _mux_buffer[MUX_SIZE] = { 0 };
 
-/* Manage muxs and updates the mux buffer. */
+/* Mux scanning. */
+/* ADC1 converts its whole sequence on every TIM6 update (1 kHz, see CubeMX), and each DMA complete interrupt steps the scan.
+*  The first sequence after the select lines switch was sampled while the mux settled, so it's thrown away. The second is
+*  kept, and the lines switch again. That refreshes every mux input once per four sequences (250 Hz), without a thread. */
 typedef enum { HIGH, LOW } _mux_state_t;
-static _mux_state_t mux_state_debug = LOW;
-int adc_switchMuxState(void) {
-    static _mux_state_t mux_state = LOW;
+static volatile _mux_state_t _mux_state = LOW;
+static bool _mux_settling = true; // The last sequence started before the select lines settled
+
+/* Drives all four select lines. */
+static void _mux_select(GPIO_PinState state) {
+    HAL_GPIO_WritePin(MUX_SEL1_GPIO_Port, MUX_SEL1_Pin, state);
+    HAL_GPIO_WritePin(MUX_SEL2_GPIO_Port, MUX_SEL2_Pin, state);
+    HAL_GPIO_WritePin(MUX_SEL3_GPIO_Port, MUX_SEL3_Pin, state);
+    HAL_GPIO_WritePin(MUX_SEL4_GPIO_Port, MUX_SEL4_Pin, state);
+}
+
+/* eFuse readings, as of the last finished sequence. */
+/* The DMA rewrites _adc1_buffer while ADC1 converts, so a thread reading it straight could mix two sequences. The
+*  readings are copied out here instead, while ADC1 is idle until the next TIM6 update, and adc_getEFuseData() copies
+*  them with the interrupt masked. */
+static volatile uint16_t _efuse_buffer[NUM_EFUSES];
+
+/* Copies the eFuse readings out of the finished sequence, and the mux. */
+static void _latch_efuses(void) {
+    _efuse_buffer[EFUSE_DASHBOARD] = _adc1_buffer[ADC1_CHANNEL3];
+    _efuse_buffer[EFUSE_BRAKE] = _mux_buffer[SEL1_HIGH];
+    _efuse_buffer[EFUSE_SHUTDOWN] = _mux_buffer[SEL3_LOW];
+    _efuse_buffer[EFUSE_LV] = _mux_buffer[SEL3_HIGH];
+    _efuse_buffer[EFUSE_RADFAN] = _mux_buffer[SEL4_HIGH];
+    _efuse_buffer[EFUSE_FANBATT] = _adc1_buffer[ADC1_CHANNEL6];
+    _efuse_buffer[EFUSE_PUMP1] = _adc1_buffer[ADC1_CHANNEL2];
+    _efuse_buffer[EFUSE_PUMP2] = _adc1_buffer[ADC1_CHANNEL13];
+    _efuse_buffer[EFUSE_BATTBOX] = _mux_buffer[SEL1_LOW];
+    _efuse_buffer[EFUSE_MC] = _adc1_buffer[ADC1_CHANNEL18];
+}
+
+/* Steps the mux scan. Called from the ADC1 DMA complete interrupt, at the end of each sequence. */
+void adc_sequenceCallback(void) {
+    /* The mux was still settling while this sequence was sampled. Its direct inputs are still good. */
+    if(_mux_settling) {
+        _mux_settling = false;
+        _latch_efuses();
+        return;
+    }
 
-    if(mux_state == LOW) {
+    if(_mux_state == LOW) {
         /* Mux is currently LOW, so update LOW values. */
         _mux_buffer[SEL1_LOW] = _adc1_buffer[ADC1_CHANNEL0];
         _mux_buffer[SEL2_LOW] = _adc1_buffer[ADC1_CHANNEL15];
         _mux_buffer[SEL3_LOW] = _adc1_buffer[ADC1_CHANNEL5];
         _mux_buffer[SEL4_LOW] = _adc1_buffer[ADC1_CHANNEL9];
 
-        /* Mux is currently LOW, so switch to HIGH. */
-        HAL_GPIO_WritePin(MUX_SEL1_GPIO_Port, MUX_SEL1_Pin, GPIO_PIN_SET);
-        HAL_GPIO_WritePin(MUX_SEL2_GPIO_Port, MUX_SEL2_Pin, GPIO_PIN_SET);
-        HAL_GPIO_WritePin(MUX_SEL3_GPIO_Port, MUX_SEL3_Pin, GPIO_PIN_SET);
-        HAL_GPIO_WritePin(MUX_SEL4_GPIO_Port, MUX_SEL4_Pin, GPIO_PIN_SET);
-
-        tx_thread_sleep(10); // Sleep for 10 ticks so the mux settles.
-        mux_state = HIGH;   // Update the mux state
-
-        PRINTLN_INFO("Switched mux_state to HIGH.");
+        /* Switch to HIGH. */
+        _mux_select(GPIO_PIN_SET);
+        _mux_state = HIGH;
     }
-    else if(mux_state == HIGH) {
-
+    else {
         /* Mux is currently HIGH, so update HIGH values. */
         _mux_buffer[SEL1_HIGH] = _adc1_buffer[ADC1_CHANNEL0];
         _mux_buffer[SEL2_HIGH] = _adc1_buffer[ADC1_CHANNEL15];
         _mux_buffer[SEL3_HIGH] = _adc1_buffer[ADC1_CHANNEL5];
         _mux_buffer[SEL4_HIGH] = _adc1_buffer[ADC1_CHANNEL9];
 
-        /* Mux is currently HIGH, so switch to LOW. */
-        HAL_GPIO_WritePin(MUX_SEL1_GPIO_Port, MUX_SEL1_Pin, GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(MUX_SEL2_GPIO_Port, MUX_SEL2_Pin, GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(MUX_SEL3_GPIO_Port, MUX_SEL3_Pin, GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(MUX_SEL4_GPIO_Port, MUX_SEL4_Pin, GPIO_PIN_RESET);
+        /* Switch to LOW. */
+        _mux_select(GPIO_PIN_RESET);
+        _mux_state = LOW;
+    }
+    _latch_efuses();
 
-        tx_thread_sleep(10); // Sleep for 10 ticks so the mux settles.
-        mux_state = LOW;   // Update the mux state
+    /* The inputs may not have settled by the next sequence, so it gets thrown away. */
+    _mux_settling = true;
+}
 
-        PRINTLN_INFO("Switched mux_state to LOW.");
-    }
-    mux_state_debug = mux_state;
+/* Pedal analog watchdogs (see u_adc.h). */
+/* A reading outside its window trips the watchdog on every conversion, so the interrupt turns itself off when it trips,
+*  and the pedals thread turns it back on once the reading is back in range. */
+typedef struct {
+    uint32_t number;        // ADC_ANALOGWATCHDOG_x
+    uint32_t channels[2];   // Channels it watches. 0 if unused.
+    uint16_t margin;        // Raw counts the window is pulled in by, to be at least as tight as the pedals thread's (see below)
+    uint32_t it;            // ADC_IT_AWDx
+    uint32_t flag;          // ADC_FLAG_AWDx
+} _pedal_watchdog_config_t;
+
+/* AWD2 and AWD3 only compare the top 8 bits of a conversion, so their windows are pulled in by most of an 8-bit step.
+*  That way they never trip later than the pedals thread would have. */
+#define AWD23_MARGIN 15
+static const _pedal_watchdog_config_t _pedal_watchdogs[NUM_PEDAL_WATCHDOGS] = {
+    [PEDAL_WATCHDOG_APPS1] = { ADC_ANALOGWATCHDOG_1, { ADC_CHANNEL_12, 0 }, 0, ADC_IT_AWD1, ADC_FLAG_AWD1 },
+    [PEDAL_WATCHDOG_APPS2] = { ADC_ANALOGWATCHDOG_2, { ADC_CHANNEL_10, 0 }, AWD23_MARGIN, ADC_IT_AWD2, ADC_FLAG_AWD2 },
+    [PEDAL_WATCHDOG_BRAKE] = { ADC_ANALOGWATCHDOG_3, { ADC_CHANNEL_2, ADC_CHANNEL_6 }, AWD23_MARGIN, ADC_IT_AWD3, ADC_FLAG_AWD3 },
+};
+static volatile uint32_t _pedal_watchdog_tick[NUM_PEDAL_WATCHDOGS];   // Tick each watchdog last tripped at
+static volatile bool _pedal_watchdog_tripped[NUM_PEDAL_WATCHDOGS];    // Tripped, and not taken by the pedals thread yet
+static volatile bool _pedal_watchdog_armed[NUM_PEDAL_WATCHDOGS];      // Interrupt enabled
+
+/* The watchdog state is shared with the ADC2 interrupt, so it is only touched with interrupts masked. */
+static uint32_t _lock(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
 
-    PRINTLN_INFO("Ran adc_switchMuxState()");
+static void _unlock(uint32_t primask) {
+    __set_PRIMASK(primask);
+}
 
+/* Sets up ADC2's analog watchdogs. Must be called before ADC2 starts converting, and after calibration_init(). */
+static int _pedal_watchdog_init(void) {
+    /* The APPS windows follow this board's calibration. */
+    const float windows[NUM_PEDAL_WATCHDOGS][2] = {
+        [PEDAL_WATCHDOG_APPS1] = { APPS1_FAULT_LOW, APPS1_FAULT_HIGH },
+        [PEDAL_WATCHDOG_APPS2] = { APPS2_FAULT_LOW, APPS2_FAULT_HIGH },
+        [PEDAL_WATCHDOG_BRAKE] = { BRAKE_FAULT_LOW, BRAKE_FAULT_HIGH },
+    };
+
+    for(uint8_t i = 0; i < NUM_PEDAL_WATCHDOGS; i++) {
+        const _pedal_watchdog_config_t *config = &_pedal_watchdogs[i];
+        for(uint8_t c = 0; c < 2 && config->channels[c] != 0; c++) {
+            /* AWD2 and AWD3 add each channel configured to the ones they already watch. */
+            ADC_AnalogWDGConfTypeDef awd = { 0 };
+            awd.WatchdogNumber = config->number;
+            awd.WatchdogMode = ADC_ANALOGWATCHDOG_SINGLE_REG;
+            awd.Channel = config->channels[c];
+            awd.ITMode = ENABLE;
+            awd.HighThreshold = PEDAL_VOLTS_TO_ADC(windows[i][1]) - config->margin;
+            awd.LowThreshold = PEDAL_VOLTS_TO_ADC(windows[i][0]) + config->margin;
+            awd.FilteringConfig = ADC_AWD_FILTERING_NONE;
+
+            int status = HAL_ADC_AnalogWDGConfig(&hadc2, &awd);
+            if(status != HAL_OK) {
+                PRINTLN_ERROR("Failed to configure ADC2 analog watchdog %d (Status: %d/%s).", i, status, hal_status_toString(status));
+                return U_ERROR;
+            }
+        }
+
+        _pedal_watchdog_tripped[i] = false;
+        _pedal_watchdog_armed[i] = true;
+    }
     return U_SUCCESS;
 }
 
-/* Start ADC DMA. */
+/* Called from the ADC2 interrupt when an analog watchdog trips. */
+void adc_watchdogCallback(uint32_t watchdog) {
+    for(uint8_t i = 0; i < NUM_PEDAL_WATCHDOGS; i++) {
+        if(_pedal_watchdogs[i].number != watchdog) {
+            continue;
+        }
+
+        /* Stop it tripping on every conversion until the pedals thread rearms it. */
+        __HAL_ADC_DISABLE_IT(&hadc2, _pedal_watchdogs[i].it);
+        _pedal_watchdog_armed[i] = false;
+        _pedal_watchdog_tick[i] = HAL_GetTick();
+        _pedal_watchdog_tripped[i] = true;
+        return;
+    }
+}
+
+/* Gets whether a pedal watchdog tripped since the last call, and the tick it tripped at. */
+bool adc_takePedalWatchdog(pedal_watchdog_t watchdog, uint32_t *tick) {
+    if(watchdog >= NUM_PEDAL_WATCHDOGS) {
+        return false;
+    }
+
+    uint32_t primask = _lock();
+    bool tripped = _pedal_watchdog_tripped[watchdog];
+    *tick = _pedal_watchdog_tick[watchdog];
+    _pedal_watchdog_tripped[watchdog] = false;
+    _unlock(primask);
+
+    return tripped;
+}
+
+/* Rearms a pedal watchdog that tripped. Only call it once the reading is back in its window, or it trips again straight away. */
+void adc_rearmPedalWatchdog(pedal_watchdog_t watchdog) {
+    if(watchdog >= NUM_PEDAL_WATCHDOGS || _pedal_watchdog_armed[watchdog]) {
+        return;
+    }
+
+    uint32_t primask = _lock();
+    __HAL_ADC_CLEAR_FLAG(&hadc2, _pedal_watchdogs[watchdog].flag);
+    __HAL_ADC_ENABLE_IT(&hadc2, _pedal_watchdogs[watchdog].it);
+    _pedal_watchdog_armed[watchdog] = true;
+    _unlock(primask);
+}
+
+/* Start ADC DMA, and the timer that triggers ADC1's sequences. */
 int adc_init(void) {
+    /* Start the mux scan from LOW. */
+    _mux_select(GPIO_PIN_RESET);
+    _mux_state = LOW;
+    _mux_settling = true;
+
     /* Start DMA for ADC1. */
     int status = HAL_ADC_Start_DMA(&hadc1, (uint32_t *) _adc1_buffer, ADC1_SIZE);
     if(status != HAL_OK) {
@@ -121,6 +264,11 @@ int adc_init(void) {
         return U_ERROR;
     }
 
+    /* Set up the pedal watchdogs, while ADC2 is still stopped. */
+    if(_pedal_watchdog_init() != U_SUCCESS) {
+        return U_ERROR;
+    }
+
     /* Start DMA for ADC2. */
     status = HAL_ADC_Start_DMA(&hadc2, (uint32_t *) _adc2_buffer, ADC2_SIZE);
     if(status != HAL_OK) {
@@ -128,26 +276,28 @@ int adc_init(void) {
         return U_ERROR;
     }
 
+    /* Start triggering ADC1. */
+    status = HAL_TIM_Base_Start(&htim6);
+    if(status != HAL_OK) {
+        PRINTLN_ERROR("Failed to start TIM6 for ADC1 (Status: %d/%s).", status, hal_status_toString(status));
+        return U_ERROR;
+    }
+
     PRINTLN_INFO("Ran adc_init().");
     return U_SUCCESS;
 }
 
-/* Get raw eFuse ADC Data. */
+/* Get raw eFuse ADC Data. All of it is from the same ADC1 sequence. */
 raw_efuse_adc_t adc_getEFuseData(void) {
     raw_efuse_adc_t efuses = { 0 };
 
-    efuses.data[EFUSE_DASHBOARD] = _adc1_buffer[ADC1_CHANNEL3];
-    efuses.data[EFUSE_BRAKE] = _mux_buffer[SEL1_HIGH];
-    efuses.data[EFUSE_SHUTDOWN] = _mux_buffer[SEL3_LOW];
-    efuses.data[EFUSE_LV] = _mux_buffer[SEL3_HIGH];
-    efuses.data[EFUSE_RADFAN] = _mux_buffer[SEL4_HIGH];
-    efuses.data[EFUSE_FANBATT] = _adc1_buffer[ADC1_CHANNEL6];
-    efuses.data[EFUSE_PUMP1] = _adc1_buffer[ADC1_CHANNEL2];
-    efuses.data[EFUSE_PUMP2] = _adc1_buffer[ADC1_CHANNEL13];
-    efuses.data[EFUSE_BATTBOX] = _mux_buffer[SEL1_LOW];
-    efuses.data[EFUSE_MC] = _adc1_buffer[ADC1_CHANNEL18];
-
-    // serial_monitor("adc1", "mux_state_debug (0=HIGH, 1=LOW)", "%d", mux_state_debug);
+    uint32_t primask = _lock();
+    for(efuse_t efuse = 0; efuse < NUM_EFUSES; efuse++) {
+        efuses.data[efuse] = _efuse_buffer[efuse];
+    }
+    _unlock(primask);
+
+    // serial_monitor("adc1", "_mux_state (0=HIGH, 1=LOW)", "%d", _mux_state);
     // serial_monitor("efuse_fanbatt", "_adc1_buffer[ADC1_CHANNEL6]=", "%d", _adc1_buffer[ADC1_CHANNEL6]);
 
     // serial_monitor("adc1", "ADC1_CHANNEL3", "%d", _adc1_buffer[ADC1_CHANNEL3]);
@@ -159,7 +309,7 @@ raw_efuse_adc_t adc_getEFuseData(void) {
     // serial_monitor("adc1", "ADC1_CHANNEL13", "%d", _adc1_buffer[ADC1_CHANNEL13]);
     // serial_monitor("adc1", "ADC1_CHANNEL18", "%d", _adc1_buffer[ADC1_CHANNEL18]);
     // serial_monitor("adc1", "ADC1_CHANNEL15 (mux)", "%d", _adc1_buffer[ADC1_CHANNEL15]);
-    // serial_monitor("adc1", "mux_state (0=HIGH, 1=LOW)", "%d", mux_state_debug);
+    // serial_monitor("adc1", "_mux_state (0=HIGH, 1=LOW)", "%d", _mux_state);
 
     // serial_monitor("mux_debug", "SEL1_LOW", "%d", _mux_buffer[SEL1_LOW]);
     // serial_monitor("mux_debug", "SEL1_HIGH", "%d", _mux_buffer[SEL1_HIGH]);
@@ -209,26 +359,16 @@ lfiu_adc_t adc_getLfiuData(void) {
     // serial_monitor("lfiu", "_mux_buffer[SEL2_LOW]", "%d", _mux_buffer[SEL2_LOW]);
     // serial_monitor("lfiu", "sensors.raw[LFIU_1]", "%d", sensors.raw[LFIU_1]);
     // serial_monitor("lfiu", "sensors.raw[LFIU_2]", "%d", sensors.raw[LFIU_2]);
-    // serial_monitor("lfiu", "mux_state (0=HIGH, 1=LOW)", "%d", mux_state_debug);
+    // serial_monitor("lfiu", "_mux_state (0=HIGH, 1=LOW)", "%d", _mux_state);
 
     /* Calculate the ADC voltage. */
     const float V_REF = 3.3f;
     sensors.voltage[LFIU_1] = (sensors.raw[LFIU_1] / 4095.0) * V_REF;
     sensors.voltage[LFIU_2] = (sensors.raw[LFIU_2] / 4095.0) * V_REF;
 
-    /* Calculate the LFIU_1 current. */
-    // CALUBRATED 6/13 center voltage
-    const float CENTER_VOLTAGE_LOW = 1.559f;
-
-    const float RATIO_LOW = 0.08f * 0.6;
-    sensors.current[LFIU_1] = ((sensors.voltage[LFIU_1] - CENTER_VOLTAGE_LOW) / RATIO_LOW);
-
-    /* Calculate the LFIU_2 current. */
-    // CALUBRATED 6/13 center voltage
-     const float CENTER_VOLTAGE_HIGH = 1.573;
-
-     const float RATIO_HIGH = 0.01f * 0.6;
-    sensors.current[LFIU_2] = ((sensors.voltage[LFIU_2] - CENTER_VOLTAGE_HIGH)  / RATIO_HIGH);
+    /* Calculate the LFIU currents, with this board's calibration. */
+    sensors.current[LFIU_1] = calibration_apply(CAL_LFIU_1, sensors.raw[LFIU_1]);
+    sensors.current[LFIU_2] = calibration_apply(CAL_LFIU_2, sensors.raw[LFIU_2]);
 
     return sensors;
 }
@@ -258,7 +398,7 @@ lvread_adc_t adc_getLVData(void) {
     return data;
 }
 
-/* Gets LV_BATT Voltage ADC data, and does all conversions based on a f(x) found experimentally based on readings from VCU 001. Should result in more accurate conversions. */
+/* Gets LV_BATT Voltage ADC data, and converts it with this board's calibration (see u_calibration.h). Should result in more accurate conversions. */
 lvread_adc_t adc_getLVData_2(void) {
     lvread_adc_t data = { 0 };
 
@@ -266,8 +406,7 @@ lvread_adc_t adc_getLVData_2(void) {
     data.raw = _mux_buffer[SEL4_LOW];
 
     /* Convert the raw ADC reading directly to the full LV Voltage. */
-    // Based on a linear fit computed via experimental data from VCU 001, we have: f(x) = 0.008988x - 0.89151  V, where f(x) is the full LV Voltage and x is the raw ADC reading.
-    data.voltage = (data.raw*0.008988) - 0.89151;
+    data.voltage = calibration_apply(CAL_LV, data.raw);
 
     return data;
 }
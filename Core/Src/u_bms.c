@@ -1,4 +1,5 @@
 #include <stdatomic.h>
+#include <math.h>
 #include "tx_api.h"
 #include "u_tx_timers.h"
 #include "u_bms.h"
@@ -13,6 +14,16 @@
 static _Atomic float battbox_temp;
 static _Atomic bool precharge = false; // Default to false until BMS confirms precharge is complete
 
+/* Current limits, as last reported by the BMS. They come in separate frames, so each is tracked on its own. */
+typedef struct {
+    _Atomic float amps;
+    _Atomic uint32_t tick;    // When it was received.
+    _Atomic bool received;
+} current_limit_t;
+
+static current_limit_t dcl; // Discharge current limit.
+static current_limit_t ccl; // Charge current limit.
+
 static void _bms_fault_callback(ULONG args); // Forward declaration
 
 static timer_t bms_fault_timer = {
@@ -45,9 +56,37 @@ int bms_init(void) {
     return U_SUCCESS;
 }
 
-/* Restarts the BMS Fault Timer. */
-int bms_handleDclMessage(void)
+/* Reads a current limit out of a DTI current command (big endian int16, Amps * 10). Returns false if the frame is too short. */
+static bool _read_limit(const can_msg_t *message, current_limit_t *limit) {
+    if (message->len < 2) {
+        return false;
+    }
+    int16_t value = (int16_t)((message->data[0] << 8) | message->data[1]);
+    limit->amps = fabsf(value / 10.0f); // The DC brake current may be sent negative
+    limit->tick = HAL_GetTick();
+    limit->received = true;
+    return true;
+}
+
+/* Gets a current limit. Returns false until the BMS has sent it. */
+static bool _get_limit(const current_limit_t *limit, float *amps, uint32_t *timestamp) {
+    if (!limit->received) {
+        return false;
+    }
+
+    if (amps != NULL) *amps = limit->amps;
+    if (timestamp != NULL) *timestamp = limit->tick;
+    return true;
+}
+
+/* Records the discharge current limit and restarts the BMS Fault Timer. */
+/* The BMS sends its DCL to the DTI as a "set max DC current" command, which the VCU listens in on. */
+int bms_handleDclMessage(can_msg_t *message)
 {
+    if (!_read_limit(message, &dcl)) {
+        PRINTLN_WARNING("Received a BMS DCL message that is too short to hold the limit (Length: %d).", message->len);
+    }
+
     int status = timer_restart(&bms_fault_timer);
     if(status != U_SUCCESS) {
         PRINTLN_ERROR("Failed to restart BMS Fault timer (Status: %d).", status);
@@ -57,6 +96,25 @@ int bms_handleDclMessage(void)
     return U_SUCCESS;
 }
 
+/* Records the charge current limit. */
+/* The BMS sends its CCL to the DTI as a "set max DC brake current" command. */
+void bms_handleCclMessage(can_msg_t *message)
+{
+    if (!_read_limit(message, &ccl)) {
+        PRINTLN_WARNING("Received a BMS CCL message that is too short to hold the limit (Length: %d).", message->len);
+    }
+}
+
+/* Gets the discharge current limit from the BMS. Returns false until the BMS has sent it. */
+bool bms_getDischargeLimit(float *discharge, uint32_t *timestamp) {
+    return _get_limit(&dcl, discharge, timestamp);
+}
+
+/* Gets the charge current limit from the BMS. Returns false until the BMS has sent it. */
+bool bms_getChargeLimit(float *charge, uint32_t *timestamp) {
+    return _get_limit(&ccl, charge, timestamp);
+}
+
 /* Returns the battbox temperature. */
 float bms_getBattboxTemp(void) {
     return battbox_temp;
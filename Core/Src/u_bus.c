@@ -0,0 +1,211 @@
+#include "u_bus.h"
+#include "u_tx_debug.h"
+#include "tx_api.h"
+
+/* This file includes the VCU's bus manager (see u_bus.h). */
+
+/* I2C2 Bus */
+bus_t i2c2_bus = {
+    .name = "I2C2 Bus",            /* Name of the bus. */
+    .type = BUS_I2C,               /* Type of the bus. */
+    .handle = &hi2c2               /* HAL handle of the bus. */
+};
+
+/* SPI2 Bus */
+bus_t spi2_bus = {
+    .name = "SPI2 Bus",            /* Name of the bus. */
+    .type = BUS_SPI,               /* Type of the bus. */
+    .handle = &hspi2               /* HAL handle of the bus. */
+};
+
+/* The queues are shared with interrupts, so they are only touched with interrupts masked. */
+static uint32_t _lock(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static void _unlock(uint32_t primask) {
+    __set_PRIMASK(primask);
+}
+
+/* Puts a transaction on the bus. */
+static HAL_StatusTypeDef _begin(bus_t *bus, bus_txn_t *txn) {
+    txn->start = HAL_GetTick();
+
+    switch(txn->op) {
+        case BUS_I2C_WRITE:
+            return HAL_I2C_Master_Transmit_IT((I2C_HandleTypeDef *)bus->handle, txn->address, (uint8_t *)txn->tx, txn->length);
+        case BUS_I2C_READ:
+            return HAL_I2C_Master_Receive_IT((I2C_HandleTypeDef *)bus->handle, txn->address, txn->rx, txn->length);
+        case BUS_I2C_MEM_READ:
+            return HAL_I2C_Mem_Read_IT((I2C_HandleTypeDef *)bus->handle, txn->address, txn->mem_address, txn->mem_size, txn->rx, txn->length);
+        case BUS_SPI_TXRX: {
+            HAL_GPIO_WritePin(txn->cs_port, txn->cs_pin, GPIO_PIN_RESET);
+            HAL_StatusTypeDef status = HAL_SPI_TransmitReceive_DMA((SPI_HandleTypeDef *)bus->handle, txn->tx, txn->rx, txn->length);
+            if(status != HAL_OK) {
+                HAL_GPIO_WritePin(txn->cs_port, txn->cs_pin, GPIO_PIN_SET);
+            }
+            return status;
+        }
+        default:
+            return HAL_ERROR;
+    }
+}
+
+/* Takes the transaction on the bus off the queue, and reports how it went. */
+static void _finish(bus_t *bus, bus_txn_t *txn, bus_status_t status) {
+    uint32_t primask = _lock();
+    bus->head = txn->next;
+    if(bus->head == NULL) {
+        bus->tail = NULL;
+    }
+    bus->busy = false;
+    _unlock(primask);
+
+    if(txn->op == BUS_SPI_TXRX) {
+        HAL_GPIO_WritePin(txn->cs_port, txn->cs_pin, GPIO_PIN_SET);
+    }
+
+    switch(status) {
+        case BUS_DONE:      bus->stats.done++; break;
+        case BUS_TIMED_OUT: bus->stats.timed_out++; break;
+        default:            bus->stats.failed++; break;
+    }
+
+    txn->status = status;
+    if(txn->callback != NULL) {
+        txn->callback(txn);
+    }
+}
+
+/* Puts the next queued transaction on the bus, if the bus is idle. */
+static void _kick(bus_t *bus) {
+    while(1) {
+        uint32_t primask = _lock();
+        bus_txn_t *txn = bus->head;
+        if(bus->busy || bus->aborting || txn == NULL) {
+            _unlock(primask);
+            return;
+        }
+        bus->busy = true;
+        _unlock(primask);
+
+        if(_begin(bus, txn) == HAL_OK) {
+            return;
+        }
+        _finish(bus, txn, BUS_FAILED);
+    }
+}
+
+/* Stops the transaction on the bus. For I2C the peripheral is reset too, since a hung device can leave it stuck busy. */
+static void _abort(bus_t *bus) {
+    if(bus->type == BUS_SPI) {
+        HAL_SPI_Abort((SPI_HandleTypeDef *)bus->handle);
+        return;
+    }
+
+    I2C_HandleTypeDef *handle = (I2C_HandleTypeDef *)bus->handle;
+    HAL_I2C_DeInit(handle);
+    if(HAL_I2C_Init(handle) != HAL_OK
+       || HAL_I2CEx_ConfigAnalogFilter(handle, I2C_ANALOGFILTER_ENABLE) != HAL_OK
+       || HAL_I2CEx_ConfigDigitalFilter(handle, 0) != HAL_OK) {
+        PRINTLN_ERROR("Failed to reset %s after a timeout.", bus->name);
+    }
+}
+
+/* Queues a transaction. Its callback runs when it finishes, from interrupt context (or from here, if the HAL refuses it). */
+int bus_submit(bus_t *bus, bus_txn_t *txn) {
+    if(bus == NULL || txn == NULL || txn->length == 0) {
+        return U_ERROR;
+    }
+
+    txn->status = BUS_PENDING;
+    txn->next = NULL;
+
+    uint32_t primask = _lock();
+    if(bus->tail == NULL) {
+        bus->head = txn;
+    } else {
+        bus->tail->next = txn;
+    }
+    bus->tail = txn;
+    _unlock(primask);
+
+    _kick(bus);
+    return U_SUCCESS;
+}
+
+/* Wakes the thread waiting in bus_transfer(). */
+static void _wake(bus_txn_t *txn) {
+    tx_semaphore_put((TX_SEMAPHORE *)txn->context);
+}
+
+/* Queues a transaction and waits for it to finish. Only call this from a thread.
+*  The wait only counts once the transaction is on the bus, but whatever is ahead of it in the queue is held to its own timeout. */
+int bus_transfer(bus_t *bus, bus_txn_t *txn) {
+    TX_SEMAPHORE done;
+    if(tx_semaphore_create(&done, (CHAR *)bus->name, 0) != TX_SUCCESS) {
+        PRINTLN_ERROR("Failed to create a semaphore for a %s transaction.", bus->name);
+        return U_ERROR;
+    }
+    txn->callback = _wake;
+    txn->context = &done;
+
+    if(bus_submit(bus, txn) != U_SUCCESS) {
+        tx_semaphore_delete(&done);
+        return U_ERROR;
+    }
+
+    /* Each time the wait runs out, time out whatever is hogging the bus. Eventually that is this transaction. */
+    while(tx_semaphore_get(&done, txn->timeout + 1) != TX_SUCCESS) {
+        bus_expire(bus);
+    }
+    tx_semaphore_delete(&done);
+
+    if(txn->status != BUS_DONE) {
+        PRINTLN_ERROR("%s transaction %s.", bus->name, (txn->status == BUS_TIMED_OUT) ? "timed out" : "failed");
+        return U_ERROR;
+    }
+    return U_SUCCESS;
+}
+
+/* Aborts the transaction on the bus if it has been there longer than its timeout. Only call this from a thread. */
+void bus_expire(bus_t *bus) {
+    uint32_t primask = _lock();
+    bus_txn_t *txn = bus->head;
+    if(!bus->busy || bus->aborting || txn == NULL || HAL_GetTick() - txn->start <= txn->timeout) {
+        _unlock(primask);
+        return;
+    }
+    bus->aborting = true;
+    _unlock(primask);
+
+    _abort(bus);
+    _finish(bus, txn, BUS_TIMED_OUT);
+    bus->aborting = false;
+    _kick(bus);
+}
+
+/* Called from the bus's transfer complete interrupts. */
+void bus_completeCallback(bus_t *bus) {
+    if(bus->aborting || !bus->busy) {
+        return;
+    }
+    _finish(bus, bus->head, BUS_DONE);
+    _kick(bus);
+}
+
+/* Called from the bus's error interrupts. */
+void bus_errorCallback(bus_t *bus) {
+    if(bus->aborting || !bus->busy) {
+        return;
+    }
+    _finish(bus, bus->head, BUS_FAILED);
+    _kick(bus);
+}
+
+/* Gets a bus's transaction counters. */
+bus_stats_t bus_getStats(const bus_t *bus) {
+    return bus->stats;
+}
@@ -0,0 +1,182 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include "main.h"
+#include "u_calibration.h"
+#include "u_flash.h"
+#include "u_pedals.h"
+#include "u_tx_debug.h"
+
+/* This file includes the VCU's per-board ADC calibration (see u_calibration.h). */
+
+#define CAL_STORE_MAGIC 0x4C414343 // "CCAL" in hex, a record in _calibration_store
+
+/* Conversions the nominal pairs are built from. */
+#define LFIU_VOLTS_PER_COUNT  (3.3f / 4095.0f)                                     // (Volts). LFIU ADC reading, as adc_getLfiuData() reports it.
+#define PEDAL_VOLTS_PER_COUNT ((float)(MAX_VOLTS / MAX_ADC_VAL_12b / PEDAL_DIVIDER)) // (Volts). Pedal sensor voltage, before the divider.
+
+/* Nominal calibration, from VCU 001. */
+#define NOMINAL_LFIU_1_CENTER 1.559f          // (Volts). LFIU_1 output at 0 A. Calibrated 6/13.
+#define NOMINAL_LFIU_1_RATIO  (0.08f * 0.6f)  // (Volts/Amp).
+#define NOMINAL_LFIU_2_CENTER 1.573f          // (Volts). LFIU_2 output at 0 A. Calibrated 6/13.
+#define NOMINAL_LFIU_2_RATIO  (0.01f * 0.6f)  // (Volts/Amp).
+#define NOMINAL_LV_GAIN       0.008988f       // (Volts/count). Linear fit of LV_BATT readings against a meter.
+#define NOMINAL_LV_OFFSET     -0.89151f       // (Volts).
+#define NOMINAL_APPS1_MIN     2.1f            // (Volts). APPS1 voltage at rest.
+#define NOMINAL_APPS1_MAX     3.4f            // (Volts). APPS1 voltage fully pressed.
+#define NOMINAL_APPS2_MIN     1.1f            // (Volts). APPS2 voltage at rest.
+#define NOMINAL_APPS2_MAX     2.2f            // (Volts). APPS2 voltage fully pressed.
+
+static const cal_pair_t _nominal[NUM_CAL_CHANNELS] = {
+    [CAL_LFIU_1] = { LFIU_VOLTS_PER_COUNT / NOMINAL_LFIU_1_RATIO, -NOMINAL_LFIU_1_CENTER / NOMINAL_LFIU_1_RATIO },
+    [CAL_LFIU_2] = { LFIU_VOLTS_PER_COUNT / NOMINAL_LFIU_2_RATIO, -NOMINAL_LFIU_2_CENTER / NOMINAL_LFIU_2_RATIO },
+    [CAL_LV]     = { NOMINAL_LV_GAIN, NOMINAL_LV_OFFSET },
+    [CAL_APPS_1] = { PEDAL_VOLTS_PER_COUNT / (NOMINAL_APPS1_MAX - NOMINAL_APPS1_MIN), -NOMINAL_APPS1_MIN / (NOMINAL_APPS1_MAX - NOMINAL_APPS1_MIN) },
+    [CAL_APPS_2] = { PEDAL_VOLTS_PER_COUNT / (NOMINAL_APPS2_MAX - NOMINAL_APPS2_MIN), -NOMINAL_APPS2_MIN / (NOMINAL_APPS2_MAX - NOMINAL_APPS2_MIN) },
+};
+
+/* A calibration record, in _calibration_store. */
+typedef struct {
+    uint32_t magic;                       // CAL_STORE_MAGIC
+    uint32_t size;                        // sizeof(cal_record_t), so a record from an older layout is ignored
+    uint32_t serial[3];                   // Unique ID of the board it was measured on
+    cal_pair_t pairs[NUM_CAL_CHANNELS];
+    uint32_t crc32;                       // IEEE 802.3, over everything before it
+} cal_record_t;
+
+/* The pairs in use. Written by calibration_set() while the ADC users read them, so they're guarded by a sequence count (odd while a write is in progress). */
+static cal_pair_t _pairs[NUM_CAL_CHANNELS];
+static _Atomic uint32_t _pairs_seq;
+static _Atomic bool _writing;
+
+/* Bitwise CRC32 (IEEE 802.3, as zlib.crc32). Only run at boot and when saving. */
+static uint32_t _crc32(const uint8_t *data, uint32_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+    for(uint32_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for(uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/* Gets this board's serial. */
+static void _get_serial(uint32_t serial[3]) {
+    serial[0] = HAL_GetUIDw0();
+    serial[1] = HAL_GetUIDw1();
+    serial[2] = HAL_GetUIDw2();
+}
+
+/* Whether a pair can convert both ways. */
+static bool _is_valid(const cal_pair_t *pair) {
+    return isfinite(pair->gain) && isfinite(pair->offset) && pair->gain != 0.0f;
+}
+
+/* Loads this board's calibration from flash, or the nominal one. */
+int calibration_init(void) {
+    memcpy(_pairs, _nominal, sizeof(_pairs));
+
+    cal_record_t record;
+    memcpy(&record, _calibration_store, sizeof(record));
+    if(record.magic != CAL_STORE_MAGIC || record.size != sizeof(record)) {
+        PRINTLN_WARNING("No stored ADC calibration, using the nominal one.");
+        return U_SUCCESS;
+    }
+
+    uint32_t crc = _crc32((const uint8_t *)&record, offsetof(cal_record_t, crc32));
+    if(crc != record.crc32) {
+        PRINTLN_ERROR("Stored ADC calibration failed its CRC check (CRC: 0x%lX, Expected: 0x%lX). Using the nominal one.", crc, record.crc32);
+        return U_SUCCESS;
+    }
+
+    uint32_t serial[3];
+    _get_serial(serial);
+    if(memcmp(serial, record.serial, sizeof(serial)) != 0) {
+        PRINTLN_WARNING("Stored ADC calibration is from another board (Serial: %08lX%08lX%08lX). Using the nominal one.", record.serial[2], record.serial[1], record.serial[0]);
+        return U_SUCCESS;
+    }
+
+    for(uint8_t i = 0; i < NUM_CAL_CHANNELS; i++) {
+        if(!_is_valid(&record.pairs[i])) {
+            PRINTLN_ERROR("Stored ADC calibration has an invalid pair for channel %d. Using the nominal one.", i);
+            return U_SUCCESS;
+        }
+    }
+
+    memcpy(_pairs, record.pairs, sizeof(_pairs));
+    PRINTLN_INFO("Loaded the stored ADC calibration.");
+    return U_SUCCESS;
+}
+
+/* Gets a channel's gain and offset. */
+cal_pair_t calibration_get(cal_channel_t channel) {
+    cal_pair_t pair;
+    uint32_t seq;
+    do {
+        seq = atomic_load_explicit(&_pairs_seq, memory_order_acquire);
+        pair = _pairs[channel];
+        atomic_thread_fence(memory_order_acquire);
+    } while((seq & 1) || seq != atomic_load_explicit(&_pairs_seq, memory_order_relaxed));
+    return pair;
+}
+
+/* Converts a raw reading into the channel's unit. */
+float calibration_apply(cal_channel_t channel, uint16_t raw) {
+    cal_pair_t pair = calibration_get(channel);
+    return raw * pair.gain + pair.offset;
+}
+
+/* Gets the raw reading a value converts from. Not rounded or clamped to the ADC's range. */
+float calibration_toRaw(cal_channel_t channel, float value) {
+    cal_pair_t pair = calibration_get(channel);
+    return (value - pair.offset) / pair.gain;
+}
+
+/* Changes a channel's gain and offset, until the next boot (or calibration_save()). */
+int calibration_set(cal_channel_t channel, const cal_pair_t *pair) {
+    if(channel >= NUM_CAL_CHANNELS || !_is_valid(pair)) {
+        PRINTLN_WARNING("Rejected ADC calibration for channel %d (gain=%f, offset=%f).", channel, pair->gain, pair->offset);
+        return U_ERROR;
+    }
+    if(atomic_exchange(&_writing, true)) {
+        PRINTLN_WARNING("ADC calibration is already being updated.");
+        return U_ERROR;
+    }
+
+    uint32_t seq = atomic_load_explicit(&_pairs_seq, memory_order_relaxed);
+    atomic_store_explicit(&_pairs_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    _pairs[channel] = *pair;
+    atomic_store_explicit(&_pairs_seq, seq + 2, memory_order_release);
+
+    _writing = false;
+    PRINTLN_INFO("Set ADC calibration for channel %d (gain=%f, offset=%f).", channel, pair->gain, pair->offset);
+    return U_SUCCESS;
+}
+
+/* Stores the current pairs in flash, for this board. Stalls bank 2 while it writes, so don't call it from a control thread. */
+int calibration_save(void) {
+    if(atomic_exchange(&_writing, true)) {
+        PRINTLN_WARNING("ADC calibration is already being updated.");
+        return U_ERROR;
+    }
+
+    cal_record_t record = { .magic = CAL_STORE_MAGIC, .size = sizeof(record) };
+    _get_serial(record.serial);
+    memcpy(record.pairs, _pairs, sizeof(record.pairs)); // Only this thread writes them while _writing is set
+    record.crc32 = _crc32((const uint8_t *)&record, offsetof(cal_record_t, crc32));
+
+    int status = U_SUCCESS;
+    if(flash_eraseSector(_calibration_store) != U_SUCCESS || flash_write(_calibration_store, &record, sizeof(record)) != U_SUCCESS) {
+        PRINTLN_ERROR("Failed to store the ADC calibration.");
+        status = U_ERROR;
+    } else {
+        PRINTLN_INFO("Stored the ADC calibration.");
+    }
+
+    _writing = false;
+    return status;
+}
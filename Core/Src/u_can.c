@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <string.h>
 #include "u_can.h"
 #include "u_tx_debug.h"
 #include "u_nx_ethernet.h"
@@ -12,6 +13,7 @@
 #include "u_efuses.h"
 #include "serial.h"
 #include "u_shutdown.h"
+#include "u_suspension.h"
 #include "can_messages_tx.h"
 #include "can_messages_rx.h"
 
@@ -60,13 +62,30 @@ uint8_t can1_init(FDCAN_HandleTypeDef *hcan) {
     }
 
     /* Add filters for standard IDs */
-    uint16_t standard5[] = {CANID_SHUTDOWN, 0x00};
+    uint16_t standard5[] = {CANID_SHUTDOWN, CANID_BMS_CCL_MSG};
     status = can_add_filter_standard(&can1, standard5);
     if (status != HAL_OK) {
         PRINTLN_ERROR("Failed to add standard filter to can1 (Status: %d/%s, ID1: 0x%X, ID2: 0x%X).", status, hal_status_toString(status), standard5[0], standard5[1]);
         return U_ERROR;
     }
 
+#ifdef SUSPENSION_LOAD_CEILING
+    /* Suspension, for TC's rear load estimate. */
+    uint16_t standard6[] = {CANID_FRONT_SHOCKPOT, CANID_FRONT_RIDE_HEIGHT};
+    status = can_add_filter_standard(&can1, standard6);
+    if (status != HAL_OK) {
+        PRINTLN_ERROR("Failed to add standard filter to can1 (Status: %d/%s, ID1: 0x%X, ID2: 0x%X).", status, hal_status_toString(status), standard6[0], standard6[1]);
+        return U_ERROR;
+    }
+
+    uint16_t standard7[] = {CANID_BACK_SHOCKPOT, CANID_BACK_RIDE_HEIGHT};
+    status = can_add_filter_standard(&can1, standard7);
+    if (status != HAL_OK) {
+        PRINTLN_ERROR("Failed to add standard filter to can1 (Status: %d/%s, ID1: 0x%X, ID2: 0x%X).", status, hal_status_toString(status), standard7[0], standard7[1]);
+        return U_ERROR;
+    }
+#endif
+
 
 
     /* Add fitlers for extended IDs */
@@ -118,13 +137,21 @@ uint8_t can1_init(FDCAN_HandleTypeDef *hcan) {
     }
 
     /* Add fitlers for extended IDs */
-    uint32_t extended7[] = {CANID_LIGHTNING_PULSE, 0x00};
+    uint32_t extended7[] = {CANID_LIGHTNING_PULSE, CANID_CALYPSO_TC_CURVE};
     status = can_add_filter_extended(&can1, extended7);
     if (status != HAL_OK) {
         PRINTLN_ERROR("Failed to add extended filter to can1 (Status: %d/%s, ID1: %ld, ID2: %ld).", status, hal_status_toString(status), extended7[0], extended7[1]);
         return U_ERROR;
     }
 
+    /* Front wheel speeds (0xDB0 doesn't fit in an 11-bit ID, so it is sent extended), and TC tuning. */
+    uint32_t extended8[] = {CANID_F_RPM, CANID_CALYPSO_TC_GAINS};
+    status = can_add_filter_extended(&can1, extended8);
+    if (status != HAL_OK) {
+        PRINTLN_ERROR("Failed to add extended filter to can1 (Status: %d/%s, ID1: %ld, ID2: %ld).", status, hal_status_toString(status), extended8[0], extended8[1]);
+        return U_ERROR;
+    }
+
     PRINTLN_INFO("Ran can1_init().");
 
     return U_SUCCESS;
@@ -134,7 +161,10 @@ uint8_t can1_init(FDCAN_HandleTypeDef *hcan) {
 void can_inbox(can_msg_t *message) {
     switch (message->id) {
     case CANID_BMS_DCL_MSG:
-        bms_handleDclMessage();
+        bms_handleDclMessage(message);
+        break;
+    case CANID_BMS_CCL_MSG:
+        bms_handleCclMessage(message);
         break;
     case CANID_BMS_CELL_TEMPS:
         cell_temperatures_t temps = { 0 };
@@ -148,6 +178,37 @@ void can_inbox(can_msg_t *message) {
     case CANID_F_RPM:
         tc_record_front_rpm(*message);
         break;
+    case CANID_CALYPSO_TC_CURVE:
+        /* Surface ID of the tire curve to select, up to 8 characters. Longer IDs can only be selected over MQTT. */
+        char surface_id[sizeof(message->data) + 1] = { 0 };
+        memcpy(surface_id, message->data, (message->len < sizeof(message->data)) ? message->len : sizeof(message->data));
+        tc_select_curve(surface_id);
+        break;
+    case CANID_CALYPSO_TC_GAINS:
+        tc_record_gains(*message);
+        break;
+#ifdef SUSPENSION_LOAD_CEILING
+    case CANID_FRONT_SHOCKPOT:
+        front_shockpot_t front_shock = { 0 };
+        receive_front_shockpot(message, &front_shock);
+        suspension_setShockpot(SUSPENSION_FRONT, front_shock.shock1);
+        break;
+    case CANID_BACK_SHOCKPOT:
+        back_shockpot_t back_shock = { 0 };
+        receive_back_shockpot(message, &back_shock);
+        suspension_setShockpot(SUSPENSION_REAR, back_shock.shock1);
+        break;
+    case CANID_FRONT_RIDE_HEIGHT:
+        front_ride_height_t front_height = { 0 };
+        receive_front_ride_height(message, &front_height);
+        suspension_setRideHeight(SUSPENSION_FRONT, front_height.rh);
+        break;
+    case CANID_BACK_RIDE_HEIGHT:
+        back_ride_height_t back_height = { 0 };
+        receive_back_ride_height(message, &back_height);
+        suspension_setRideHeight(SUSPENSION_REAR, back_height.rh);
+        break;
+#endif
     case DTI_CANID_TEMPS_FAULT:
         dti_record_temp(message);
         break;
@@ -23,11 +23,31 @@
 #include "u_emrax.h"
 #include "u_queues.h"
 #include "u_mutexes.h"
+#include "u_tx_timers.h"
+#include "u_nx_protobuf.h"
+#include "u_time.h"
 
 #define CAN_QUEUE_SIZE 5 /* messages */
 #define SAMPLES \
 	3 /* determines number of torque request samples to average for dti*/
 
+/* Power limiter. */
+#define POWER_LIMIT_EFFICIENCY	     0.90f /* Motor + inverter efficiency used to predict the torque headroom (EMRAX_PEAK_EFFICIENCY) */
+#define POWER_LIMIT_TARGET	     0.95f /* Fraction of the cap the limiter regulates to, leaves margin for transients */
+#define POWER_LIMIT_KI		     2.0f  /* 1/s. Integral gain of the closed loop trim on the power budget */
+#define POWER_LIMIT_TRIM_MIN	     -0.30f /* Fraction of the cap. Bounds of the closed loop trim */
+#define POWER_LIMIT_TRIM_MAX	     0.05f
+#define POWER_LIMIT_RELEASE_RATE     2.0f  /* 1/s. How fast the torque scale may recover towards 1 */
+#define POWER_LIMIT_MIN_SPEED	     50.0f /* rad/s. Below this the headroom is unbounded (P = T*w is tiny) */
+#define POWER_LIMIT_MAX_DT	     0.1f  /* s. Longest gap between torque commands we integrate over */
+#define POWER_LIMIT_TELEMETRY_PERIOD 100   /* ticks */
+
+/* BMS current limits. */
+#define BMS_LIMIT_FALL_RATE 2000.0f /* A/s. How fast the applied limit follows a falling BMS limit */
+#define BMS_LIMIT_RISE_RATE 200.0f  /* A/s. How fast the applied limit follows a rising BMS limit */
+#define BMS_LIMIT_NONE	    1000.0f /* A. Applied limit until the BMS has reported one */
+#define MAX_AC_CURRENT	    (499 * 10) /* A x10. Largest AC current target sent to the DTI */
+
 
 /* Struct for all motor controller data. */
 typedef struct {
@@ -45,6 +65,324 @@ typedef struct {
 } dti_t;
 static dti_t mc = { 0 };
 
+/* Closed loop DC power limiter state. */
+typedef struct {
+	_Atomic float default_cap;    /* UNITS: Watts. Cap for the functional mode, set on every mode change */
+	_Atomic float override_cap;   /* UNITS: Watts. Cap set at runtime, 0 when not overridden. Survives mode changes */
+	_Atomic float torque_ceiling; /* UNITS: Nm. Motor torque the budget allows at the current speed */
+	_Atomic float scale;	      /* Torque scale applied to the last command, 0-1 */
+	_Atomic bool active;	      /* True while the last command was reduced */
+	_Atomic uint32_t limited_ms;  /* Time spent limited while commanding positive torque */
+	_Atomic uint32_t driving_ms;  /* Time spent commanding positive torque */
+	float trim;		      /* Closed loop correction to the budget, as a fraction of the cap */
+	uint64_t last_us;
+} power_limit_t;
+static power_limit_t power_limit = { .default_cap = DTI_POWER_LIMIT_MAX, .scale = 1.0f };
+
+/* A BMS current limit, as applied to the current targets. */
+typedef struct {
+	_Atomic float applied;	 /* UNITS: Amps DC. BMS limit, ramped */
+	_Atomic float reduction; /* Fraction of the last current target removed by the limit, 0-1 */
+	uint64_t last_us;
+} bms_limit_t;
+static bms_limit_t discharge_limit = { .applied = BMS_LIMIT_NONE };
+static bms_limit_t charge_limit = { .applied = BMS_LIMIT_NONE };
+
+/* Temperature derating tables, temperature (degC) -> max torque fraction. Written by
+ * dti_set_derate_table() while the torque path reads them, so each is guarded by a sequence
+ * count (odd while a write is in progress). */
+typedef struct {
+	derate_point_t points[DERATE_TABLE_POINTS_MAX];
+	uint8_t num_points;
+	_Atomic uint32_t seq;
+	_Atomic float fraction; /* Fraction from the last lookup */
+} derate_table_t;
+static derate_table_t derate_tables[NUM_DERATE_SOURCES] = {
+	[DERATE_MOTOR] = {
+		/* Back off well before EMRAX_MAX_MOTOR_TEMP */
+		.points = { { 90, 1.0f }, { 105, 0.7f }, { 115, 0.3f }, { EMRAX_MAX_MOTOR_TEMP, 0.0f } },
+		.num_points = 4,
+		.fraction = 1.0f,
+	},
+	[DERATE_CONTROLLER] = {
+		.points = { { 65, 1.0f }, { 75, 0.6f }, { 85, 0.0f } },
+		.num_points = 3,
+		.fraction = 1.0f,
+	},
+	[DERATE_BATTBOX] = {
+		.points = { { 50, 1.0f }, { 55, 0.6f }, { 60, 0.0f } },
+		.num_points = 3,
+		.fraction = 1.0f,
+	},
+};
+static _Atomic bool derate_writing;
+
+/**
+ * @brief Limits a positive motor torque request so that the pack power stays under the cap.
+ *
+ * The torque headroom is predicted from motor speed (T = P * efficiency / w), and an integral
+ * trim on the budget, driven by the measured P = V_dc * I_dc, corrects for the efficiency and
+ * measurement errors of that prediction. Reductions take effect immediately; the scale is
+ * released back towards 1 at POWER_LIMIT_RELEASE_RATE so the torque comes back smoothly.
+ *
+ * @param torque Averaged torque request (Nm)
+ * @return float The torque to command (Nm)
+ */
+static float _limit_power(float torque)
+{
+	float dt = time_getElapsedSeconds(&power_limit.last_us);
+	if (dt > POWER_LIMIT_MAX_DT) {
+		dt = POWER_LIMIT_MAX_DT;
+	}
+
+	float cap = dti_get_power_limit();
+	float omega = dti_get_rpm() * 2.0f * (float)M_PI / 60.0f;
+	float power = dti_get_dc_power();
+
+	/* Only trim while limiting, otherwise bleed the trim off so a stale correction doesn't
+	 * linger into the next pull. */
+	if (power_limit.active || power > cap * POWER_LIMIT_TARGET) {
+		power_limit.trim += POWER_LIMIT_KI * (POWER_LIMIT_TARGET - power / cap) * dt;
+	} else {
+		power_limit.trim -= power_limit.trim * dt;
+	}
+	if (power_limit.trim > POWER_LIMIT_TRIM_MAX) {
+		power_limit.trim = POWER_LIMIT_TRIM_MAX;
+	} else if (power_limit.trim < POWER_LIMIT_TRIM_MIN) {
+		power_limit.trim = POWER_LIMIT_TRIM_MIN;
+	}
+
+	float budget = cap * (POWER_LIMIT_TARGET + power_limit.trim);
+	float ceiling = (omega > POWER_LIMIT_MIN_SPEED) ?
+				budget * POWER_LIMIT_EFFICIENCY / omega :
+				EMRAX_PEAK_TORQUE;
+	power_limit.torque_ceiling = ceiling;
+
+	float scale = power_limit.scale;
+	float target = (torque > ceiling) ? ceiling / torque : 1.0f;
+	if (torque <= 0.0f || target >= scale) {
+		scale += POWER_LIMIT_RELEASE_RATE * dt;
+		if (scale > target) {
+			scale = target;
+		}
+	} else {
+		scale = target;
+	}
+	power_limit.scale = scale;
+	power_limit.active = torque > 0.0f && scale < 1.0f;
+
+	if (torque > 0.0f) {
+		uint32_t dt_ms = (uint32_t)lrintf(dt * 1000.0f);
+		power_limit.driving_ms += dt_ms;
+		if (power_limit.active) {
+			power_limit.limited_ms += dt_ms;
+		}
+		return torque * scale;
+	}
+	return torque;
+}
+
+/**
+ * @brief Linear interpolation into a derating table. Holds the end values outside the table.
+ *
+ * @param table The table to look up
+ * @param temp Temperature (degC)
+ * @return float Max torque fraction, 0-1
+ */
+static float _lookup_derate(derate_table_t *table, float temp)
+{
+	derate_point_t points[DERATE_TABLE_POINTS_MAX];
+	uint8_t n;
+	uint32_t seq;
+	do {
+		seq = atomic_load_explicit(&table->seq, memory_order_acquire);
+		n = table->num_points;
+		memcpy(points, table->points, sizeof(points));
+		atomic_thread_fence(memory_order_acquire);
+	} while ((seq & 1) ||
+		 seq != atomic_load_explicit(&table->seq, memory_order_relaxed));
+
+	float fraction = points[n - 1].fraction;
+
+	if (temp <= points[0].temp) {
+		fraction = points[0].fraction;
+	} else {
+		for (uint8_t i = 1; i < n; i++) {
+			if (temp <= points[i].temp) {
+				float t = (temp - points[i - 1].temp) /
+					  (points[i].temp - points[i - 1].temp);
+				fraction = points[i - 1].fraction +
+					   t * (points[i].fraction -
+						points[i - 1].fraction);
+				break;
+			}
+		}
+	}
+
+	table->fraction = fraction;
+	return fraction;
+}
+
+/**
+ * @brief Gets the max torque fraction allowed by the motor, controller and battbox temperatures.
+ *
+ * @return float The smallest fraction of the three tables, 0-1
+ */
+static float _thermal_derate(void)
+{
+	float motor = _lookup_derate(&derate_tables[DERATE_MOTOR],
+				     dti_get_motor_temp());
+	float controller = _lookup_derate(&derate_tables[DERATE_CONTROLLER],
+					  dti_get_controller_temp());
+	float battbox = _lookup_derate(&derate_tables[DERATE_BATTBOX],
+				       bms_getBattboxTemp());
+
+	return fminf(motor, fminf(controller, battbox));
+}
+
+/**
+ * @brief Ramps the applied BMS current limit towards the BMS's latest limit. Falling limits are
+ * followed quickly and rising limits slowly, so the current targets never step.
+ *
+ * @param limit The limit to ramp
+ * @param target The latest limit from the BMS (Amps DC)
+ * @return float The applied limit (Amps DC)
+ */
+static float _ramp_bms_limit(bms_limit_t *limit, float target)
+{
+	float dt = time_getElapsedSeconds(&limit->last_us);
+	if (dt > POWER_LIMIT_MAX_DT) {
+		dt = POWER_LIMIT_MAX_DT;
+	}
+
+	float applied = limit->applied;
+	if (target < applied) {
+		applied -= BMS_LIMIT_FALL_RATE * dt;
+		if (applied < target) {
+			applied = target;
+		}
+	} else {
+		applied += BMS_LIMIT_RISE_RATE * dt;
+		if (applied > target) {
+			applied = target;
+		}
+	}
+	limit->applied = applied;
+	return applied;
+}
+
+/**
+ * @brief Converts a DC current limit into an AC current ceiling at the present motor speed and
+ * bus voltage, from P_mech = V_dc * I_dc * efficiency.
+ *
+ * @param dc_limit DC current limit (Amps)
+ * @param efficiency Mechanical power out per electrical power in
+ * @return float AC current ceiling multiplied by 10
+ */
+static float _dc_limit_to_ac(float dc_limit, float efficiency)
+{
+	float omega = fabsf(dti_get_rpm() * 2.0f * (float)M_PI / 60.0f);
+	float voltage = mc.input_voltage;
+
+	/* At low speed the DC current is small whatever the torque */
+	if (omega < POWER_LIMIT_MIN_SPEED || voltage <= 0.0f) {
+		return MAX_AC_CURRENT;
+	}
+
+	float torque = dc_limit * voltage * efficiency / omega;
+	return torque / EMRAX_KT * 1.414f * 10.0f;
+}
+
+/**
+ * @brief Applies a BMS current limit to a current target.
+ *
+ * @param limit The limit to apply
+ * @param bms_limit The latest limit from the BMS (Amps DC)
+ * @param efficiency Mechanical power out per electrical power in
+ * @param current The AC current target multiplied by 10
+ * @return float The AC current target multiplied by 10, with the ceiling applied
+ */
+static float _apply_bms_limit(bms_limit_t *limit, float bms_limit,
+			      float efficiency, float current)
+{
+	float ceiling = _dc_limit_to_ac(_ramp_bms_limit(limit, bms_limit),
+					efficiency);
+	float request = fabsf(current);
+
+	if (request <= ceiling) {
+		limit->reduction = 0.0f;
+		return current;
+	}
+
+	limit->reduction = 1.0f - ceiling / request;
+	return copysignf(ceiling, current);
+}
+
+/* Publishes the power limiter and BMS current limit state. */
+static void _send_power_limit_data(ULONG args)
+{
+	(void)args;
+
+	ethernet_mqtt_message_t message = nx_protobuf_mqtt_message_create(
+		"VCU_Ethernet/A/Power_Limit/Power", "W", dti_get_power_limit(),
+		dti_get_dc_power());
+	queue_send(&eth_manager, &message, TX_NO_WAIT);
+
+	message = nx_protobuf_mqtt_message_create(
+		"VCU_Ethernet/A/Power_Limit/Torque_Ceiling", "Nm",
+		power_limit.torque_ceiling);
+	queue_send(&eth_manager, &message, TX_NO_WAIT);
+
+	/* Whether the limiter is active, and how much of the time spent driving it has been */
+	message = nx_protobuf_mqtt_message_create(
+		"VCU_Ethernet/A/Power_Limit/Limited", "%",
+		power_limit.active ? 100.0f : 0.0f,
+		dti_get_power_limited_fraction() * 100.0f);
+	queue_send(&eth_manager, &message, TX_NO_WAIT);
+
+	/* Each BMS limit, the limit being applied, and how long ago the BMS sent it */
+	float limit = 0;
+	uint32_t timestamp = 0;
+	if (bms_getDischargeLimit(&limit, &timestamp)) {
+		message = nx_protobuf_mqtt_message_create(
+			"VCU_Ethernet/A/BMS_Limit/Discharge", "A", limit,
+			discharge_limit.applied, HAL_GetTick() - timestamp);
+		queue_send(&eth_manager, &message, TX_NO_WAIT);
+	}
+	if (bms_getChargeLimit(&limit, &timestamp)) {
+		message = nx_protobuf_mqtt_message_create(
+			"VCU_Ethernet/A/BMS_Limit/Charge", "A", limit,
+			charge_limit.applied, HAL_GetTick() - timestamp);
+		queue_send(&eth_manager, &message, TX_NO_WAIT);
+	}
+
+	/* How much of the last drive and regen current targets the BMS limits removed */
+	message = nx_protobuf_mqtt_message_create(
+		"VCU_Ethernet/A/BMS_Limit/Reduction", "%",
+		discharge_limit.reduction * 100.0f,
+		charge_limit.reduction * 100.0f);
+	queue_send(&eth_manager, &message, TX_NO_WAIT);
+
+	/* Torque allowed by each derating table, and the one applied */
+	message = nx_protobuf_mqtt_message_create(
+		"VCU_Ethernet/A/Thermal_Derate", "%",
+		derate_tables[DERATE_MOTOR].fraction * 100.0f,
+		derate_tables[DERATE_CONTROLLER].fraction * 100.0f,
+		derate_tables[DERATE_BATTBOX].fraction * 100.0f,
+		dti_get_thermal_derate() * 100.0f);
+	queue_send(&eth_manager, &message, TX_NO_WAIT);
+}
+
+/* Power Limit Data Timer. */
+static timer_t power_limit_timer = {
+	.name = "Power Limit Data Timer",
+	.callback = _send_power_limit_data,
+	.callback_input = 0,
+	.duration = POWER_LIMIT_TELEMETRY_PERIOD,
+	.type = PERIODIC,
+	.auto_activate = true
+};
+
 void dti_init(void)
 {
 	mc.rpm = 0;
@@ -52,6 +390,10 @@ void dti_init(void)
 	mc.motor_temp = 0;
 	mc.rpm = 0;
 
+	if (timer_init(&power_limit_timer) != U_SUCCESS) {
+		PRINTLN_ERROR("Failed to create Power Limit Data Timer.");
+	}
+
 	PRINTLN_INFO("Ran dti_init().");
 }
 
@@ -90,6 +432,12 @@ void dti_set_torque(int16_t torque)
 		average = 0;
 	}
 
+	/* Back off as the motor, controller or pack get hot */
+	average *= _thermal_derate();
+
+	/* Hold the pack under the power cap */
+	average = _limit_power(average);
+
 	/* Motor controller expects AC current target to be received as multiplied by 10 */
 	int16_t ac_current = (((float)average / EMRAX_KT) * 1.414 * 10);
 
@@ -117,6 +465,13 @@ void dti_set_regen(uint16_t current_target)
 	}
 	uint16_t average = sum / SAMPLES;
 
+	/* Hold the charge current under the BMS charge limit */
+	float ccl = 0;
+	float bms_limit = bms_getChargeLimit(&ccl, NULL) ? ccl : BMS_LIMIT_NONE;
+	average = (uint16_t)_apply_bms_limit(&charge_limit, bms_limit,
+					     1.0f / POWER_LIMIT_EFFICIENCY,
+					     average);
+
 	dti_send_brake_current(average);
 }
 
@@ -125,9 +480,16 @@ void dti_set_current(int16_t current)
 	if (!bms_getPrecharge()) {
 		return;
 	}
-	if (current > 499 * 10) {
-		current = 499*10;
+	if (current > MAX_AC_CURRENT) {
+		current = MAX_AC_CURRENT;
 	}
+
+	/* Hold the discharge current under the BMS discharge limit */
+	float dcl = 0;
+	float bms_limit = bms_getDischargeLimit(&dcl, NULL) ? dcl : BMS_LIMIT_NONE;
+	current = (int16_t)_apply_bms_limit(&discharge_limit, bms_limit,
+					    POWER_LIMIT_EFFICIENCY, current);
+
 	can_msg_t msg = { .id = 0x036, .len = 2, .data = { 0 } };
 
 #ifdef TSMS_OVERRIDE
@@ -329,6 +691,14 @@ void dti_record_rpm(can_msg_t* msg)
 	int32_t rpm = erpm / POLE_PAIRS;
 
 	mc.rpm = rpm;
+
+	/* Input voltage is the last two bytes in big endian format */
+	mc.input_voltage = (int16_t)((msg->data[6] << 8) | msg->data[7]);
+}
+
+uint16_t dti_get_input_voltage(void)
+{
+	return mc.input_voltage;
 }
 
 void dti_record_temp(can_msg_t* msg)
@@ -355,9 +725,9 @@ uint16_t dti_get_controller_temp(void)
 
 void dti_record_currents(can_msg_t* msg)
 {
-
-	int16_t ac_current = (msg->data[0] << 8) + (msg->data[1]) / 10;
-	int16_t dc_current = (msg->data[2] << 8) + (msg->data[3]) / 10;
+	/* Both currents are signed, big endian, and already scaled by 10 */
+	int16_t ac_current = (int16_t)((msg->data[0] << 8) | msg->data[1]);
+	int16_t dc_current = (int16_t)((msg->data[2] << 8) | msg->data[3]);
 
 	mc.ac_current = ac_current;
 	mc.dc_current = dc_current;
@@ -367,3 +737,99 @@ uint16_t dti_get_dc_current(void)
 {
 	return mc.dc_current;
 }
+
+float dti_get_dc_power(void)
+{
+	return mc.input_voltage * (mc.dc_current / 10.0f);
+}
+
+int dti_set_default_power_limit(float power)
+{
+	if (power < DTI_POWER_LIMIT_MIN || power > DTI_POWER_LIMIT_MAX) {
+		PRINTLN_ERROR("Default power limit out of range (Power: %d W).", (int)power);
+		return U_ERROR;
+	}
+
+	power_limit.default_cap = power;
+	return U_SUCCESS;
+}
+
+int dti_set_power_limit(float power)
+{
+	if (power < DTI_POWER_LIMIT_MIN || power > DTI_POWER_LIMIT_MAX) {
+		PRINTLN_ERROR("Power limit out of range (Power: %d W).", (int)power);
+		return U_ERROR;
+	}
+
+	power_limit.override_cap = power;
+	return U_SUCCESS;
+}
+
+void dti_clear_power_limit(void)
+{
+	power_limit.override_cap = 0.0f;
+}
+
+float dti_get_power_limit(void)
+{
+	float override_cap = power_limit.override_cap;
+	return override_cap > 0.0f ? override_cap : power_limit.default_cap;
+}
+
+bool dti_is_power_limited(void)
+{
+	return power_limit.active;
+}
+
+int dti_set_derate_table(derate_source_t source, const derate_point_t *points,
+			 uint8_t num_points)
+{
+	if (source >= NUM_DERATE_SOURCES || points == NULL ||
+	    num_points < 1 || num_points > DERATE_TABLE_POINTS_MAX) {
+		PRINTLN_ERROR("Invalid derating table (Source: %d, Points: %d).",
+			      source, num_points);
+		return U_ERROR;
+	}
+
+	for (uint8_t i = 0; i < num_points; i++) {
+		if (!isfinite(points[i].temp) || !isfinite(points[i].fraction) ||
+		    points[i].fraction < 0.0f || points[i].fraction > 1.0f ||
+		    (i > 0 && points[i].temp <= points[i - 1].temp)) {
+			PRINTLN_ERROR("Derating table point %d is out of order or out of range.", i);
+			return U_ERROR;
+		}
+	}
+
+	if (atomic_exchange(&derate_writing, true)) {
+		PRINTLN_WARNING("Derating tables are already being updated.");
+		return U_ERROR;
+	}
+
+	derate_table_t *table = &derate_tables[source];
+	uint32_t seq = atomic_load_explicit(&table->seq, memory_order_relaxed);
+	atomic_store_explicit(&table->seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	memcpy(table->points, points, num_points * sizeof(derate_point_t));
+	table->num_points = num_points;
+	atomic_store_explicit(&table->seq, seq + 2, memory_order_release);
+
+	derate_writing = false;
+	PRINTLN_INFO("Set derating table %d (%d points).", source, num_points);
+	return U_SUCCESS;
+}
+
+float dti_get_thermal_derate(void)
+{
+	return fminf(derate_tables[DERATE_MOTOR].fraction,
+		     fminf(derate_tables[DERATE_CONTROLLER].fraction,
+			   derate_tables[DERATE_BATTBOX].fraction));
+}
+
+float dti_get_power_limited_fraction(void)
+{
+	uint32_t driving_ms = power_limit.driving_ms;
+	if (driving_ms == 0) {
+		return 0.0f;
+	}
+	return (float)power_limit.limited_ms / driving_ms;
+}
@@ -1,4 +1,5 @@
 #include <stdatomic.h>
+#include <math.h>
 #include "u_efuses.h"
 #include "u_tx_debug.h"
 #include "u_adc.h"
@@ -8,6 +9,9 @@
 /* Config */
 #define GAIN_IMON 27.9e-6f           /* GAIN_(IMON) = 27.9 uA/A. Taken from Altium schematic. */
 
+/* V_(IMON) = (ADC_READING / 4095) * V_(REF), with V_(REF) = 3V3. */
+#define VOLTS_PER_COUNT (3.3f / 4095.0f)
+
 /* Scale calculation macro. */
 /* R_IMON is a value in kOhms. It depends on current (and differs for each eFuse). Check the Altium schematic. */
 #define SCALE(R_IMON) (1.0f) / (GAIN_IMON * R_IMON * 1000.0f)
@@ -38,41 +42,104 @@ static const _metadata efuses[] = {
     [EFUSE_SPARE] = {.en_pin = EF_SPARE_EN_Pin, .en_port = EF_SPARE_EN_GPIO_Port, .er_pin = EF_SPARE_ER_Pin, .er_port = EF_SPARE_ER_GPIO_Port, .scale = 0, .default_state = EF_AUTO}
 };
 
+/* Default AUTO policies. */
+/* eFuses with no sensor to follow (EFUSE_SOURCE_NONE) treat AUTO the same as ON. */
+static const efuse_policy_t default_policies[] = {
+    [EFUSE_DASHBOARD] = {.source = EFUSE_SOURCE_NONE},
+    [EFUSE_BRAKE] = {.source = EFUSE_SOURCE_BRAKE, .on = 1, .off = 0, .dwell = 0, .fallback = EFUSE_FALLBACK_HOLD},
+    [EFUSE_SHUTDOWN] = {.source = EFUSE_SOURCE_NONE},
+    [EFUSE_LV] = {.source = EFUSE_SOURCE_NONE},
+    [EFUSE_RADFAN] = {.source = EFUSE_SOURCE_MOTOR_TEMP, .on = 45, .off = 40, .dwell = 0, .fallback = EFUSE_FALLBACK_HOLD},
+    [EFUSE_FANBATT] = {.source = EFUSE_SOURCE_BATTBOX_TEMP, .on = 45, .off = 40, .dwell = 0, .fallback = EFUSE_FALLBACK_HOLD},
+    [EFUSE_PUMP1] = {.source = EFUSE_SOURCE_CONTROLLER_TEMP, .on = 45, .off = 40, .dwell = 5000, .fallback = EFUSE_FALLBACK_HOLD},
+    [EFUSE_PUMP2] = {.source = EFUSE_SOURCE_MOTOR_TEMP, .on = 45, .off = 40, .dwell = 5000, .fallback = EFUSE_FALLBACK_HOLD},
+    [EFUSE_BATTBOX] = {.source = EFUSE_SOURCE_NONE},
+    [EFUSE_MC] = {.source = EFUSE_SOURCE_NONE},
+    [EFUSE_SPARE] = {.source = EFUSE_SOURCE_CONTROLLER_TEMP, .on = 45, .off = 40, .dwell = 0, .fallback = EFUSE_FALLBACK_HOLD}
+};
+
+/* What each EN pin was last driven to. */
+typedef enum {
+    OUTPUT_UNKNOWN = 0, // Not driven since boot, so the first write always goes through.
+    OUTPUT_OFF,
+    OUTPUT_ON
+} _output_t;
+
+/* GPIO ports the EN and ER pins are on. efuse_getData() reads each port's input register once, and picks the pins out with masks. */
+/* Filled in from the efuses[] table by efuse_init(). */
+static GPIO_TypeDef *_ports[2 * NUM_EFUSES];
+static uint8_t _num_ports;
+static uint8_t _en_port[NUM_EFUSES]; // Index into _ports[] of each eFuse's EN port.
+static uint8_t _er_port[NUM_EFUSES]; // Index into _ports[] of each eFuse's ER port.
+
+/* Per-channel scale factors, from a raw ADC reading. Filled in by efuse_init(). */
+static float _amps_per_count[NUM_EFUSES];
+
 /* eFuse State Array (updated by Calypso command messages). */
 static _Atomic efuse_control_state_t _efuse_control_state[NUM_EFUSES]; // The initial/default values for each index is set in efuse_init(), as configured in the efuses[] table.
 
+/* eFuse outputs. Both the eFuses thread and the pedals (brake eFuse) drive them. */
+static _Atomic _output_t _output[NUM_EFUSES];
+static uint32_t _switched_at[NUM_EFUSES]; // Tick of each eFuse's last AUTO switch. Only efuse_control() touches these two.
+static bool _switched[NUM_EFUSES];        // Whether it has switched in AUTO yet. Driving it for the first time doesn't count.
+
+/* AUTO policies. Written by efuse_set_policy() while the eFuses thread reads them, so they're guarded by a sequence count (odd while a write is in progress). */
+static efuse_policy_t _policies[NUM_EFUSES];
+static _Atomic uint32_t _policies_seq;
+static _Atomic bool _writing;
+
+/* Gets the index of a GPIO port in _ports[], adding it if it's new. */
+static uint8_t _port_index(GPIO_TypeDef *port) {
+    for(uint8_t i = 0; i < _num_ports; i++) {
+        if(_ports[i] == port) {
+            return i;
+        }
+    }
+    _ports[_num_ports] = port;
+    return _num_ports++;
+}
+
 /* Inititialize the _efuse_control_state array to the values configured in the efuses[] table. */
 int efuse_init(void) {
 
+    _num_ports = 0;
     for(efuse_t efuse = 0; efuse < NUM_EFUSES; efuse++) {
         _efuse_control_state[efuse] = efuses[efuse].default_state;
+        _policies[efuse] = default_policies[efuse];
+
+        /* Group the pins by port, and fold the ADC scaling into each channel's current scale. */
+        _en_port[efuse] = _port_index(efuses[efuse].en_port);
+        _er_port[efuse] = _port_index(efuses[efuse].er_port);
+        _amps_per_count[efuse] = VOLTS_PER_COUNT * efuses[efuse].scale;
     }
 
     return U_SUCCESS;
 }
 
 /* Returns an instance of efuse_data_t with all current eFuse data. */
-#define V_REF 3.3f // V_(REF) = 3V3
 efuse_data_t efuse_getData(void) {
     raw_efuse_adc_t adc = adc_getEFuseData();
 
+    /* Read every port the pins are on in one go, so the EN and ER states are all from the same moment. */
+    uint32_t idr[2 * NUM_EFUSES];
+    for(uint8_t i = 0; i < _num_ports; i++) {
+        idr[i] = READ_REG(_ports[i]->IDR);
+    }
+
     /* Loop through each eFuse and calculate the necessary values. */
     efuse_data_t data = { 0 };
     for(efuse_t efuse = 0; efuse < NUM_EFUSES; efuse++) {
         data.raw[efuse] = adc.data[efuse]; // Get Raw ADC readings.
 
-        /* Calculate the eFuse's V_(IMON) voltage reading. */
-        // V_(IMON) = (ADC_READING / 4095) * V_(REF)
-        data.voltage[efuse] = ((float)(adc.data[efuse]) / 4095) * V_REF;
-
-        /* Calculate the eFuse's I_(OUT) current reading. */
-        data.current[efuse] = data.voltage[efuse] * efuses[efuse].scale;
+        /* Calculate the eFuse's V_(IMON) voltage, and I_(OUT) current readings. */
+        data.voltage[efuse] = adc.data[efuse] * VOLTS_PER_COUNT;
+        data.current[efuse] = adc.data[efuse] * _amps_per_count[efuse];
 
         /* Get the eFuse's fault status (true = faulted, false = not faulted). */
-        data.faulted[efuse] = (bool)(HAL_GPIO_ReadPin(efuses[efuse].er_port, efuses[efuse].er_pin) == GPIO_PIN_RESET); // GPIO_PIN_RESET means that a fault has been detected. GPIO_PIN_SET means that no fault has been detected.
+        data.faulted[efuse] = (idr[_er_port[efuse]] & efuses[efuse].er_pin) == 0; // Low means that a fault has been detected. High means that no fault has been detected.
 
         /* Get the eFuse's enable status (true = eFuse is enabled, false = eFuse is disabled). */
-        data.enabled[efuse] = (bool)(HAL_GPIO_ReadPin(efuses[efuse].en_port, efuses[efuse].en_pin) == GPIO_PIN_SET);
+        data.enabled[efuse] = (idr[_en_port[efuse]] & efuses[efuse].en_pin) != 0;
 
         /* Get the eFuse's current control state (as understood by VCU) from the control state tracking array. */
         #ifdef EFUSES_OVERRIDE_CALYPSO
@@ -85,14 +152,23 @@ efuse_data_t efuse_getData(void) {
     return data;
 }
 
+/* Drives an eFuse's EN pin, if it isn't already driven that way. */
+static void _drive(efuse_t efuse, bool on) {
+    _output_t output = on ? OUTPUT_ON : OUTPUT_OFF;
+    if(atomic_exchange(&_output[efuse], output) == output) {
+        return;
+    }
+    HAL_GPIO_WritePin(efuses[efuse].en_port, efuses[efuse].en_pin, on ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
 /* Enables an eFuse. */
 void efuse_enable(efuse_t efuse) {
-    HAL_GPIO_WritePin(efuses[efuse].en_port, efuses[efuse].en_pin, GPIO_PIN_SET);
+    _drive(efuse, true);
 }
 
 /* Disables an eFuse. */
 void efuse_disable(efuse_t efuse) {
-    HAL_GPIO_WritePin(efuses[efuse].en_port, efuses[efuse].en_pin, GPIO_PIN_RESET);
+    _drive(efuse, false);
 }
 
 /* Updates an eFuse's control state. Intended to be called when the relevant commands from Calypso are received. */
@@ -103,4 +179,103 @@ void efuse_update_state(efuse_t efuse, efuse_control_state_t state) {
 /* Gets the control state of the eFuse. */
 efuse_control_state_t efuse_get_state(efuse_t efuse) {
     return _efuse_control_state[efuse];
-}
\ No newline at end of file
+}
+
+/* Gets an eFuse's AUTO policy. */
+efuse_policy_t efuse_get_policy(efuse_t efuse) {
+    efuse_policy_t policy;
+    uint32_t seq;
+    do {
+        seq = atomic_load_explicit(&_policies_seq, memory_order_acquire);
+        policy = _policies[efuse];
+        atomic_thread_fence(memory_order_acquire);
+    } while((seq & 1) || seq != atomic_load_explicit(&_policies_seq, memory_order_relaxed));
+    return policy;
+}
+
+/* Changes an eFuse's AUTO policy, until the next boot. */
+int efuse_set_policy(efuse_t efuse, const efuse_policy_t *policy) {
+    bool follows = policy->source != EFUSE_SOURCE_NONE;
+    if(efuse >= NUM_EFUSES || policy->source >= NUM_EFUSE_SOURCES || policy->fallback > EFUSE_FALLBACK_OFF ||
+       (follows && (!isfinite(policy->on) || !isfinite(policy->off) || policy->on <= policy->off))) {
+        PRINTLN_WARNING("Rejected AUTO policy for eFuse %d (source=%d, on=%f, off=%f).", efuse, policy->source, policy->on, policy->off);
+        return U_ERROR;
+    }
+    if(atomic_exchange(&_writing, true)) {
+        PRINTLN_WARNING("eFuse policies are already being updated.");
+        return U_ERROR;
+    }
+
+    uint32_t seq = atomic_load_explicit(&_policies_seq, memory_order_relaxed);
+    atomic_store_explicit(&_policies_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    _policies[efuse] = *policy;
+    atomic_store_explicit(&_policies_seq, seq + 2, memory_order_release);
+
+    _writing = false;
+    PRINTLN_INFO("Set AUTO policy for eFuse %d (source=%d, on=%f, off=%f, dwell=%lu ms).", efuse, policy->source, policy->on, policy->off, policy->dwell);
+    return U_SUCCESS;
+}
+
+/* Works out whether an eFuse in AUTO should be on. Returns false if it should stay as it is. */
+static bool _evaluate(const efuse_policy_t *policy, const efuse_inputs_t *inputs, bool *on) {
+    if(policy->source == EFUSE_SOURCE_NONE) {
+        *on = true; // No sensor to follow, so AUTO is the same as ON
+        return true;
+    }
+
+    if(inputs->faulted[policy->source]) {
+        switch(policy->fallback) {
+            case EFUSE_FALLBACK_ON: *on = true; return true;
+            case EFUSE_FALLBACK_OFF: *on = false; return true;
+            default: return false;
+        }
+    }
+
+    float value = inputs->value[policy->source];
+    if(value >= policy->on) {
+        *on = true;
+        return true;
+    }
+    if(value <= policy->off) {
+        *on = false;
+        return true;
+    }
+    return false; // In the hysteresis band
+}
+
+/* Drives every eFuse as its control state (and, in AUTO, its policy) says. Only writes the EN pins that change. */
+void efuse_control(const efuse_data_t *data, const efuse_inputs_t *inputs) {
+    uint32_t now = HAL_GetTick();
+
+    for(efuse_t efuse = 0; efuse < NUM_EFUSES; efuse++) {
+        switch(data->control_state[efuse]) {
+            case EF_OFF: _drive(efuse, false); break;
+            case EF_AUTO: {
+                efuse_policy_t policy = efuse_get_policy(efuse);
+                bool on;
+                if(!_evaluate(&policy, inputs, &on)) {
+                    break;
+                }
+
+                _output_t output = atomic_load(&_output[efuse]);
+                if(output == (on ? OUTPUT_ON : OUTPUT_OFF)) {
+                    break;
+                }
+
+                /* Hold off switching again until the dwell time is up. */
+                if(_switched[efuse] && now - _switched_at[efuse] < policy.dwell) {
+                    break;
+                }
+                if(output != OUTPUT_UNKNOWN) {
+                    _switched_at[efuse] = now;
+                    _switched[efuse] = true;
+                }
+                _drive(efuse, on);
+                break;
+            }
+            case EF_ON:
+            default: _drive(efuse, true); break;
+        }
+    }
+}
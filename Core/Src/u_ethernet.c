@@ -8,12 +8,120 @@
 #include "u_tx_general.h"
 #include "u_tx_queues.h"
 #include "nxd_mqtt_client.h"
+#include "u_tc.h"
+#include "u_tc_stream.h"
+#include "u_calibration.h"
+#include "u_efuses.h"
+#include "u_dti.h"
+#include <string.h>
 
 #define ETH_TYPE_SEND 0
 #define ETH_TYPE_RECV 1
 
+/* Incoming command topics. */
+#define TOPIC_TC_CURVE "VCU/Commands/TC/Curve" /* Unit field carries the surface_id. */
+#define TOPIC_TC_GAINS "VCU/Commands/TC/Gains" /* Values are index, speed (mph), kp, ki, slip_ratio. */
+#define TOPIC_TC_STREAM "VCU/Commands/TC/Stream" /* First value is 1 to start the TC debug stream, 0 to stop it. */
+#define TOPIC_CALIBRATION "VCU/Commands/Calibration" /* Values are channel (cal_channel_t), gain, offset. Applied until the next boot. */
+#define TOPIC_CALIBRATION_SAVE "VCU/Commands/Calibration/Save" /* Stores the calibration in use, so it is loaded at boot. */
+#define TOPIC_DERATE "VCU/Commands/Derate" /* Values are source (derate_source_t), then temperature (C), fraction pairs in increasing temperature order. Applied until the next boot. */
+#define TOPIC_EFUSE_POLICY "VCU/Commands/EFuse/Policy" /* Values are eFuse (efuse_t), on, off, dwell (ms). Keeps the eFuse's source and fallback. Applied until the next boot. */
+
+/* TC debug stream. Broadcast, so whatever is logging on the car's network picks it up without setup. */
+#define TC_STREAM_ADDRESS IP_ADDRESS(255, 255, 255, 255)
+#define TC_STREAM_QUEUE_MAX 8 /* Datagrams queued on the socket, if ever sent to a local port. */
+
+/* Tire curve uploads. A client connects, sends a tc_upload_header_t and then the curve, and gets one
+*  byte back: U_SUCCESS if the curve was loaded (and stored, if asked), U_ERROR if not. See tmg/upload.py. */
+#define TC_UPLOAD_PORT    5006
+#define TC_UPLOAD_MAGIC   0x50554354 /* "TCUP" */
+#define TC_UPLOAD_PERSIST 0x01       /* Flag: store the curve in flash, so it is loaded at boot */
+#define TC_UPLOAD_TIMEOUT 2000       /* Gives up on a client that stops sending (ticks) */
+#define TC_UPLOAD_WINDOW  2048       /* TCP receive window (bytes) */
+
+typedef struct __attribute__((__packed__)) {
+    uint32_t magic;    /* TC_UPLOAD_MAGIC */
+    uint32_t size;     /* Of the curve that follows, TC_CURVE_SIZE */
+    uint32_t crc32;    /* zlib.crc32 of the curve */
+    uint8_t flags;     /* TC_UPLOAD_* */
+    uint8_t reserved[3];
+} tc_upload_header_t;
+
+static volatile bool _ethernet_ready = false;
+static NX_IP *_ip = NX_NULL; /* IP instance ethernet_init() created. Captured by _eth_driver(). */
+static NX_UDP_SOCKET _tc_stream_socket;
+static bool _tc_stream_socket_created = false;
+
 /* Callback for when a ethernet message is recieved. */
 void _ethernet_recieve(ethernet_mqtt_message_t message) {
+  if(strcmp(message.topic, TOPIC_TC_CURVE) == 0) {
+    tc_select_curve(message.msg.unit);
+    return;
+  }
+  if(strcmp(message.topic, TOPIC_TC_GAINS) == 0) {
+    if(message.msg.values_count < 5) {
+      PRINTLN_WARNING("TC gains command needs 5 values (Got: %d).", message.msg.values_count);
+      return;
+    }
+    tc_gains_t gains = { .speed = message.msg.values[1], .kp = message.msg.values[2], .ki = message.msg.values[3], .slip_ratio = message.msg.values[4] };
+    tc_set_gains((uint8_t)(int)message.msg.values[0], &gains);
+    return;
+  }
+  if(strcmp(message.topic, TOPIC_TC_STREAM) == 0) {
+    bool enabled = message.msg.values_count > 0 && message.msg.values[0] != 0.0f;
+    tc_stream_enable(enabled);
+    PRINTLN_INFO("TC debug stream %s (UDP port %d).", enabled ? "started" : "stopped", TC_STREAM_PORT);
+    return;
+  }
+  if(strcmp(message.topic, TOPIC_CALIBRATION) == 0) {
+    if(message.msg.values_count < 3) {
+      PRINTLN_WARNING("Calibration command needs 3 values (Got: %d).", message.msg.values_count);
+      return;
+    }
+    cal_pair_t pair = { .gain = message.msg.values[1], .offset = message.msg.values[2] };
+    calibration_set((cal_channel_t)(int)message.msg.values[0], &pair);
+    return;
+  }
+  if(strcmp(message.topic, TOPIC_CALIBRATION_SAVE) == 0) {
+    calibration_save();
+    return;
+  }
+  if(strcmp(message.topic, TOPIC_DERATE) == 0) {
+    if(message.msg.values_count < 3 || message.msg.values_count % 2 == 0) {
+      PRINTLN_WARNING("Derate command needs a source and temperature, fraction pairs (Got: %d values).", message.msg.values_count);
+      return;
+    }
+    derate_point_t points[DERATE_TABLE_POINTS_MAX];
+    uint8_t num_points = (message.msg.values_count - 1) / 2;
+    if(num_points > DERATE_TABLE_POINTS_MAX) {
+      PRINTLN_WARNING("Derate command has too many points (Got: %d, Max: %d).", num_points, DERATE_TABLE_POINTS_MAX);
+      return;
+    }
+    for(uint8_t i = 0; i < num_points; i++) {
+      points[i].temp = message.msg.values[1 + 2 * i];
+      points[i].fraction = message.msg.values[2 + 2 * i];
+    }
+    dti_set_derate_table((derate_source_t)(int)message.msg.values[0], points, num_points);
+    return;
+  }
+  if(strcmp(message.topic, TOPIC_EFUSE_POLICY) == 0) {
+    if(message.msg.values_count < 4) {
+      PRINTLN_WARNING("eFuse policy command needs 4 values (Got: %d).", message.msg.values_count);
+      return;
+    }
+    efuse_t efuse = (efuse_t)(int)message.msg.values[0];
+    if(efuse >= NUM_EFUSES) {
+      PRINTLN_WARNING("eFuse policy command for unknown eFuse %d.", efuse);
+      return;
+    }
+    efuse_policy_t policy = efuse_get_policy(efuse);
+    policy.on = message.msg.values[1];
+    policy.off = message.msg.values[2];
+    policy.dwell = message.msg.values[3] > 0.0f ? (uint32_t)message.msg.values[3] : 0;
+    efuse_set_policy(efuse, &policy);
+    return;
+  }
+
   /* Send the message to the incoming ethernet queue. */
   int status = queue_send(&eth_manager, &message, TX_NO_WAIT);
   if(status != U_SUCCESS) {
@@ -22,15 +130,149 @@ void _ethernet_recieve(ethernet_mqtt_message_t message) {
   }
 }
 
+/* STM32 Ethernet driver entry. ethernet_init() creates the IP instance internally, and NetX passes it with
+   every driver request (attaching the interface is the first), so it is captured here. */
+static VOID _eth_driver(NX_IP_DRIVER *driver_req) {
+    if(_ip == NX_NULL) {
+        _ip = driver_req->nx_ip_driver_ptr;
+    }
+    nx_stm32_eth_driver(driver_req);
+}
+
 /* Initializes ethernet. */
 UINT ethernet1_init(void) {
     /* PHY_RESET Pin has to be set HIGH for the PHY to function. */
     HAL_GPIO_WritePin(PHY_RESET_GPIO_Port, PHY_RESET_Pin, GPIO_PIN_SET);
 
     /* Init the ethernet. */
-    return ethernet_init(VCU, nx_stm32_eth_driver, _ethernet_recieve);
+    return ethernet_init(VCU, _eth_driver, _ethernet_recieve);
 }
 
+/* Gets the IP instance ethernet1_init() created. NULL until ethernet has been initialized. */
+NX_IP *ethernet1_get_ip(void) {
+    return _ethernet_ready ? _ip : NX_NULL;
+}
+
+/* Gets the packet pool of the IP instance. NULL until ethernet has been initialized. */
+NX_PACKET_POOL *ethernet1_get_packet_pool(void) {
+    NX_IP *ip = ethernet1_get_ip();
+    return ip != NX_NULL ? ip->nx_ip_default_packet_pool : NX_NULL;
+}
+
+/* Sends one TC debug stream datagram over UDP. Called from the stream thread. */
+UINT ethernet1_tc_stream_send(const uint8_t *data, uint16_t size) {
+    NX_IP *ip = ethernet1_get_ip();
+    NX_PACKET_POOL *pool = ethernet1_get_packet_pool();
+    if(ip == NX_NULL || pool == NX_NULL) {
+        return NX_NOT_ENABLED;
+    }
+
+    UINT status;
+    if(!_tc_stream_socket_created) {
+        status = nx_udp_socket_create(ip, &_tc_stream_socket, "TC Stream Socket", NX_IP_NORMAL, NX_DONT_FRAGMENT, NX_IP_TIME_TO_LIVE, TC_STREAM_QUEUE_MAX);
+        if(status != NX_SUCCESS) {
+            return status;
+        }
+        status = nx_udp_socket_bind(&_tc_stream_socket, NX_ANY_PORT, TX_NO_WAIT);
+        if(status != NX_SUCCESS) {
+            nx_udp_socket_delete(&_tc_stream_socket);
+            return status;
+        }
+        _tc_stream_socket_created = true;
+    }
+
+    /* Never wait for a packet. If the pool is empty the datagram is lost, and the receiver sees the gap in datagram_seq. */
+    NX_PACKET *packet;
+    status = nx_packet_allocate(pool, &packet, NX_UDP_PACKET, TX_NO_WAIT);
+    if(status != NX_SUCCESS) {
+        return status;
+    }
+    status = nx_packet_data_append(packet, (VOID *)data, size, pool, TX_NO_WAIT);
+    if(status == NX_SUCCESS) {
+        status = nx_udp_socket_send(&_tc_stream_socket, packet, TC_STREAM_ADDRESS, TC_STREAM_PORT);
+    }
+    if(status != NX_SUCCESS) {
+        nx_packet_release(packet);
+    }
+    return status;
+}
+
+/* Receives one tire curve upload from a connected client, and loads it. */
+static uint8_t _receive_curve(NX_TCP_SOCKET *socket) {
+    static uint8_t upload[sizeof(tc_upload_header_t) + TC_CURVE_SIZE];
+    tc_upload_header_t header = { 0 };
+    ULONG received = 0;
+    ULONG expected = sizeof(header);
+
+    while(received < expected) {
+        NX_PACKET *packet;
+        UINT status = nx_tcp_socket_receive(socket, &packet, TC_UPLOAD_TIMEOUT);
+        if(status != NX_SUCCESS) {
+            PRINTLN_WARNING("Tire curve upload ended early (Received: %lu/%lu bytes, Status: %d/%s).", received, expected, status, nx_status_toString(status));
+            return U_ERROR;
+        }
+
+        ULONG copied = 0;
+        status = nx_packet_data_extract_offset(packet, 0, upload + received, sizeof(upload) - received, &copied);
+        nx_packet_release(packet);
+        if(status != NX_SUCCESS) {
+            return U_ERROR;
+        }
+        received += copied;
+
+        /* Once the header is in, it says how much more to wait for. */
+        if(expected == sizeof(header) && received >= sizeof(header)) {
+            memcpy(&header, upload, sizeof(header));
+            if(header.magic != TC_UPLOAD_MAGIC || header.size != TC_CURVE_SIZE) {
+                PRINTLN_WARNING("Invalid tire curve upload (Magic: 0x%lX, Size: %lu bytes).", header.magic, header.size);
+                return U_ERROR;
+            }
+            expected += header.size;
+        }
+    }
+
+    return tc_load_curve(upload + sizeof(header), header.size, header.crc32, header.flags & TC_UPLOAD_PERSIST);
+}
+
+/* Tire Curve Server. Accepts tire curve uploads over TCP, one client at a time. */
+void vTireCurveServer(ULONG thread_input) {
+    static NX_TCP_SOCKET socket;
+
+    /* The IP instance is created by ethernet1_init(), in the ethernet thread. */
+    NX_IP *ip;
+    while((ip = ethernet1_get_ip()) == NX_NULL) {
+        tx_thread_sleep(100);
+    }
+    NX_PACKET_POOL *pool = ethernet1_get_packet_pool();
+
+    UINT status = nx_tcp_socket_create(ip, &socket, "Tire Curve Socket", NX_IP_NORMAL, NX_FRAGMENT_OKAY, NX_IP_TIME_TO_LIVE, TC_UPLOAD_WINDOW, NX_NULL, NX_NULL);
+    if(status == NX_SUCCESS) {
+        status = nx_tcp_server_socket_listen(ip, TC_UPLOAD_PORT, &socket, 1, NX_NULL);
+    }
+    if(status != NX_SUCCESS) {
+        PRINTLN_ERROR("Failed to start the tire curve server (Status: %d/%s).", status, nx_status_toString(status));
+        return;
+    }
+
+    while(1) {
+        if(nx_tcp_server_socket_accept(&socket, NX_WAIT_FOREVER) == NX_SUCCESS) {
+            uint8_t result = _receive_curve(&socket);
+
+            NX_PACKET *reply;
+            if(nx_packet_allocate(pool, &reply, NX_TCP_PACKET, TC_UPLOAD_TIMEOUT) == NX_SUCCESS) {
+                if(nx_packet_data_append(reply, &result, sizeof(result), pool, TC_UPLOAD_TIMEOUT) != NX_SUCCESS ||
+                   nx_tcp_socket_send(&socket, reply, TC_UPLOAD_TIMEOUT) != NX_SUCCESS) {
+                    nx_packet_release(reply);
+                }
+            }
+            nx_tcp_socket_disconnect(&socket, TC_UPLOAD_TIMEOUT);
+        }
+
+        /* Ready for the next client. */
+        nx_tcp_server_socket_unaccept(&socket);
+        nx_tcp_server_socket_relisten(ip, TC_UPLOAD_PORT, &socket);
+    }
+}
 
 void vEthernet1Manager(ULONG thread_input) {
 
@@ -42,6 +284,7 @@ void vEthernet1Manager(ULONG thread_input) {
         PRINTLN_ERROR("Failed to call ethernet1_init() (Status: %d/%s).", status, nx_status_toString(status));
         return;
     }
+    _ethernet_ready = true;
 
     ethernet_mqtt_message_t message = { 0 };
 
@@ -0,0 +1,62 @@
+#include <string.h>
+#include "main.h"
+#include "u_flash.h"
+#include "u_tx_debug.h"
+
+/* This file includes helpers for the VCU's reserved internal flash sectors (see u_flash.h). */
+
+#define FLASH_BANK_BYTES 0x100000U /* 1 MB per bank, with the banks not swapped. */
+
+/* HAL_FLASH_Program() takes the source as a 32-bit address, so each quad-word is staged here. */
+static uint32_t _quadword[FLASH_QUADWORD_SIZE / sizeof(uint32_t)];
+
+/* Erases the 8 KB sector that starts at `sector`. */
+int flash_eraseSector(const void *sector) {
+    uint32_t offset = (uint32_t)sector - FLASH_BASE;
+    if (offset % FLASH_SECTOR_SIZE != 0 || offset >= 2 * FLASH_BANK_BYTES) {
+        PRINTLN_ERROR("Not the start of a flash sector (Address: 0x%lX).", (uint32_t)sector);
+        return U_ERROR;
+    }
+
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_SECTORS,
+        .Banks = (offset < FLASH_BANK_BYTES) ? FLASH_BANK_1 : FLASH_BANK_2,
+        .Sector = (offset % FLASH_BANK_BYTES) / FLASH_SECTOR_SIZE,
+        .NbSectors = 1,
+    };
+    uint32_t sector_error = 0;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &sector_error);
+    HAL_FLASH_Lock();
+    HAL_ICACHE_Invalidate(); // The cache may still hold the old contents
+    if (status != HAL_OK) {
+        PRINTLN_ERROR("Failed to erase flash sector (Bank: %ld, Sector: %ld, Status: %d/%s).", erase.Banks, erase.Sector, status, hal_status_toString(status));
+        return U_ERROR;
+    }
+    return U_SUCCESS;
+}
+
+/* Writes to erased flash. `address` must be quad-word aligned; the last quad-word is padded with 0xFF. */
+int flash_write(const void *address, const void *data, uint32_t size) {
+    if ((uint32_t)address % FLASH_QUADWORD_SIZE != 0) {
+        PRINTLN_ERROR("Flash writes must be quad-word aligned (Address: 0x%lX).", (uint32_t)address);
+        return U_ERROR;
+    }
+
+    HAL_StatusTypeDef status = HAL_OK;
+    HAL_FLASH_Unlock();
+    for (uint32_t written = 0; written < size && status == HAL_OK; written += FLASH_QUADWORD_SIZE) {
+        uint32_t chunk = (size - written < FLASH_QUADWORD_SIZE) ? size - written : FLASH_QUADWORD_SIZE;
+        memset(_quadword, 0xFF, sizeof(_quadword));
+        memcpy(_quadword, (const uint8_t *)data + written, chunk);
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_QUADWORD, (uint32_t)address + written, (uint32_t)_quadword);
+    }
+    HAL_FLASH_Lock();
+    HAL_ICACHE_Invalidate();
+    if (status != HAL_OK) {
+        PRINTLN_ERROR("Failed to write flash (Address: 0x%lX, Status: %d/%s).", (uint32_t)address, status, hal_status_toString(status));
+        return U_ERROR;
+    }
+    return U_SUCCESS;
+}
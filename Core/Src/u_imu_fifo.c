@@ -0,0 +1,238 @@
+#include <stdatomic.h>
+#include <string.h>
+#include <math.h>
+#include "u_imu_fifo.h"
+
+/* This file includes the VCU's IMU sample ring (see u_imu_fifo.h). */
+
+#define IMU_FIFO_PERIOD_US (1000000 / IMU_FIFO_ODR_HZ)
+#define IMU_FIFO_RING_MASK (IMU_FIFO_RING_SIZE - 1)
+
+/* A FIFO word's tag byte holds the sensor in bits 7:3, and a counter shared by the words of one ODR period in bits 2:1. */
+#define TAG_SENSOR(tag)  ((tag) >> 3)
+#define TAG_COUNTER(tag) (((tag) >> 1) & 0x3)
+
+/* The words of the sample being paired up. A burst can end between them. */
+typedef struct {
+    int16_t accel[3];
+    int16_t gyro[3];
+    uint8_t counter;
+    bool has_accel;
+    bool has_gyro;
+} imu_pair_t;
+
+/* The newest sensor fusion output, that each sample is stamped with. */
+typedef struct {
+    quaternion_t orientation;
+    vector3_t gravity;
+    bool has_orientation;
+    bool has_gravity;
+} imu_fusion_t;
+
+static imu_sample_t _ring[IMU_FIFO_RING_SIZE];
+static _Atomic uint32_t _head;     // Samples ever added. Only the parser writes it.
+static uint32_t _tail;             // Samples ever popped. Only imu_fifo_pop() touches it.
+static imu_pair_t _pair;
+static imu_fusion_t _fusion;
+static uint64_t _last_us;          // Time of the newest sample, so times never go backwards
+static imu_fifo_stats_t _stats;
+
+/* Reads one 16-bit axis out of a FIFO word (little endian). */
+static int16_t _get_axis(const uint8_t *data, uint8_t axis) {
+    return (int16_t)((uint16_t)data[2 * axis] | ((uint16_t)data[2 * axis + 1] << 8));
+}
+
+/* Converts an IEEE 754 half-precision float. The SFLP's quaternions are never infinite or NaN, so those aren't handled. */
+static float _half_to_float(uint16_t half) {
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    float value;
+    if(exponent == 0) {
+        value = (float)mantissa * (1.0f / 16777216.0f); // Subnormal, 2^-24 per LSB
+        return sign ? -value : value;
+    }
+    uint32_t bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13); // Rebias the exponent, and widen the mantissa
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/* Reads a game rotation vector word. The IMU only sends x, y and z, since w follows from them being a unit quaternion. */
+static void _set_orientation(const uint8_t *data) {
+    quaternion_t *q = &_fusion.orientation;
+    q->x = _half_to_float((uint16_t)_get_axis(data, 0));
+    q->y = _half_to_float((uint16_t)_get_axis(data, 1));
+    q->z = _half_to_float((uint16_t)_get_axis(data, 2));
+
+    float sum = q->x * q->x + q->y * q->y + q->z * q->z;
+    if(sum > 1.0f) {
+        /* Rounding pushed it just past a unit quaternion. Renormalize, with w = 0. */
+        float norm = sqrtf(sum);
+        q->x /= norm;
+        q->y /= norm;
+        q->z /= norm;
+        q->w = 0.0f;
+    } else {
+        q->w = sqrtf(1.0f - sum);
+    }
+    _fusion.has_orientation = true;
+}
+
+/* Reads a gravity vector word. */
+static void _set_gravity(const uint8_t *data) {
+    _fusion.gravity.x = lsm6dsv_from_sflp_to_mg(_get_axis(data, 0));
+    _fusion.gravity.y = lsm6dsv_from_sflp_to_mg(_get_axis(data, 1));
+    _fusion.gravity.z = lsm6dsv_from_sflp_to_mg(_get_axis(data, 2));
+    _fusion.has_gravity = true;
+}
+
+/* Counts the samples a burst will complete. The gyroscope word of each ODR period comes first, so that's one per accelerometer word. */
+static uint16_t _count_samples(const uint8_t *words, uint16_t count) {
+    uint16_t samples = 0;
+    for(uint16_t i = 0; i < count; i++) {
+        if(TAG_SENSOR(words[i * IMU_FIFO_WORD_SIZE]) == LSM6DSV_XL_NC_TAG) {
+            samples++;
+        }
+    }
+    return samples;
+}
+
+/* Converts a pair into a sample, and adds it to the ring. */
+static void _push(const imu_pair_t *pair, uint64_t time_us) {
+    uint32_t head = atomic_load_explicit(&_head, memory_order_relaxed);
+    imu_sample_t *sample = &_ring[head & IMU_FIFO_RING_MASK];
+
+    /* Somewhat important: These conversions MUST match the full-scale settings configured in peripherals_init(). */
+    sample->accel.x = lsm6dsv_from_fs2_to_mg(pair->accel[0]);
+    sample->accel.y = lsm6dsv_from_fs2_to_mg(pair->accel[1]);
+    sample->accel.z = lsm6dsv_from_fs2_to_mg(pair->accel[2]);
+    sample->gyro.x = lsm6dsv_from_fs2000_to_mdps(pair->gyro[0]);
+    sample->gyro.y = lsm6dsv_from_fs2000_to_mdps(pair->gyro[1]);
+    sample->gyro.z = lsm6dsv_from_fs2000_to_mdps(pair->gyro[2]);
+    sample->time_us = time_us;
+    sample->orientation = _fusion.orientation;
+    sample->gravity = _fusion.gravity;
+    sample->fused = _fusion.has_orientation && _fusion.has_gravity;
+
+    atomic_store_explicit(&_head, head + 1, memory_order_release);
+    _stats.samples++;
+}
+
+/* Empties the ring, and forgets any half-paired word. Call it before the IMU starts batching. */
+void imu_fifo_reset(void) {
+    memset(&_pair, 0, sizeof(_pair));
+    memset(&_fusion, 0, sizeof(_fusion));
+    _last_us = 0;
+    _tail = atomic_load(&_head);
+}
+
+/* Adds a burst of FIFO words to the ring. Its anchor'th sample was taken at anchor_us, and the rest are an ODR period apart. */
+uint16_t imu_fifo_parse(const uint8_t *words, uint16_t count, uint64_t anchor_us, uint16_t anchor) {
+    uint16_t added = 0;
+    if(anchor == IMU_FIFO_ANCHOR_NEWEST) {
+        anchor = _count_samples(words, count) - 1;
+    }
+
+    for(uint16_t i = 0; i < count; i++) {
+        const uint8_t *word = &words[i * IMU_FIFO_WORD_SIZE];
+        uint8_t tag = TAG_SENSOR(word[0]);
+        uint8_t counter = TAG_COUNTER(word[0]);
+
+        /* Sensor fusion words are batched in between, and don't take part in the pairing. */
+        if(tag == LSM6DSV_SFLP_GAME_ROTATION_VECTOR_TAG || tag == LSM6DSV_SFLP_GRAVITY_VECTOR_TAG) {
+            if(tag == LSM6DSV_SFLP_GAME_ROTATION_VECTOR_TAG) {
+                _set_orientation(&word[1]);
+            } else {
+                _set_gravity(&word[1]);
+            }
+            _stats.fusion++;
+            continue;
+        }
+        if(tag != LSM6DSV_XL_NC_TAG && tag != LSM6DSV_GY_NC_TAG) {
+            continue; // Nothing else is batched
+        }
+
+        /* A word from a new ODR period means the last period's other word went missing. */
+        if((_pair.has_accel || _pair.has_gyro) && counter != _pair.counter) {
+            _stats.unpaired++;
+            _pair.has_accel = false;
+            _pair.has_gyro = false;
+        }
+        _pair.counter = counter;
+
+        int16_t *axes = (tag == LSM6DSV_XL_NC_TAG) ? _pair.accel : _pair.gyro;
+        bool *has = (tag == LSM6DSV_XL_NC_TAG) ? &_pair.has_accel : &_pair.has_gyro;
+        if(*has) {
+            _stats.unpaired++; // Same sensor twice in one period
+        }
+        for(uint8_t axis = 0; axis < 3; axis++) {
+            axes[axis] = _get_axis(&word[1], axis);
+        }
+        *has = true;
+
+        if(_pair.has_accel && _pair.has_gyro) {
+            int64_t offset = ((int64_t)added - anchor) * IMU_FIFO_PERIOD_US;
+            uint64_t time_us = (offset < 0 && (uint64_t)-offset > anchor_us) ? 0 : anchor_us + offset;
+            if(time_us <= _last_us) {
+                time_us = _last_us + 1; // The anchor jitters by the interrupt latency
+            }
+            _last_us = time_us;
+
+            _push(&_pair, time_us);
+            _pair.has_accel = false;
+            _pair.has_gyro = false;
+            added++;
+        }
+    }
+
+    return added;
+}
+
+/* Counts an IMU FIFO overrun. */
+void imu_fifo_overrun(void) {
+    _stats.overruns++;
+}
+
+/* Gets the oldest sample imu_fifo_pop() has not returned yet. Samples that were overwritten first are counted as dropped. */
+bool imu_fifo_pop(imu_sample_t *sample) {
+    while(1) {
+        uint32_t head = atomic_load_explicit(&_head, memory_order_acquire);
+        if(_tail == head) {
+            return false;
+        }
+        if(head - _tail > IMU_FIFO_RING_SIZE) {
+            _stats.dropped += head - _tail - IMU_FIFO_RING_SIZE;
+            _tail = head - IMU_FIFO_RING_SIZE;
+        }
+
+        *sample = _ring[_tail & IMU_FIFO_RING_MASK];
+
+        /* If the parser lapped us while we copied, the copy may be torn. Skip past it. */
+        if(atomic_load_explicit(&_head, memory_order_acquire) - _tail > IMU_FIFO_RING_SIZE) {
+            continue;
+        }
+        _tail++;
+        return true;
+    }
+}
+
+/* Gets the newest sample. false if there has not been one yet. */
+bool imu_fifo_latest(imu_sample_t *sample) {
+    while(1) {
+        uint32_t head = atomic_load_explicit(&_head, memory_order_acquire);
+        if(head == 0) {
+            return false;
+        }
+
+        *sample = _ring[(head - 1) & IMU_FIFO_RING_MASK];
+
+        if(atomic_load_explicit(&_head, memory_order_acquire) - head < IMU_FIFO_RING_SIZE) {
+            return true;
+        }
+    }
+}
+
+/* Gets the ring's counters. */
+imu_fifo_stats_t imu_fifo_getStats(void) {
+    return _stats;
+}
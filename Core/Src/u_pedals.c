@@ -19,6 +19,7 @@
 #include "u_statemachine.h"
 #include "u_adc.h"
 #include "u_tc.h"
+#include "u_time.h"
 
 /* Globals. */
 typedef enum {
@@ -144,6 +145,33 @@ static timer_t pedal_data_timer = {
 	.auto_activate = true
 };
 
+/* Starts a fault's debounce from when ADC2's analog watchdog saw the reading leave its window, rather than from now.
+*  The watchdogs catch it on the conversion it happens, which can be up to a pedals thread period earlier. */
+static void _debounce_from(bool fault, nertimer_t *timer, uint32_t period, bool tripped, uint32_t tripped_tick) {
+    if(!fault || !tripped || is_timer_active(timer)) {
+        return;
+    }
+
+    uint32_t elapsed = HAL_GetTick() - tripped_tick;
+    start_timer(timer, (elapsed < period) ? period - elapsed : 0);
+}
+
+/* Collects the pedal watchdogs that tripped since the last check, and rearms them once their readings are back in range. */
+static bool _check_watchdogs(const pedal_watchdog_t *watchdogs, uint8_t count, bool in_range, uint32_t *tripped_tick) {
+    bool tripped = false;
+    for(uint8_t i = 0; i < count; i++) {
+        uint32_t tick;
+        if(adc_takePedalWatchdog(watchdogs[i], &tick) && (!tripped || (int32_t)(tick - *tripped_tick) < 0)) {
+            *tripped_tick = tick; // Earliest of the group
+            tripped = true;
+        }
+        if(in_range) {
+            adc_rearmPedalWatchdog(watchdogs[i]);
+        }
+    }
+    return tripped;
+}
+
 /* Calculates brake faults. */
 static void _calculate_brake_faults(float voltage_brake1, float voltage_brake2) {
     /* Debounce Timers */
@@ -152,15 +180,23 @@ static void _calculate_brake_faults(float voltage_brake1, float voltage_brake2)
 
     /* EV3.5.4: For analog acceleration control signals, this error checking must detect open circuit, short to ground and short to sensor power. */
 
+    bool open_circuit_fault = (voltage_brake1 > BRAKE_FAULT_HIGH) || (voltage_brake2 > BRAKE_FAULT_HIGH);
+    bool short_circuit_fault = (voltage_brake1 < BRAKE_FAULT_LOW) || (voltage_brake2 < BRAKE_FAULT_LOW);
+
+    /* The watchdog may have caught it first. */
+    static const pedal_watchdog_t watchdogs[] = { PEDAL_WATCHDOG_BRAKE };
+    uint32_t tripped_tick = 0;
+    bool tripped = _check_watchdogs(watchdogs, 1, !open_circuit_fault && !short_circuit_fault, &tripped_tick);
+
     /* Open Circuit Fault */
-    bool open_circuit_fault = (voltage_brake1 > BRAKE_SENSOR_IRREGULAR_HIGH + BRAKE_THRESHOLD_TOLERANCE) || (voltage_brake2 > BRAKE_SENSOR_IRREGULAR_HIGH + BRAKE_THRESHOLD_TOLERANCE);
+    _debounce_from(open_circuit_fault, &open_circuit_timer, BRAKE_FAULT_DEBOUNCE, tripped, tripped_tick);
     debounce(open_circuit_fault, &open_circuit_timer, BRAKE_FAULT_DEBOUNCE, &_onboard_brake_open_circuit_fault_callback, NULL);
     if (!open_circuit_fault) {
         _drive_lock_unset(BRAKE_OC);
     }
 
     /* Short Circuit Fault */
-    bool short_circuit_fault = (voltage_brake1 < BRAKE_SENSOR_IRREGULAR_LOW - BRAKE_THRESHOLD_TOLERANCE) || (voltage_brake2 < BRAKE_SENSOR_IRREGULAR_LOW - BRAKE_THRESHOLD_TOLERANCE);
+    _debounce_from(short_circuit_fault, &short_circuit_timer, BRAKE_FAULT_DEBOUNCE, tripped, tripped_tick);
     debounce(short_circuit_fault, &short_circuit_timer, BRAKE_FAULT_DEBOUNCE, &_onboard_brake_short_circuit_fault_callback, NULL);
     if (!short_circuit_fault) {
         _drive_lock_unset(BRAKE_SC);
@@ -176,15 +212,23 @@ static void _calculate_accel_faults(float voltage_accel1, float voltage_accel2,
 
     /* EV3.5.4: For analog acceleration control signals, this error checking must detect open circuit, short to ground and short to sensor power. */
 
+    bool open_circuit_fault = (voltage_accel1 > APPS1_FAULT_HIGH) || (voltage_accel2 > APPS2_FAULT_HIGH);
+    bool short_circuit_fault = (voltage_accel1 < APPS1_FAULT_LOW) || (voltage_accel2 < APPS2_FAULT_LOW);
+
+    /* The watchdogs may have caught it first. */
+    static const pedal_watchdog_t watchdogs[] = { PEDAL_WATCHDOG_APPS1, PEDAL_WATCHDOG_APPS2 };
+    uint32_t tripped_tick = 0;
+    bool tripped = _check_watchdogs(watchdogs, 2, !open_circuit_fault && !short_circuit_fault, &tripped_tick);
+
     /* Open Circuit Fault */
-    bool open_circuit_fault = (voltage_accel1 > MAX_VOLTS_UNSCALED - APPS_THRESHOLD_TOLERANCE) || (voltage_accel2 > MAX_VOLTS_UNSCALED - APPS_THRESHOLD_TOLERANCE);
+    _debounce_from(open_circuit_fault, &open_circuit_timer, PEDAL_FAULT_DEBOUNCE, tripped, tripped_tick);
     debounce(open_circuit_fault, &open_circuit_timer, PEDAL_FAULT_DEBOUNCE, &_onboard_accel_open_circuit_fault_callback, NULL);
     if (!open_circuit_fault) {
         _drive_lock_unset(ACCEL_OC);
     }
 
     /* Short Circuit Fault */
-    bool short_circuit_fault = (voltage_accel1 < MIN_APPS1_VOLTS - APPS_THRESHOLD_TOLERANCE) || (voltage_accel2 < MIN_APPS2_VOLTS - APPS_THRESHOLD_TOLERANCE);
+    _debounce_from(short_circuit_fault, &short_circuit_timer, PEDAL_FAULT_DEBOUNCE, tripped, tripped_tick);
     debounce(short_circuit_fault, &short_circuit_timer, PEDAL_FAULT_DEBOUNCE, &_onboard_accel_short_circuit_fault_callback, NULL);
     if (!short_circuit_fault) {
         _drive_lock_unset(ACCEL_SC);
@@ -361,22 +405,21 @@ static void _accel_pedal_regen_braking(float percentage_accel)
 static void _launch_control(float mph, float percentage_accel)
 {
 	static float last_mph = 0.0f;
-	static uint32_t prevTime = 0;
+	static uint64_t prev_us = 0;
 	static float prev_accel = 0;
 
     const float deltaMPHPS_max = 22.0f; // Miles per hour per second, based on matlab accel numbers
     const float max_limiting_mph = 30;
 
-	if (prevTime == 0) { // Initialize time
-		prevTime = HAL_GetTick();
+	if (prev_us == 0) { // Initialize time
+		(void)time_getElapsedSeconds(&prev_us);
 		return;
 	}
 
-	uint32_t now = HAL_GetTick();
-	uint32_t delta_ms = now - prevTime;
+	float delta_s = time_getElapsedSeconds(&prev_us);
 
 	float delta_mph = mph - last_mph;
-	float max_delta_adjusted = deltaMPHPS_max * (delta_ms / 1000.0f);
+	float max_delta_adjusted = deltaMPHPS_max * delta_s;
 
 	if (mph < max_limiting_mph && delta_mph > max_delta_adjusted) {
 		_linear_accel_to_torque(prev_accel / 2);
@@ -385,7 +428,6 @@ static void _launch_control(float mph, float percentage_accel)
 	}
 
 	// Update for next cycle
-	prevTime = now;
 	last_mph = mph;
 	prev_accel = percentage_accel;
 }
@@ -466,10 +508,12 @@ static float _adc_to_voltage(uint16_t raw_adc) {
 	return ((2000.0 + 3000) / 3000) * v3_volts;
 }
 
-/* Returns the percentage the pedal is pressed down. */
-static float _get_pedal_percent_pressed(float voltage, float offset, float max)
+/* Clamps a pedal's travel to 0-1, with a small deadband at rest. */
+static float _clamp_percent_pressed(float ret)
 {
-	float ret = voltage - offset < 0 ? 0 : (voltage - offset) / (max - offset);
+	if (ret < 0) {
+	    return 0;
+	}
 	if (ret > 1.0) {
 	    return 1.0;
 	}
@@ -481,6 +525,12 @@ static float _get_pedal_percent_pressed(float voltage, float offset, float max)
 	return ret;
 }
 
+/* Returns the percentage the pedal is pressed down. */
+static float _get_pedal_percent_pressed(float voltage, float offset, float max)
+{
+	return _clamp_percent_pressed((voltage - offset) / (max - offset));
+}
+
 /* Initializes Pedals ADC and creates pedal data timer. */
 int pedals_init(void) {
 
@@ -612,8 +662,8 @@ void pedals_process(void) {
 	pedal_data.voltage_brake2 = _adc_to_voltage(raw.data[PEDAL_BRAKE2]);
 
     /* Calculate acceleration pedal percentage pressed. */
-    float accel1_percentage = _get_pedal_percent_pressed(pedal_data.voltage_accel1, MIN_APPS1_VOLTS, MAX_APPS1_VOLTS); // For sensor 1...
-    float accel2_percentage = _get_pedal_percent_pressed(pedal_data.voltage_accel2, MIN_APPS2_VOLTS, MAX_APPS2_VOLTS); // For sensor 2...
+    float accel1_percentage = _clamp_percent_pressed(calibration_apply(CAL_APPS_1, raw.data[PEDAL_ACCEL1])); // For sensor 1...
+    float accel2_percentage = _clamp_percent_pressed(calibration_apply(CAL_APPS_2, raw.data[PEDAL_ACCEL2])); // For sensor 2...
     pedal_data.percentage_accel = (accel1_percentage + accel2_percentage) / 2; /* Record the averaged percentage. */
     _calculate_accel_faults(pedal_data.voltage_accel1, pedal_data.voltage_accel2, accel1_percentage, accel2_percentage); // Check for faults.
 
@@ -680,9 +730,6 @@ void pedals_process(void) {
 	    return;
 	}
 
-    /* Update TC torque scale before issuing any torque command. */
-    tc_process();
-
     switch(get_func_state()) {
         case READY:
             dti_set_torque(0);
@@ -3,99 +3,216 @@
 #include "main.h"
 #include "u_peripherals.h"
 #include "u_mutexes.h"
+#include "u_queues.h"
+#include "u_imu_fifo.h"
+#include "u_time.h"
+#include "u_bus.h"
+#include "u_tx_timers.h"
+#include <stdatomic.h>
+#include <string.h>
+
+#define IMU_SPI_READ     0x80 // Bit 7 of the register address selects a read (1=read, 0=write)
+#define IMU_REG_MAX      32   // Most bytes the lsm6dsv driver reads or writes at once
+#define IMU_TIMEOUT      5    // (ticks). A few bytes at 2 MHz take microseconds.
+#define SHT30_TIMEOUT    20   // (ticks). The SHT30 stretches the clock while it measures.
 
 /* Wrapper for lsm6dsv SPI reading. */
-static int32_t _lsm6dsv_read(void* spi_handle, uint8_t reg, uint8_t* buffer, uint16_t length) {
-    
-    SPI_HandleTypeDef *handle = (SPI_HandleTypeDef *)spi_handle;
-    HAL_StatusTypeDef status;
-
-    /* Select the IMU by setting its CS pin LOW. */
-    HAL_GPIO_WritePin(IMU_CS_GPIO_Port, IMU_CS_Pin, GPIO_PIN_RESET);
-    
-    /* Tell the IMU you want to read from 'reg'. */
-    uint8_t spi_reg = (uint8_t)(reg | 0b10000000); // Bits 0 through 6 store 'reg' (the register address), while Bit 7 lets you chose if it's a read or write operation (1=read, 0=write).
-    status = HAL_SPI_Transmit(handle, &spi_reg, sizeof(spi_reg), HAL_MAX_DELAY);
-    if(status != HAL_OK) {
-        PRINTLN_ERROR("Failed to call HAL_SPI_Transmit() to write the first SPI command (Status: %d/%s).", status, hal_status_toString(status));
-        HAL_GPIO_WritePin(IMU_CS_GPIO_Port, IMU_CS_Pin, GPIO_PIN_SET); // Deselect IMU since error.
+static int32_t _lsm6dsv_read(void* bus, uint8_t reg, uint8_t* buffer, uint16_t length) {
+    uint8_t tx[1 + IMU_REG_MAX] = { 0 };
+    uint8_t rx[1 + IMU_REG_MAX];
+    if(length > IMU_REG_MAX) {
+        PRINTLN_ERROR("IMU read of %d bytes is over the %d byte limit.", length, IMU_REG_MAX);
         return -1;
     }
 
-    /* Read from 'reg'. */
-    status = HAL_SPI_Receive(handle, buffer, length, HAL_MAX_DELAY);
-    if(status != HAL_OK) {
-        PRINTLN_ERROR("Failed to call HAL_SPI_Receive() to read from 'reg' (Status: %d/%s).", status, hal_status_toString(status));
-        HAL_GPIO_WritePin(IMU_CS_GPIO_Port, IMU_CS_Pin, GPIO_PIN_SET); // Deselect IMU since error.
+    /* Bits 0 through 6 store 'reg' (the register address), while Bit 7 lets you chose if it's a read or write operation. The data comes back after it. */
+    tx[0] = reg | IMU_SPI_READ;
+    bus_txn_t txn = {
+        .op = BUS_SPI_TXRX,
+        .cs_port = IMU_CS_GPIO_Port,
+        .cs_pin = IMU_CS_Pin,
+        .tx = tx,
+        .rx = rx,
+        .length = 1 + length,
+        .timeout = IMU_TIMEOUT
+    };
+    if(bus_transfer((bus_t *)bus, &txn) != U_SUCCESS) {
+        PRINTLN_ERROR("Failed to read IMU register 0x%02X.", reg);
         return -1;
     }
 
-    /* Deselect the IMU by setting its CS pin HIGH. */
-    HAL_GPIO_WritePin(IMU_CS_GPIO_Port, IMU_CS_Pin, GPIO_PIN_SET);
-    
+    memcpy(buffer, &rx[1], length);
     return 0;
 }
 
 /* Wrapper for lsm6dsv SPI writing. */
-static int32_t _lsm6dsv_write(void* spi_handle, uint8_t reg, const uint8_t* data, uint16_t length) {
-    
-    SPI_HandleTypeDef *handle = (SPI_HandleTypeDef *)spi_handle;
-    HAL_StatusTypeDef status;
-
-    /* Select the IMU by setting its CS pin LOW. */
-    HAL_GPIO_WritePin(IMU_CS_GPIO_Port, IMU_CS_Pin, GPIO_PIN_RESET);
-    
-    /* Tell the IMU you want to write to 'reg'. */
-    uint8_t spi_reg = (uint8_t)(reg & 0b01111111); // Bits 0 through 6 store 'reg' (the register address), while Bit 7 lets you chose if it's a read or write operation (1=read, 0=write).
-    status = HAL_SPI_Transmit(handle, &spi_reg, sizeof(spi_reg), HAL_MAX_DELAY);
-    if(status != HAL_OK) {
-        PRINTLN_ERROR("Failed to call HAL_SPI_Transmit() to write the first SPI command (Status: %d/%s).", status, hal_status_toString(status));
-        HAL_GPIO_WritePin(IMU_CS_GPIO_Port, IMU_CS_Pin, GPIO_PIN_SET); // Deselect IMU since error.
+static int32_t _lsm6dsv_write(void* bus, uint8_t reg, const uint8_t* data, uint16_t length) {
+    uint8_t tx[1 + IMU_REG_MAX];
+    uint8_t rx[1 + IMU_REG_MAX];
+    if(length > IMU_REG_MAX) {
+        PRINTLN_ERROR("IMU write of %d bytes is over the %d byte limit.", length, IMU_REG_MAX);
         return -1;
     }
 
-    /* Write to 'reg'. */
-    status = HAL_SPI_Transmit(handle, data, length, HAL_MAX_DELAY);
-    if(status != HAL_OK) {
-        PRINTLN_ERROR("Failed to call HAL_SPI_Transmit() to write to 'reg' (Status: %d/%s).", status, hal_status_toString(status));
-        HAL_GPIO_WritePin(IMU_CS_GPIO_Port, IMU_CS_Pin, GPIO_PIN_SET); // Deselect IMU since error.
+    tx[0] = reg & ~IMU_SPI_READ;
+    memcpy(&tx[1], data, length);
+    bus_txn_t txn = {
+        .op = BUS_SPI_TXRX,
+        .cs_port = IMU_CS_GPIO_Port,
+        .cs_pin = IMU_CS_Pin,
+        .tx = tx,
+        .rx = rx,
+        .length = 1 + length,
+        .timeout = IMU_TIMEOUT
+    };
+    if(bus_transfer((bus_t *)bus, &txn) != U_SUCCESS) {
+        PRINTLN_ERROR("Failed to write IMU register 0x%02X.", reg);
         return -1;
     }
-
-    /* Deselect the IMU by setting its CS pin HIGH. */
-    HAL_GPIO_WritePin(IMU_CS_GPIO_Port, IMU_CS_Pin, GPIO_PIN_SET);
-
     return 0;
 }
 
 /* Wrapper for sht30 I2C reading. */
 static int _sht30_read(uint8_t *data, uint16_t command, uint8_t device_address, uint8_t length) {
-    HAL_StatusTypeDef status = HAL_I2C_Mem_Read(&hi2c2, (uint16_t)device_address, command, I2C_MEMADD_SIZE_16BIT, data, length, HAL_MAX_DELAY);
-    if(status != HAL_OK) {
-        PRINTLN_ERROR("Failed to call _sht30_read() (Status: %d/%s, Command: %d).", status, hal_status_toString(status), command);
-        return status;
+    bus_txn_t txn = {
+        .op = BUS_I2C_MEM_READ,
+        .address = device_address,
+        .mem_address = command,
+        .mem_size = I2C_MEMADD_SIZE_16BIT,
+        .rx = data,
+        .length = length,
+        .timeout = SHT30_TIMEOUT
+    };
+    if(bus_transfer(&i2c2_bus, &txn) != U_SUCCESS) {
+        PRINTLN_ERROR("Failed to call _sht30_read() (Command: %d).", command);
+        return HAL_ERROR;
     }
-    return status;
+    return HAL_OK;
 }
 
 /* Wrapper for sht30 I2C writing. */
 static int _sht30_write(uint8_t *data, uint8_t device_address, uint8_t length) {
-    HAL_StatusTypeDef status = HAL_I2C_Master_Transmit(&hi2c2, (uint16_t)device_address, data, (uint16_t)length, HAL_MAX_DELAY);
-    if(status != HAL_OK) {
-        PRINTLN_ERROR("Failed to call _sht30_write() (Status: %d/%s).", status, hal_status_toString(status));
-        return status;
+    bus_txn_t txn = {
+        .op = BUS_I2C_WRITE,
+        .address = device_address,
+        .tx = data,
+        .length = length,
+        .timeout = SHT30_TIMEOUT
+    };
+    if(bus_transfer(&i2c2_bus, &txn) != U_SUCCESS) {
+        PRINTLN_ERROR("Failed to call _sht30_write().");
+        return HAL_ERROR;
     }
-    return status;
+    return HAL_OK;
 }
 
 /* Driver instances. */
 static sht30_t temperature_sensor = { .dev_address = SHT30_I2C_ADDR };
 static const stmdev_ctx_t imu = {
-    .handle = &hspi2,
+    .handle = &spi2_bus,
     .read_reg = _lsm6dsv_read,
     .write_reg = _lsm6dsv_write
 };
 
+/* Temperature sensor periodic mode. The SHT30 measures on its own once a second, and a timer fetches each
+*  measurement over I2C2 in the background. Readers only ever see the cached reading.
+*/
+#define SHT30_CMD_PERIODIC    0x2130 // Periodic mode, 1 measurement per second, high repeatability
+#define SHT30_CMD_FETCH       0xE000 // Read out the latest periodic measurement
+#define SHT30_CMD_BREAK       0x3093 // Stop periodic mode
+#define SHT30_CMD_HEATER_ON   0x306D
+#define SHT30_CMD_HEATER_OFF  0x3066
+#define SHT30_FETCH_PERIOD    1000   // (ticks). Matches the measurement rate.
+#define SHT30_STALE           3000   // (ticks). The reading is stale after a couple of missed fetches.
+#define SHT30_FIRST_MEASURE   20     // (ticks). The first periodic measurement takes up to 15 ms.
+
+static void _sht30_fetch(ULONG args); // Forward declaration
+static void _sht30_fetch_done(bus_txn_t *txn);
+
+static timer_t sht30_fetch_timer = {
+    .name = "SHT30 Fetch Timer",
+    .callback = _sht30_fetch,
+    .callback_input = 0,
+    .duration = SHT30_FETCH_PERIOD,
+    .type = PERIODIC,
+    .auto_activate = true
+};
+
+static uint8_t _sht30_rx[6]; // Temperature MSB, LSB, CRC, humidity MSB, LSB, CRC
+static bus_txn_t _sht30_fetch_txn = {
+    .op = BUS_I2C_MEM_READ,
+    .mem_address = SHT30_CMD_FETCH,
+    .mem_size = I2C_MEMADD_SIZE_16BIT,
+    .rx = _sht30_rx,
+    .length = sizeof(_sht30_rx),
+    .timeout = SHT30_TIMEOUT,
+    .callback = _sht30_fetch_done
+};
+static _Atomic bool _sht30_fetching = false;
+
+/* The cached reading. Written from the I2C interrupt, so it is guarded by a sequence count that is odd while a write is in progress. */
+static tempsensor_reading_t _sht30_reading;
+static _Atomic uint32_t _sht30_seq = 0;
+static _Atomic uint32_t _sht30_crc_errors = 0;
+
+/* CRC-8 from the SHT3x datasheet (polynomial 0x31, initial value 0xFF). */
+static uint8_t _sht30_crc(const uint8_t *data) {
+    uint8_t crc = 0xFF;
+    for(int i = 0; i < 2; i++) {
+        crc ^= data[i];
+        for(int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/* Sends a command to the SHT30, and waits for it to go out. */
+static int _sht30_command(uint16_t command) {
+    uint8_t data[2] = { command >> 8, command & 0xFF };
+    return _sht30_write(data, temperature_sensor.dev_address, sizeof(data)) == HAL_OK ? U_SUCCESS : U_ERROR;
+}
+
+/* Timer callback. Starts fetching the latest measurement, unless the last fetch is still on the bus. */
+static void _sht30_fetch(ULONG args) {
+    bool idle = false;
+    if(!atomic_compare_exchange_strong(&_sht30_fetching, &idle, true)) {
+        return;
+    }
+    _sht30_fetch_txn.address = temperature_sensor.dev_address;
+    if(bus_submit(&i2c2_bus, &_sht30_fetch_txn) != U_SUCCESS) {
+        atomic_store(&_sht30_fetching, false);
+    }
+}
+
+/* Checks a fetched measurement, and caches it. */
+static int _sht30_store(const uint8_t *rx) {
+    if(_sht30_crc(&rx[0]) != rx[2] || _sht30_crc(&rx[3]) != rx[5]) {
+        atomic_fetch_add(&_sht30_crc_errors, 1);
+        return U_ERROR;
+    }
+
+    uint16_t raw_temperature = (uint16_t)((rx[0] << 8) | rx[1]);
+    uint16_t raw_humidity = (uint16_t)((rx[3] << 8) | rx[4]);
+
+    uint32_t seq = atomic_load_explicit(&_sht30_seq, memory_order_relaxed);
+    atomic_store_explicit(&_sht30_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    _sht30_reading.temperature = -45.0f + 175.0f * raw_temperature / 65535.0f; // Conversions from the datasheet
+    _sht30_reading.humidity = 100.0f * raw_humidity / 65535.0f;
+    _sht30_reading.tick = HAL_GetTick();
+    atomic_store_explicit(&_sht30_seq, seq + 2, memory_order_release);
+    return U_SUCCESS;
+}
+
+/* Fetch complete (I2C interrupt). */
+static void _sht30_fetch_done(bus_txn_t *txn) {
+    if(txn->status == BUS_DONE) {
+        _sht30_store(_sht30_rx);
+    } // Otherwise, the SHT30 NACKed a fetch with no new measurement. The reading just ages until the next one.
+    atomic_store(&_sht30_fetching, false);
+}
+
 /* Initializes I2C devices. */
 int peripherals_init(void) {
 
@@ -108,6 +225,26 @@ int peripherals_init(void) {
     }
     printf("after sht30_init()\n");
 
+    /* Put the temperature sensor in periodic mode, and start fetching its measurements. */
+    status = _sht30_command(SHT30_CMD_PERIODIC);
+    if(status != U_SUCCESS) {
+        PRINTLN_ERROR("Failed to put the SHT30 in periodic mode.");
+        return U_ERROR;
+    }
+
+    /* Fetch the first measurement here, so there's a reading before the peripherals thread first asks for one. */
+    tx_thread_sleep(SHT30_FIRST_MEASURE);
+    uint8_t rx[6];
+    if(_sht30_read(rx, SHT30_CMD_FETCH, temperature_sensor.dev_address, sizeof(rx)) != HAL_OK || _sht30_store(rx) != U_SUCCESS) {
+        PRINTLN_ERROR("Failed to fetch the SHT30's first measurement.");
+        return U_ERROR;
+    }
+    status = timer_init(&sht30_fetch_timer);
+    if(status != U_SUCCESS) {
+        PRINTLN_ERROR("Failed to create SHT30 Fetch Timer (Status: %d).", status);
+        return U_ERROR;
+    }
+
     /* Make sure IMU is set up correctly. */
     uint8_t id;
     printf("before lsm6dsv_device_id_get()\n");
@@ -157,48 +294,128 @@ int peripherals_init(void) {
         return U_ERROR;
     }
 
-    /* Set accelerometer output data rate. */
-    status = lsm6dsv_xl_data_rate_set(&imu, LSM6DSV_ODR_AT_120Hz);
+    /* Set accelerometer output data rate. This is also the rate traction control runs at (see imu_waitForSample()). Must match IMU_FIFO_ODR_HZ. */
+    status = lsm6dsv_xl_data_rate_set(&imu, LSM6DSV_ODR_AT_960Hz);
     if(status != 0) {
         PRINTLN_ERROR("Failed to set IMU Accelerometer Datarate via lsm6dsv_xl_data_rate_set() (Status: %d).", status);
         return U_ERROR;
     }
 
     /* Set gyroscope output data rate. */
-    status = lsm6dsv_gy_data_rate_set(&imu, LSM6DSV_ODR_AT_120Hz);
+    status = lsm6dsv_gy_data_rate_set(&imu, LSM6DSV_ODR_AT_960Hz);
     if(status != 0) {
         PRINTLN_ERROR("Failed to set IMU Gyroscope Datarate via lsm6dsv_gy_data_rate_set() (Status: %d).", status);
         return U_ERROR;
     }
 
+    /* Batch both sensors into the FIFO at their full data rate. */
+    status = lsm6dsv_fifo_xl_batch_set(&imu, LSM6DSV_XL_BATCHED_AT_960Hz);
+    if(status != 0) {
+        PRINTLN_ERROR("Failed to batch the IMU Accelerometer into the FIFO via lsm6dsv_fifo_xl_batch_set() (Status: %d).", status);
+        return U_ERROR;
+    }
+    status = lsm6dsv_fifo_gy_batch_set(&imu, LSM6DSV_GY_BATCHED_AT_960Hz);
+    if(status != 0) {
+        PRINTLN_ERROR("Failed to batch the IMU Gyroscope into the FIFO via lsm6dsv_fifo_gy_batch_set() (Status: %d).", status);
+        return U_ERROR;
+    }
+
+    /* Run the IMU's sensor fusion (SFLP). TC takes gravity out of the longitudinal acceleration with it (see u_tc.c). Must match IMU_FIFO_SFLP_HZ. */
+    status = lsm6dsv_sflp_data_rate_set(&imu, LSM6DSV_SFLP_480Hz);
+    if(status != 0) {
+        PRINTLN_ERROR("Failed to set the IMU SFLP Datarate via lsm6dsv_sflp_data_rate_set() (Status: %d).", status);
+        return U_ERROR;
+    }
+    status = lsm6dsv_sflp_game_rotation_set(&imu, PROPERTY_ENABLE);
+    if(status != 0) {
+        PRINTLN_ERROR("Failed to enable the IMU SFLP via lsm6dsv_sflp_game_rotation_set() (Status: %d).", status);
+        return U_ERROR;
+    }
+
+    /* Batch its game rotation vector and gravity vector into the FIFO too. */
+    lsm6dsv_fifo_sflp_raw_t sflp_batch = { 0 };
+    sflp_batch.game_rotation = PROPERTY_ENABLE;
+    sflp_batch.gravity = PROPERTY_ENABLE;
+    status = lsm6dsv_fifo_sflp_batch_set(&imu, sflp_batch);
+    if(status != 0) {
+        PRINTLN_ERROR("Failed to batch the IMU SFLP into the FIFO via lsm6dsv_fifo_sflp_batch_set() (Status: %d).", status);
+        return U_ERROR;
+    }
+
+    /* Raise the FIFO threshold after IMU_FIFO_WATERMARK samples (one accelerometer word and one gyroscope word each, plus the SFLP's words). */
+    status = lsm6dsv_fifo_watermark_set(&imu, IMU_FIFO_WATERMARK_WORDS);
+    if(status != 0) {
+        PRINTLN_ERROR("Failed to set the IMU FIFO watermark via lsm6dsv_fifo_watermark_set() (Status: %d).", status);
+        return U_ERROR;
+    }
+
+    /* Route the FIFO threshold to INT2 (IMU_INT2, PA11). It stays high until the FIFO is drained below the watermark. */
+    lsm6dsv_pin_int_route_t int2_route = { 0 };
+    int2_route.fifo_th = PROPERTY_ENABLE;
+    status = lsm6dsv_pin_int2_route_set(&imu, &int2_route);
+    if(status != 0) {
+        PRINTLN_ERROR("Failed to route the IMU FIFO threshold to INT2 via lsm6dsv_pin_int2_route_set() (Status: %d).", status);
+        return U_ERROR;
+    }
+
+    /* Start batching. In stream mode the FIFO keeps the newest words if it ever fills up. */
+    imu_fifo_reset();
+    status = lsm6dsv_fifo_mode_set(&imu, LSM6DSV_STREAM_MODE);
+    if(status != 0) {
+        PRINTLN_ERROR("Failed to set the IMU FIFO mode via lsm6dsv_fifo_mode_set() (Status: %d).", status);
+        return U_ERROR;
+    }
+
     PRINTLN_INFO("Ran peripherals_init().");
     return U_SUCCESS;
 }
 
-/* Toggles the status of the temperature sensor's internal heater. */
+/* Toggles the status of the temperature sensor's internal heater. The SHT30 only takes heater commands outside periodic mode. */
 int tempsensor_toggleHeater(bool enable) {
     CATCH_ERROR(mutex_get(&peripherals_mutex), U_SUCCESS);
-    HAL_StatusTypeDef status = sht30_toggle_heater(&temperature_sensor, enable);
+    int status = _sht30_command(SHT30_CMD_BREAK);
+    if(status == U_SUCCESS) {
+        status = _sht30_command(enable ? SHT30_CMD_HEATER_ON : SHT30_CMD_HEATER_OFF);
+    }
+    if(_sht30_command(SHT30_CMD_PERIODIC) != U_SUCCESS) {
+        status = U_ERROR; // Always try to restart periodic mode, or the reading goes stale for good
+    }
     CATCH_ERROR(mutex_put(&peripherals_mutex), U_SUCCESS);
-    if(status != HAL_OK) {
-        PRINTLN_ERROR("Failed to toggle SHT30 heater (Status: %d/%s).", status, hal_status_toString(status));
+    if(status != U_SUCCESS) {
+        PRINTLN_ERROR("Failed to toggle SHT30 heater.");
         return U_ERROR;
     }
     return U_SUCCESS;
 }
 
-/* Gets the temp sensor's temperature and humidity readings. */
-int tempsensor_getTemperatureAndHumidity(float *temperature, float *humidity) {
-    CATCH_ERROR(mutex_get(&peripherals_mutex), U_SUCCESS);
-    int status = sht30_get_temp_humid(&temperature_sensor);
-    CATCH_ERROR(mutex_put(&peripherals_mutex), U_SUCCESS);
-    if(status != 0) {
-        PRINTLN_ERROR("Failed to read SHT30 temperature/humidity (Status: %d).", status);
+/* Gets the temp sensor's latest reading. Never touches the bus. */
+int tempsensor_getReading(tempsensor_reading_t *reading) {
+    uint32_t seq;
+    do {
+        seq = atomic_load_explicit(&_sht30_seq, memory_order_acquire);
+        *reading = _sht30_reading;
+        atomic_thread_fence(memory_order_acquire);
+    } while((seq & 1) || seq != atomic_load_explicit(&_sht30_seq, memory_order_relaxed));
+
+    if(seq == 0) {
+        return U_ERROR; // No reading yet
+    }
+    if(HAL_GetTick() - reading->tick > SHT30_STALE) {
+        bus_expire(&i2c2_bus); // In case a fetch is stuck on the bus
+        PRINTLN_ERROR("SHT30 reading is stale (%lu ms old, %lu CRC errors).", HAL_GetTick() - reading->tick, atomic_load(&_sht30_crc_errors));
         return U_ERROR;
     }
+    return U_SUCCESS;
+}
 
-    *temperature = temperature_sensor.temp;
-    *humidity = temperature_sensor.humidity;
+/* Gets the temp sensor's temperature and humidity readings. Same as tempsensor_getReading(). */
+int tempsensor_getTemperatureAndHumidity(float *temperature, float *humidity) {
+    tempsensor_reading_t reading;
+    if(tempsensor_getReading(&reading) != U_SUCCESS) {
+        return U_ERROR;
+    }
+    *temperature = reading.temperature;
+    *humidity = reading.humidity;
     return U_SUCCESS;
 }
 
@@ -208,44 +425,164 @@ float _mg_to_mpss(float data) {
     return g*9.80665; // Convert to m/s^2
 }
 
-/* Gets the IMU's acceleration reading. */
+/* Gets the IMU's acceleration reading. This is the newest sample drained from the FIFO, so it doesn't touch the bus. */
 int imu_getAcceleration(vector3_t* data) {
-    int16_t raw_data[3];
-    
-    /* Read raw accelerometer data. */
-    CATCH_ERROR(mutex_get(&peripherals_mutex), U_SUCCESS);
-    int status = lsm6dsv_acceleration_raw_get(&imu, raw_data);
-    CATCH_ERROR(mutex_put(&peripherals_mutex), U_SUCCESS);
-    if(status != 0) {
-        PRINTLN_ERROR("Failed to read accelerometer data.");
+    imu_sample_t sample;
+    if(!imu_fifo_latest(&sample)) {
+        PRINTLN_ERROR("No IMU samples have been drained from the FIFO yet.");
         return U_ERROR;
     }
-    
-    /* Convert to mg (milligravity). */
-    data->x = lsm6dsv_from_fs2_to_mg(raw_data[0]); // Somewhat important: These functions MUST match the full-scale settings configured in peripherals_init(). The conversions will be incorrect if you use the wrong functions.
-    data->y = lsm6dsv_from_fs2_to_mg(raw_data[1]);
-    data->z = lsm6dsv_from_fs2_to_mg(raw_data[2]);
-    
+    *data = sample.accel;
     return U_SUCCESS;
 }
 
-/* Gets the IMU's angular rate reading. */
+/* Gets the IMU's angular rate reading. Same as imu_getAcceleration(). */
 int imu_getAngularRate(vector3_t* data) {
-    int16_t raw_data[3];
-    
-    /* Read raw gyroscope data. */
-    CATCH_ERROR(mutex_get(&peripherals_mutex), U_SUCCESS);
-    int status = lsm6dsv_angular_rate_raw_get(&imu, raw_data);
-    CATCH_ERROR(mutex_put(&peripherals_mutex), U_SUCCESS);
-    if(status != 0) {
-        PRINTLN_ERROR("Failed to read gyroscope data.");
+    imu_sample_t sample;
+    if(!imu_fifo_latest(&sample)) {
+        PRINTLN_ERROR("No IMU samples have been drained from the FIFO yet.");
+        return U_ERROR;
+    }
+    *data = sample.gyro;
+    return U_SUCCESS;
+}
+
+/* Gets the IMU's orientation (game rotation vector). Same as imu_getAcceleration(). */
+int imu_getOrientation(quaternion_t* data) {
+    imu_sample_t sample;
+    if(!imu_fifo_latest(&sample) || !sample.fused) {
+        PRINTLN_ERROR("No IMU sensor fusion output has been drained from the FIFO yet.");
+        return U_ERROR;
+    }
+    *data = sample.orientation;
+    return U_SUCCESS;
+}
+
+/* Gets the IMU's acceleration with gravity (from its sensor fusion) taken out. Same as imu_getAcceleration(). */
+int imu_getLinearAcceleration(vector3_t* data) {
+    imu_sample_t sample;
+    if(!imu_fifo_latest(&sample) || !sample.fused) {
+        PRINTLN_ERROR("No IMU sensor fusion output has been drained from the FIFO yet.");
         return U_ERROR;
     }
-    
-    /* Convert to mdps (millidegrees per second). */
-    data->x = lsm6dsv_from_fs2000_to_mdps(raw_data[0]); // Somewhat important: These functions MUST match the full-scale settings configured in peripherals_init(). The conversions will be incorrect if you use the wrong functions.
-    data->y = lsm6dsv_from_fs2000_to_mdps(raw_data[1]);
-    data->z = lsm6dsv_from_fs2000_to_mdps(raw_data[2]);
-    
+    data->x = sample.accel.x - sample.gravity.x;
+    data->y = sample.accel.y - sample.gravity.y;
+    data->z = sample.accel.z - sample.gravity.z;
+    return U_SUCCESS;
+}
+
+/* FIFO drain. Each drain is two transactions on SPI2, the second submitted from the first's callback:
+*  FIFO_STATUS1/2 for how many words are waiting, then one burst of that many words from FIFO_DATA_OUT_TAG
+*  (the IMU rolls the address back to FIFO_DATA_OUT_TAG after each word).
+*/
+#define IMU_FIFO_LEVEL_MSB    0x01   // FIFO_STATUS2: Bit 8 of the FIFO level
+#define IMU_FIFO_OVR          0x40   // FIFO_STATUS2: The FIFO filled up and words were overwritten
+
+static void _drain_status_done(bus_txn_t *txn);
+static void _drain_data_done(bus_txn_t *txn);
+
+static _Atomic bool _draining = false;
+static uint64_t _drain_us;       // When the drain's anchor sample was taken
+static uint16_t _drain_anchor;   // Which of the drained samples was taken at _drain_us
+static uint16_t _drain_words;    // Words being read in the burst
+static const uint8_t _status_tx[3] = { LSM6DSV_FIFO_STATUS1 | IMU_SPI_READ };
+static uint8_t _status_rx[3];
+static const uint8_t _data_tx[1 + IMU_FIFO_BURST_MAX * IMU_FIFO_WORD_SIZE] = { LSM6DSV_FIFO_DATA_OUT_TAG | IMU_SPI_READ };
+static uint8_t _data_rx[1 + IMU_FIFO_BURST_MAX * IMU_FIFO_WORD_SIZE];
+
+static bus_txn_t _drain_status = {
+    .op = BUS_SPI_TXRX,
+    .cs_port = IMU_CS_GPIO_Port,
+    .cs_pin = IMU_CS_Pin,
+    .tx = _status_tx,
+    .rx = _status_rx,
+    .length = sizeof(_status_tx),
+    .timeout = IMU_TIMEOUT,
+    .callback = _drain_status_done
+};
+
+static bus_txn_t _drain_data = {
+    .op = BUS_SPI_TXRX,
+    .cs_port = IMU_CS_GPIO_Port,
+    .cs_pin = IMU_CS_Pin,
+    .tx = _data_tx,
+    .rx = _data_rx,
+    .timeout = IMU_TIMEOUT,
+    .callback = _drain_data_done
+};
+
+/* Starts draining the FIFO, unless a drain is already running. anchor is which of the drained samples was taken at time_us. */
+static void _drain_start(uint64_t time_us, uint16_t anchor) {
+    bool idle = false;
+    if(!atomic_compare_exchange_strong(&_draining, &idle, true)) {
+        return;
+    }
+    _drain_us = time_us;
+    _drain_anchor = anchor;
+    if(bus_submit(&spi2_bus, &_drain_status) != U_SUCCESS) {
+        atomic_store(&_draining, false);
+    }
+}
+
+/* FIFO_STATUS1/2 is in. Reads out the FIFO. */
+static void _drain_status_done(bus_txn_t *txn) {
+    if(txn->status != BUS_DONE) {
+        atomic_store(&_draining, false); // The next watermark (or imu_waitForSample() timeout) starts another
+        return;
+    }
+    if(_status_rx[2] & IMU_FIFO_OVR) {
+        imu_fifo_overrun();
+    }
+
+    /* A burst can end partway through a sample. The parser picks it back up on the next drain. */
+    uint16_t level = _status_rx[1] | ((uint16_t)(_status_rx[2] & IMU_FIFO_LEVEL_MSB) << 8);
+    _drain_words = (level > IMU_FIFO_BURST_MAX) ? IMU_FIFO_BURST_MAX : level;
+    if(_drain_words == 0) {
+        atomic_store(&_draining, false);
+        return;
+    }
+    if(_drain_anchor == IMU_FIFO_ANCHOR_NEWEST) {
+        _drain_us = time_getMicros();
+    }
+
+    _drain_data.length = 1 + _drain_words * IMU_FIFO_WORD_SIZE;
+    if(bus_submit(&spi2_bus, &_drain_data) != U_SUCCESS) {
+        atomic_store(&_draining, false);
+    }
+}
+
+/* The FIFO's words are in. Adds them to the ring, and wakes the reader. */
+static void _drain_data_done(bus_txn_t *txn) {
+    uint16_t added = 0;
+    if(txn->status == BUS_DONE) {
+        added = imu_fifo_parse(&_data_rx[1], _drain_words, _drain_us, _drain_anchor);
+    }
+    atomic_store(&_draining, false);
+    if(added > 0) {
+        queue_send(&imu_data_ready, &_drain_us, TX_NO_WAIT); // If the queue is full, the reader has wakeups pending anyway.
+    }
+
+    /* INT2 is a level, so it gives no new edge if the FIFO refilled past the watermark while we drained it. */
+    if(txn->status == BUS_DONE && HAL_GPIO_ReadPin(IMU_INT2_GPIO_Port, IMU_INT2_Pin) == GPIO_PIN_SET) {
+        _drain_start(0, IMU_FIFO_ANCHOR_NEWEST);
+    }
+}
+
+/* Called from the IMU_INT2 FIFO threshold interrupt. The watermark'th sample was taken just now. */
+void imu_watermarkCallback(void) {
+    _drain_start(time_getMicros(), IMU_FIFO_WATERMARK - 1);
+}
+
+/* Waits (up to timeout ticks) for the IMU's next sample. Samples come out in order, and none are skipped unless the ring overflows. */
+int imu_waitForSample(imu_sample_t *sample, uint32_t timeout) {
+    uint64_t time_us;
+    while(!imu_fifo_pop(sample)) {
+        if(queue_receive(&imu_data_ready, &time_us, timeout) != U_SUCCESS) {
+            /* A drain can hang on the bus, and if one failed while INT2 was high, INT2 never gives another edge. Get it going again from here. */
+            bus_expire(&spi2_bus);
+            _drain_start(0, IMU_FIFO_ANCHOR_NEWEST);
+            return U_ERROR;
+        }
+    }
     return U_SUCCESS;
-}
\ No newline at end of file
+}
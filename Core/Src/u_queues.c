@@ -43,6 +43,13 @@ queue_t state_transition_queue = {
     .capacity = 10                         /* Number of messages the queue can hold. */
 };
 
+/* IMU Data Ready Queue. Wakes imu_waitForSample() each time a FIFO drain adds samples to the IMU ring. */
+queue_t imu_data_ready = {
+    .name = "IMU Data Ready Queue",        /* Name of the queue. */
+    .message_size = sizeof(uint64_t),      /* Size of each queue message, in bytes. */
+    .capacity = 4                          /* Number of messages the queue can hold. */
+};
+
 /* Initializes all ThreadX queues.
 *  Calls to _create_queue() should go in here
 */
@@ -54,6 +61,7 @@ uint8_t queues_init(TX_BYTE_POOL *byte_pool) {
     CATCH_ERROR(create_queue(byte_pool, &can_outgoing), U_SUCCESS); // Create Outgoing CAN Queue
     CATCH_ERROR(create_queue(byte_pool, &faults), U_SUCCESS);       // Create Faults Queue
     CATCH_ERROR(create_queue(byte_pool, &state_transition_queue), U_SUCCESS); // Create state transition queue.
+    CATCH_ERROR(create_queue(byte_pool, &imu_data_ready), U_SUCCESS); // Create IMU data ready queue.
 
     PRINTLN_INFO("Ran queues_init().");
     return U_SUCCESS;
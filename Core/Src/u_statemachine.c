@@ -168,6 +168,12 @@ static int transition_functional_state(func_state_t new_state)
 			rtds_soundRTDS();
 		}
 
+		/* Efficiency mode runs under a lower pack power cap to protect the cells. A runtime cap
+		 * (dti_set_power_limit()) still takes precedence over it. */
+		dti_set_default_power_limit(new_state == F_EFFICIENCY ?
+						    DTI_POWER_LIMIT_ENDURANCE :
+						    DTI_POWER_LIMIT_MAX);
+
 		printf("ACTIVE STATE\r\n");
 		break;
 	default:
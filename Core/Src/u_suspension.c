@@ -0,0 +1,127 @@
+#include <stdatomic.h>
+#include "main.h"
+#include "u_suspension.h"
+#include "u_tx_debug.h"
+
+/* This file includes the VCU's axle normal load estimate (see u_suspension.h). */
+
+/* Vehicle parameters. Estimates, not measured on the car, so TC only uses the load with SUSPENSION_LOAD_CEILING (see u_suspension.h). */
+#define SUSPENSION_MASS         290.0f   // (kg). Car + driver.
+#define SUSPENSION_G            9.80665f
+#define SUSPENSION_REAR_STATIC  0.55f    // Fraction of the weight on the rear axle at rest
+#define SUSPENSION_CG_HEIGHT    0.28f    // (m)
+#define SUSPENSION_WHEELBASE    1.53f    // (m)
+#define SUSPENSION_MOTION_RATIO 1.0f     // Shock travel per unit of wheel travel
+
+/* Wheel rate of each wheel on an axle (N/m), including the tire. */
+static const float _wheel_rate[NUM_SUSPENSION_AXLES] = {
+    [SUSPENSION_FRONT] = 35000.0f,
+    [SUSPENSION_REAR] = 40000.0f,
+};
+
+#define SUSPENSION_CALIB_SAMPLES 50      // Readings averaged into the static position
+#define SUSPENSION_TIMEOUT       100     // Readings are stale after this long (ms)
+
+typedef enum {
+    SENSOR_SHOCKPOT,
+    SENSOR_RIDE_HEIGHT,
+    NUM_SENSORS
+} sensor_t;
+
+/* One sensor. Only the CAN thread writes it, so only what the TC thread reads is atomic. */
+typedef struct {
+    float calib_sum;
+    uint16_t calib_samples;
+    _Atomic float rest;          // Static position, once calibrated
+    _Atomic float position;      // Latest reading
+    _Atomic uint32_t tick;       // When the latest reading arrived
+    _Atomic bool calibrated;
+} sensor_state_t;
+
+static sensor_state_t _sensors[NUM_SUSPENSION_AXLES][NUM_SENSORS];
+
+/* Records a reading, and averages the first ones into the sensor's static position. */
+static void _record(sensor_state_t *sensor, float position) {
+    if (!atomic_load(&sensor->calibrated)) {
+        sensor->calib_sum += position;
+        if (++sensor->calib_samples >= SUSPENSION_CALIB_SAMPLES) {
+            atomic_store(&sensor->rest, sensor->calib_sum / sensor->calib_samples);
+            atomic_store(&sensor->calibrated, true);
+        }
+    }
+    atomic_store(&sensor->position, position);
+    atomic_store(&sensor->tick, HAL_GetTick());
+}
+
+/* Gets how far a sensor has moved from its static position, towards compression. false if it is stale or uncalibrated. */
+static bool _get_compression(const sensor_state_t *sensor, float *compression) {
+    if (!atomic_load(&sensor->calibrated) || HAL_GetTick() - atomic_load(&sensor->tick) > SUSPENSION_TIMEOUT) {
+        return false;
+    }
+    *compression = atomic_load(&sensor->position) - atomic_load(&sensor->rest);
+    return true;
+}
+
+/* Gets how far an axle's wheels have moved up from rest (m), from whichever of its sensors are fresh. */
+static bool _get_wheel_travel(suspension_axle_t axle, float *travel) {
+    float shock = 0.0f, height = 0.0f;
+    bool has_shock = _get_compression(&_sensors[axle][SENSOR_SHOCKPOT], &shock);
+    bool has_height = _get_compression(&_sensors[axle][SENSOR_RIDE_HEIGHT], &height);
+
+    /* Shock compression is wheel travel through the motion ratio. Ride height drops by the wheel travel. */
+    float shock_travel = shock / 1000.0f / SUSPENSION_MOTION_RATIO;
+    float height_travel = height / 1000.0f;
+
+    if (has_shock && has_height) {
+        *travel = 0.5f * (shock_travel + height_travel);
+    } else if (has_shock) {
+        *travel = shock_travel;
+    } else if (has_height) {
+        *travel = height_travel;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* Records a shock pot reading (mm of shock compression). */
+void suspension_setShockpot(suspension_axle_t axle, float travel) {
+    if (axle >= NUM_SUSPENSION_AXLES) {
+        return;
+    }
+    _record(&_sensors[axle][SENSOR_SHOCKPOT], travel);
+}
+
+/* Records a ride height reading (mm). Stored negated, so it grows with compression like the shock pots. */
+void suspension_setRideHeight(suspension_axle_t axle, float height) {
+    if (axle >= NUM_SUSPENSION_AXLES) {
+        return;
+    }
+    _record(&_sensors[axle][SENSOR_RIDE_HEIGHT], -height);
+}
+
+/* Gets an axle's normal load (N). ax (m/s^2, forwards) is only used without fresh readings. */
+float suspension_getAxleLoad(suspension_axle_t axle, float ax) {
+    if (axle >= NUM_SUSPENSION_AXLES) {
+        return 0.0f;
+    }
+
+    float fraction = (axle == SUSPENSION_REAR) ? SUSPENSION_REAR_STATIC : 1.0f - SUSPENSION_REAR_STATIC;
+    float load = SUSPENSION_MASS * SUSPENSION_G * fraction;
+
+    float travel;
+    if (_get_wheel_travel(axle, &travel)) {
+        load += 2.0f * _wheel_rate[axle] * travel;
+    } else {
+        /* Accelerating moves load onto the rear axle, braking onto the front. */
+        float transfer = SUSPENSION_MASS * ax * SUSPENSION_CG_HEIGHT / SUSPENSION_WHEELBASE;
+        load += (axle == SUSPENSION_REAR) ? transfer : -transfer;
+    }
+    return (load > 0.0f) ? load : 0.0f;
+}
+
+/* Gets whether an axle's load comes from its sensors, rather than from ax. */
+bool suspension_isMeasured(suspension_axle_t axle) {
+    float travel;
+    return axle < NUM_SUSPENSION_AXLES && _get_wheel_travel(axle, &travel);
+}
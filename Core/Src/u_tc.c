@@ -1,8 +1,16 @@
 #include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
 #include "u_tc.h"
 #include "u_dti.h"
 #include "u_tx_debug.h"
 #include "u_peripherals.h"
+#include "u_time.h"
+#include "u_tc_stream.h"
+#include "u_flash.h"
+#include "u_suspension.h"
+#include "u_pedals.h"
 
 // CONSTANTS ---------------------------------------------------------
 
@@ -18,7 +26,10 @@
 // Unit conversions
 #define INCHES_TO_MILES     63360.0f   // inches per mile
 #define SECONDS_TO_HOURS    3600.0f    // seconds per hour
-#define G_IN_PER_S2         386.09f    // standard gravity in in/s^2
+#define G_MPS2              9.80665f   // standard gravity in m/s^2
+#define INCHES_TO_METERS    0.0254f    // meters per inch
+#define MPS_TO_MPH          2.23694f   // mph per m/s
+#define DEG_TO_RAD          (M_PI / 180.0f)
 
 // TC
 #define TC_CURVE_MAGIC      0x004E4552 // " NER" in hex
@@ -26,8 +37,33 @@
 #define TC_CURVE_POINTS_MAX 200
 #define TC_CALIB_SAMPLES    50
 #define TC_MIN_VX           0.5f
-#define VEL_ALPHA           0.98f 
 #define TC_INTEGRAL_LIMIT   1.0f
+#define TC_GRID_POINTS      256        // Uniform slip grid the tire curve is resampled onto
+#define TC_SLIP_RATIO_MAX   1.5f       // Highest slip target a gain point can ask for, as a fraction of peak slip
+#define TC_BANK_MAGIC       0x4B4E4254 // "TBNK" in hex
+#define TC_BANK_VERSION     1
+#define TC_BANK_CURVES_MAX  16
+#define TC_STORE_MAGIC      0x54535443 // "CTST" in hex, a curve in _tire_curve_store
+#define TC_TIRE_MU          1.4f       // Peak friction coefficient, that scales the tire curve's normalized force by the rear load
+#define TC_CEILING_MIN      0.05f      // Lowest torque ceiling, as a fraction of MAX_TORQUE, so the controller keeps some authority
+
+// Velocity estimator, see _vel_predict() and _vel_update()
+#define VEL_IMU_NOISE         0.5f     // Accelerometer noise and model error (m/s^2)
+#define VEL_IMU_DROPOUT_NOISE 5.0f     // Used instead while there is no IMU sample to integrate (m/s^2)
+#define VEL_BIAS_DRIFT        0.02f    // Accelerometer bias random walk (m/s^2 per sqrt(s))
+#define VEL_PITCH_NOISE       0.05f    // Gyro noise (rad/s)
+#define VEL_PITCH_TAU         0.5f     // Pitch leaks back to level with this time constant (s)
+#define VEL_WHEEL_NOISE       0.3f     // Front wheel speed noise (m/s)
+#define VEL_GATE              9.0f     // Innovation gate, in variances (3 sigma)
+#define VEL_MAX_REJECTS       50       // Consecutive rejections before the estimate is reset to the wheels
+#define VEL_WHEEL_TIMEOUT     100      // Front wheel speeds are stale after this long (ms)
+#define VEL_BIAS_INIT_VARIANCE  0.01f  // After calibration (m/s^2)^2
+#define VEL_PITCH_INIT_VARIANCE 0.001f // rad^2
+
+// Curve set state, see tc_state_t
+#define TC_CURVE_ACTIVE     0x01       // Index of the set in use
+#define TC_CURVE_PENDING    0x02       // The other set holds a newly selected curve
+#define TC_CURVE_LOADED     0x04       // The active set holds a valid curve
 
 // STRUCTS -----------------------------------------------------------
 
@@ -42,97 +78,405 @@ typedef struct {
   uint32_t magic;
   uint8_t version;
   uint16_t num_points;
-  char surface_id[16];
+  char surface_id[TC_SURFACE_ID_SIZE];
   float peak_lambda;
   tire_curve_point_t points[TC_CURVE_POINTS_MAX];
 } tire_curve_t;
 
+/* Curve bank, as packed by tmg/make_bank.py: this header, num_curves entries, then the curves. */
+typedef struct {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t num_curves;
+  uint16_t reserved;
+} tc_bank_header_t;
+
+typedef struct {
+  char surface_id[TC_SURFACE_ID_SIZE];
+  uint32_t offset;   // From the start of the bank
+  uint32_t size;
+  uint32_t crc32;    // IEEE 802.3, over the curve's size bytes
+} tc_bank_entry_t;
+
+/* A curve uploaded with tc_load_curve(..., persist), in _tire_curve_store: this header, then the curve. */
+typedef struct {
+  uint32_t magic;
+  uint32_t size;
+  uint32_t crc32;    // IEEE 802.3, over the curve's size bytes
+  uint32_t reserved; // Pads the header to a flash quad-word
+} tc_store_header_t;
+
 #pragma pack(pop)
 
+_Static_assert(sizeof(tire_curve_t) == TC_CURVE_SIZE, "TC_CURVE_SIZE must match tire_curve_t.");
+
+/* Either a single curve or a curve bank, linked into flash. */
 extern const uint8_t _tire_curve_start[];
 extern const uint8_t _tire_curve_size;
 
-static tire_curve_t _tire_curve;
+/* Tire curve resampled onto a uniform slip grid, so a lookup is a multiply, an index and a lerp. */
+typedef struct {
+  float slip_min;
+  float inv_step;          // 1 / grid spacing
+  float fx[TC_GRID_POINTS]; // Normalized to the curve's peak
+} tc_grid_t;
 
+/* Everything derived from one tire curve. */
 typedef struct {
-  float    v_x;
-  float    ax_bias;
-  float    alpha;
+  tire_curve_t curve;
+  tc_grid_t    grid;
+  float        peak_slip;  // Slip of peak force, that the gain schedule's slip targets are relative to
+} tc_curve_set_t;
+
+/* One set is in use by the controller while a newly selected curve is prepared in the other. */
+static tc_curve_set_t _curve_sets[2];
+
+/* Longitudinal velocity estimator: a Kalman filter over velocity, accelerometer bias and pitch, in SI
+ * units. Without the IMU's sensor fusion, the bias also absorbs road grade. */
+enum { VEL_V, VEL_BIAS, VEL_PITCH, VEL_STATES };
+
+typedef struct {
+  float    x[VEL_STATES];
+  float    P[VEL_STATES][VEL_STATES];
+  uint32_t rejected;            // Wheel speed updates rejected by the innovation gate
+  uint16_t consecutive_rejects;
+  float    calib_ax_sum;        // Stationary longitudinal accelerations, until init (mg, see _get_ax())
+  uint16_t calib_samples;
   bool     init;
 } vel_estimator_t;
 
 typedef struct {
-  float kp;
-  float ki;
-  float integral;
+  float integral; // ki * integral of the error, in normalized force, so retuning ki doesn't bump the output
+  bool  track;    // Start the next update from the last torque scale (bumpless transfer)
 } tc_pi_t;
 
 typedef struct {
-  const tire_curve_t       *tire_curve;
   vel_estimator_t          vel_estimator;
   tc_pi_t                  pi;
 
+  /* Which curve set the controller runs on, and whether the other one holds a curve waiting to be
+   * swapped in at the start of the next cycle (TC_CURVE_*). Kept in one word so the controller's swap
+   * and a new selection can each claim the pending set with a single compare and swap. */
+  _Atomic uint8_t curve_state;
+  _Atomic bool selecting;
+
+  /* Gain schedule, by vehicle speed. Tuned at runtime (tc_set_gains()) while the TC thread reads it,
+   * so it is guarded by a sequence count that is odd while a write is in progress. */
+  tc_gains_t gains[TC_GAIN_POINTS];
+  _Atomic uint32_t gains_seq;
+  _Atomic bool tuning;
+  uint32_t gains_seen;     // gains_seq when the controller last ran
+  bool was_enabled;
+
+  /* Written only by the TC thread, read by the torque path in the pedals thread. A 32 bit float, so
+   * publishing it is a single store and never blocks either side (see _publish_torque_scale()). */
   _Atomic float torque_scale;
+  _Atomic float torque_ceiling; // What the rear tires can take at peak force, from their load (Nm)
   _Atomic bool tc_enabled;
   float omega_fl;
   float omega_fr;
+  uint32_t wheel_tick;     // When the front wheel speeds last arrived
+  _Atomic bool wheel_fresh; // Set by tc_record_front_rpm(), cleared when the estimator uses them
+  bool wheel_stale;
+  bool imu_lost;            // No IMU sample on the last cycle, so the loss is only logged once
+
+  /* Copy of the estimator for tc_get_velocity_estimate(). Odd while the TC thread is writing it. */
+  _Atomic uint32_t estimate_seq;
+  tc_velocity_estimate_t estimate;
   float dt;
-  uint32_t last_tick;
-  bool tire_curve_loaded;
+  uint64_t last_us;
 } tc_state_t;
 
 static tc_state_t _tc_state = {
-  .pi           = { .kp = 1.5f, .ki = 0.2f },
+  /* Softer and with more slip allowed at launch, where the slip estimate is noisiest, tightening
+   * towards the peak as speed builds. */
+  .gains        = {
+    { .speed = 0.0f,  .kp = 1.5f, .ki = 4.0f, .slip_ratio = 1.00f },
+    { .speed = 10.0f, .kp = 2.0f, .ki = 6.0f, .slip_ratio = 0.98f },
+    { .speed = 30.0f, .kp = 2.5f, .ki = 8.0f, .slip_ratio = 0.95f },
+    { .speed = 60.0f, .kp = 3.0f, .ki = 8.0f, .slip_ratio = 0.90f },
+  },
   .torque_scale = 1.0f,
 };
 
 
 // FUNCTION PROTOTYPES ------------------------------------------------
 
-static void _load_tire_curve(tire_curve_t *curve, const uint8_t *data,
+static bool _load_tire_curve(tire_curve_t *curve, const uint8_t *data,
                              uint32_t size);
+static uint32_t _crc32(const uint8_t *data, uint32_t size);
+static bool _find_curve(const char *surface_id, const uint8_t **data, uint32_t *size);
+static bool _find_stored_curve(const char *surface_id, const uint8_t **data, uint32_t *size);
+static bool _prepare_curve_set(tc_curve_set_t *set, const uint8_t *data, uint32_t size);
+static bool _stage_curve(const uint8_t *data, uint32_t size);
+static int _store_curve(const uint8_t *data, uint32_t size, uint32_t crc32);
 static float _calc_slip(float motor_rpm, float vx_car);
 static float _rpm_to_rads(int16_t rpm);
-static void _update_dt(void);
-static float _lookup_fx(const tire_curve_t *curve, float slip);
+static void _update_dt(const imu_sample_t *sample);
+static float _lookup_fx_piecewise(const tire_curve_t *curve, float slip);
+static void _build_grid(tc_grid_t *grid, const tire_curve_t *curve);
+static float _lookup_fx(const tc_grid_t *grid, float slip);
+static float _get_ax(const imu_sample_t *sample);
+static float _get_pitch(const imu_sample_t *sample);
 static void _init_vel_estimator(vel_estimator_t *est, float avg_ax_stationary);
-static float _estimate_velocity(vel_estimator_t *est, float avg_front_rads, float ax, float dt);
-static float _update_pi(tc_pi_t *pi, const tire_curve_t *curve, float slip, float dt);
+static void _vel_predict(vel_estimator_t *est, const imu_sample_t *sample, float dt);
+static bool _vel_update(vel_estimator_t *est, float v_wheel);
+static float _estimate_velocity(vel_estimator_t *est, const imu_sample_t *sample, float dt);
+static void _publish_estimate(const vel_estimator_t *est);
+static void _schedule_gains(float mph, tc_gains_t *gains);
+static float _get_torque_ceiling(const imu_sample_t *sample);
+static float _update_pi(tc_pi_t *pi, const tc_gains_t *gains, float slip_ref, float fx_ff, float slip, float dt, float ceiling);
+static void _publish_torque_scale(float torque_scale);
+static void _stream_sample(const imu_sample_t *sample, float slip, float torque_scale);
 
 // PRIVATE FUNCTION DEFINIIONS ----------------------------------------
 
 /**
  * @brief Loads the tire curve from the given data, and checks that it is valid.
- * Sets the _tc_curve_loaded flag to true if successful.
  *
  * @param curve The tire curve struct to load data into
  * @param data Pointer to the raw tire curve data (e.g. from flash)
  * @param size Size of the raw tire curve data in bytes
+ * @return true if the curve is valid
  */
-static void _load_tire_curve(tire_curve_t *curve, const uint8_t *data,
+static bool _load_tire_curve(tire_curve_t *curve, const uint8_t *data,
                              uint32_t size) {
   if (size < sizeof(tire_curve_t)) {
     PRINTLN_ERROR("Tire curve data is too small to be valid (Size: %d bytes).",
                   size);
-    return;
+    return false;
   }
-  *curve = *(tire_curve_t *)data;
+  memcpy(curve, data, sizeof(tire_curve_t));
   if (curve->magic != TC_CURVE_MAGIC) {
     PRINTLN_ERROR("Invalid tire curve data (Magic: 0x%X).", curve->magic);
-    return;
+    return false;
   }
   if (curve->version != TC_CURVE_VERSION) {
     PRINTLN_ERROR("Unsupported tire curve version (Version: %d).",
                   curve->version);
-    return;
+    return false;
   }
-  if (curve->num_points > TC_CURVE_POINTS_MAX) {
-    PRINTLN_ERROR("Too many points in tire curve data (Num Points: %d).",
+  if (curve->num_points < 2 || curve->num_points > TC_CURVE_POINTS_MAX) {
+    PRINTLN_ERROR("Invalid number of points in tire curve data (Num Points: %d).",
                   curve->num_points);
-    return;
+    return false;
+  }
+  for (uint16_t i = 1; i < curve->num_points; i++) {
+    if (curve->points[i].slip_ratio <= curve->points[i - 1].slip_ratio) {
+      PRINTLN_ERROR("Tire curve slip ratios must be increasing (Point: %d).", i);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Bitwise CRC32 (IEEE 802.3, as zlib.crc32). Only run when a curve is selected.
+ *
+ * @param data The data to checksum
+ * @param size Size of the data in bytes
+ * @return uint32_t The CRC
+ */
+static uint32_t _crc32(const uint8_t *data, uint32_t size) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint32_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+/**
+ * @brief Finds the curve uploaded into the reserved flash sector, if there is a valid one.
+ *
+ * @param surface_id The curve to find, or NULL for whichever curve is stored
+ * @param data Set to the start of the curve
+ * @param size Set to the size of the curve in bytes
+ * @return true if a stored curve matched and passed its CRC check
+ */
+static bool _find_stored_curve(const char *surface_id, const uint8_t **data, uint32_t *size) {
+  tc_store_header_t header;
+  memcpy(&header, _tire_curve_store, sizeof(header));
+  if (header.magic != TC_STORE_MAGIC || header.size != sizeof(tire_curve_t)) {
+    return false; // Erased, or never written
+  }
+
+  const uint8_t *curve = _tire_curve_store + sizeof(header);
+  if (surface_id != NULL && strncmp(surface_id, ((const tire_curve_t *)curve)->surface_id, TC_SURFACE_ID_SIZE) != 0) {
+    return false;
+  }
+  uint32_t crc = _crc32(curve, header.size);
+  if (crc != header.crc32) {
+    PRINTLN_ERROR("Stored tire curve failed its CRC check (CRC: 0x%X, Expected: 0x%X).", crc, header.crc32);
+    return false;
+  }
+  *data = curve;
+  *size = header.size;
+  return true;
+}
+
+/**
+ * @brief Finds a tire curve in flash. The linked blob is either a curve bank, searched by
+ * surface_id with its directory bounds and CRC checked, or a single curve.
+ *
+ * @param surface_id The curve to find, or NULL for the default (the first curve in the bank)
+ * @param data Set to the start of the curve
+ * @param size Set to the size of the curve in bytes
+ * @return true if the curve was found
+ */
+static bool _find_curve(const char *surface_id, const uint8_t **data, uint32_t *size) {
+  /* An uploaded curve replaces the default, and any curve in the bank with the same surface_id. */
+  if (_find_stored_curve(surface_id, data, size)) {
+    return true;
+  }
+
+  const uint8_t *blob = _tire_curve_start;
+  uint32_t blob_size = (uint32_t)&_tire_curve_size;
+
+  if (blob_size < sizeof(tc_bank_header_t)) {
+    PRINTLN_ERROR("Tire curve data is too small to be valid (Size: %d bytes).", blob_size);
+    return false;
+  }
+
+  tc_bank_header_t header;
+  memcpy(&header, blob, sizeof(header));
+
+  /* A single curve has no directory, so it can only be selected by its own surface_id. */
+  if (header.magic == TC_CURVE_MAGIC) {
+    const tire_curve_t *curve = (const tire_curve_t *)blob;
+    if (surface_id != NULL && strncmp(surface_id, curve->surface_id, TC_SURFACE_ID_SIZE) != 0) {
+      PRINTLN_ERROR("Tire curve '%.16s' not found.", surface_id);
+      return false;
+    }
+    *data = blob;
+    *size = blob_size;
+    return true;
+  }
+
+  if (header.magic != TC_BANK_MAGIC || header.version != TC_BANK_VERSION) {
+    PRINTLN_ERROR("Invalid tire curve bank (Magic: 0x%X, Version: %d).", header.magic, header.version);
+    return false;
+  }
+  uint32_t directory_size = sizeof(tc_bank_header_t) + header.num_curves * sizeof(tc_bank_entry_t);
+  if (header.num_curves == 0 || header.num_curves > TC_BANK_CURVES_MAX || directory_size > blob_size) {
+    PRINTLN_ERROR("Invalid tire curve bank directory (Num Curves: %d).", header.num_curves);
+    return false;
+  }
+
+  for (uint8_t i = 0; i < header.num_curves; i++) {
+    tc_bank_entry_t entry;
+    memcpy(&entry, blob + sizeof(tc_bank_header_t) + i * sizeof(tc_bank_entry_t), sizeof(entry));
+    if (surface_id != NULL && strncmp(surface_id, entry.surface_id, TC_SURFACE_ID_SIZE) != 0) {
+      continue;
+    }
+
+    if (entry.offset < directory_size || entry.offset > blob_size || entry.size > blob_size - entry.offset) {
+      PRINTLN_ERROR("Tire curve '%.16s' lies outside the bank (Offset: %d, Size: %d).", entry.surface_id,
+                    entry.offset, entry.size);
+      return false;
+    }
+    uint32_t crc = _crc32(blob + entry.offset, entry.size);
+    if (crc != entry.crc32) {
+      PRINTLN_ERROR("Tire curve '%.16s' failed its CRC check (CRC: 0x%X, Expected: 0x%X).", entry.surface_id,
+                    crc, entry.crc32);
+      return false;
+    }
+    *data = blob + entry.offset;
+    *size = entry.size;
+    return true;
+  }
+
+  PRINTLN_ERROR("Tire curve '%.16s' not found in the bank.", surface_id);
+  return false;
+}
+
+/**
+ * @brief Loads a tire curve into a curve set, and builds everything the controller needs from it.
+ *
+ * @param set The curve set to fill. Must not be in use by the controller.
+ * @param data The tire curve blob
+ * @param size Size of the blob in bytes
+ * @return true if the curve is valid
+ */
+static bool _prepare_curve_set(tc_curve_set_t *set, const uint8_t *data, uint32_t size) {
+  if (!_load_tire_curve(&set->curve, data, size)) {
+    return false;
+  }
+
+  _build_grid(&set->grid, &set->curve);
+
+  /* peak_lambda is only trusted inside the curve's (driving) slip range. Otherwise the peak is taken
+   * from the points. */
+  const tire_curve_t *curve = &set->curve;
+  set->peak_slip = curve->peak_lambda;
+  if (!(set->peak_slip > 0.0f && set->peak_slip <= curve->points[curve->num_points - 1].slip_ratio)) {
+    float fx_peak = -INFINITY;
+    for (uint16_t i = 0; i < curve->num_points; i++) {
+      if (curve->points[i].slip_ratio > 0.0f && curve->points[i].fx_norm > fx_peak) {
+        fx_peak = curve->points[i].fx_norm;
+        set->peak_slip = curve->points[i].slip_ratio;
+      }
+    }
+    if (!(fx_peak > -INFINITY)) {
+      PRINTLN_ERROR("Tire curve '%.16s' has no positive slip points.", curve->surface_id);
+      return false;
+    }
+    PRINTLN_WARNING("Tire curve '%.16s' peak_lambda (%.3f) is out of range, using the peak at slip %.3f.",
+                    curve->surface_id, curve->peak_lambda, set->peak_slip);
+  }
+  return true;
+}
+
+/**
+ * @brief Prepares a curve in the set the controller is not using, to be swapped in at the start of the
+ * next cycle. Replaces a curve that has been staged but not swapped in yet, even if this one is invalid.
+ * Only called with _tc_state.selecting held.
+ *
+ * @param data The tire curve blob
+ * @param size Size of the blob in bytes
+ * @return true if the curve is valid and was staged
+ */
+static bool _stage_curve(const uint8_t *data, uint32_t size) {
+  /* Take back a curve that has not been swapped in yet. If the controller swaps it in first, the
+   * compare fails and the state is reloaded with the new active set. Either way the set that is not
+   * active is then free to overwrite. */
+  uint8_t state = _tc_state.curve_state;
+  while ((state & TC_CURVE_PENDING) &&
+         !atomic_compare_exchange_weak(&_tc_state.curve_state, &state, state & ~TC_CURVE_PENDING)) {
+  }
+  state &= ~TC_CURVE_PENDING;
+
+  tc_curve_set_t *set = &_curve_sets[(state & TC_CURVE_ACTIVE) ^ 1];
+  if (!_prepare_curve_set(set, data, size)) {
+    return false;
   }
+  _tc_state.curve_state = state | TC_CURVE_PENDING;
+  return true;
+}
+
+/**
+ * @brief Writes a curve to the reserved flash sector, so it is loaded at boot. Erasing the sector
+ * takes tens of ms, so this is never called from the TC thread. Only called with
+ * _tc_state.selecting held, so no one is reading the sector.
+ *
+ * @param data The tire curve blob
+ * @param size Size of the blob in bytes
+ * @param crc32 CRC of the blob
+ * @return int U_SUCCESS, or U_ERROR if the flash could not be written
+ */
+static int _store_curve(const uint8_t *data, uint32_t size, uint32_t crc32) {
+  tc_store_header_t header = { .magic = TC_STORE_MAGIC, .size = size, .crc32 = crc32 };
 
-  _tc_state.tire_curve_loaded = true;
+  /* Header last, so a write that is cut short leaves no valid curve rather than a bad one. */
+  if (flash_eraseSector(_tire_curve_store) != U_SUCCESS ||
+      flash_write(_tire_curve_store + sizeof(header), data, size) != U_SUCCESS ||
+      flash_write(_tire_curve_store, &header, sizeof(header)) != U_SUCCESS) {
+    return U_ERROR;
+  }
+  return U_SUCCESS;
 }
 
 /**
@@ -162,25 +506,31 @@ static float _rpm_to_rads(int16_t rpm) {
 }
 
 /**
- * @brief Updates the time delta (dt) in seconds since the last call to this function, and stores the current tick count. Should be called at the beginning of each TC processing cycle to ensure accurate velocity estimation and slip calculation.
- * 
+ * @brief Updates the time delta (dt) in seconds since the last call to this function. Uses the time of the IMU's data-ready interrupt when there is a sample, so dt is the time between samples and not between cycles. Should be called at the beginning of each TC processing cycle to ensure accurate velocity estimation and slip calculation.
+ *
+ * @param sample The IMU sample for this cycle, or NULL if none arrived
  */
-static void _update_dt(void) {
-  uint32_t current_tick = HAL_GetTick();
-  // Convert ms to seconds
-  _tc_state.dt = (current_tick - _tc_state.last_tick) / 1000.0f;
-  _tc_state.last_tick = current_tick;
+static void _update_dt(const imu_sample_t *sample) {
+  uint64_t now = (sample != NULL) ? sample->time_us : time_getMicros();
+  if (_tc_state.last_us == 0 || now < _tc_state.last_us) {
+    // Nothing to integrate over on the first cycle, or for a sample from before the last cycle
+    _tc_state.dt = 0.0f;
+    _tc_state.last_us = MAX(now, _tc_state.last_us);
+    return;
+  }
+  _tc_state.dt = (now - _tc_state.last_us) / 1000000.0f;
+  _tc_state.last_us = now;
 }
 
 /**
  * @brief Linear interpolation into the tire curve using binary search.
- * O(log n)
+ * O(log n). Only used to build the grid.
  *
  * @param curve The tire curve struct to use for lookup
  * @param slip The slip ratio
  * @return float The longitudinal force
  */
-static float _lookup_fx(const tire_curve_t *curve, float slip) {
+static float _lookup_fx_piecewise(const tire_curve_t *curve, float slip) {
   uint16_t n = curve->num_points;
 
   if (slip <= curve->points[0].slip_ratio) return curve->points[0].fx_norm;
@@ -202,98 +552,569 @@ static float _lookup_fx(const tire_curve_t *curve, float slip) {
   return curve->points[lo].fx_norm + t * (curve->points[hi].fx_norm - curve->points[lo].fx_norm);
 }
 
+/**
+ * @brief Resamples the tire curve onto a uniform slip grid spanning the curve's slip range.
+ * Curves exported in newtons rather than normalized are scaled so their peak is 1.0.
+ *
+ * @param grid The grid to build
+ * @param curve A validated tire curve
+ */
+static void _build_grid(tc_grid_t *grid, const tire_curve_t *curve) {
+  float slip_min = curve->points[0].slip_ratio;
+  float slip_max = curve->points[curve->num_points - 1].slip_ratio;
+  float step = (slip_max - slip_min) / (TC_GRID_POINTS - 1);
+
+  float fx_peak = 0.0f;
+  for (uint16_t i = 0; i < curve->num_points; i++) {
+    fx_peak = MAX(fx_peak, curve->points[i].fx_norm);
+  }
+  float scale = (fx_peak > 1.0f) ? 1.0f / fx_peak : 1.0f;
+
+  grid->slip_min = slip_min;
+  grid->inv_step = 1.0f / step;
+  for (uint16_t i = 0; i < TC_GRID_POINTS; i++) {
+    grid->fx[i] = _lookup_fx_piecewise(curve, slip_min + i * step) * scale;
+  }
+}
+
+/**
+ * @brief Linear interpolation into the uniform slip grid.
+ * O(1)
+ *
+ * @param grid The grid to use for lookup
+ * @param slip The slip ratio
+ * @return float The normalized longitudinal force
+ */
+static float _lookup_fx(const tc_grid_t *grid, float slip) {
+  float x = (slip - grid->slip_min) * grid->inv_step;
+
+  if (x <= 0.0f) return grid->fx[0];
+  if (x >= TC_GRID_POINTS - 1) return grid->fx[TC_GRID_POINTS - 1];
+
+  uint16_t i = (uint16_t)x;
+  float t = x - i;
+  return grid->fx[i] + t * (grid->fx[i + 1] - grid->fx[i]);
+}
+
+/**
+ * @brief Gets the longitudinal acceleration from an IMU sample. When the IMU's sensor fusion (SFLP) is
+ * running, the gravity it estimates is taken out, so chassis pitch and road grade are too. Otherwise
+ * this is the raw reading, and the estimator's pitch and bias have to account for gravity.
+ *
+ * @param sample The IMU sample
+ * @return float Longitudinal acceleration (mg)
+ */
+static float _get_ax(const imu_sample_t *sample) {
+  return sample->fused ? sample->accel.x - sample->gravity.x : sample->accel.x;
+}
+
+/**
+ * @brief Gets the pitch from the gravity the IMU's sensor fusion estimates. Nose up is gravity along +x,
+ * as the accelerometer sees it.
+ *
+ * @param sample The IMU sample, which must be fused
+ * @return float Pitch (rad)
+ */
+static float _get_pitch(const imu_sample_t *sample) {
+  const vector3_t *g = &sample->gravity;
+  float norm = sqrtf(g->x * g->x + g->y * g->y + g->z * g->z);
+  if (norm <= 0.0f) {
+    return 0.0f;
+  }
+  return asinf(MIN(MAX(g->x / norm, -1.0f), 1.0f));
+}
+
 /**
  * @brief Initializes the velocity estimator with a stationary accelerometer
  * bias. Must be called once with the average ax reading while the car is
- * stationary so that ax_bias can be subtracted during integration.
+ * stationary, so the car starts at rest with a known bias.
  *
  * @param est Pointer to the velocity estimator struct
- * @param avg_ax_stationary Average x-axis accelerometer reading at rest (mg)
+ * @param avg_ax_stationary Average longitudinal acceleration at rest, from _get_ax() (mg)
  */
 static void _init_vel_estimator(vel_estimator_t *est, float avg_ax_stationary) {
-  est->ax_bias   = avg_ax_stationary;
-  est->v_x       = 0.0f;
-  est->init      = true;
-  est->alpha     = VEL_ALPHA;
+  memset(est, 0, sizeof(*est));
+  est->x[VEL_BIAS] = avg_ax_stationary * G_MPS2 / 1000.0f;
+  est->P[VEL_V][VEL_V] = VEL_WHEEL_NOISE * VEL_WHEEL_NOISE;
+  est->P[VEL_BIAS][VEL_BIAS] = VEL_BIAS_INIT_VARIANCE;
+  est->P[VEL_PITCH][VEL_PITCH] = VEL_PITCH_INIT_VARIANCE;
+  est->init = true;
   PRINTLN_INFO("Vel estimator calibrated (ax_bias=%.3f mg).", avg_ax_stationary);
 }
 
 /**
- * @brief Estimates the longitudinal velocity using the front wheel speeds and x-axis acceleration. Uses a simple complementary filter to combine the wheel speed-based velocity estimate with the accelerometer-based estimate, which helps mitigate wheel slip errors. Should be called periodically from the TC thread after calibration is complete.
- * 
+ * @brief Kalman filter predict step. Integrates the bias and pitch corrected acceleration:
+ *
+ *   v'     = v + (ax - bias - g sin(pitch)) dt
+ *   bias'  = bias
+ *   pitch' = pitch + (pitch_rate - pitch / VEL_PITCH_TAU) dt
+ *
+ * Pitch is the gyro integrated with a leak, so it follows squat and dive but not a steady grade.
+ * When the sample carries the IMU's sensor fusion output, gravity is already out of ax (see _get_ax()),
+ * so the g sin(pitch) term drops out and pitch is just the fusion's.
+ * Without an IMU sample the velocity is held and its variance grows with VEL_IMU_DROPOUT_NOISE.
+ *
  * @param est Pointer to the velocity estimator struct
- * @param avg_front_rads Average of the front left and right wheel speeds in radians per second
- * @param ax Accelerometer x-axis reading in mg (without bias already subtracted)
+ * @param sample The IMU sample for this cycle, or NULL if none arrived
+ * @param dt Time in seconds since the last prediction
+ */
+static void _vel_predict(vel_estimator_t *est, const imu_sample_t *sample, float dt) {
+  float F[VEL_STATES][VEL_STATES] = {
+    { 1.0f, 0.0f, 0.0f },
+    { 0.0f, 1.0f, 0.0f },
+    { 0.0f, 0.0f, 1.0f - dt / VEL_PITCH_TAU },
+  };
+  float pitch = est->x[VEL_PITCH];
+  float accel_noise;
+
+  if (sample != NULL && sample->fused) {
+    float ax = _get_ax(sample) * G_MPS2 / 1000.0f;            // mg -> m/s^2
+    est->x[VEL_V] += (ax - est->x[VEL_BIAS]) * dt;
+    est->x[VEL_PITCH] = _get_pitch(sample);
+    F[VEL_V][VEL_BIAS] = -dt;
+    F[VEL_PITCH][VEL_PITCH] = 0.0f;
+    accel_noise = VEL_IMU_NOISE;
+  } else if (sample != NULL) {
+    float ax = sample->accel.x * G_MPS2 / 1000.0f;           // mg -> m/s^2
+    float pitch_rate = sample->gyro.y * DEG_TO_RAD / 1000.0f; // mdps -> rad/s
+    est->x[VEL_V] += (ax - est->x[VEL_BIAS] - G_MPS2 * sinf(pitch)) * dt;
+    est->x[VEL_PITCH] += (pitch_rate - pitch / VEL_PITCH_TAU) * dt;
+    F[VEL_V][VEL_BIAS] = -dt;
+    F[VEL_V][VEL_PITCH] = -G_MPS2 * cosf(pitch) * dt;
+    accel_noise = VEL_IMU_NOISE;
+  } else {
+    est->x[VEL_PITCH] -= pitch / VEL_PITCH_TAU * dt;
+    accel_noise = VEL_IMU_DROPOUT_NOISE;
+  }
+
+  // P = F P F' + Q
+  float FP[VEL_STATES][VEL_STATES];
+  for (int i = 0; i < VEL_STATES; i++) {
+    for (int j = 0; j < VEL_STATES; j++) {
+      FP[i][j] = 0.0f;
+      for (int k = 0; k < VEL_STATES; k++) FP[i][j] += F[i][k] * est->P[k][j];
+    }
+  }
+  for (int i = 0; i < VEL_STATES; i++) {
+    for (int j = 0; j < VEL_STATES; j++) {
+      est->P[i][j] = 0.0f;
+      for (int k = 0; k < VEL_STATES; k++) est->P[i][j] += FP[i][k] * F[j][k];
+    }
+  }
+  est->P[VEL_V][VEL_V] += (accel_noise * dt) * (accel_noise * dt);
+  est->P[VEL_BIAS][VEL_BIAS] += VEL_BIAS_DRIFT * VEL_BIAS_DRIFT * dt;
+  est->P[VEL_PITCH][VEL_PITCH] += (VEL_PITCH_NOISE * dt) * (VEL_PITCH_NOISE * dt);
+}
+
+/**
+ * @brief Kalman filter update step with the front wheel speed, which measures the velocity directly.
+ * Updates that disagree with the prediction by more than VEL_GATE variances (a locked or spinning
+ * front wheel) are rejected. If VEL_MAX_REJECTS are rejected in a row, the wheels are more likely
+ * right than the estimate, so the velocity is reset to them.
+ *
+ * @param est Pointer to the velocity estimator struct
+ * @param v_wheel Velocity measured by the front wheels (m/s)
+ * @return bool Whether the measurement was used
+ */
+static bool _vel_update(vel_estimator_t *est, float v_wheel) {
+  const float r = VEL_WHEEL_NOISE * VEL_WHEEL_NOISE;
+  float innovation = v_wheel - est->x[VEL_V];
+  float s = est->P[VEL_V][VEL_V] + r;
+
+  if (innovation * innovation > VEL_GATE * s) {
+    est->rejected++;
+    if (++est->consecutive_rejects < VEL_MAX_REJECTS) {
+      return false;
+    }
+    PRINTLN_WARNING("Vel estimator reset to wheel speed (%.2f m/s, estimate was %.2f m/s).", v_wheel, est->x[VEL_V]);
+    est->x[VEL_V] = v_wheel;
+    est->P[VEL_V][VEL_V] = r;
+    for (int i = 1; i < VEL_STATES; i++) {
+      est->P[VEL_V][i] = 0.0f;
+      est->P[i][VEL_V] = 0.0f;
+    }
+    est->consecutive_rejects = 0;
+    return true;
+  }
+  est->consecutive_rejects = 0;
+
+  // H = [1 0 0], so K = P[:, v] / S and P -= K P[v, :]
+  float gain[VEL_STATES];
+  float p_v[VEL_STATES];
+  for (int i = 0; i < VEL_STATES; i++) {
+    gain[i] = est->P[i][VEL_V] / s;
+    p_v[i] = est->P[VEL_V][i];
+  }
+  for (int i = 0; i < VEL_STATES; i++) {
+    est->x[i] += gain[i] * innovation;
+    for (int j = 0; j < VEL_STATES; j++) {
+      est->P[i][j] -= gain[i] * p_v[j];
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Estimates the longitudinal velocity from the IMU and the front wheel speeds. Predicts with
+ * the IMU sample every cycle, and corrects with the front wheels whenever a new wheel speed message
+ * has arrived since the last cycle. Should be called every TC cycle after calibration is complete.
+ *
+ * @param est Pointer to the velocity estimator struct
+ * @param sample The IMU sample for this cycle, or NULL if none arrived
  * @param dt Time in seconds since the last velocity estimate (should be the TC thread period)
  * @return float Estimated longitudinal velocity in miles per hour
  */
-static float _estimate_velocity(vel_estimator_t *est, float avg_front_rads, float ax, float dt) {
-  // MPH: v = ω * r * SECONDS_TO_HOURS / INCHES_TO_MILES
-  //      = ω [rad/s] * r [in] * (3600 s/hr) / (63360 in/mi)
-  float vx_wheel = avg_front_rads * (TIRE_DIAMETER / 2.0f) * SECONDS_TO_HOURS / INCHES_TO_MILES;
-  float ax_corrected = ax - est->ax_bias;
-  // IMU integration: a [mg] * (G_IN_PER_S2/1000) [in/s² per mg] * dt [s] → dv [in/s]
-  //                  then convert dv to mph and add to current estimate
-  float vx_imu = est->v_x + ax_corrected * (G_IN_PER_S2 / 1000.0f) * dt * SECONDS_TO_HOURS / INCHES_TO_MILES;
+static float _estimate_velocity(vel_estimator_t *est, const imu_sample_t *sample, float dt) {
+  _vel_predict(est, sample, dt);
 
-  // Complementary filter to combine wheel and IMU estimates
-  est->v_x = (est->alpha * vx_wheel) + ((1.0f - est->alpha) * vx_imu);
+  if (atomic_exchange(&_tc_state.wheel_fresh, false)) {
+    // v = ω [rad/s] * r [in] * (0.0254 m/in)
+    float avg_front_rads = (_tc_state.omega_fl + _tc_state.omega_fr) / 2.0f;
+    _vel_update(est, avg_front_rads * (TIRE_DIAMETER / 2.0f) * INCHES_TO_METERS);
+  }
+
+  bool stale = (HAL_GetTick() - _tc_state.wheel_tick) > VEL_WHEEL_TIMEOUT;
+  if (stale && !_tc_state.wheel_stale) {
+    PRINTLN_WARNING("Front wheel speeds are stale, velocity is estimated from the IMU only.");
+  }
+  _tc_state.wheel_stale = stale;
+
+  _publish_estimate(est);
 
   // Velocity can't be negative (for TC purposes)
-  if (est->v_x < 0.0f) est->v_x = 0.0f;
+  return MAX(est->x[VEL_V], 0.0f) * MPS_TO_MPH;
+}
 
-  return est->v_x;
+/**
+ * @brief Copies the estimator for tc_get_velocity_estimate(). The sequence is odd while the copy is
+ * being written, so a reader in another thread can tell it raced with the TC thread and retry.
+ *
+ * @param est Pointer to the velocity estimator struct
+ */
+static void _publish_estimate(const vel_estimator_t *est) {
+  uint32_t seq = atomic_load_explicit(&_tc_state.estimate_seq, memory_order_relaxed);
+  atomic_store_explicit(&_tc_state.estimate_seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  _tc_state.estimate.velocity = est->x[VEL_V];
+  _tc_state.estimate.ax_bias = est->x[VEL_BIAS];
+  _tc_state.estimate.pitch = est->x[VEL_PITCH];
+  memcpy(_tc_state.estimate.covariance, est->P, sizeof(est->P));
+  _tc_state.estimate.rejected = est->rejected;
+  _tc_state.estimate.wheel_age = HAL_GetTick() - _tc_state.wheel_tick;
+
+  atomic_store_explicit(&_tc_state.estimate_seq, seq + 2, memory_order_release);
+}
+
+/**
+ * @brief Interpolates the gain schedule at the given speed. Speeds outside the table use the nearest
+ * point.
+ *
+ * @param mph Vehicle speed in miles per hour
+ * @param gains Filled in with the interpolated gains
+ */
+static void _schedule_gains(float mph, tc_gains_t *gains) {
+  uint32_t seq;
+  do {
+    seq = atomic_load_explicit(&_tc_state.gains_seq, memory_order_acquire);
+    const tc_gains_t *table = _tc_state.gains;
+    uint8_t i = 1;
+    while (i < TC_GAIN_POINTS - 1 && mph > table[i].speed) i++;
+
+    float t = (mph - table[i - 1].speed) / (table[i].speed - table[i - 1].speed);
+    t = MIN(MAX(t, 0.0f), 1.0f);
+    gains->speed      = mph;
+    gains->kp         = table[i - 1].kp + t * (table[i].kp - table[i - 1].kp);
+    gains->ki         = table[i - 1].ki + t * (table[i].ki - table[i - 1].ki);
+    gains->slip_ratio = table[i - 1].slip_ratio + t * (table[i].slip_ratio - table[i - 1].slip_ratio);
+    atomic_thread_fence(memory_order_acquire);
+  } while ((seq & 1) || seq != atomic_load_explicit(&_tc_state.gains_seq, memory_order_relaxed));
+}
+
+/**
+ * @brief Gets the torque the rear tires can take at their peak force, as a fraction of MAX_TORQUE.
+ * The tire curve is normalized to its peak, so this is what turns the controller's output into torque.
+ * It follows the rear axle's load (see u_suspension.h), so TC's authority grows as weight transfers
+ * onto the rear under acceleration, and shrinks as it comes off. Without SUSPENSION_LOAD_CEILING, the
+ * ceiling is MAX_TORQUE, so the controller's output is the torque scale.
+ *
+ * @param sample The IMU sample for this cycle, or NULL. Only used when the suspension sensors are stale.
+ * @return float
+ */
+static float _get_torque_ceiling(const imu_sample_t *sample) {
+#ifndef SUSPENSION_LOAD_CEILING
+  (void)sample;
+  atomic_store_explicit(&_tc_state.torque_ceiling, MAX_TORQUE, memory_order_relaxed);
+  return 1.0f;
+#else
+  float ax = 0.0f;
+  if (sample != NULL) {
+    ax = _get_ax(sample) * G_MPS2 / 1000.0f - _tc_state.vel_estimator.x[VEL_BIAS];
+  }
+
+  float fz_rear = suspension_getAxleLoad(SUSPENSION_REAR, ax);
+  float wheel_radius = TIRE_DIAMETER / 2.0f * INCHES_TO_METERS;
+  float ceiling = TC_TIRE_MU * fz_rear * wheel_radius / GEAR_RATIO;
+  atomic_store_explicit(&_tc_state.torque_ceiling, ceiling, memory_order_relaxed);
+  return MAX(ceiling / MAX_TORQUE, TC_CEILING_MIN);
+#endif
 }
 
 /**
  * @brief Updates the PI controller and returns the resulting torque scale.
- * 
- * @param pi Pointer to the tc_pi_t struct containing the PI controller state and gains
- * @param curve Pointer to the tire curve struct for feedforward lookup
+ *
+ * The controller works in the tire curve's normalized force, which the torque ceiling turns into a
+ * torque scale, so the same gains hold at any rear load. The integral is only updated when that
+ * doesn't push a saturated output further into saturation (conditional integration), so it can't
+ * wind up while TC has nothing to do. When pi->track is set, the integral is first set so the output
+ * continues from the last torque scale (bumpless transfer).
+ *
+ * @param pi Pointer to the tc_pi_t struct containing the PI controller state
+ * @param gains Gains scheduled for the current speed
+ * @param slip_ref The target slip ratio
+ * @param fx_ff Feedforward term, the tire curve at slip_ref
  * @param slip The current slip ratio
  * @param dt Time in seconds since the last update (should be the TC thread period)
- * @return float 
+ * @param ceiling Torque at the tire curve's peak, as a fraction of MAX_TORQUE (see _get_torque_ceiling())
+ * @return float
  */
-static float _update_pi(tc_pi_t *pi, const tire_curve_t *curve, float slip, float dt) {
-  // Target slip slightly below peak for stability
-  float slip_ref = curve->peak_lambda * 0.98f; 
+static float _update_pi(tc_pi_t *pi, const tc_gains_t *gains, float slip_ref, float fx_ff, float slip, float dt, float ceiling) {
   float error = slip_ref - slip;
 
-  pi->integral += error * dt;
-  if (pi->integral > TC_INTEGRAL_LIMIT) pi->integral = TC_INTEGRAL_LIMIT;
-  else if (pi->integral < -TC_INTEGRAL_LIMIT) pi->integral = -TC_INTEGRAL_LIMIT;
+  if (pi->track) {
+    pi->track = false;
+    float previous = atomic_load_explicit(&_tc_state.torque_scale, memory_order_relaxed);
+    pi->integral = MIN(MAX(previous / ceiling - fx_ff - gains->kp * error, -TC_INTEGRAL_LIMIT), TC_INTEGRAL_LIMIT);
+  }
 
-  // feedforward term from tire curve, plus PI control
-  float fx_ff = _lookup_fx(curve, slip_ref);
+  float integral = MIN(MAX(pi->integral + gains->ki * error * dt, -TC_INTEGRAL_LIMIT), TC_INTEGRAL_LIMIT);
 
-  float feedback = pi->kp * error + pi->ki * pi->integral;
-  float torque_scale = fx_ff + feedback;
+  // feedforward term from tire curve, plus PI control, scaled by what the rear tires can take
+  float torque_scale = (fx_ff + gains->kp * error + integral) * ceiling;
+  bool winding_up = (torque_scale > 1.0f && error > 0.0f) || (torque_scale < 0.0f && error < 0.0f);
+  if (winding_up) {
+    torque_scale = (fx_ff + gains->kp * error + pi->integral) * ceiling;
+  } else {
+    pi->integral = integral;
+  }
 
-  if (torque_scale < 0.0f) torque_scale = 0.0f;
-  if (torque_scale > 1.0f) torque_scale = 1.0f;
+  return MIN(MAX(torque_scale, 0.0f), 1.0f);
+}
 
-  return torque_scale;
+/**
+ * @brief Publishes a new torque scale for the torque path. Release ordering, so a reader that sees
+ * the new scale also sees everything the TC thread wrote before it.
+ *
+ * @param torque_scale The new torque scale, in [0.0, 1.0]
+ */
+static void _publish_torque_scale(float torque_scale) {
+  atomic_store_explicit(&_tc_state.torque_scale, torque_scale, memory_order_release);
+}
+
+/**
+ * @brief Records this cycle into the debug stream, if it is enabled (see u_tc_stream.h).
+ *
+ * @param sample The IMU sample for this cycle, or NULL if none arrived
+ * @param slip The rear slip ratio
+ * @param torque_scale The torque scale published this cycle
+ */
+static void _stream_sample(const imu_sample_t *sample, float slip, float torque_scale) {
+  if (!tc_stream_isEnabled()) {
+    return;
+  }
+
+  tc_stream_sample_t record = {
+    .time_us      = (uint32_t)((sample != NULL) ? sample->time_us : _tc_state.last_us),
+    .slip         = slip,
+    .velocity     = _tc_state.vel_estimator.x[VEL_V],
+    .omega_fl     = _tc_state.omega_fl,
+    .omega_fr     = _tc_state.omega_fr,
+    .ax           = (sample != NULL) ? sample->accel.x / 1000.0f * G_MPS2 : NAN,
+    .integral     = _tc_state.pi.integral,
+    .torque_scale = torque_scale,
+  };
+  tc_stream_record(&record);
 }
 
 // PUBLIC FUNCTION DEFINITIONS -----------------------------------------
 
 /**
- * @brief Loads the tire curve from flash into the _tc_curve global variable,
+ * @brief Loads the default tire curve from flash (the first curve in the bank),
  * and checks that it is valid. Also inits TC module.
  *
  * @return int Success or error code (U_SUCCESS or U_ERROR)
  */
 int tc_init(void) {
-  int tire_model_bin_size = (int)&_tire_curve_size;
-  printf("Tire model bin size: %d bytes\n", tire_model_bin_size);
+  printf("Tire model bin size: %d bytes\n", (int)&_tire_curve_size);
 
-  _load_tire_curve(&_tire_curve, _tire_curve_start, tire_model_bin_size);
-  _tc_state.tire_curve = &_tire_curve;
+  const uint8_t *data;
+  uint32_t size;
+  if (_find_curve(NULL, &data, &size) && _prepare_curve_set(&_curve_sets[0], data, size)) {
+    _tc_state.curve_state = TC_CURVE_LOADED;
+    PRINTLN_INFO("Loaded tire curve '%.16s'.", _curve_sets[0].curve.surface_id);
+  }
 
   PRINTLN_INFO("Ran tc_init().");
   return U_SUCCESS;
 }
 
+/**
+ * @brief Selects the tire curve TC runs on. The curve is loaded and checked here, in the
+ * caller's thread, and swapped in at the start of the next control cycle.
+ *
+ * A curve that has been selected but not swapped in yet is replaced, even if this selection fails.
+ *
+ * @param surface_id The surface_id of a curve in the bank
+ * @return int U_SUCCESS, or U_ERROR if the curve is not found or invalid, or another selection is in progress
+ */
+int tc_select_curve(const char *surface_id) {
+  if (atomic_exchange(&_tc_state.selecting, true)) {
+    PRINTLN_WARNING("Tire curve selection already in progress, ignoring '%.16s'.", surface_id);
+    return U_ERROR;
+  }
+
+  int status = U_ERROR;
+  const uint8_t *data;
+  uint32_t size;
+  if (_find_curve(surface_id, &data, &size) && _stage_curve(data, size)) {
+    PRINTLN_INFO("Selected tire curve '%.16s'.", surface_id);
+    status = U_SUCCESS;
+  }
+
+  _tc_state.selecting = false;
+  return status;
+}
+
+/**
+ * @brief Loads a tire curve that did not come from flash (e.g. uploaded over the network). The curve
+ * is checked (CRC, magic, version, point count, increasing slip) in the caller's thread, and swapped in
+ * at the start of the next control cycle, like a selection.
+ *
+ * @param data The tire curve blob, as written by tmg/fetch.py
+ * @param size Size of the blob in bytes
+ * @param crc32 CRC32 (IEEE 802.3, as zlib.crc32) the sender computed over the blob
+ * @param persist Also write the curve to flash, so it replaces the default curve at boot
+ * @return int U_SUCCESS, or U_ERROR if the curve is invalid, could not be stored, or another selection is in progress
+ */
+int tc_load_curve(const uint8_t *data, uint32_t size, uint32_t crc32, bool persist) {
+  if (size != sizeof(tire_curve_t)) {
+    PRINTLN_ERROR("Uploaded tire curve is the wrong size (Size: %d bytes, Expected: %d).", size, sizeof(tire_curve_t));
+    return U_ERROR;
+  }
+  uint32_t crc = _crc32(data, size);
+  if (crc != crc32) {
+    PRINTLN_ERROR("Uploaded tire curve failed its CRC check (CRC: 0x%X, Expected: 0x%X).", crc, crc32);
+    return U_ERROR;
+  }
+
+  if (atomic_exchange(&_tc_state.selecting, true)) {
+    PRINTLN_WARNING("Tire curve selection already in progress, ignoring the uploaded curve.");
+    return U_ERROR;
+  }
+
+  int status = U_ERROR;
+  if (_stage_curve(data, size)) {
+    PRINTLN_INFO("Loaded uploaded tire curve '%.16s'.", ((const tire_curve_t *)data)->surface_id);
+    status = U_SUCCESS;
+    if (persist) {
+      status = _store_curve(data, size, crc32);
+      if (status != U_SUCCESS) {
+        PRINTLN_ERROR("Failed to store the uploaded tire curve. It is in use, but will not survive a reboot.");
+      }
+    }
+  }
+
+  _tc_state.selecting = false;
+  return status;
+}
+
+/**
+ * @brief Gets the surface_id of the tire curve TC is running on.
+ *
+ * @return const char* The surface_id, or an empty string if no curve is loaded
+ */
+const char *tc_get_surface_id(void) {
+  uint8_t state = _tc_state.curve_state;
+  return (state & TC_CURVE_LOADED) ? _curve_sets[state & TC_CURVE_ACTIVE].curve.surface_id : "";
+}
+
+/**
+ * @brief Sets one point of the gain schedule. Takes effect on the next TC cycle, without a bump in
+ * the torque scale.
+ *
+ * @param index The point to set, in [0, TC_GAIN_POINTS)
+ * @param gains The new gains. Points must stay in increasing order of speed.
+ * @return int U_SUCCESS, or U_ERROR if the gains are invalid or another update is in progress
+ */
+int tc_set_gains(uint8_t index, const tc_gains_t *gains) {
+  if (index >= TC_GAIN_POINTS || !(gains->kp >= 0.0f && gains->kp < INFINITY) || !(gains->ki >= 0.0f && gains->ki < INFINITY) ||
+      !(gains->slip_ratio > 0.0f && gains->slip_ratio <= TC_SLIP_RATIO_MAX)) {
+    PRINTLN_WARNING("Rejected TC gains for point %d (kp=%.3f, ki=%.3f, slip_ratio=%.3f).", index, gains->kp, gains->ki, gains->slip_ratio);
+    return U_ERROR;
+  }
+  if (atomic_exchange(&_tc_state.tuning, true)) {
+    PRINTLN_WARNING("TC gains are already being updated.");
+    return U_ERROR;
+  }
+
+  /* Only this function writes the table, so it can be read here without the sequence count. */
+  const tc_gains_t *table = _tc_state.gains;
+  if ((index > 0 && !(gains->speed > table[index - 1].speed)) ||
+      (index < TC_GAIN_POINTS - 1 && !(gains->speed < table[index + 1].speed))) {
+    PRINTLN_WARNING("Rejected TC gains for point %d, speed %.1f mph is out of order.", index, gains->speed);
+    _tc_state.tuning = false;
+    return U_ERROR;
+  }
+
+  uint32_t seq = atomic_load_explicit(&_tc_state.gains_seq, memory_order_relaxed);
+  atomic_store_explicit(&_tc_state.gains_seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  _tc_state.gains[index] = *gains;
+  atomic_store_explicit(&_tc_state.gains_seq, seq + 2, memory_order_release);
+
+  _tc_state.tuning = false;
+  PRINTLN_INFO("Set TC gains for point %d (%.1f mph: kp=%.3f, ki=%.3f, slip_ratio=%.3f).", index, gains->speed, gains->kp, gains->ki, gains->slip_ratio);
+  return U_SUCCESS;
+}
+
+/**
+ * @brief Gets one point of the gain schedule.
+ *
+ * @param index The point to get, in [0, TC_GAIN_POINTS)
+ * @param gains Filled in with the point's gains
+ * @return int U_SUCCESS, or U_ERROR if the index is out of range
+ */
+int tc_get_gains(uint8_t index, tc_gains_t *gains) {
+  if (index >= TC_GAIN_POINTS) {
+    return U_ERROR;
+  }
+
+  uint32_t seq;
+  do {
+    seq = atomic_load_explicit(&_tc_state.gains_seq, memory_order_acquire);
+    *gains = _tc_state.gains[index];
+    atomic_thread_fence(memory_order_acquire);
+  } while ((seq & 1) || seq != atomic_load_explicit(&_tc_state.gains_seq, memory_order_relaxed));
+  return U_SUCCESS;
+}
+
+/**
+ * @brief Parses a gain schedule CAN message and sets the point it carries.
+ * Expected format: byte 0 = index, byte 1 = speed (mph), bytes 2-3 = kp, bytes 4-5 = ki and
+ * bytes 6-7 = slip_ratio, each a big-endian uint16 in thousandths.
+ *
+ * @param msg The CAN message to parse
+ */
+void tc_record_gains(can_msg_t msg) {
+  tc_gains_t gains = {
+    .speed      = msg.data[1],
+    .kp         = (uint16_t)((msg.data[2] << 8) | msg.data[3]) / 1000.0f,
+    .ki         = (uint16_t)((msg.data[4] << 8) | msg.data[5]) / 1000.0f,
+    .slip_ratio = (uint16_t)((msg.data[6] << 8) | msg.data[7]) / 1000.0f,
+  };
+  tc_set_gains(msg.data[0], &gains);
+}
+
 /**
  * @brief Enables traction control.
  * 
@@ -343,6 +1164,28 @@ void tc_record_front_rpm(can_msg_t msg) {
   int16_t fr_rpm = (int16_t)((msg.data[2] << 8) | msg.data[3]);
   _tc_state.omega_fl = _rpm_to_rads(fl_rpm);
   _tc_state.omega_fr = _rpm_to_rads(fr_rpm);
+  _tc_state.wheel_tick = HAL_GetTick();
+  atomic_store(&_tc_state.wheel_fresh, true);
+}
+
+/**
+ * @brief Gets a consistent copy of the velocity estimator. Safe to call from any thread.
+ *
+ * @param estimate Filled in with the latest estimate
+ * @return bool false until the estimator has been calibrated
+ */
+bool tc_get_velocity_estimate(tc_velocity_estimate_t *estimate) {
+  if (!_tc_state.vel_estimator.init) {
+    return false;
+  }
+
+  uint32_t seq;
+  do {
+    seq = atomic_load_explicit(&_tc_state.estimate_seq, memory_order_acquire);
+    *estimate = _tc_state.estimate;
+    atomic_thread_fence(memory_order_acquire);
+  } while ((seq & 1) || seq != atomic_load_explicit(&_tc_state.estimate_seq, memory_order_relaxed));
+  return true;
 }
 
 /**
@@ -352,57 +1195,91 @@ void tc_record_front_rpm(can_msg_t msg) {
  * @return float Torque scale factor in [0.0, 1.0]
  */
 float tc_get_torque_scale(void) {
-  return _tc_state.torque_scale;
+  return atomic_load_explicit(&_tc_state.torque_scale, memory_order_acquire);
+}
+
+/**
+ * @brief Gets the torque the rear tires can take at their peak force, from their load.
+ *
+ * @return float Torque at the motor (Nm)
+ */
+float tc_get_torque_ceiling(void) {
+  return atomic_load_explicit(&_tc_state.torque_ceiling, memory_order_relaxed);
 }
 
 /**
  * @brief Runs one iteration of the traction control algorithm.
- * Computes the current slip ratio and adjusts _torque_scale accordingly.
- * Should be called periodically from the TC thread.
+ * Computes the current slip ratio and publishes the new torque scale.
+ * Called from the TC thread for every IMU sample.
+ *
+ * @param sample The IMU sample that triggered this cycle, or NULL if none arrived in time
  */
-void tc_process(void) {
-  if (!_tc_state.tc_enabled) {
-    _tc_state.torque_scale = 1.0f;
-    return;
+void tc_process(const imu_sample_t *sample) {
+  /* Swap in a newly selected curve between cycles. The integral was wound against the old curve. */
+  uint8_t state = _tc_state.curve_state;
+  if (state & TC_CURVE_PENDING) {
+    uint8_t swapped = ((state & TC_CURVE_ACTIVE) ^ 1) | TC_CURVE_LOADED;
+    if (atomic_compare_exchange_strong(&_tc_state.curve_state, &state, swapped)) {
+      state = swapped;
+      _tc_state.pi.track = true;
+    }
   }
 
-  if (!_tc_state.tire_curve_loaded) {
-    _tc_state.torque_scale = 1.0f;
-    return;
-  }
+  _update_dt(sample);
 
   /* Calibration phase: accumulate TC_CALIB_SAMPLES stationary IMU readings
    * to establish the accelerometer x-axis bias before driving begins. */
-  if (!_tc_state.vel_estimator.init) {
-    static float    _ax_sum       = 0.0f;
-    static uint16_t _sample_count = 0;
-
-    vector3_t accel;
-    if (imu_getAcceleration(&accel) == U_SUCCESS) {
-      _ax_sum += accel.x;
-      _sample_count++;
+  vel_estimator_t *est = &_tc_state.vel_estimator;
+  if (!est->init) {
+    if (sample != NULL) {
+      est->calib_ax_sum += _get_ax(sample);
+      est->calib_samples++;
     }
 
-    if (_sample_count >= TC_CALIB_SAMPLES) {
-      _init_vel_estimator(&_tc_state.vel_estimator, _ax_sum / _sample_count);
+    if (est->calib_samples >= TC_CALIB_SAMPLES) {
+      _init_vel_estimator(est, est->calib_ax_sum / est->calib_samples);
     }
 
-    _tc_state.torque_scale = 1.0f;
+    _publish_torque_scale(1.0f);
     return;
   }
 
-  _update_dt();
+  /* The estimator runs whether or not TC is on, so it is converged when TC is switched on.
+   * A missed sample is only logged when the stream is lost, and again when it comes back. */
+  if ((sample == NULL) != _tc_state.imu_lost) {
+    _tc_state.imu_lost = (sample == NULL);
+    if (_tc_state.imu_lost) {
+      PRINTLN_ERROR("Lost the IMU samples for TC processing.");
+    } else {
+      PRINTLN_INFO("IMU samples for TC processing are back.");
+    }
+  }
+  float vx_car = _estimate_velocity(est, sample, _tc_state.dt);
+  float slip = _calc_slip((float)dti_get_rpm(), vx_car);
+  float ceiling = _get_torque_ceiling(sample);
+
+  const tc_curve_set_t *set = &_curve_sets[state & TC_CURVE_ACTIVE];
+  if (!_tc_state.tc_enabled || !(state & TC_CURVE_LOADED)) {
+    _tc_state.was_enabled = false;
+    _publish_torque_scale(1.0f);
+    _stream_sample(sample, slip, 1.0f);
+    return;
+  }
 
-  vector3_t accel;
-  if (imu_getAcceleration(&accel) != U_SUCCESS) {
-    PRINTLN_ERROR("Failed to read accelerometer data during TC processing.");
-    accel.x = 0.0f;
-    // If we can't get IMU data, rely entirely on wheel speed for velocity estimation (disable complementary filter)
-    _tc_state.vel_estimator.alpha = 0.0f; 
+  /* Pick up from the current torque scale when TC is switched on, or its gains were retuned. */
+  uint32_t gains_seq = _tc_state.gains_seq;
+  if (!_tc_state.was_enabled || gains_seq != _tc_state.gains_seen) {
+    _tc_state.pi.track = true;
+    _tc_state.was_enabled = true;
+    _tc_state.gains_seen = gains_seq;
   }
-  float f_rpms = (_tc_state.omega_fl + _tc_state.omega_fr) / 2.0f;
-  float vx_car = _estimate_velocity(&_tc_state.vel_estimator, f_rpms, accel.x, _tc_state.dt);
 
-  float slip = _calc_slip((float)dti_get_rpm(), vx_car);
-  _tc_state.torque_scale = _update_pi(&_tc_state.pi, _tc_state.tire_curve, slip, _tc_state.dt);
+  tc_gains_t gains;
+  _schedule_gains(vx_car, &gains);
+  float slip_ref = set->peak_slip * gains.slip_ratio;
+  float fx_ff = _lookup_fx(&set->grid, slip_ref);
+
+  float torque_scale = _update_pi(&_tc_state.pi, &gains, slip_ref, fx_ff, slip, _tc_state.dt, ceiling);
+  _publish_torque_scale(torque_scale);
+  _stream_sample(sample, slip, torque_scale);
 }
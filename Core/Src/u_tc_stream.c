@@ -0,0 +1,107 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "u_tc_stream.h"
+
+/* This file includes the traction control debug stream (see u_tc_stream.h). */
+
+/* 256 ms of samples at 1 kHz. Must be a power of 2, so the free-running indices wrap cleanly. */
+#define TC_STREAM_RING_SIZE 256
+
+typedef struct {
+    uint32_t seq;
+    tc_stream_sample_t sample;
+} tc_stream_entry_t;
+
+/* Single producer (the TC thread) and single consumer (the stream thread), so the ring needs no lock.
+*  Each side only writes its own index, and publishes it after the entries it covers. */
+static tc_stream_entry_t _ring[TC_STREAM_RING_SIZE];
+static _Atomic uint32_t _head = 0;     // Next entry to write. Written by the TC thread.
+static _Atomic uint32_t _tail = 0;     // Next entry to read. Written by the stream thread.
+static _Atomic bool _enabled = false;
+static uint32_t _next_seq = 0;         // Sequence number of the next sample, whether or not it fits
+static _Atomic uint32_t _dropped = 0;
+static uint32_t _datagram_seq = 0;
+
+_Static_assert((TC_STREAM_RING_SIZE & (TC_STREAM_RING_SIZE - 1)) == 0, "TC_STREAM_RING_SIZE must be a power of 2.");
+_Static_assert(sizeof(tc_stream_sample_t) == 32, "tc_stream_sample_t is part of the datagram format.");
+_Static_assert(sizeof(tc_stream_header_t) == 16, "tc_stream_header_t is part of the datagram format.");
+
+/* Starts or stops recording. Off at boot. */
+void tc_stream_enable(bool enabled) {
+    atomic_store(&_enabled, enabled);
+}
+
+/* Gets whether the stream is recording. */
+bool tc_stream_isEnabled(void) {
+    return atomic_load(&_enabled);
+}
+
+/* Records a sample, if enabled. Only called from the TC thread. */
+void tc_stream_record(const tc_stream_sample_t *sample) {
+    if (!atomic_load_explicit(&_enabled, memory_order_relaxed)) {
+        return;
+    }
+
+    uint32_t seq = _next_seq++;
+    uint32_t head = atomic_load_explicit(&_head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&_tail, memory_order_acquire) >= TC_STREAM_RING_SIZE) {
+        /* Full. The sequence number is still used up, so the receiver sees the gap. */
+        atomic_fetch_add_explicit(&_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    tc_stream_entry_t *entry = &_ring[head % TC_STREAM_RING_SIZE];
+    entry->seq = seq;
+    entry->sample = *sample;
+    atomic_store_explicit(&_head, head + 1, memory_order_release);
+}
+
+/* Packs the oldest samples into a datagram. Returns its length, or 0 if there is nothing to send. */
+uint16_t tc_stream_pack(uint8_t *buffer, uint16_t size) {
+    uint32_t tail = atomic_load_explicit(&_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&_head, memory_order_acquire);
+    if (tail == head || size < sizeof(tc_stream_header_t) + sizeof(tc_stream_sample_t)) {
+        return 0;
+    }
+
+    uint32_t max = (size - sizeof(tc_stream_header_t)) / sizeof(tc_stream_sample_t);
+    if (max > TC_STREAM_BATCH_MAX) {
+        max = TC_STREAM_BATCH_MAX;
+    }
+
+    /* Every entry before this one either was sent or was never recorded, so the number dropped
+    *  before it is exactly how far its sequence number is ahead of its position in the ring. */
+    tc_stream_header_t header = {
+        .magic = TC_STREAM_MAGIC,
+        .version = TC_STREAM_VERSION,
+        .datagram_seq = _datagram_seq++,
+        .first_seq = _ring[tail % TC_STREAM_RING_SIZE].seq,
+    };
+    header.dropped = header.first_seq - tail;
+
+    /* A datagram only holds consecutive samples. A drop ends it, and the next one starts after the gap. */
+    uint8_t *out = buffer + sizeof(header);
+    while (tail != head && header.count < max) {
+        const tc_stream_entry_t *entry = &_ring[tail % TC_STREAM_RING_SIZE];
+        if (entry->seq != header.first_seq + header.count) {
+            break;
+        }
+        memcpy(out, &entry->sample, sizeof(entry->sample));
+        out += sizeof(entry->sample);
+        header.count++;
+        tail++;
+    }
+    atomic_store_explicit(&_tail, tail, memory_order_release);
+
+    memcpy(buffer, &header, sizeof(header));
+    return (uint16_t)(out - buffer);
+}
+
+/* Gets the stream's counters. */
+tc_stream_stats_t tc_stream_getStats(void) {
+    return (tc_stream_stats_t){
+        .recorded = atomic_load(&_head),
+        .dropped = atomic_load(&_dropped),
+        .datagrams = _datagram_seq,
+    };
+}
@@ -16,6 +16,8 @@
 #include "u_statemachine.h"
 #include "u_bms.h"
 #include "u_peripherals.h"
+#include "u_tc.h"
+#include "u_tc_stream.h"
 #include "u_ethernet.h"
 #include "bitstream.h"
 #include "serial.h"
@@ -34,16 +36,18 @@
 #define PRIO_vEthernetManager  1
 #define PRIO_vCANIncoming      1
 #define PRIO_vCANOutgoing      1
+#define PRIO_vTractionControl  1
 #define PRIO_vStatemachine     2
 #define PRIO_vFaults           2
 #define PRIO_vPedals           2
 #define PRIO_vTSMS             2
 #define PRIO_vShutdown         2
 #define PRIO_vEFuses           3
-#define PRIO_vMux              3
 #define PRIO_vRTDS             3
 #define PRIO_vTest             3
 #define PRIO_vPeripherals      3
+#define PRIO_vTCStream         3
+#define PRIO_vTireCurveServer  3
 
 
 
@@ -117,6 +121,18 @@ static thread_t ethernet_manager = {
         .function   = vEthernet1Manager            /* Thread Function */
 };
 
+/* Tire Curve Server Thread. Accepts tire curve uploads over TCP. */
+static thread_t tire_curve_server = {
+        .name       = "Tire Curve Server Thread", /* Name */
+        .size       = 2048,                       /* Stack Size (in bytes) */
+        .priority   = PRIO_vTireCurveServer,      /* Priority */
+        .threshold  = 0,                          /* Preemption Threshold */
+        .time_slice = TX_NO_TIME_SLICE,           /* Time Slice */
+        .auto_start = TX_AUTO_START,              /* Auto Start */
+        .sleep      = 0,                          /* Sleep (in ticks) */
+        .function   = vTireCurveServer            /* Thread Function */
+};
+
 /* Incoming CAN Thread. Processes incoming messages. */
 static thread_t can_incoming_thread = {
         .name       = "Incoming CAN Thread",     /* Name */
@@ -287,6 +303,67 @@ void vShutdown(ULONG thread_input) {
     }
 }
 
+/* Traction Control Thread. Runs TC once per IMU sample. */
+static thread_t tc_thread = {
+        .name       = "Traction Control Thread", /* Name */
+        .size       = 2048,                      /* Stack Size (in bytes) */
+        .priority   = PRIO_vTractionControl,     /* Priority */
+        .threshold  = 0,                         /* Preemption Threshold */
+        .time_slice = TX_NO_TIME_SLICE,          /* Time Slice */
+        .auto_start = TX_AUTO_START,             /* Auto Start */
+        .sleep      = 10,                        /* IMU sample timeout (in ticks) */
+        .function   = vTractionControl           /* Thread Function */
+    };
+void vTractionControl(ULONG thread_input) {
+
+    imu_sample_t sample;
+
+    while(1) {
+
+        /* Wait for the IMU's next sample. They arrive in bursts, each time the IMU's FIFO is drained. If none come, TC still runs, on wheel speeds alone. */
+        if(imu_waitForSample(&sample, tc_thread.sleep) == U_SUCCESS) {
+            tc_process(&sample);
+        } else {
+            tc_process(NULL);
+        }
+
+        /* No sleep. Thread timing is controlled by the IMU FIFO watermark interrupt. */
+    }
+}
+
+/* TC Stream Thread. Ships the TC debug stream's samples over UDP, in batches. */
+static thread_t tc_stream_thread = {
+        .name       = "TC Stream Thread",     /* Name */
+        .size       = 2048,                   /* Stack Size (in bytes) */
+        .priority   = PRIO_vTCStream,         /* Priority */
+        .threshold  = 0,                      /* Preemption Threshold */
+        .time_slice = TX_NO_TIME_SLICE,       /* Time Slice */
+        .auto_start = TX_AUTO_START,          /* Auto Start */
+        .sleep      = 10,                     /* Sleep (in ticks) */
+        .function   = vTCStream               /* Thread Function */
+    };
+void vTCStream(ULONG thread_input) {
+
+    static uint8_t datagram[sizeof(tc_stream_header_t) + TC_STREAM_BATCH_MAX * sizeof(tc_stream_sample_t)];
+    bool failing = false;
+
+    while(1) {
+
+        /* Drain everything recorded since the last pass. The stream is opt-in, so this is usually empty. */
+        uint16_t size;
+        while((size = tc_stream_pack(datagram, sizeof(datagram))) > 0) {
+            UINT status = ethernet1_tc_stream_send(datagram, size);
+            if(status != NX_SUCCESS && !failing) {
+                PRINTLN_WARNING("Failed to send TC stream datagram, dropping them until it succeeds (Status: %d/%s).", status, nx_status_toString(status));
+            }
+            failing = (status != NX_SUCCESS);
+        }
+
+        /* Sleep Thread for specified number of ticks. */
+        tx_thread_sleep(tc_stream_thread.sleep);
+    }
+}
+
 /* Pedals Thread. */
 static thread_t pedals_thread = {
         .name       = "Pedals Thread",        /* Name */
@@ -356,158 +433,19 @@ void vEFuses(ULONG thread_input) {
             trigger_fault(MOTOR_TEMP_SENSOR_FAULT);
         }
 
-        /* Determine radfan eFuse state. */
-        static const uint16_t RADFAN_UPPERBOUND = 45;
-        static const uint16_t RADFAN_LOWERBOUND = 40;
-        switch(data.control_state[EFUSE_RADFAN]) {
-            case EF_ON: efuse_enable(EFUSE_RADFAN); break;
-            case EF_OFF: efuse_disable(EFUSE_RADFAN); break;
-            case EF_AUTO:
-                if(!get_fault(MOTOR_TEMP_SENSOR_FAULT) && motor_temp >= RADFAN_UPPERBOUND) {
-                    efuse_enable(EFUSE_RADFAN);
-                } else if (motor_temp <= RADFAN_LOWERBOUND) {
-                    efuse_disable(EFUSE_RADFAN);
-                }
-                break;
-            default: efuse_enable(EFUSE_RADFAN); break;
-        }
-
-        /* Determine fanbatt eFuse state. */
-        static const float FANBATT_UPPERBOUND = 45;
-        static const float FANBATT_LOWERBOUND = 40;
-        switch(data.control_state[EFUSE_FANBATT]) {
-            case EF_ON: efuse_enable(EFUSE_FANBATT); break;
-            case EF_OFF: efuse_disable(EFUSE_FANBATT); break;
-            case EF_AUTO:
-                if(battbox_temp >= FANBATT_UPPERBOUND) {
-                    efuse_enable(EFUSE_FANBATT);
-                } else if (battbox_temp <= FANBATT_LOWERBOUND) {
-                    efuse_disable(EFUSE_FANBATT);
-                }
-                break;
-            default: efuse_enable(EFUSE_FANBATT); break;
-        }
-
-        /* Determine pump1 eFuse state. */
-        static const uint16_t PUMP1_UPPERBOUND = 45;
-        static const uint16_t PUMP1_LOWERBOUND = 40;
-        static const int PUMP1_SWITCHING_TIMEOUT = 5000;
-        static nertimer_t pump1_switching_timer = { 0 };
-        switch(data.control_state[EFUSE_PUMP1]) {
-            case EF_ON: efuse_enable(EFUSE_PUMP1); break;
-            case EF_OFF: efuse_disable(EFUSE_PUMP1); break;
-            case EF_AUTO:
-                if(controller_temp >= PUMP1_UPPERBOUND) {
-                    /* If timer is still active, break early. */
-                    if(!is_timer_expired(&pump1_switching_timer) && is_timer_active(&pump1_switching_timer)) { break; }
-
-                    /* Otherwise, make the state change but restart the timer. */
-                    efuse_enable(EFUSE_PUMP1);
-                    start_timer(&pump1_switching_timer, PUMP1_SWITCHING_TIMEOUT);
-                } else if (controller_temp <= PUMP1_LOWERBOUND) {
-                    /* If timer is still active, break early. */
-                    if(!is_timer_expired(&pump1_switching_timer) && is_timer_active(&pump1_switching_timer)) { break; }
-
-                    /* Otherwise, make the state change but restart the timer. */
-                    efuse_disable(EFUSE_PUMP1);
-                    start_timer(&pump1_switching_timer, PUMP1_SWITCHING_TIMEOUT);
-                }
-                break;
-            default: efuse_enable(EFUSE_PUMP1); break;
-        }
-
-        /* Determine pump2 eFuse state. */
-        static const uint16_t PUMP2_UPPERBOUND = 45;
-        static const uint16_t PUMP2_LOWERBOUND = 40;
-        static const int PUMP2_SWITCHING_TIMEOUT = 5000;
-        static nertimer_t pump2_switching_timer = { 0 };
-        switch(data.control_state[EFUSE_PUMP2]) {
-            case EF_ON: efuse_enable(EFUSE_PUMP2); break;
-            case EF_OFF: efuse_disable(EFUSE_PUMP2); break;
-            case EF_AUTO:
-                if(!get_fault(MOTOR_TEMP_SENSOR_FAULT) && motor_temp >= PUMP2_UPPERBOUND) {
-                    /* If timer is still active, break early. */
-                    if(!is_timer_expired(&pump2_switching_timer) && is_timer_active(&pump2_switching_timer)) { break; }
-
-                    /* Otherwise, make the state change but restart the timer. */
-                    efuse_enable(EFUSE_PUMP2);
-                    start_timer(&pump2_switching_timer, PUMP2_SWITCHING_TIMEOUT);
-                } else if (motor_temp <= PUMP2_LOWERBOUND) {
-                    /* If timer is still active, break early. */
-                    if(!is_timer_expired(&pump2_switching_timer) && is_timer_active(&pump2_switching_timer)) { break; }
-
-                    /* Otherwise, make the state change but restart the timer. */
-                    efuse_disable(EFUSE_PUMP2);
-                    start_timer(&pump2_switching_timer, PUMP2_SWITCHING_TIMEOUT);
-                }
-                break;
-            default: efuse_enable(EFUSE_PUMP2); break;
-        }
-
-        /* Determine dashboard eFuse state. */
-        switch(data.control_state[EFUSE_DASHBOARD]) {
-            case EF_ON: efuse_enable(EFUSE_DASHBOARD); break;
-            case EF_OFF: efuse_disable(EFUSE_DASHBOARD); break;
-            default: efuse_enable(EFUSE_DASHBOARD); break;
-        }
-
-        /* Determine brake eFuse state. */
-        switch(data.control_state[EFUSE_BRAKE]) {
-            case EF_ON: efuse_enable(EFUSE_BRAKE); break;
-            case EF_OFF: efuse_disable(EFUSE_BRAKE); break;
-            case EF_AUTO:
-                if(brake_state == true) {
-                    efuse_enable(EFUSE_BRAKE);
-                } else {
-                    efuse_disable(EFUSE_BRAKE);
-                }
-                break;
-            default: efuse_enable(EFUSE_BRAKE); break;
-        }
-
-        /* Determine Shutdown eFuse state. */
-        switch(data.control_state[EFUSE_SHUTDOWN]) {
-            case EF_ON: efuse_enable(EFUSE_SHUTDOWN); break;
-            case EF_OFF: efuse_disable(EFUSE_SHUTDOWN); break;
-            default: efuse_enable(EFUSE_SHUTDOWN); break;
-        }
-
-        /* Determine LV eFuse state. */
-        switch(data.control_state[EFUSE_LV]) {
-            case EF_ON: efuse_enable(EFUSE_LV); break;
-            case EF_OFF: efuse_disable(EFUSE_LV); break;
-            default: efuse_enable(EFUSE_LV); break;
-        }
-
-        /* Determine Battbox eFuse state. */
-        switch(data.control_state[EFUSE_BATTBOX]) {
-            case EF_ON: efuse_enable(EFUSE_BATTBOX); break;
-            case EF_OFF: efuse_disable(EFUSE_BATTBOX); break;
-            default: efuse_enable(EFUSE_BATTBOX); break;
-        }
-
-        /* Determine MC eFuse state. */
-        switch(data.control_state[EFUSE_MC]) {
-            case EF_ON: efuse_enable(EFUSE_MC); break;
-            case EF_OFF: efuse_disable(EFUSE_MC); break;
-            default: efuse_enable(EFUSE_MC); break;
-        }
-
-        /* Determine Spare (other radfan) eFuse state. */
-        static const uint16_t SPARE_UPPERBOUND = 45;
-        static const uint16_t SPARE_LOWERBOUND = 40;
-        switch(data.control_state[EFUSE_SPARE]) {
-            case EF_ON: efuse_enable(EFUSE_SPARE); break;
-            case EF_OFF: efuse_disable(EFUSE_SPARE); break;
-            case EF_AUTO:
-                if(controller_temp >= SPARE_UPPERBOUND) {
-                    efuse_enable(EFUSE_SPARE);
-                } else if (controller_temp <= SPARE_LOWERBOUND) {
-                    efuse_disable(EFUSE_SPARE);
-                }
-                break;
-            default: efuse_enable(EFUSE_SPARE); break;
-        }
+        /* Drive the eFuses. The AUTO ones follow their policies (see u_efuses.c). */
+        efuse_inputs_t inputs = {
+            .value = {
+                [EFUSE_SOURCE_MOTOR_TEMP] = motor_temp,
+                [EFUSE_SOURCE_CONTROLLER_TEMP] = controller_temp,
+                [EFUSE_SOURCE_BATTBOX_TEMP] = battbox_temp,
+                [EFUSE_SOURCE_BRAKE] = brake_state
+            },
+            .faulted = {
+                [EFUSE_SOURCE_MOTOR_TEMP] = get_fault(MOTOR_TEMP_SENSOR_FAULT)
+            }
+        };
+        efuse_control(&data, &inputs);
 
         /* Send dashboard eFuse message. */
         send_dashboard_efuse(
@@ -670,30 +608,6 @@ void vEFuses(ULONG thread_input) {
     }
 }
 
-
-/* Mux Thread (for the ADC multiplexer). */
-static thread_t mux_thread = {
-        .name       = "Mux Thread",           /* Name */
-        .size       = 2048,                   /* Stack Size (in bytes) */
-        .priority   = PRIO_vMux,              /* Priority */
-        .threshold  = 0,                      /* Preemption Threshold */
-        .time_slice = TX_NO_TIME_SLICE,       /* Time Slice */
-        .auto_start = TX_AUTO_START,          /* Auto Start */
-        .sleep      = 500,                    /* Sleep (in ticks) */
-        .function   = vMux                    /* Thread Function */
-    };
-void vMux(ULONG thread_input) {
-
-    while(1) {
-
-        /* Switches the multiplexer state and updates the buffer. */
-        adc_switchMuxState();
-
-        /* Sleep Thread for specified number of ticks. */
-        tx_thread_sleep(mux_thread.sleep);
-    }
-}
-
 /* Peripherals Thread. */
 static thread_t peripherals_thread = {
         .name       = "Peripherals Thread",   /* Name */
@@ -731,7 +645,7 @@ void vPeripherals(ULONG thread_input) {
 
         /* SECTION 1: Read the temperature sensor data and send it over CAN. */
         do {
-            /* Get the temp sensor data. */
+            /* Get the temp sensor data. This is the cached periodic reading, so it never waits on I2C2. */
             float temperature = 0;
             float humidity = 0;
             int status = tempsensor_getTemperatureAndHumidity(&temperature, &humidity);
@@ -812,7 +726,25 @@ void vPeripherals(ULONG thread_input) {
             queue_send(&eth_manager, &message, TX_NO_WAIT);
         } while (0);
 
-        /* SECTION 4: Send LV ADC Message. */
+        /* SECTION 4: Read the IMU's sensor fusion output and send it over ethernet. */
+        do {
+            /* Get the IMU orientation and gravity compensated acceleration. */
+            quaternion_t orientation;
+            vector3_t linear;
+            if(imu_getOrientation(&orientation) != U_SUCCESS || imu_getLinearAcceleration(&linear) != U_SUCCESS) {
+                break; // Break from SECTION 4. The IMU faults are already raised by SECTIONS 2 and 3 if the IMU is down.
+            }
+
+            /* Send orientation over ethernet! */
+            ethernet_mqtt_message_t message = nx_protobuf_mqtt_message_create("VCU_Ethernet/A/Orientation", "quaternion", orientation.w, orientation.x, orientation.y, orientation.z);
+            queue_send(&eth_manager, &message, TX_NO_WAIT);
+
+            /* Send linear acceleration over ethernet! */
+            message = nx_protobuf_mqtt_message_create("VCU_Ethernet/A/Linear_Acceleration", "mg", linear.x, linear.y, linear.z);
+            queue_send(&eth_manager, &message, TX_NO_WAIT);
+        } while (0);
+
+        /* SECTION 5: Send LV ADC Message. */
         do {
             lvread_adc_t lv_data = adc_getLVData_2();
 
@@ -829,7 +761,7 @@ void vPeripherals(ULONG thread_input) {
 
         } while (0);
 
-        /* SECTION 5: Send LFIU ADC Message. */
+        /* SECTION 6: Send LFIU ADC Message. */
         do {
             lfiu_adc_t lfiu_data = adc_getLfiuData();
 
@@ -909,10 +841,12 @@ uint8_t threads_init(TX_BYTE_POOL *byte_pool) {
     CATCH_ERROR(create_thread(byte_pool, &shutdown_thread), U_SUCCESS);          // Create Shutdown thread.
     CATCH_ERROR(create_thread(byte_pool, &statemachine_thread), U_SUCCESS);      // Create State Machine thread.
     CATCH_ERROR(create_thread(byte_pool, &pedals_thread), U_SUCCESS);            // Create Pedals thread.
+    CATCH_ERROR(create_thread(byte_pool, &tc_thread), U_SUCCESS);                // Create Traction Control thread.
+    CATCH_ERROR(create_thread(byte_pool, &tc_stream_thread), U_SUCCESS);         // Create TC Stream thread.
     CATCH_ERROR(create_thread(byte_pool, &efuses_thread), U_SUCCESS);              // Create eFuses thread.
-    CATCH_ERROR(create_thread(byte_pool, &mux_thread), U_SUCCESS);               // Create Mux thread.
     CATCH_ERROR(create_thread(byte_pool, &peripherals_thread), U_SUCCESS);       // Create Peripherals thread.
     CATCH_ERROR(create_thread(byte_pool, &ethernet_manager), U_SUCCESS); // Create Outgoing Ethernet thread.
+    CATCH_ERROR(create_thread(byte_pool, &tire_curve_server), U_SUCCESS); // Create Tire Curve Server thread.
     //CATCH_ERROR(create_thread(byte_pool, &test_thread), U_SUCCESS);                // Create Test thread.
     CATCH_ERROR(create_thread(byte_pool, &rtds_thread), U_SUCCESS);              // Create RTDS thread.
 
@@ -0,0 +1,58 @@
+#include "main.h"
+#include "u_time.h"
+#include "u_tx_debug.h"
+
+/* This file includes the VCU's monotonic time base (see u_time.h). */
+
+/* The 32-bit DWT cycle counter wraps every ~17 s at 250 MHz. It is extended with a count of wraps,
+*  which is only correct if the counter is read at least once per wrap, hence time_tickCallback(). */
+static uint32_t _wraps = 0;     // Number of times CYCCNT has wrapped
+static uint32_t _last = 0;      // CYCCNT when it was last read
+static uint32_t _cycles_per_us = 1;
+
+/* Starts the cycle counter. Call once, right after the system clock is configured. */
+void time_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    _cycles_per_us = SystemCoreClock / 1000000U;
+    if (_cycles_per_us == 0) {
+        _cycles_per_us = 1;
+    }
+    PRINTLN_INFO("Ran time_init() (%lu cycles/us).", _cycles_per_us);
+}
+
+/* Called from the 1 ms HAL tick, so the counter is extended at least once per wrap. */
+void time_tickCallback(void) {
+    (void)time_getCycles();
+}
+
+/* Gets the number of core clock cycles since time_init(). */
+uint64_t time_getCycles(void) {
+    /* The read and the wrap check have to happen together, or an ISR that reads the counter in
+    *  between could count the same wrap twice. This is a handful of instructions. */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t now = DWT->CYCCNT;
+    if (now < _last) {
+        _wraps++;
+    }
+    _last = now;
+    uint64_t cycles = ((uint64_t)_wraps << 32) | now;
+    __set_PRIMASK(primask);
+    return cycles;
+}
+
+/* Gets the number of microseconds since time_init(). */
+uint64_t time_getMicros(void) {
+    return time_getCycles() / _cycles_per_us;
+}
+
+/* Gets the seconds since *since (us), and sets *since to now. 0 the first time (*since == 0). */
+float time_getElapsedSeconds(uint64_t *since) {
+    uint64_t now = time_getMicros();
+    float elapsed = (*since == 0 || now < *since) ? 0.0f : (now - *since) / 1000000.0f;
+    *since = now;
+    return elapsed;
+}
@@ -1,6 +1,8 @@
 #include "unity.h"
 #include "mock_u_dti.h"
 #include "mock_u_peripherals.h"
+#include "mock_u_flash.h"
+#include "mock_u_suspension.h"
 #include "u_tc.h"
 #include "u_tx_debug.h"
 #include <stdint.h>
@@ -56,8 +58,15 @@ const uint8_t _tire_curve_start[1627] = {
 /* Value unused; only its ADDRESS matters as described above. */
 const uint8_t _tire_curve_size = 0;
 
+/* Reserved sector for uploaded curves (see u_flash.h), erased so
+ * tc_init() falls back to _tire_curve_start. */
+const uint8_t _tire_curve_store[16] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
 /* =========================================================
- * Mock: HAL_GetTick
+ * Mock: HAL_GetTick, time_getMicros
  * ========================================================= */
 static uint32_t _mock_tick_ms = 100;
 
@@ -65,19 +74,23 @@ uint32_t HAL_GetTick(void) {
     return _mock_tick_ms;
 }
 
+uint64_t time_getMicros(void) {
+    return _mock_tick_ms * 1000ULL;
+}
+
 /* =========================================================
- * CMock stub state — read by callbacks registered in setUp
+ * Mock state — read by callbacks registered in setUp, and by
+ * run_tc() to build the IMU sample
  * ========================================================= */
 static float   _mock_ax        = 0.0f;
 static int     _mock_imu_ret   = 0; /* 0 = U_SUCCESS */
 static int32_t _mock_motor_rpm = 0;
 
-static int _imu_stub(vector3_t *data, int num_calls) {
-    (void)num_calls;
-    data->x = _mock_ax;
-    data->y = 0.0f;
-    data->z = 0.0f;
-    return _mock_imu_ret;
+/* Runs one TC cycle the way the TC thread does: with the IMU
+ * sample, or with NULL when the IMU doesn't deliver one. */
+static void run_tc(void) {
+    imu_sample_t sample = { .accel = { .x = _mock_ax }, .time_us = _mock_tick_ms * 1000ULL };
+    tc_process(_mock_imu_ret == 0 ? &sample : NULL);
 }
 
 static int32_t _dti_rpm_stub(int num_calls) {
@@ -110,8 +123,10 @@ void setUp(void) {
 
     mock_u_dti_Init();
     mock_u_peripherals_Init();
+    mock_u_flash_Init();
+    mock_u_suspension_Init();
     dti_get_rpm_Stub(_dti_rpm_stub);
-    imu_getAcceleration_Stub(_imu_stub);
+    suspension_getAxleLoad_IgnoreAndReturn(1600.0f); /* About the static rear load (N) */
 
     assert(tc_init() == 0);
     assert(enable_tc() == 0);
@@ -122,6 +137,10 @@ void tearDown(void) {
     mock_u_dti_Destroy();
     mock_u_peripherals_Verify();
     mock_u_peripherals_Destroy();
+    mock_u_flash_Verify();
+    mock_u_flash_Destroy();
+    mock_u_suspension_Verify();
+    mock_u_suspension_Destroy();
 }
 
 /* =========================================================
@@ -146,7 +165,7 @@ void test_record_front_rpm_zero_values(void) {
     can_msg_t msg = make_rpm_msg(0, 0);
     tc_record_front_rpm(msg);
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -155,7 +174,7 @@ void test_record_front_rpm_positive_equal(void) {
     can_msg_t msg = make_rpm_msg(1000, 1000);
     tc_record_front_rpm(msg);
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -165,7 +184,7 @@ void test_record_front_rpm_asymmetric_wheels(void) {
     can_msg_t msg = make_rpm_msg(500, 1500);
     tc_record_front_rpm(msg);
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -174,7 +193,7 @@ void test_record_front_rpm_negative_values(void) {
     can_msg_t msg = make_rpm_msg(-500, -500);
     tc_record_front_rpm(msg);
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -183,7 +202,7 @@ void test_record_front_rpm_max_int16(void) {
     can_msg_t msg = make_rpm_msg(32767, 32767);
     tc_record_front_rpm(msg);
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -192,7 +211,7 @@ void test_record_front_rpm_min_int16(void) {
     can_msg_t msg = make_rpm_msg(-32768, -32768);
     tc_record_front_rpm(msg);
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -205,7 +224,7 @@ void test_record_front_rpm_big_endian_byte_order(void) {
     msg.data[2] = 0x07; msg.data[3] = 0xD0; /* FR = 2000 */
     tc_record_front_rpm(msg);
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -217,7 +236,7 @@ void test_record_front_rpm_negative_sign_extension(void) {
     msg.data[2] = 0xFF; msg.data[3] = 0x00; /* FR = -256 */
     tc_record_front_rpm(msg);
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -233,7 +252,7 @@ void test_process_scale_bounded_over_many_iterations(void) {
 
     for (int i = 0; i < 75; i++) {
         _mock_tick_ms += 50;
-        tc_process();
+        run_tc();
         float s = tc_get_torque_scale();
         TEST_ASSERT_TRUE(s >= 0.0f);
         TEST_ASSERT_TRUE(s <= 1.0f);
@@ -250,7 +269,7 @@ void test_process_zero_speed_slip_is_zero(void) {
     /* Run enough iterations for the PI integral to fully wind up. */
     for (int i = 0; i < 200; i++) {
         _mock_tick_ms += 100;
-        tc_process();
+        run_tc();
     }
     TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, tc_get_torque_scale());
 }
@@ -258,7 +277,7 @@ void test_process_zero_speed_slip_is_zero(void) {
 void test_process_scale_bounded_with_high_front_rpm(void) {
     tc_record_front_rpm(make_rpm_msg(32767, 32767));
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -273,7 +292,7 @@ void test_process_reduces_torque_on_high_motor_rpm_tc_off(void) {
     for (int i = 0; i < 100; i++) {
         _mock_tick_ms += 100;
         _mock_motor_rpm -= 50; 
-        tc_process();
+        run_tc();
         PRINTLN_INFO("Iteration %d: torque_scale=%.3f, RPM=%d", i, tc_get_torque_scale(), _mock_motor_rpm);
     }
     TEST_ASSERT_TRUE(tc_get_torque_scale() == 1.0f);
@@ -281,7 +300,7 @@ void test_process_reduces_torque_on_high_motor_rpm_tc_off(void) {
     for (int i = 100; i < 200; i++) {
         _mock_tick_ms += 100;
         _mock_motor_rpm -= 50; 
-        tc_process();
+        run_tc();
         PRINTLN_INFO("Iteration %d: torque_scale=%.3f, RPM=%d", i, tc_get_torque_scale(), _mock_motor_rpm);
     }
     TEST_ASSERT_TRUE(tc_get_torque_scale() == 1.0f);
@@ -296,7 +315,7 @@ void test_process_reduces_torque_on_high_motor_rpm(void) {
     for (int i = 0; i < 100; i++) {
         _mock_tick_ms += 100;
         _mock_motor_rpm -= 50; 
-        tc_process();
+        run_tc();
         PRINTLN_INFO("Iteration %d: torque_scale=%.3f, RPM=%d", i, tc_get_torque_scale(), _mock_motor_rpm);
     }
     TEST_ASSERT_TRUE(tc_get_torque_scale() < 1.0f);
@@ -305,7 +324,7 @@ void test_process_reduces_torque_on_high_motor_rpm(void) {
     for (int i = 100; i < 200; i++) {
         _mock_tick_ms += 100;
         _mock_motor_rpm -= 50; 
-        tc_process();
+        run_tc();
         PRINTLN_INFO("Iteration %d: torque_scale=%.3f, RPM=%d", i, tc_get_torque_scale(), _mock_motor_rpm);
     }
     TEST_ASSERT_TRUE(tc_get_torque_scale() == 1.0f);
@@ -319,20 +338,20 @@ void test_process_zero_motor_rpm_no_reduction(void) {
 
     for (int i = 0; i < 200; i++) {
         _mock_tick_ms += 100;
-        tc_process();
+        run_tc();
     }
     TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, tc_get_torque_scale());
 }
 
 void test_process_imu_failure_falls_back_gracefully(void) {
     /* When IMU read fails, tc_process should not crash and must
-     * produce a valid scale.  The implementation falls back to
-     * alpha=0 (wheel-speed-only velocity estimate). */
+     * produce a valid scale.  The velocity estimator holds its
+     * velocity and corrects it with the wheel speeds alone. */
     _mock_imu_ret   = 1; /* U_ERROR */
     _mock_motor_rpm = 5000;
     tc_record_front_rpm(make_rpm_msg(500, 500));
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -343,7 +362,7 @@ void test_process_imu_failure_multiple_iterations(void) {
     tc_record_front_rpm(make_rpm_msg(1000, 1000));
     for (int i = 0; i < 200; i++) {
         _mock_tick_ms += 100;
-        tc_process();
+        run_tc();
         TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
         TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
     }
@@ -355,7 +374,7 @@ void test_process_dt_zero_no_crash(void) {
     tc_record_front_rpm(make_rpm_msg(1000, 1000));
     _mock_motor_rpm = 5000;
     /* _mock_tick_ms unchanged from setUp (100) */
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -366,7 +385,7 @@ void test_process_large_positive_imu_ax(void) {
     _mock_ax = 100000.0f;
     tc_record_front_rpm(make_rpm_msg(500, 500));
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -376,7 +395,7 @@ void test_process_large_negative_imu_ax(void) {
     _mock_ax = -100000.0f;
     tc_record_front_rpm(make_rpm_msg(500, 500));
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -388,7 +407,7 @@ void test_process_scale_bounded_alternating_motor_rpm(void) {
         _mock_motor_rpm = 3000 + (i % 5) * 1000;
         tc_record_front_rpm(make_rpm_msg(f_rpm, f_rpm));
         _mock_tick_ms += 100;
-        tc_process();
+        run_tc();
         float s = tc_get_torque_scale();
         TEST_ASSERT_TRUE(s >= 0.0f);
         TEST_ASSERT_TRUE(s <= 1.0f);
@@ -398,7 +417,7 @@ void test_process_scale_bounded_alternating_motor_rpm(void) {
 void test_process_no_rpm_messages_recorded(void) {
     /* tc_process() with no preceding front rpm recording (omega == 0). */
     _mock_tick_ms = 200;
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -408,7 +427,7 @@ void test_process_rapid_tick_advance(void) {
     tc_record_front_rpm(make_rpm_msg(500, 500));
     _mock_motor_rpm = 5000;
     _mock_tick_ms += 5000; /* 5 s */
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
@@ -420,11 +439,28 @@ void test_process_tick_rollover(void) {
     tc_record_front_rpm(make_rpm_msg(500, 500));
     _mock_motor_rpm = 5000;
     _mock_tick_ms = 0x00000100; /* rollover */
-    tc_process();
+    run_tc();
     TEST_ASSERT_TRUE(tc_get_torque_scale() >= 0.0f);
     TEST_ASSERT_TRUE(tc_get_torque_scale() <= 1.0f);
 }
 
+void test_torque_ceiling_follows_rear_load(void) {
+    /* The ceiling is the torque at peak force, mu * Fz * r / gear ratio,
+     * so it scales with the rear load the suspension reports. Needs
+     * SUSPENSION_LOAD_CEILING, which ner_test.conf defines. */
+    for (int i = 0; i < 60; i++) {
+        _mock_tick_ms += 1;
+        run_tc();
+    }
+    float ceiling = tc_get_torque_ceiling();
+    TEST_ASSERT_TRUE(ceiling > 0.0f);
+
+    suspension_getAxleLoad_IgnoreAndReturn(2400.0f);
+    _mock_tick_ms += 1;
+    run_tc();
+    TEST_ASSERT_FLOAT_WITHIN(0.01f * ceiling, 1.5f * ceiling, tc_get_torque_ceiling());
+}
+
 /* =========================================================
  * main
  * ========================================================= */
@@ -461,6 +497,7 @@ int main(void) {
     RUN_TEST(test_process_no_rpm_messages_recorded);
     RUN_TEST(test_process_rapid_tick_advance);
     RUN_TEST(test_process_tick_rollover);
+    RUN_TEST(test_torque_ceiling_follows_rear_load);
 
     return UNITY_END();
-}
\ No newline at end of file
+}
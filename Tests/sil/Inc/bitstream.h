@@ -0,0 +1,16 @@
+#ifndef __SIL_BITSTREAM_H
+#define __SIL_BITSTREAM_H
+
+/* Host stand-in for Embedded-Base's bitstream.h. Only the overflow flag is referenced by the generated CAN code. */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    uint8_t *data;
+    uint16_t total_bits;
+    uint16_t bits_used;
+    bool overflow;
+} bitstream_t;
+
+#endif /* bitstream.h */
@@ -0,0 +1,16 @@
+#ifndef __SIL_C_UTILS_H
+#define __SIL_C_UTILS_H
+
+/* Host stand-in for Embedded-Base's c_utils.h. */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define NER_SET_BIT(num, bit)   ((num) |= (1U << (bit)))
+#define NER_CLEAR_BIT(num, bit) ((num) &= ~(1U << (bit)))
+#define NER_GET_BIT(num, bit)   (((num) >> (bit)) & 1U)
+
+/* Reverses the byte order of `size` bytes at `ptr`, in place. */
+void endian_swap(void *ptr, size_t size);
+
+#endif /* c_utils.h */
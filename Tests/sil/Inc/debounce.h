@@ -0,0 +1,12 @@
+#ifndef __SIL_DEBOUNCE_H
+#define __SIL_DEBOUNCE_H
+
+/* Host stand-in for Embedded-Base's middleware debounce.h. */
+
+#include <stdbool.h>
+#include "timer.h"
+
+/* Calls `cb(arg)` once `input` has been held true for `period` ms. Releasing the input cancels the timer. */
+void debounce(bool input, nertimer_t *timer, uint32_t period, void (*cb)(void *arg), void *arg);
+
+#endif /* debounce.h */
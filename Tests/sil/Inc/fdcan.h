@@ -0,0 +1,27 @@
+#ifndef __SIL_FDCAN_H
+#define __SIL_FDCAN_H
+
+/* Host stand-in for Embedded-Base's stm32h563 fdcan.h. Frames leave the application through the can_outgoing queue, so the bus itself is only a handle. */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include "stm32h5xx_hal.h"
+
+typedef struct {
+    uint32_t id;
+    bool id_is_extended;
+    uint8_t data[8];
+    uint8_t len;
+} can_msg_t;
+
+typedef struct {
+    FDCAN_HandleTypeDef *hcan;
+} can_t;
+
+HAL_StatusTypeDef can_init(can_t *can, FDCAN_HandleTypeDef *hcan);
+HAL_StatusTypeDef can_add_filter_standard(can_t *can, uint16_t can_ids[2]);
+HAL_StatusTypeDef can_add_filter_extended(can_t *can, uint32_t can_ids[2]);
+HAL_StatusTypeDef can_send_msg(can_t *can, can_msg_t *msg);
+
+#endif /* fdcan.h */
@@ -0,0 +1,30 @@
+#ifndef __SIL_LSM6DSV_REG_H
+#define __SIL_LSM6DSV_REG_H
+
+/* Host stand-in for the LSM6DSV register driver. The SIL feeds IMU data directly (see sil_sensors.c), so only
+ * the FIFO tags and unit conversions that u_imu_fifo.c uses are here, copied from the driver. */
+
+#include <stdint.h>
+
+typedef enum {
+    LSM6DSV_FIFO_EMPTY = 0x0,
+    LSM6DSV_GY_NC_TAG = 0x1,
+    LSM6DSV_XL_NC_TAG = 0x2,
+    LSM6DSV_SFLP_GAME_ROTATION_VECTOR_TAG = 0x13,
+    LSM6DSV_SFLP_GYROSCOPE_BIAS_TAG = 0x16,
+    LSM6DSV_SFLP_GRAVITY_VECTOR_TAG = 0x17,
+} lsm6dsv_fifo_tag_t;
+
+static inline float lsm6dsv_from_fs2_to_mg(int16_t lsb) {
+    return ((float)lsb) * 0.061f;
+}
+
+static inline float lsm6dsv_from_fs2000_to_mdps(int16_t lsb) {
+    return ((float)lsb) * 70.0f;
+}
+
+static inline float lsm6dsv_from_sflp_to_mg(int16_t lsb) {
+    return ((float)lsb) * 0.061f;
+}
+
+#endif /* lsm6dsv_reg.h */
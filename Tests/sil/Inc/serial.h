@@ -0,0 +1,8 @@
+#ifndef __SIL_SERIAL_H
+#define __SIL_SERIAL_H
+
+/* Host stand-in for Embedded-Base's serial monitor. Output is discarded by the SIL. */
+
+void serial_monitor(const char *category, const char *name, const char *format, ...);
+
+#endif /* serial.h */
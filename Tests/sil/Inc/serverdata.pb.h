@@ -0,0 +1,17 @@
+#ifndef __SIL_SERVERDATA_PB_H
+#define __SIL_SERVERDATA_PB_H
+
+/* Host stand-in for the nanopb-generated ServerData message. */
+
+#include <stdint.h>
+
+#define SIL_PB_MAX_VALUES 8
+
+typedef struct {
+    char unit[16];
+    float values[SIL_PB_MAX_VALUES];
+    uint8_t values_count;
+    uint64_t time_us;
+} serverdata_v2_ServerData;
+
+#endif /* serverdata.pb.h */
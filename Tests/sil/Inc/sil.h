@@ -0,0 +1,186 @@
+#ifndef __SIL_H
+#define __SIL_H
+
+/*
+*   Software-in-the-loop (SIL) harness for the VCU control stack.
+*
+*   The real application modules (pedals, TC, DTI, state machine, faults, CAN inbox, ...) are compiled
+*   for the host against the stand-ins in this directory. Time is a simulated 1 kHz tick, the ThreadX
+*   threads are replaced by a deterministic cooperative schedule (sil_app_tick()), and the rest of the
+*   car is replaced by a longitudinal vehicle model that speaks the same CAN frames the VCU expects.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "main.h"
+#include "fdcan.h"
+#include "u_nx_protobuf.h"
+#include "u_peripherals.h"
+#include "u_adc.h"
+#include "u_tc_stream.h"
+
+/* =================================== */
+/*               CLOCK                 */
+/* =================================== */
+uint32_t sil_clock_now(void);          /* Current simulated tick (1 tick = 1 ms). */
+void sil_clock_advance(uint32_t ticks); /* Advances the clock, firing any ThreadX timers that expire on the way. */
+void sil_clock_set_offset_us(int32_t offset_us); /* Offsets time_getMicros() from the current tick, for events that happen between ticks. */
+double sil_wall_time(void);             /* Host CPU time (seconds). Only used to report how much faster than real time a run was. */
+uint64_t sil_wall_ns(void);             /* Host monotonic clock (ns). Used to profile the application's compute time. */
+
+/* =================================== */
+/*                GPIO                 */
+/* =================================== */
+void sil_gpio_reset(void);                                                 /* Sets every pin to its idle level (inputs high, outputs low). */
+void sil_gpio_set(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state); /* Drives an input pin. */
+GPIO_PinState sil_gpio_get(GPIO_TypeDef *port, uint16_t pin);             /* Reads back any pin (including outputs written by the application). */
+bool sil_can_accepts(const can_msg_t *msg);                                /* Whether a frame passes the FDCAN filters set up by can1_init(). */
+
+/* =================================== */
+/*              SENSORS                */
+/* =================================== */
+/* Values returned by the simulated ADC and IMU drivers. */
+typedef struct {
+    float apps;          /* Accelerator pedal travel (0-1). Converted to APPS1/APPS2 voltages. */
+    float brake;         /* Brake pedal travel (0-1). Converted to BRAKE1/BRAKE2 voltages. */
+    vector3_t accel;     /* IMU acceleration (mg). */
+    vector3_t gyro;      /* IMU angular rate (mdps). */
+    quaternion_t orientation; /* IMU sensor fusion game rotation vector. Level by default. */
+    vector3_t gravity;   /* IMU sensor fusion gravity vector (mg). Level by default. */
+    bool imu_ok;         /* When false, the IMU drivers return U_ERROR. */
+    bool replay_pedals;  /* When true, the pedal ADC returns `pedal_adc` verbatim instead of converting apps/brake. */
+    raw_pedal_adc_t pedal_adc; /* Raw 12-bit pedal readings: the last conversion, or the values to replay. */
+    float apps1_volts;   /* When >= 0, forces the APPS1 line to this voltage (before the divider), to inject an open or short circuit. */
+} sil_sensors_t;
+
+sil_sensors_t *sil_sensors(void);
+void sil_sensors_adc_step(void);  /* Runs ADC2's analog watchdogs against the pedal lines. Call once per tick. */
+bool sil_sensors_imu_batch(void); /* Batches one IMU sample into the simulated FIFO. true if that reached the watermark and drained it. */
+
+/* =================================== */
+/*           VEHICLE MODEL             */
+/* =================================== */
+typedef struct {
+    /* Parameters (settable from drive cycles). */
+    float mu;              /* Peak road friction coefficient (unitless). */
+    float ax_bias;         /* Accelerometer bias added to the IMU reading (mg). */
+    float pack_voltage;    /* Open-circuit pack voltage (V). */
+    float motor_temp;      /* Reported motor temperature (C). */
+    float controller_temp; /* Reported controller temperature (C). */
+    float battbox_temp;    /* Reported average cell temperature (C). */
+    float dcl;             /* Discharge current limit broadcast by BMS (A). */
+    float ccl;             /* Charge current limit broadcast by BMS (A). */
+    uint8_t precharge;     /* Precharge state broadcast by BMS (0=open, 1=floating, 2=closed). */
+    bool shutdown_closed;  /* Shutdown state broadcast by BMS. */
+    bool bus_alive;        /* When false, the BMS/Lightning heartbeats stop. */
+    bool msb_alive;        /* When false, the shock pot and ride height frames stop. */
+    bool ccl_alive;        /* When false, the BMS sends its DCL frame but not its CCL frame. */
+
+    /* State. */
+    float v;               /* Vehicle speed (m/s). */
+    float omega_rear;      /* Rear (driven) wheel speed (rad/s). */
+    float ax;              /* Longitudinal acceleration (m/s^2). */
+    float slip;            /* Rear slip ratio (unitless). */
+    float fz_rear;         /* Rear axle normal load (N). */
+    float motor_torque;    /* Torque produced by the motor (Nm). Negative while regenerating. */
+    float ac_current;      /* Motor AC current (A). */
+    float dc_current;      /* Pack DC current (A). */
+    float dc_voltage;      /* Pack terminal voltage (V). */
+    float distance;        /* Distance travelled (m). */
+
+    /* Last commands received from the VCU. */
+    float cmd_ac_current;    /* From 0x036 (A). */
+    float cmd_brake_current; /* From 0x056 (A). */
+    bool drive_enable;       /* From 0x196. */
+    uint32_t last_cmd_tick;  /* Tick the last 0x036/0x056 arrived. */
+} sil_vehicle_t;
+
+sil_vehicle_t *sil_vehicle(void);
+void sil_vehicle_init(void);                       /* Resets the model to a stationary car with default parameters. */
+void sil_vehicle_step(void);                       /* Advances the model by one tick and publishes its periodic CAN frames. */
+void sil_vehicle_receive(const can_msg_t *msg);    /* Consumes a frame sent by the VCU. */
+float sil_vehicle_mph(void);                       /* Vehicle speed in mph. */
+
+/* =================================== */
+/*         APPLICATION SCHEDULE        */
+/* =================================== */
+void sil_app_init(void);                         /* Runs the module init sequence from app_threadx.c. */
+void sil_app_tick(void);                         /* Runs one tick of the emulated thread schedule. */
+void sil_can_inject(const can_msg_t *msg);       /* Puts a frame on the VCU's can_incoming queue (if it passes the filters). */
+void sil_app_use_plant(bool enabled);            /* Enables/disables the vehicle model. It is disabled while replaying a log. */
+void sil_app_stall_stream(bool stalled);         /* Stops draining the TC debug stream, as if its thread were starved. */
+bool sil_app_stream_stalled(void);
+
+/* Host compute time spent in the application, excluding the plant and the harness. */
+typedef enum {
+    SIL_TIMING_TICK,   /* Everything the emulated threads did in one tick. */
+    SIL_TIMING_PEDALS, /* One control cycle (pedals_process(), which commands the DTI). */
+    SIL_TIMING_TC,     /* One traction control cycle (tc_process(), once per IMU sample). */
+    SIL_NUM_TIMINGS
+} sil_timing_kind_t;
+
+typedef struct {
+    uint32_t count;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+} sil_timing_t;
+
+sil_timing_t sil_app_timing(sil_timing_kind_t kind);
+
+/* =================================== */
+/*               REPLAY                */
+/* =================================== */
+/*
+*   Replays a recorded bus log and pedal ADC trace into the application, open loop.
+*
+*   CAN logs are candump log files ("(<seconds>) <iface> <id>#<hex>"), normalised so the first frame is
+*   at t = 0. Pedal traces are CSV files with a header and rows of "t_ms,accel1,accel2,brake1,brake2"
+*   (raw 12-bit counts), held until the next row. The --capture options write both formats.
+*/
+int sil_replay_load_can(const char *path);     /* Returns 0 on success. */
+int sil_replay_load_pedals(const char *path);  /* Returns 0 on success. */
+void sil_replay_apply(uint32_t tick);          /* Injects every frame due by `tick`, and updates the pedal readings. */
+uint32_t sil_replay_end(void);                 /* Timestamp of the last logged event (ms). */
+
+/* =================================== */
+/*              RECORDER               */
+/* =================================== */
+typedef struct {
+    uint32_t id;
+    uint32_t count;
+} sil_frame_count_t;
+
+#define SIL_MAX_TRACKED_IDS 64
+
+typedef struct {
+    sil_frame_count_t frames[SIL_MAX_TRACKED_IDS]; /* Outgoing CAN frames, per ID. */
+    uint16_t num_ids;
+    uint32_t total_frames;
+    uint32_t mqtt_messages;
+
+    /* TC debug stream, as a receiver on the network would decode it (see u_tc_stream.h). */
+    uint32_t stream_datagrams;
+    uint32_t stream_samples;
+    uint32_t stream_gap;        /* Samples missing from the sequence. */
+    uint32_t stream_dropped;    /* Samples the VCU reported dropping, from the last header. */
+    uint32_t stream_errors;     /* Malformed datagrams, lost datagrams, and gaps the drop count doesn't account for. */
+    tc_stream_sample_t stream_last;
+} sil_recorder_stats_t;
+
+int sil_recorder_open(const char *path);   /* Starts writing every emitted frame/message to `path` (CSV). NULL records to a temporary file. */
+void sil_recorder_close(void);
+int sil_recorder_diff(const char *golden_path, int max_report); /* Compares the recording with a golden trace. Returns the number of differing lines, or -1 on error. */
+
+/* Capture of the application's inputs, in the formats the replay reads. */
+int sil_capture_open(const char *can_path, const char *pedals_path); /* Either path may be NULL. */
+void sil_capture_close(void);
+void sil_capture_can(const can_msg_t *msg);            /* A frame the application received. */
+void sil_capture_pedals(const raw_pedal_adc_t *adc);   /* The pedal ADC reading a control cycle used. */
+void sil_recorder_can(const can_msg_t *msg);
+void sil_recorder_mqtt(const ethernet_mqtt_message_t *msg);
+void sil_recorder_udp(const uint8_t *data, uint16_t size); /* A TC debug stream datagram. */
+const sil_recorder_stats_t *sil_recorder_stats(void);
+
+#endif /* sil.h */
@@ -0,0 +1,21 @@
+#ifndef __SIL_TIMER_H
+#define __SIL_TIMER_H
+
+/* Host stand-in for Embedded-Base's middleware timer.h (polled software timers on HAL_GetTick()). */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    uint32_t start_time;
+    uint32_t end_time;
+    bool active;
+    bool completed;
+} nertimer_t;
+
+void start_timer(nertimer_t *timer, uint32_t duration);
+void cancel_timer(nertimer_t *timer);
+bool is_timer_expired(nertimer_t *timer);
+bool is_timer_active(nertimer_t *timer);
+
+#endif /* timer.h */
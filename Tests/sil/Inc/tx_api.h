@@ -0,0 +1,40 @@
+#ifndef __SIL_TX_API_H
+#define __SIL_TX_API_H
+
+/*
+*   Host stand-in for the ThreadX API. Only the types, constants and services that the
+*   application modules actually touch are provided. Time is driven by the SIL clock (see sil.h),
+*   so nothing in here ever blocks.
+*/
+
+#include <stdint.h>
+
+typedef void VOID;
+typedef char CHAR;
+typedef unsigned char UCHAR;
+typedef int INT;
+typedef unsigned int UINT;
+typedef long LONG;
+typedef unsigned long ULONG;
+typedef unsigned long long ULONG64;
+
+#define TX_SUCCESS        0x00
+#define TX_QUEUE_EMPTY    0x0A
+#define TX_QUEUE_FULL     0x0B
+#define TX_NO_WAIT        0UL
+#define TX_WAIT_FOREVER   0xFFFFFFFFUL
+#define TX_AUTO_START     1
+#define TX_DONT_START     0
+#define TX_NO_TIME_SLICE  0
+#define TX_INHERIT        1
+#define TX_NO_INHERIT     0
+
+#define TX_TIMER_TICKS_PER_SECOND 1000UL
+
+typedef struct { ULONG unused; } TX_BYTE_POOL;
+
+/* Thread services. */
+UINT tx_thread_sleep(ULONG timer_ticks); /* Advances the simulated clock instead of blocking. */
+ULONG tx_time_get(void);                 /* Returns the simulated tick count. */
+
+#endif /* tx_api.h */
@@ -0,0 +1,8 @@
+#ifndef __SIL_U_NX_ETHERNET_H
+#define __SIL_U_NX_ETHERNET_H
+
+/* Host stand-in for Embedded-Base's u_nx_ethernet.h. There is no network stack in the SIL. */
+
+#include "u_nx_protobuf.h"
+
+#endif /* u_nx_ethernet.h */
@@ -0,0 +1,23 @@
+#ifndef __SIL_U_NX_PROTOBUF_H
+#define __SIL_U_NX_PROTOBUF_H
+
+/* Host stand-in for Embedded-Base's u_nx_protobuf.h. Messages are captured from the eth_manager queue by the SIL recorder instead of being published. */
+
+#include <stdint.h>
+#include "serverdata.pb.h"
+
+#define SIL_MQTT_TOPIC_SIZE 100
+
+typedef struct {
+    char topic[SIL_MQTT_TOPIC_SIZE];
+    serverdata_v2_ServerData msg;
+} ethernet_mqtt_message_t;
+
+ethernet_mqtt_message_t _sil_mqtt_message_create(const char *topic, const char *unit, const float *values, uint8_t num_values);
+
+/* Builds an MQTT message from a topic, a unit and up to SIL_PB_MAX_VALUES values. */
+#define nx_protobuf_mqtt_message_create(topic, unit, ...)                                   \
+    _sil_mqtt_message_create((topic), (unit), (const float[]){ __VA_ARGS__ },               \
+                             (uint8_t)(sizeof((const float[]){ __VA_ARGS__ }) / sizeof(float)))
+
+#endif /* u_nx_protobuf.h */
@@ -0,0 +1,31 @@
+#ifndef __SIL_U_TX_DEBUG_H
+#define __SIL_U_TX_DEBUG_H
+
+/* Host stand-in for Embedded-Base's u_tx_debug.h. Log output is routed through sil_log() so it can be silenced during long drive cycles. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "stm32h5xx_hal.h"
+#include "u_tx_general.h"
+
+
+typedef enum { SIL_LOG_ERROR, SIL_LOG_WARNING, SIL_LOG_INFO } sil_log_level_t;
+void sil_log(sil_log_level_t level, const char *file, int line, const char *format, ...) __attribute__((format(printf, 4, 5)));
+
+#define PRINTLN_ERROR(...)   sil_log(SIL_LOG_ERROR, __FILE__, __LINE__, __VA_ARGS__)
+#define PRINTLN_WARNING(...) sil_log(SIL_LOG_WARNING, __FILE__, __LINE__, __VA_ARGS__)
+#define PRINTLN_INFO(...)    sil_log(SIL_LOG_INFO, __FILE__, __LINE__, __VA_ARGS__)
+
+/* Returns from the calling function if `func` does not evaluate to `success`. */
+#define CATCH_ERROR(func, success)                                                   \
+    do {                                                                             \
+        int _status = (func);                                                        \
+        if (_status != (success)) {                                                  \
+            PRINTLN_ERROR("CATCH_ERROR(): %s failed (Status: %d).", #func, _status); \
+            return _status;                                                          \
+        }                                                                            \
+    } while (0)
+
+const char *hal_status_toString(HAL_StatusTypeDef status);
+
+#endif /* u_tx_debug.h */
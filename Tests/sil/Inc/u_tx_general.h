@@ -0,0 +1,9 @@
+#ifndef __SIL_U_TX_GENERAL_H
+#define __SIL_U_TX_GENERAL_H
+
+/* Host stand-in for Embedded-Base's u_tx_general.h. */
+
+#define U_SUCCESS 0
+#define U_ERROR   1
+
+#endif /* u_tx_general.h */
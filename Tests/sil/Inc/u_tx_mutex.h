@@ -0,0 +1,20 @@
+#ifndef __SIL_U_TX_MUTEX_H
+#define __SIL_U_TX_MUTEX_H
+
+/* Host stand-in for Embedded-Base's u_tx_mutex.h. The SIL scheduler is single threaded, so mutexes only track ownership. */
+
+#include <stdint.h>
+#include "tx_api.h"
+#include "u_tx_general.h"
+
+typedef struct {
+    const char *name;      /* Name of the mutex. */
+    UINT priority_inherit; /* Priority inheritance setting. */
+    UINT _owned;
+} mutex_t;
+
+uint8_t create_mutex(mutex_t *mutex);
+uint8_t mutex_get(mutex_t *mutex);
+uint8_t mutex_put(mutex_t *mutex);
+
+#endif /* u_tx_mutex.h */
@@ -0,0 +1,27 @@
+#ifndef __SIL_U_TX_QUEUES_H
+#define __SIL_U_TX_QUEUES_H
+
+/* Host stand-in for Embedded-Base's u_tx_queues.h. Queues are plain ring buffers that never block. */
+
+#include <stdint.h>
+#include "tx_api.h"
+#include "u_tx_general.h"
+
+typedef struct {
+    /* Set by the user. */
+    const char *name;  /* Name of the queue. */
+    UINT message_size; /* Size of each queue message, in bytes. */
+    UINT capacity;     /* Number of messages the queue can hold. */
+
+    /* Managed by the SIL runtime. */
+    uint8_t *_storage;
+    UINT _head;
+    UINT _count;
+    ULONG _dropped; /* Messages rejected because the queue was full. */
+} queue_t;
+
+uint8_t create_queue(TX_BYTE_POOL *byte_pool, queue_t *queue);
+uint8_t queue_send(queue_t *queue, void *message, UINT wait_time);
+uint8_t queue_receive(queue_t *queue, void *message, UINT wait_time);
+
+#endif /* u_tx_queues.h */
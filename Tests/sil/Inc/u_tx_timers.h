@@ -0,0 +1,38 @@
+#ifndef __SIL_U_TX_TIMERS_H
+#define __SIL_U_TX_TIMERS_H
+
+/* Host stand-in for Embedded-Base's u_tx_timers.h. Expired timers are fired by sil_clock_advance(). */
+
+#include <stdbool.h>
+#include "tx_api.h"
+#include "u_tx_general.h"
+#include "u_tx_debug.h"
+
+typedef enum {
+    ONESHOT,
+    PERIODIC
+} timer_type_t;
+
+typedef struct timer_t {
+    /* Set by the user. */
+    const char *name;              /* Name of the timer. */
+    void (*callback)(ULONG);       /* Function called when the timer expires. */
+    ULONG callback_input;          /* Argument passed to the callback. */
+    ULONG duration;                /* Timer duration (in ticks). */
+    timer_type_t type;             /* ONESHOT or PERIODIC. */
+    bool auto_activate;            /* Start the timer as soon as it is created. */
+
+    /* Managed by the SIL runtime. */
+    bool _active;
+    ULONG _expiry;
+    struct timer_t *_next;
+} timer_t;
+
+int timer_init(timer_t *timer);
+int timer_start(timer_t *timer);
+int timer_stop(timer_t *timer);
+int timer_reset(timer_t *timer);
+int timer_restart(timer_t *timer);
+int timer_isActive(timer_t *timer, bool *active);
+
+#endif /* u_tx_timers.h */
@@ -0,0 +1,323 @@
+#include <stdlib.h>
+#include "sil.h"
+#include "u_tx_debug.h"
+#include "u_queues.h"
+#include "u_mutexes.h"
+#include "u_can.h"
+#include "u_faults.h"
+#include "u_statemachine.h"
+#include "u_pedals.h"
+#include "u_bms.h"
+#include "u_calibration.h"
+#include "u_rtds.h"
+#include "u_efuses.h"
+#include "u_lightning.h"
+#include "u_shutdown.h"
+#include "u_dti.h"
+#include "u_tc.h"
+#include "u_tc_stream.h"
+#include "u_imu_fifo.h"
+#include "can_messages_tx.h"
+
+/*
+*   Deterministic stand-in for the ThreadX schedule in u_threads.c.
+*
+*   Each call to sil_app_tick() is one millisecond. Queue-driven threads (CAN incoming/outgoing,
+*   faults, state machine, ethernet) drain their queues every tick, and the periodic threads run
+*   on the same periods they sleep for on the car. Priorities are respected by running the
+*   threads in priority order within a tick.
+*/
+
+/* Thread periods (ticks), mirrored from u_threads.c. */
+#define SIL_PERIOD_PEDALS       10
+#define SIL_PERIOD_STATEMACHINE 200
+#define SIL_PERIOD_FAULTS       500
+#define SIL_PERIOD_SHUTDOWN     100
+#define SIL_PERIOD_TC_STREAM    10
+#define SIL_PERIOD_EFUSES       100
+#define SIL_TIMEOUT_TC          10  /* vTractionControl's IMU data-ready timeout. */
+#define SIL_IMU_ODR_HZ          IMU_FIFO_ODR_HZ /* IMU sample rate, mirrored from peripherals_init(). */
+
+static bool _plant = true;
+static bool _stream_stalled = false;
+
+static uint32_t _imu_phase = 0; /* Accumulates SIL_IMU_ODR_HZ per tick; a sample is ready every 1000. */
+static uint32_t _tc_last = 0;   /* Tick of the last TC cycle. */
+
+/* Per-tick compute time samples (ns), one series per sil_timing_kind_t. */
+typedef struct {
+    uint32_t *samples;
+    uint32_t count;
+    uint32_t capacity;
+} timing_series_t;
+
+static timing_series_t _timings[SIL_NUM_TIMINGS];
+static uint64_t _busy_ns; /* Application time accumulated during the current tick. */
+
+static void _timing_add(sil_timing_kind_t kind, uint64_t ns) {
+    timing_series_t *series = &_timings[kind];
+    if (series->count == series->capacity) {
+        uint32_t capacity = series->capacity ? series->capacity * 2 : 4096;
+        uint32_t *samples = realloc(series->samples, capacity * sizeof(uint32_t));
+        if (samples == NULL) {
+            return;
+        }
+        series->samples = samples;
+        series->capacity = capacity;
+    }
+    series->samples[series->count++] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+}
+
+static int _compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+sil_timing_t sil_app_timing(sil_timing_kind_t kind) {
+    timing_series_t *series = &_timings[kind];
+    sil_timing_t timing = { .count = series->count };
+    if (series->count == 0) {
+        return timing;
+    }
+
+    qsort(series->samples, series->count, sizeof(uint32_t), _compare_u32);
+    double sum = 0.0;
+    for (uint32_t i = 0; i < series->count; i++) {
+        sum += series->samples[i];
+    }
+    timing.mean_us = sum / series->count / 1000.0;
+    timing.p50_us = series->samples[series->count / 2] / 1000.0;
+    timing.p99_us = series->samples[(uint32_t)((series->count - 1) * 0.99)] / 1000.0;
+    timing.max_us = series->samples[series->count - 1] / 1000.0;
+    return timing;
+}
+
+void sil_app_use_plant(bool enabled) {
+    _plant = enabled;
+}
+
+void sil_app_stall_stream(bool stalled) {
+    _stream_stalled = stalled;
+}
+
+bool sil_app_stream_stalled(void) {
+    return _stream_stalled;
+}
+
+void sil_can_inject(const can_msg_t *msg) {
+    if (!sil_can_accepts(msg)) {
+        return;
+    }
+    can_msg_t copy = *msg;
+    if (queue_send(&can_incoming, &copy, TX_NO_WAIT) != U_SUCCESS) {
+        PRINTLN_ERROR("SIL dropped incoming CAN frame (ID: 0x%lX).", (unsigned long)msg->id);
+    }
+}
+
+void sil_app_init(void) {
+    /* Same order as App_ThreadX_Init(). */
+    static TX_BYTE_POOL pool;
+    can1_init(NULL); /* Called from main() on the car, before the kernel starts. */
+    queues_init(&pool);
+    faults_init();
+    mutexes_init();
+    rtds_init();
+    calibration_init();
+    efuse_init();
+    pedals_init();
+    bms_init();
+    lightning_init();
+    dti_init();
+    tc_init();
+    init_statemachine();
+}
+
+/* vCANIncoming */
+static void _can_incoming(void) {
+    can_msg_t message;
+    while (queue_receive(&can_incoming, &message, TX_NO_WAIT) == U_SUCCESS) {
+        sil_capture_can(&message);
+        uint64_t start = sil_wall_ns();
+        can_inbox(&message);
+        _busy_ns += sil_wall_ns() - start;
+    }
+}
+
+/* vFaultsQueue */
+static void _faults_queue(void) {
+    fault_t fault_id;
+    while (queue_receive(&faults, &fault_id, TX_NO_WAIT) == U_SUCCESS) {
+        uint64_t start = sil_wall_ns();
+        trigger_fault(fault_id);
+        _busy_ns += sil_wall_ns() - start;
+    }
+}
+
+/* vCANOutgoing + vEthernet1Manager. Everything the VCU emits goes to the recorder and the plant.
+ * On the car these threads only hand frames to the peripherals, so they are not profiled. */
+static void _outgoing(void) {
+    can_msg_t message;
+    while (queue_receive(&can_outgoing, &message, TX_NO_WAIT) == U_SUCCESS) {
+        can_send_msg(&can1, &message);
+        if (_plant) {
+            sil_vehicle_receive(&message);
+        }
+    }
+
+    ethernet_mqtt_message_t mqtt;
+    while (queue_receive(&eth_manager, &mqtt, TX_NO_WAIT) == U_SUCCESS) {
+        sil_recorder_mqtt(&mqtt);
+    }
+}
+
+/* Runs one TC cycle, and profiles it. */
+static void _tc_cycle(const imu_sample_t *sample, uint32_t tick) {
+    uint64_t start = sil_wall_ns();
+    tc_process(sample);
+    uint64_t tc_ns = sil_wall_ns() - start;
+    _busy_ns += tc_ns;
+    _timing_add(SIL_TIMING_TC, tc_ns);
+    _tc_last = tick;
+}
+
+/* vTractionControl. Runs once per IMU sample, in a burst each time the IMU's FIFO reaches its watermark,
+ * or when it times out waiting for one. A failed IMU batches nothing at all. */
+static void _traction_control(uint32_t tick) {
+    bool drained = false;
+    _imu_phase += SIL_IMU_ODR_HZ;
+    if (_imu_phase >= 1000) {
+        _imu_phase -= 1000;
+        /* The sample was taken between ticks, _imu_phase / SIL_IMU_ODR_HZ ms before this one. */
+        sil_clock_set_offset_us(-(int32_t)(_imu_phase * 1000 / SIL_IMU_ODR_HZ));
+        drained = sil_sensors_imu_batch();
+        sil_clock_set_offset_us(0);
+    }
+
+    imu_sample_t sample;
+    if (drained) {
+        while (imu_waitForSample(&sample, SIL_TIMEOUT_TC) == U_SUCCESS) {
+            _tc_cycle(&sample, tick);
+        }
+    } else if (tick - _tc_last >= SIL_TIMEOUT_TC) {
+        _tc_cycle(NULL, tick);
+    }
+}
+
+/* vTCStream. Datagrams go to the recorder instead of the network. */
+static void _tc_stream(void) {
+    static uint8_t datagram[sizeof(tc_stream_header_t) + TC_STREAM_BATCH_MAX * sizeof(tc_stream_sample_t)];
+    uint16_t size;
+    while (!_stream_stalled && (size = tc_stream_pack(datagram, sizeof(datagram))) > 0) {
+        sil_recorder_udp(datagram, size);
+    }
+}
+
+/* vStatemachine. On the car the thread blocks on the transition queue for up to 200 ticks, then sends the car state. */
+static void _statemachine(uint32_t tick) {
+    state_req_t new_state_req;
+    if (queue_receive(&state_transition_queue, &new_state_req, TX_NO_WAIT) == U_SUCCESS) {
+        statemachine_process(new_state_req);
+    } else if (tick % SIL_PERIOD_STATEMACHINE == 0) {
+        send_carstate_msg();
+    }
+}
+
+/* vEFuses. Only the eFuse control. The eFuse and temperature reports aren't sent, so the recorded traces don't depend on it. */
+static void _efuses(void) {
+    efuse_data_t data = efuse_getData();
+    efuse_inputs_t inputs = {
+        .value = {
+            [EFUSE_SOURCE_MOTOR_TEMP] = dti_get_motor_temp(),
+            [EFUSE_SOURCE_CONTROLLER_TEMP] = dti_get_controller_temp(),
+            [EFUSE_SOURCE_BATTBOX_TEMP] = bms_getBattboxTemp(),
+            [EFUSE_SOURCE_BRAKE] = pedals_getBrakeState()
+        },
+        .faulted = {
+            [EFUSE_SOURCE_MOTOR_TEMP] = get_fault(MOTOR_TEMP_SENSOR_FAULT)
+        }
+    };
+    efuse_control(&data, &inputs);
+}
+
+/* vFaults */
+static void _faults(void) {
+    send_faults(
+        get_fault(CAN_OUTGOING_FAULT),
+        get_fault(CAN_INCOMING_FAULT),
+        get_fault(BMS_CAN_MONITOR_FAULT),
+        get_fault(LIGHTNING_CAN_MONITOR_FAULT),
+        get_fault(ONBOARD_TEMP_FAULT),
+        get_fault(IMU_ACCEL_FAULT),
+        get_fault(IMU_GYRO_FAULT),
+        get_fault(BSPD_PREFAULT),
+        get_fault(ONBOARD_BRAKE_OPEN_CIRCUIT_FAULT),
+        get_fault(ONBOARD_ACCEL_OPEN_CIRCUIT_FAULT),
+        get_fault(ONBOARD_BRAKE_SHORT_CIRCUIT_FAULT),
+        get_fault(ONBOARD_ACCEL_SHORT_CIRCUIT_FAULT),
+        get_fault(ONBOARD_PEDAL_DIFFERENCE_FAULT),
+        get_fault(RTDS_FAULT),
+        get_fault(LV_LOW_VOLTAGE_FAULT),
+        get_fault(PRECHARGE_FLOATING_FAULT)
+    );
+}
+
+void sil_app_tick(void) {
+    sil_clock_advance(1);
+    uint32_t tick = sil_clock_now();
+
+    /* The rest of the car publishes first, so the VCU sees this tick's bus traffic. */
+    if (_plant) {
+        sil_vehicle_step();
+    }
+
+    _busy_ns = 0;
+
+    /* ADC2 converts continuously, so its watchdogs see the pedal lines every tick. */
+    sil_sensors_adc_step();
+
+    /* Priority 1 */
+    _faults_queue();
+    _can_incoming();
+    _outgoing();
+    _traction_control(tick);
+
+    /* Priority 2 */
+    uint64_t start = sil_wall_ns();
+    _statemachine(tick);
+    if (tick % SIL_PERIOD_FAULTS == 0) {
+        _faults();
+    }
+    _busy_ns += sil_wall_ns() - start;
+
+    if (tick % SIL_PERIOD_PEDALS == 0) {
+        start = sil_wall_ns();
+        pedals_process();
+        uint64_t pedals_ns = sil_wall_ns() - start;
+        _busy_ns += pedals_ns;
+        _timing_add(SIL_TIMING_PEDALS, pedals_ns);
+        sil_capture_pedals(&sil_sensors()->pedal_adc);
+    }
+
+    if (tick % SIL_PERIOD_SHUTDOWN == 0) {
+        start = sil_wall_ns();
+        shutdown_process();
+        _busy_ns += sil_wall_ns() - start;
+    }
+
+    /* Priority 3 */
+    if (tick % SIL_PERIOD_TC_STREAM == 0) {
+        _tc_stream();
+    }
+    if (tick % SIL_PERIOD_EFUSES == 0) {
+        start = sil_wall_ns();
+        _efuses();
+        _busy_ns += sil_wall_ns() - start;
+    }
+
+    /* Flush anything the lower priority threads queued this tick. */
+    _faults_queue();
+    _outgoing();
+
+    _timing_add(SIL_TIMING_TICK, _busy_ns);
+}
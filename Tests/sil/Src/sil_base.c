@@ -0,0 +1,109 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sil.h"
+#include "u_tx_debug.h"
+#include "c_utils.h"
+#include "timer.h"
+#include "debounce.h"
+#include "serial.h"
+#include "u_nx_protobuf.h"
+
+/* Host versions of the Embedded-Base middleware used by the application modules. */
+
+/* Logging. Errors are always printed; warnings and info messages only with SIL_VERBOSE set. */
+void sil_log(sil_log_level_t level, const char *file, int line, const char *format, ...) {
+    static int verbose = -1;
+    if (verbose < 0) {
+        verbose = getenv("SIL_VERBOSE") != NULL;
+    }
+    if (level != SIL_LOG_ERROR && !verbose) {
+        return;
+    }
+
+    static const char *prefix[] = { [SIL_LOG_ERROR] = "ERROR", [SIL_LOG_WARNING] = "WARNING", [SIL_LOG_INFO] = "INFO" };
+    fprintf(stderr, "[%8lu ms] %s (%s:%d): ", (unsigned long)sil_clock_now(), prefix[level], file, line);
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+const char *hal_status_toString(HAL_StatusTypeDef status) {
+    switch (status) {
+        case HAL_OK: return "HAL_OK";
+        case HAL_ERROR: return "HAL_ERROR";
+        case HAL_BUSY: return "HAL_BUSY";
+        case HAL_TIMEOUT: return "HAL_TIMEOUT";
+        default: return "UNKNOWN";
+    }
+}
+
+void serial_monitor(const char *category, const char *name, const char *format, ...) {
+    (void)category;
+    (void)name;
+    (void)format;
+}
+
+/* c_utils */
+void endian_swap(void *ptr, size_t size) {
+    uint8_t *bytes = ptr;
+    for (size_t i = 0; i < size / 2; i++) {
+        uint8_t tmp = bytes[i];
+        bytes[i] = bytes[size - 1 - i];
+        bytes[size - 1 - i] = tmp;
+    }
+}
+
+/* Polled software timers. */
+void start_timer(nertimer_t *timer, uint32_t duration) {
+    timer->start_time = HAL_GetTick();
+    timer->end_time = timer->start_time + duration;
+    timer->active = true;
+    timer->completed = false;
+}
+
+void cancel_timer(nertimer_t *timer) {
+    timer->active = false;
+    timer->completed = false;
+}
+
+bool is_timer_expired(nertimer_t *timer) {
+    if (timer->active && (int32_t)(HAL_GetTick() - timer->end_time) >= 0) {
+        timer->active = false;
+        timer->completed = true;
+    }
+    return timer->completed;
+}
+
+bool is_timer_active(nertimer_t *timer) {
+    return timer->active;
+}
+
+void debounce(bool input, nertimer_t *timer, uint32_t period, void (*cb)(void *arg), void *arg) {
+    if (input && !is_timer_active(timer)) {
+        start_timer(timer, period);
+    } else if (!input && is_timer_active(timer)) {
+        cancel_timer(timer);
+    }
+
+    if (input && is_timer_expired(timer)) {
+        cb(arg);
+    }
+}
+
+/* Protobuf/MQTT messages. */
+ethernet_mqtt_message_t _sil_mqtt_message_create(const char *topic, const char *unit, const float *values, uint8_t num_values) {
+    ethernet_mqtt_message_t message = { 0 };
+    strncpy(message.topic, topic, sizeof(message.topic) - 1);
+    strncpy(message.msg.unit, unit, sizeof(message.msg.unit) - 1);
+    if (num_values > SIL_PB_MAX_VALUES) {
+        num_values = SIL_PB_MAX_VALUES;
+    }
+    memcpy(message.msg.values, values, num_values * sizeof(float));
+    message.msg.values_count = num_values;
+    message.msg.time_us = (uint64_t)sil_clock_now() * 1000u;
+    return message;
+}
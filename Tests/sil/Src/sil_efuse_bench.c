@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "sil.h"
+
+/*
+*   Host benchmark and accuracy check for the eFuse acquisition.
+*
+*   u_efuses.c is compiled into this file so its pin table can be used directly. efuse_getData(), which
+*   reads each GPIO port's input register once and scales with precomputed per-channel factors, is checked
+*   against the original per-pin version (two HAL_GPIO_ReadPin() calls and a divide per eFuse) over random
+*   pin levels and ADC readings. Then both are timed over the same states.
+*
+*       sil_efuse_bench [--samples <n>]
+*
+*   Fails if any pin state or raw reading differs, or a voltage or current is off by more than a float's rounding.
+*/
+
+#include "../../../Core/Src/u_efuses.c"
+
+#define BENCH_SAMPLES   200000
+#define BENCH_TOLERANCE 1e-6f /* Relative. */
+#define BENCH_STATES    64    /* Pin and ADC states cycled through while timing. */
+
+/* The rest of the application, as far as u_efuses.c is concerned. */
+static raw_efuse_adc_t _adc;
+raw_efuse_adc_t adc_getEFuseData(void) { return _adc; }
+uint32_t HAL_GetTick(void) { return 0; }
+
+void sil_log(sil_log_level_t level, const char *file, int line, const char *format, ...) {
+    (void)level;
+    (void)file;
+    (void)line;
+    (void)format;
+}
+
+/* efuse_getData() as it was: both pins through the HAL, and the ADC scaling done in two steps. */
+static efuse_data_t _get_data_per_pin(void) {
+    raw_efuse_adc_t adc = adc_getEFuseData();
+    efuse_data_t data = { 0 };
+    for (efuse_t efuse = 0; efuse < NUM_EFUSES; efuse++) {
+        data.raw[efuse] = adc.data[efuse];
+        data.voltage[efuse] = ((float)(adc.data[efuse]) / 4095) * 3.3f;
+        data.current[efuse] = data.voltage[efuse] * efuses[efuse].scale;
+        data.faulted[efuse] = (bool)(HAL_GPIO_ReadPin(efuses[efuse].er_port, efuses[efuse].er_pin) == GPIO_PIN_RESET);
+        data.enabled[efuse] = (bool)(HAL_GPIO_ReadPin(efuses[efuse].en_port, efuses[efuse].en_pin) == GPIO_PIN_SET);
+        data.control_state[efuse] = _efuse_control_state[efuse];
+    }
+    return data;
+}
+
+/* A random state: every EN and ER pin, and every eFuse's ADC reading. */
+typedef struct {
+    bool en[NUM_EFUSES];
+    bool er[NUM_EFUSES];
+    raw_efuse_adc_t adc;
+} state_t;
+
+static void _random_state(state_t *state) {
+    for (efuse_t efuse = 0; efuse < NUM_EFUSES; efuse++) {
+        state->en[efuse] = rand() & 1;
+        state->er[efuse] = rand() & 1;
+        state->adc.data[efuse] = (uint16_t)(rand() % 4096);
+    }
+}
+
+static void _apply_state(const state_t *state) {
+    for (efuse_t efuse = 0; efuse < NUM_EFUSES; efuse++) {
+        sil_gpio_set(efuses[efuse].en_port, efuses[efuse].en_pin, state->en[efuse] ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        sil_gpio_set(efuses[efuse].er_port, efuses[efuse].er_pin, state->er[efuse] ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    }
+    _adc = state->adc;
+}
+
+static bool _close(float a, float b) {
+    return fabsf(a - b) <= BENCH_TOLERANCE * fmaxf(fabsf(a), fabsf(b));
+}
+
+/* Times one acquisition over the states. Returns ns per call. */
+static double _time(efuse_data_t (*get_data)(void), const state_t *states, long samples, volatile float *sink) {
+    uint64_t start = sil_wall_ns();
+    for (long i = 0; i < samples; i++) {
+        if (i % 256 == 0) {
+            _apply_state(&states[(i / 256) % BENCH_STATES]);
+        }
+        efuse_data_t data = get_data();
+        *sink += data.current[EFUSE_PUMP1] + data.faulted[EFUSE_MC] + data.enabled[EFUSE_RADFAN];
+    }
+    return (double)(sil_wall_ns() - start) / samples;
+}
+
+int main(int argc, char **argv) {
+    long samples = BENCH_SAMPLES;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = strtol(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--samples <n>]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (samples < BENCH_STATES) {
+        samples = BENCH_STATES;
+    }
+
+    sil_gpio_reset();
+    efuse_init();
+    srand(1);
+
+    /* Accuracy: every random state through both versions. */
+    long mismatches = 0;
+    float worst = 0.0f;
+    for (long i = 0; i < samples / 16; i++) {
+        state_t state;
+        _random_state(&state);
+        _apply_state(&state);
+        efuse_data_t expected = _get_data_per_pin();
+        efuse_data_t data = efuse_getData();
+        for (efuse_t efuse = 0; efuse < NUM_EFUSES; efuse++) {
+            if (data.raw[efuse] != expected.raw[efuse] || data.faulted[efuse] != expected.faulted[efuse] ||
+                data.enabled[efuse] != expected.enabled[efuse] || data.control_state[efuse] != expected.control_state[efuse] ||
+                !_close(data.voltage[efuse], expected.voltage[efuse]) || !_close(data.current[efuse], expected.current[efuse])) {
+                mismatches++;
+            }
+            worst = fmaxf(worst, fabsf(data.current[efuse] - expected.current[efuse]));
+        }
+    }
+    printf("eFuse acquisition: %d eFuses, EN/ER pins on %u GPIO ports.\n", NUM_EFUSES, _num_ports);
+    printf("  accuracy: %ld mismatches over %ld states, worst current difference %.3g A %s\n", mismatches, samples / 16,
+           worst, mismatches == 0 ? "ok" : "FAILED");
+
+    /* Timing: the same states through both versions. */
+    state_t states[BENCH_STATES];
+    for (int i = 0; i < BENCH_STATES; i++) {
+        _random_state(&states[i]);
+    }
+    volatile float sink = 0.0f;
+    double per_pin_ns = _time(_get_data_per_pin, states, samples, &sink);
+    double snapshot_ns = _time(efuse_getData, states, samples, &sink);
+    printf("  per pin (%d HAL reads):      %.2f ns/call\n", 2 * NUM_EFUSES, per_pin_ns);
+    printf("  port snapshot (%u IDR reads): %.2f ns/call (%.1fx)\n", _num_ports, snapshot_ns, per_pin_ns / snapshot_ns);
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <string.h>
+#include "u_tx_general.h"
+
+/*
+*   Stand-in for u_flash.c and the reserved STORE region of the linker script.
+*
+*   The reserved sectors are host arrays, erased to 0xFF. Like the real flash, a write may only go to
+*   erased bytes, so code that forgets to erase first fails here too. Nothing persists between runs.
+*/
+
+#define SIL_FLASH_SECTOR_SIZE 0x2000
+
+/* Not const here, unlike in u_flash.h, so the stubs below can write them. */
+uint8_t _calibration_store[SIL_FLASH_SECTOR_SIZE] __attribute__((aligned(16))) = { [0 ... SIL_FLASH_SECTOR_SIZE - 1] = 0xFF };
+uint8_t _tire_curve_store[SIL_FLASH_SECTOR_SIZE] __attribute__((aligned(16))) = { [0 ... SIL_FLASH_SECTOR_SIZE - 1] = 0xFF };
+
+static uint8_t *const _sectors[] = { _calibration_store, _tire_curve_store };
+
+static uint8_t *_sector(const void *address) {
+    const uint8_t *p = address;
+    for (size_t i = 0; i < sizeof(_sectors) / sizeof(_sectors[0]); i++) {
+        if (p >= _sectors[i] && p < _sectors[i] + SIL_FLASH_SECTOR_SIZE) {
+            return _sectors[i];
+        }
+    }
+    return NULL;
+}
+
+int flash_eraseSector(const void *sector) {
+    if (sector == NULL || _sector(sector) != sector) {
+        return U_ERROR;
+    }
+    memset((uint8_t *)sector, 0xFF, SIL_FLASH_SECTOR_SIZE);
+    return U_SUCCESS;
+}
+
+int flash_write(const void *address, const void *data, uint32_t size) {
+    uint8_t *sector = _sector(address);
+    uint8_t *dst = (uint8_t *)address;
+    if (sector == NULL || ((uintptr_t)address & 15) != 0 || dst + size > sector + SIL_FLASH_SECTOR_SIZE) {
+        return U_ERROR;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        if (dst[i] != 0xFF) {
+            return U_ERROR; /* Not erased. */
+        }
+    }
+    memcpy(dst, data, size);
+    return U_SUCCESS;
+}
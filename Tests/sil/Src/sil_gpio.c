@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "sil.h"
+
+/* Simulated STM32 GPIO.
+ *
+ * The ports live at their real addresses, so the application can read a port's registers directly (as
+ * efuse_getData() reads IDR) as well as through the HAL. Pins loop back: driving one, from either side,
+ * sets both its ODR and IDR bits, like an output pin reads back on the chip. The binaries are linked
+ * without PIE, so nothing else is mapped there. */
+
+#define SIL_GPIO_PORTS    9  /* GPIOA..GPIOI */
+#define SIL_GPIO_PORT_GAP (GPIOB_BASE_NS - GPIOA_BASE_NS)
+
+static bool _mapped = false;
+
+/* Maps the GPIO ports' registers, the first time they're used. */
+static void _map(void) {
+    if (_mapped) {
+        return;
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = GPIOA_BASE_NS & ~(uintptr_t)(page - 1);
+    size_t size = (GPIOA_BASE_NS + SIL_GPIO_PORTS * SIL_GPIO_PORT_GAP - start + page - 1) & ~(size_t)(page - 1);
+    void *registers = mmap((void *)start, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (registers != (void *)start) {
+        fprintf(stderr, "SIL could not map the GPIO registers at 0x%lx.\n", (unsigned long)start);
+        abort();
+    }
+    _mapped = true;
+}
+
+/* Maps a GPIO port to its registers. Returns NULL for unknown ports. */
+static GPIO_TypeDef *_port(const GPIO_TypeDef *port) {
+    uintptr_t index = ((uintptr_t)port - GPIOA_BASE_NS) / SIL_GPIO_PORT_GAP;
+    if (index >= SIL_GPIO_PORTS) {
+        return NULL;
+    }
+    _map();
+    return (GPIO_TypeDef *)(GPIOA_BASE_NS + index * SIL_GPIO_PORT_GAP);
+}
+
+void sil_gpio_reset(void) {
+    /* Inputs idle high (pulled up shutdown loop, eFuse ER lines not faulted). */
+    for (int index = 0; index < SIL_GPIO_PORTS; index++) {
+        GPIO_TypeDef *port = _port((GPIO_TypeDef *)(GPIOA_BASE_NS + index * SIL_GPIO_PORT_GAP));
+        port->IDR = 0xFFFF;
+        port->ODR = 0xFFFF;
+    }
+}
+
+void sil_gpio_set(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state) {
+    GPIO_TypeDef *registers = _port(port);
+    if (registers == NULL) {
+        return;
+    }
+    if (state == GPIO_PIN_SET) {
+        registers->IDR |= pin;
+        registers->ODR |= pin;
+    } else {
+        registers->IDR &= ~(uint32_t)pin;
+        registers->ODR &= ~(uint32_t)pin;
+    }
+}
+
+GPIO_PinState sil_gpio_get(GPIO_TypeDef *port, uint16_t pin) {
+    GPIO_TypeDef *registers = _port(port);
+    return (registers != NULL && pin != 0 && (registers->IDR & pin)) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+/* HAL GPIO. */
+GPIO_PinState HAL_GPIO_ReadPin(const GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    return sil_gpio_get((GPIO_TypeDef *)GPIOx, GPIO_Pin);
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    sil_gpio_set(GPIOx, GPIO_Pin, PinState);
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    sil_gpio_set(GPIOx, GPIO_Pin, sil_gpio_get(GPIOx, GPIO_Pin) == GPIO_PIN_SET ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
@@ -0,0 +1,66 @@
+#include <string.h>
+#include "sil.h"
+#include "u_tx_debug.h"
+
+/* Simulated STM32 HAL: the FDCAN hooks used by the application. GPIO is in sil_gpio.c. */
+
+void Error_Handler(void) {
+    PRINTLN_ERROR("Error_Handler() called.");
+}
+
+/* Unique device ID, the board serial u_calibration.c keys its record on. Any fixed value will do. */
+uint32_t HAL_GetUIDw0(void) { return 0x00510053; }
+uint32_t HAL_GetUIDw1(void) { return 0x4D433230; }
+uint32_t HAL_GetUIDw2(void) { return 0x00000001; }
+
+/* FDCAN. Outgoing frames never reach this layer; the SIL drains can_outgoing directly.
+ * Incoming frames go through the same dual-ID acceptance filters the application configures in
+ * can1_init(), so replayed bus logs (which contain every node's traffic) are filtered like on the car. */
+#define SIL_CAN_MAX_FILTERS 16
+
+typedef struct {
+    uint32_t ids[2];
+    bool extended;
+} can_filter_t;
+
+static can_filter_t _filters[SIL_CAN_MAX_FILTERS];
+static uint8_t _num_filters = 0;
+
+HAL_StatusTypeDef can_init(can_t *can, FDCAN_HandleTypeDef *hcan) {
+    can->hcan = hcan;
+    _num_filters = 0;
+    return HAL_OK;
+}
+
+static HAL_StatusTypeDef _add_filter(uint32_t id1, uint32_t id2, bool extended) {
+    if (_num_filters >= SIL_CAN_MAX_FILTERS) {
+        return HAL_ERROR;
+    }
+    _filters[_num_filters++] = (can_filter_t){ .ids = { id1, id2 }, .extended = extended };
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef can_add_filter_standard(can_t *can, uint16_t can_ids[2]) {
+    return _add_filter(can_ids[0], can_ids[1], false);
+}
+
+HAL_StatusTypeDef can_add_filter_extended(can_t *can, uint32_t can_ids[2]) {
+    return _add_filter(can_ids[0], can_ids[1], true);
+}
+
+bool sil_can_accepts(const can_msg_t *msg) {
+    if (_num_filters == 0) {
+        return true; /* No filters configured, so the peripheral accepts everything. */
+    }
+    for (uint8_t i = 0; i < _num_filters; i++) {
+        if (_filters[i].extended == msg->id_is_extended && (_filters[i].ids[0] == msg->id || _filters[i].ids[1] == msg->id)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+HAL_StatusTypeDef can_send_msg(can_t *can, can_msg_t *msg) {
+    sil_recorder_can(msg);
+    return HAL_OK;
+}
@@ -0,0 +1,303 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sil.h"
+#include "u_imu_fifo.h"
+
+/*
+*   Host check and CPU cost of the IMU's sensor fusion (SFLP) through the FIFO parser.
+*
+*   A synthetic stream of FIFO words is built for a chassis slowly pitching and rolling: accelerometer and
+*   gyroscope words at IMU_FIFO_ODR_HZ, with the SFLP's game rotation and gravity vector words in between at
+*   IMU_FIFO_SFLP_HZ, encoded as the LSM6DSV writes them. It is parsed in watermark sized bursts, and each
+*   sample must carry the orientation and gravity it was batched with, and the right time.
+*
+*   Then the cost of getting orientation and gravity is timed two ways, per sample, over the parse alone:
+*   reading the SFLP's words out of the FIFO, and running a software 6-axis fusion (Madgwick's filter, the
+*   usual alternative) on each sample.
+*
+*       sil_imu_bench [--samples <n>]
+*
+*   Fails if a sample's orientation or gravity doesn't match what was batched, or its time is off.
+*/
+
+#define BENCH_SAMPLES     96000  /* 100 s at IMU_FIFO_ODR_HZ. */
+#define BENCH_RUNS        5      /* Timing runs. The fastest is reported. */
+#define BENCH_QUAT_TOL    1e-3f  /* Half precision, with w rebuilt from x, y and z. */
+#define BENCH_GRAVITY_TOL 0.061f /* (mg). One LSB. */
+#define BENCH_MADGWICK_BETA 0.033f
+#define BENCH_PERIOD_US   (1000000 / IMU_FIFO_ODR_HZ)
+
+uint64_t sil_wall_ns(void);
+
+typedef struct {
+    quaternion_t orientation;
+    vector3_t gravity;
+    vector3_t accel; /* (mg). */
+    vector3_t gyro;  /* (mdps). */
+} truth_t;
+
+typedef struct {
+    uint8_t *words;
+    uint32_t count;
+} stream_t;
+
+/* Orientation of a chassis pitching and rolling a few degrees, at time t (s). */
+static quaternion_t _orientation(float t) {
+    float pitch = 0.05f * sinf(0.7f * t);
+    float roll = 0.03f * sinf(1.3f * t);
+    float cp = cosf(pitch / 2), sp = sinf(pitch / 2), cr = cosf(roll / 2), sr = sinf(roll / 2);
+    return (quaternion_t){ .w = cr * cp, .x = sr * cp, .y = cr * sp, .z = -sr * sp };
+}
+
+/* Gravity in the IMU's frame for an orientation, as the accelerometer reads it at rest (mg). */
+static vector3_t _gravity(const quaternion_t *q) {
+    return (vector3_t){
+        .x = 2000.0f * (q->x * q->z - q->w * q->y),
+        .y = 2000.0f * (q->w * q->x + q->y * q->z),
+        .z = 1000.0f * (q->w * q->w - q->x * q->x - q->y * q->y + q->z * q->z),
+    };
+}
+
+static int16_t _to_lsb(float value, float scale) {
+    float lsb = value / scale;
+    if (lsb > 32767.0f) lsb = 32767.0f;
+    if (lsb < -32768.0f) lsb = -32768.0f;
+    return (int16_t)lrintf(lsb);
+}
+
+/* IEEE 754 half-precision, for |value| <= 1. */
+static int16_t _to_half(float value) {
+    uint16_t sign = (value < 0.0f) ? 0x8000 : 0;
+    float magnitude = fabsf(value);
+    if (magnitude < 6.103515625e-05f) {
+        return (int16_t)(sign | (uint16_t)lrintf(magnitude * 16777216.0f));
+    }
+    int exponent;
+    float fraction = frexpf(magnitude, &exponent);
+    uint32_t mantissa = (uint32_t)lrintf((fraction * 2.0f - 1.0f) * 1024.0f);
+    if (mantissa == 1024) {
+        mantissa = 0;
+        exponent++;
+    }
+    return (int16_t)(sign | (uint16_t)((exponent + 14) << 10) | (uint16_t)mantissa);
+}
+
+static void _push(stream_t *stream, lsm6dsv_fifo_tag_t tag, uint8_t counter, const int16_t axes[3]) {
+    uint8_t *word = &stream->words[stream->count++ * IMU_FIFO_WORD_SIZE];
+    word[0] = (uint8_t)((tag << 3) | (counter << 1));
+    for (int axis = 0; axis < 3; axis++) {
+        word[1 + 2 * axis] = (uint8_t)(axes[axis] & 0xFF);
+        word[2 + 2 * axis] = (uint8_t)((uint16_t)axes[axis] >> 8);
+    }
+}
+
+/* Builds the truth, and the FIFO words the IMU would batch with and without the SFLP. */
+static void _build(truth_t *truth, long samples, stream_t *plain, stream_t *fused) {
+    uint32_t sflp_phase = 0;
+    for (long i = 0; i < samples; i++) {
+        float t = (float)i / IMU_FIFO_ODR_HZ;
+        truth_t *now = &truth[i];
+        quaternion_t next = _orientation(t + 1.0f / IMU_FIFO_ODR_HZ);
+        now->orientation = _orientation(t);
+        now->gravity = _gravity(&now->orientation);
+        now->accel = now->gravity;
+        now->accel.x += 50.0f * sinf(3.0f * t); /* Some driving on top. */
+
+        /* Body rates from the change in orientation: 2 q* dq/dt (rad/s), then mdps. */
+        const quaternion_t *q = &now->orientation;
+        float dw = (next.w - q->w) * IMU_FIFO_ODR_HZ, dx = (next.x - q->x) * IMU_FIFO_ODR_HZ;
+        float dy = (next.y - q->y) * IMU_FIFO_ODR_HZ, dz = (next.z - q->z) * IMU_FIFO_ODR_HZ;
+        float to_mdps = 2.0f * 180.0f / (float)M_PI * 1000.0f;
+        now->gyro.x = to_mdps * (q->w * dx - q->x * dw - q->y * dz + q->z * dy);
+        now->gyro.y = to_mdps * (q->w * dy + q->x * dz - q->y * dw - q->z * dx);
+        now->gyro.z = to_mdps * (q->w * dz - q->x * dy + q->y * dx - q->z * dw);
+
+        uint8_t counter = (uint8_t)(i & 0x3);
+        int16_t gyro[3] = { _to_lsb(now->gyro.x, 70.0f), _to_lsb(now->gyro.y, 70.0f), _to_lsb(now->gyro.z, 70.0f) };
+        int16_t accel[3] = { _to_lsb(now->accel.x, 0.061f), _to_lsb(now->accel.y, 0.061f), _to_lsb(now->accel.z, 0.061f) };
+        _push(plain, LSM6DSV_GY_NC_TAG, counter, gyro);
+        _push(plain, LSM6DSV_XL_NC_TAG, counter, accel);
+        _push(fused, LSM6DSV_GY_NC_TAG, counter, gyro);
+        _push(fused, LSM6DSV_XL_NC_TAG, counter, accel);
+
+        sflp_phase += IMU_FIFO_SFLP_HZ;
+        if (sflp_phase >= IMU_FIFO_ODR_HZ) {
+            sflp_phase -= IMU_FIFO_ODR_HZ;
+            int16_t quaternion[3] = { _to_half(q->x), _to_half(q->y), _to_half(q->z) };
+            int16_t gravity[3] = { _to_lsb(now->gravity.x, 0.061f), _to_lsb(now->gravity.y, 0.061f), _to_lsb(now->gravity.z, 0.061f) };
+            _push(fused, LSM6DSV_SFLP_GAME_ROTATION_VECTOR_TAG, counter, quaternion);
+            _push(fused, LSM6DSV_SFLP_GRAVITY_VECTOR_TAG, counter, gravity);
+        }
+    }
+}
+
+/* Madgwick's 6-axis filter: one gradient descent step towards the accelerometer's gravity, blended into the integrated gyro. */
+static void _madgwick(quaternion_t *q, const vector3_t *gyro, const vector3_t *accel, float dt) {
+    const float to_rads = (float)M_PI / 180.0f / 1000.0f;
+    float gx = gyro->x * to_rads, gy = gyro->y * to_rads, gz = gyro->z * to_rads;
+    float q0 = q->w, q1 = q->x, q2 = q->y, q3 = q->z;
+
+    float dq0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+    float dq1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+    float dq2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+    float dq3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+    float norm = sqrtf(accel->x * accel->x + accel->y * accel->y + accel->z * accel->z);
+    if (norm > 0.0f) {
+        float ax = accel->x / norm, ay = accel->y / norm, az = accel->z / norm;
+        float f0 = 2.0f * (q1 * q3 - q0 * q2) - ax;
+        float f1 = 2.0f * (q0 * q1 + q2 * q3) - ay;
+        float f2 = 2.0f * (0.5f - q1 * q1 - q2 * q2) - az;
+        float s0 = -2.0f * q2 * f0 + 2.0f * q1 * f1;
+        float s1 = 2.0f * q3 * f0 + 2.0f * q0 * f1 - 4.0f * q1 * f2;
+        float s2 = -2.0f * q0 * f0 + 2.0f * q3 * f1 - 4.0f * q2 * f2;
+        float s3 = 2.0f * q1 * f0 + 2.0f * q2 * f1;
+        float s_norm = sqrtf(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3);
+        if (s_norm > 0.0f) {
+            float k = BENCH_MADGWICK_BETA / s_norm;
+            dq0 -= k * s0;
+            dq1 -= k * s1;
+            dq2 -= k * s2;
+            dq3 -= k * s3;
+        }
+    }
+
+    q0 += dq0 * dt;
+    q1 += dq1 * dt;
+    q2 += dq2 * dt;
+    q3 += dq3 * dt;
+    float q_norm = sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    q->w = q0 / q_norm;
+    q->x = q1 / q_norm;
+    q->y = q2 / q_norm;
+    q->z = q3 / q_norm;
+}
+
+/* Counts out which words make up each watermark burst. */
+static uint32_t _burst(const stream_t *stream, uint32_t start) {
+    uint32_t end = start + IMU_FIFO_WATERMARK_WORDS;
+    return (end > stream->count) ? stream->count - start : IMU_FIFO_WATERMARK_WORDS;
+}
+
+/* Parses a whole stream in bursts, optionally running the software fusion on each sample. Returns the time taken (ns). */
+static uint64_t _time_parse(const stream_t *stream, bool software, quaternion_t *q, volatile float *sink) {
+    imu_fifo_reset();
+    imu_sample_t sample;
+    uint64_t start = sil_wall_ns();
+    for (uint32_t i = 0; i < stream->count; ) {
+        uint32_t count = _burst(stream, i);
+        imu_fifo_parse(&stream->words[i * IMU_FIFO_WORD_SIZE], (uint16_t)count, 0, IMU_FIFO_ANCHOR_NEWEST);
+        i += count;
+        while (imu_fifo_pop(&sample)) {
+            if (software) {
+                _madgwick(q, &sample.gyro, &sample.accel, 1.0f / IMU_FIFO_ODR_HZ);
+                *sink += q->w;
+            } else {
+                *sink += sample.orientation.w + sample.gravity.x;
+            }
+        }
+    }
+    return sil_wall_ns() - start;
+}
+
+static float _quaternion_error(const quaternion_t *a, const quaternion_t *b) {
+    /* q and -q are the same rotation. */
+    float dot = a->w * b->w + a->x * b->x + a->y * b->y + a->z * b->z;
+    float sign = (dot < 0.0f) ? -1.0f : 1.0f;
+    return fmaxf(fmaxf(fabsf(a->w - sign * b->w), fabsf(a->x - sign * b->x)), fmaxf(fabsf(a->y - sign * b->y), fabsf(a->z - sign * b->z)));
+}
+
+int main(int argc, char **argv) {
+    long samples = BENCH_SAMPLES;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = strtol(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--samples <n>]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (samples < 2 * IMU_FIFO_WATERMARK) {
+        samples = 2 * IMU_FIFO_WATERMARK;
+    }
+
+    truth_t *truth = calloc((size_t)samples, sizeof(truth_t));
+    stream_t plain = { .words = calloc((size_t)samples * 2, IMU_FIFO_WORD_SIZE) };
+    stream_t fused = { .words = calloc((size_t)samples * 4, IMU_FIFO_WORD_SIZE) };
+    if (truth == NULL || plain.words == NULL || fused.words == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        return 2;
+    }
+    _build(truth, samples, &plain, &fused);
+    printf("IMU sensor fusion: %ld samples at %d Hz, SFLP at %d Hz, bursts of %d words.\n", samples, IMU_FIFO_ODR_HZ,
+           IMU_FIFO_SFLP_HZ, IMU_FIFO_WATERMARK_WORDS);
+
+    /* Accuracy: each sample carries the newest SFLP words batched before it, and the right time. */
+    imu_fifo_reset();
+    long checked = 0, popped = 0, time_errors = 0;
+    float quat_error = 0.0f, gravity_error = 0.0f;
+    imu_sample_t sample;
+    for (uint32_t i = 0; i < fused.count; ) {
+        uint32_t count = _burst(&fused, i);
+        i += count;
+        long newest = (long)((i + 1) / 3) - 1; /* Three words per sample on average, and the burst ends on one. */
+        uint64_t newest_us = 1000000 + (uint64_t)newest * BENCH_PERIOD_US;
+        imu_fifo_parse(&fused.words[(i - count) * IMU_FIFO_WORD_SIZE], (uint16_t)count, newest_us, IMU_FIFO_ANCHOR_NEWEST);
+        while (imu_fifo_pop(&sample)) {
+            long index = popped++;
+            if (sample.time_us != 1000000 + (uint64_t)index * BENCH_PERIOD_US) {
+                time_errors++;
+            }
+            if (!sample.fused) {
+                continue;
+            }
+            /* The SFLP batches after every other sample's words, so the first two samples go without. */
+            const truth_t *batched = &truth[(index - 2) | 1];
+            quat_error = fmaxf(quat_error, _quaternion_error(&sample.orientation, &batched->orientation));
+            gravity_error = fmaxf(gravity_error, fabsf(sample.gravity.x - batched->gravity.x));
+            gravity_error = fmaxf(gravity_error, fabsf(sample.gravity.y - batched->gravity.y));
+            gravity_error = fmaxf(gravity_error, fabsf(sample.gravity.z - batched->gravity.z));
+            checked++;
+        }
+    }
+    imu_fifo_stats_t stats = imu_fifo_getStats();
+    bool accuracy_ok = checked == samples - 2 && popped == samples && time_errors == 0 && stats.unpaired == 0 &&
+                       quat_error <= BENCH_QUAT_TOL && gravity_error <= BENCH_GRAVITY_TOL;
+    printf("  sflp: %ld/%ld samples fused, %u words, orientation error %.5f, gravity error %.3f mg, %ld timing errors %s\n",
+           checked, popped, stats.fusion, quat_error, gravity_error, time_errors, accuracy_ok ? "ok" : "FAILED");
+
+    /* Cost: the fastest of a few runs of each, over the parse alone. */
+    volatile float sink = 0.0f;
+    uint64_t plain_ns = UINT64_MAX, sflp_ns = UINT64_MAX, software_ns = UINT64_MAX;
+    quaternion_t q = { .w = 1.0f };
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        uint64_t ns = _time_parse(&plain, false, &q, &sink);
+        plain_ns = (ns < plain_ns) ? ns : plain_ns;
+        ns = _time_parse(&fused, false, &q, &sink);
+        sflp_ns = (ns < sflp_ns) ? ns : sflp_ns;
+        q = (quaternion_t){ .w = 1.0f };
+        ns = _time_parse(&plain, true, &q, &sink);
+        software_ns = (ns < software_ns) ? ns : software_ns;
+    }
+    double plain_per = (double)plain_ns / samples;
+    double sflp_per = ((double)sflp_ns - (double)plain_ns) / samples;
+    double software_per = ((double)software_ns - (double)plain_ns) / samples;
+    printf("  parse alone:                    %.2f ns/sample\n", plain_per);
+    printf("  + SFLP words from the FIFO:     %.2f ns/sample\n", sflp_per);
+    printf("  + software fusion (Madgwick):   %.2f ns/sample (%.1fx)\n", software_per, sflp_per > 0.0 ? software_per / sflp_per : INFINITY);
+
+    /* The software filter's gravity, for comparison. It converges from level, so only its final estimate is fair. */
+    vector3_t software_gravity = _gravity(&q);
+    const truth_t *last = &truth[samples - 1];
+    printf("  software gravity error at the end: %.2f mg\n",
+           fmaxf(fmaxf(fabsf(software_gravity.x - last->gravity.x), fabsf(software_gravity.y - last->gravity.y)),
+                 fabsf(software_gravity.z - last->gravity.z)));
+
+    free(truth);
+    free(plain.words);
+    free(fused.words);
+    printf(accuracy_ok ? "PASS\n" : "FAIL\n");
+    return accuracy_ok ? 0 : 1;
+}
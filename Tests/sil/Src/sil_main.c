@@ -0,0 +1,638 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "sil.h"
+#include "u_queues.h"
+#include "u_statemachine.h"
+#include "u_pedals.h"
+#include "u_faults.h"
+#include "u_buttons.h"
+#include "u_can.h"
+#include "u_tc.h"
+#include "u_tc_stream.h"
+#include "u_dti.h"
+#include "u_suspension.h"
+#include "u_efuses.h"
+
+/*
+*   Drive cycle runner.
+*
+*   A drive cycle is a text file of timestamped commands, one per line ('#' starts a comment):
+*
+*       <t_ms> set    <signal> <value>        Step a signal to a value.
+*       <t_ms> ramp   <signal> <value>        Ramp linearly from the signal's previous keyframe to <value>.
+*       <t_ms> can    <id> [<byte> ...]       Inject a CAN frame (hex) on the VCU's incoming queue.
+*       <t_ms> button <name>                  Press a steering wheel button.
+*       <t_ms> expect <observable> <min> <max> Fail the run unless the observable is within [min, max].
+*       <t_ms> end                            Stop the run (defaults to the last command).
+*
+*   With --replay, a recorded bus log (and optionally a pedal ADC trace) is fed to the application
+*   open loop instead of the vehicle model. A drive cycle can still be given alongside it, to press
+*   buttons or check expectations during the replay. --golden diffs everything the VCU sent against
+*   a previous --trace.
+*/
+
+/* =================================== */
+/*              SIGNALS                */
+/* =================================== */
+typedef enum {
+    SIG_APPS,
+    SIG_BRAKE,
+    SIG_MU,
+    SIG_AX_BIAS,
+    SIG_PACK_VOLTAGE,
+    SIG_MOTOR_TEMP,
+    SIG_CONTROLLER_TEMP,
+    SIG_BATTBOX_TEMP,
+    SIG_DCL,
+    SIG_CCL,
+    SIG_PRECHARGE,
+    SIG_SHUTDOWN,
+    SIG_IMU,
+    SIG_BUS,
+    SIG_TC_STREAM,
+    SIG_STREAM_STALL,
+    SIG_MSB,
+    SIG_BMS_CCL,
+    SIG_APPS1_VOLTS,
+    NUM_SIGNALS
+} signal_t;
+
+static const char *_signal_names[] = {
+    [SIG_APPS] = "apps",
+    [SIG_BRAKE] = "brake",
+    [SIG_MU] = "mu",
+    [SIG_AX_BIAS] = "ax_bias",
+    [SIG_PACK_VOLTAGE] = "pack_voltage",
+    [SIG_MOTOR_TEMP] = "motor_temp",
+    [SIG_CONTROLLER_TEMP] = "controller_temp",
+    [SIG_BATTBOX_TEMP] = "battbox_temp",
+    [SIG_DCL] = "dcl",
+    [SIG_CCL] = "ccl",
+    [SIG_PRECHARGE] = "precharge",
+    [SIG_SHUTDOWN] = "shutdown",
+    [SIG_IMU] = "imu",
+    [SIG_BUS] = "bus",
+    [SIG_TC_STREAM] = "tc_stream",
+    [SIG_STREAM_STALL] = "stream_stall",
+    [SIG_MSB] = "msb",
+    [SIG_BMS_CCL] = "bms_ccl",
+    [SIG_APPS1_VOLTS] = "apps1_volts",
+};
+_Static_assert(sizeof(_signal_names) / sizeof(_signal_names[0]) == NUM_SIGNALS, "Signal name table must match signal_t.");
+
+/* Current value of a signal, as the model/sensors see it. */
+static float _signal_get(signal_t signal) {
+    sil_vehicle_t *car = sil_vehicle();
+    switch (signal) {
+        case SIG_APPS: return sil_sensors()->apps;
+        case SIG_BRAKE: return sil_sensors()->brake;
+        case SIG_MU: return car->mu;
+        case SIG_AX_BIAS: return car->ax_bias;
+        case SIG_PACK_VOLTAGE: return car->pack_voltage;
+        case SIG_MOTOR_TEMP: return car->motor_temp;
+        case SIG_CONTROLLER_TEMP: return car->controller_temp;
+        case SIG_BATTBOX_TEMP: return car->battbox_temp;
+        case SIG_DCL: return car->dcl;
+        case SIG_CCL: return car->ccl;
+        case SIG_PRECHARGE: return car->precharge;
+        case SIG_SHUTDOWN: return car->shutdown_closed;
+        case SIG_IMU: return sil_sensors()->imu_ok;
+        case SIG_BUS: return car->bus_alive;
+        case SIG_TC_STREAM: return tc_stream_isEnabled();
+        case SIG_STREAM_STALL: return sil_app_stream_stalled();
+        case SIG_MSB: return car->msb_alive;
+        case SIG_BMS_CCL: return car->ccl_alive;
+        case SIG_APPS1_VOLTS: return sil_sensors()->apps1_volts;
+        default: return 0.0f;
+    }
+}
+
+static void _signal_set(signal_t signal, float value) {
+    sil_vehicle_t *car = sil_vehicle();
+    switch (signal) {
+        case SIG_APPS: sil_sensors()->apps = value; break;
+        case SIG_BRAKE: sil_sensors()->brake = value; break;
+        case SIG_MU: car->mu = value; break;
+        case SIG_AX_BIAS: car->ax_bias = value; break;
+        case SIG_PACK_VOLTAGE: car->pack_voltage = value; break;
+        case SIG_MOTOR_TEMP: car->motor_temp = value; break;
+        case SIG_CONTROLLER_TEMP: car->controller_temp = value; break;
+        case SIG_BATTBOX_TEMP: car->battbox_temp = value; break;
+        case SIG_DCL: car->dcl = value; break;
+        case SIG_CCL: car->ccl = value; break;
+        case SIG_PRECHARGE: car->precharge = (uint8_t)value; break;
+        case SIG_SHUTDOWN: car->shutdown_closed = value != 0.0f; break;
+        case SIG_IMU: sil_sensors()->imu_ok = value != 0.0f; break;
+        case SIG_BUS: car->bus_alive = value != 0.0f; break;
+        case SIG_TC_STREAM: tc_stream_enable(value != 0.0f); break;
+        case SIG_STREAM_STALL: sil_app_stall_stream(value != 0.0f); break;
+        case SIG_MSB: car->msb_alive = value != 0.0f; break;
+        case SIG_BMS_CCL: car->ccl_alive = value != 0.0f; break;
+        case SIG_APPS1_VOLTS: sil_sensors()->apps1_volts = value; break;
+        default: break;
+    }
+}
+
+/* =================================== */
+/*            OBSERVABLES              */
+/* =================================== */
+typedef struct {
+    const char *name;
+    float (*read)(void);
+} observable_t;
+
+static float _obs_func_state(void) { return (float)get_func_state(); }
+static float _obs_nero_index(void) { return (float)get_nero_state().nero_index; }
+static float _obs_torque_scale(void) { return tc_get_torque_scale(); }
+static float _obs_tc_enabled(void) { return tc_isEnabled(); }
+static float _obs_mph(void) { return sil_vehicle_mph(); }
+static float _obs_slip(void) { return sil_vehicle()->slip; }
+static float _obs_motor_torque(void) { return sil_vehicle()->motor_torque; }
+static float _obs_dc_current(void) { return sil_vehicle()->dc_current; }
+static float _obs_dc_power(void) { return sil_vehicle()->dc_current * sil_vehicle()->dc_voltage; }
+static float _obs_power_limited(void) { return dti_get_power_limited_fraction(); }
+static float _obs_brake_pressed(void) { return pedals_getBrakeState(); }
+static float _obs_accel_pressed(void) { return pedals_getAccelState(); }
+static float _obs_critical_faults(void) { return are_critical_faults_active(); }
+static float _obs_accel_open_circuit(void) { return get_fault(ONBOARD_ACCEL_OPEN_CIRCUIT_FAULT); }
+static float _obs_radfan_on(void) { return efuse_getData().enabled[EFUSE_RADFAN]; }
+static float _obs_pump1_on(void) { return efuse_getData().enabled[EFUSE_PUMP1]; }
+static float _obs_pump2_on(void) { return efuse_getData().enabled[EFUSE_PUMP2]; }
+
+/* Velocity estimator error against the model, and its standard deviation (mph). NAN until calibrated. */
+static float _obs_vx_est_error(void) {
+    tc_velocity_estimate_t est;
+    return tc_get_velocity_estimate(&est) ? (est.velocity - sil_vehicle()->v) * 2.23694f : NAN;
+}
+static float _obs_vx_std(void) {
+    tc_velocity_estimate_t est;
+    return tc_get_velocity_estimate(&est) ? sqrtf(est.covariance[0][0]) * 2.23694f : NAN;
+}
+
+/* Rear load estimate error against the model (N), and whether it comes from the suspension sensors. */
+static float _obs_rear_load_error(void) { return suspension_getAxleLoad(SUSPENSION_REAR, sil_vehicle()->ax) - sil_vehicle()->fz_rear; }
+static float _obs_load_measured(void) { return suspension_isMeasured(SUSPENSION_REAR); }
+static float _obs_torque_ceiling(void) { return tc_get_torque_ceiling(); }
+
+/* TC debug stream, as decoded from the datagrams the VCU sent. */
+static float _obs_stream_samples(void) { return sil_recorder_stats()->stream_samples; }
+static float _obs_stream_gap(void) { return sil_recorder_stats()->stream_gap; }
+static float _obs_stream_dropped(void) { return sil_recorder_stats()->stream_dropped; }
+static float _obs_stream_errors(void) { return sil_recorder_stats()->stream_errors; }
+static float _obs_stream_torque_scale(void) { return sil_recorder_stats()->stream_last.torque_scale; }
+static float _obs_stream_slip(void) { return sil_recorder_stats()->stream_last.slip; }
+
+static const observable_t _observables[] = {
+    { "func_state", _obs_func_state },
+    { "nero_index", _obs_nero_index },
+    { "torque_scale", _obs_torque_scale },
+    { "tc_enabled", _obs_tc_enabled },
+    { "mph", _obs_mph },
+    { "slip", _obs_slip },
+    { "motor_torque", _obs_motor_torque },
+    { "dc_current", _obs_dc_current },
+    { "dc_power", _obs_dc_power },
+    { "power_limited", _obs_power_limited },
+    { "brake_pressed", _obs_brake_pressed },
+    { "accel_pressed", _obs_accel_pressed },
+    { "critical_faults", _obs_critical_faults },
+    { "accel_open_circuit", _obs_accel_open_circuit },
+    { "radfan_on", _obs_radfan_on },
+    { "pump1_on", _obs_pump1_on },
+    { "pump2_on", _obs_pump2_on },
+    { "vx_est_error", _obs_vx_est_error },
+    { "vx_std", _obs_vx_std },
+    { "rear_load_error", _obs_rear_load_error },
+    { "load_measured", _obs_load_measured },
+    { "torque_ceiling", _obs_torque_ceiling },
+    { "stream_samples", _obs_stream_samples },
+    { "stream_gap", _obs_stream_gap },
+    { "stream_dropped", _obs_stream_dropped },
+    { "stream_errors", _obs_stream_errors },
+    { "stream_torque_scale", _obs_stream_torque_scale },
+    { "stream_slip", _obs_stream_slip },
+};
+#define NUM_OBSERVABLES (sizeof(_observables) / sizeof(_observables[0]))
+
+/* =================================== */
+/*              BUTTONS                */
+/* =================================== */
+static const struct {
+    const char *name;
+    button_t button;
+} _buttons[] = {
+    { "esc", BUTTON_ESC },
+    { "left", BUTTON_LEFT },
+    { "launch", BUTTON_LAUNCH_CONTROL_TOGGLE },
+    { "regen_up", BUTTON_UP_REGEN },
+    { "regen_down", BUTTON_DOWN_REGEN },
+    { "enter", BUTTON_ENTER },
+    { "right", BUTTON_RIGHT },
+    { "tc", BUTTON_TRACTION_CONTROL_TOGGLE },
+    { "torque_up", BUTTON_UP_TORQUE },
+    { "torque_down", BUTTON_DOWN_TORQUE },
+};
+
+/* =================================== */
+/*             DRIVE CYCLE             */
+/* =================================== */
+typedef enum { CMD_SET, CMD_RAMP, CMD_CAN, CMD_EXPECT, CMD_END } command_kind_t;
+
+typedef struct {
+    uint32_t t;
+    command_kind_t kind;
+    int target;       /* Signal or observable index. */
+    float value;      /* Set/ramp target, or expectation minimum. */
+    float value_max;  /* Expectation maximum. */
+    can_msg_t msg;    /* Frame for CMD_CAN. */
+    int line;
+} command_t;
+
+typedef struct {
+    command_t *commands;
+    size_t count;
+    size_t capacity;
+    uint32_t end;
+} cycle_t;
+
+static int _find_signal(const char *name) {
+    for (int i = 0; i < NUM_SIGNALS; i++) {
+        if (strcasecmp(name, _signal_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static int _find_observable(const char *name) {
+    for (size_t i = 0; i < NUM_OBSERVABLES; i++) {
+        if (strcasecmp(name, _observables[i].name) == 0) return (int)i;
+    }
+    return -1;
+}
+
+static command_t *_append(cycle_t *cycle) {
+    if (cycle->count == cycle->capacity) {
+        cycle->capacity = cycle->capacity ? cycle->capacity * 2 : 64;
+        cycle->commands = realloc(cycle->commands, cycle->capacity * sizeof(command_t));
+        if (cycle->commands == NULL) {
+            fprintf(stderr, "Out of memory.\n");
+            exit(2);
+        }
+    }
+    command_t *cmd = &cycle->commands[cycle->count++];
+    memset(cmd, 0, sizeof(*cmd));
+    return cmd;
+}
+
+static int _parse_cycle(const char *path, cycle_t *cycle) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open drive cycle '%s'.\n", path);
+        return -1;
+    }
+
+    char line[512];
+    int line_no = 0;
+    uint32_t last_t = 0;
+    bool has_end = false;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_no++;
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        char *save = NULL;
+        char *tok_t = strtok_r(line, " \t\r\n", &save);
+        if (tok_t == NULL) continue;
+        char *tok_cmd = strtok_r(NULL, " \t\r\n", &save);
+        if (tok_cmd == NULL) {
+            fprintf(stderr, "%s:%d: missing command.\n", path, line_no);
+            goto error;
+        }
+
+        uint32_t t = (uint32_t)strtoul(tok_t, NULL, 10);
+        if (t < last_t) {
+            fprintf(stderr, "%s:%d: commands must be in time order.\n", path, line_no);
+            goto error;
+        }
+        last_t = t;
+
+        command_t *cmd = _append(cycle);
+        cmd->t = t;
+        cmd->line = line_no;
+
+        if (strcmp(tok_cmd, "set") == 0 || strcmp(tok_cmd, "ramp") == 0) {
+            char *name = strtok_r(NULL, " \t\r\n", &save);
+            char *value = strtok_r(NULL, " \t\r\n", &save);
+            cmd->kind = (tok_cmd[0] == 's') ? CMD_SET : CMD_RAMP;
+            cmd->target = name ? _find_signal(name) : -1;
+            if (cmd->target < 0 || value == NULL) {
+                fprintf(stderr, "%s:%d: expected '%s <signal> <value>'.\n", path, line_no, tok_cmd);
+                goto error;
+            }
+            cmd->value = strtof(value, NULL);
+        } else if (strcmp(tok_cmd, "can") == 0 || strcmp(tok_cmd, "button") == 0) {
+            cmd->kind = CMD_CAN;
+            if (tok_cmd[0] == 'b') {
+                char *name = strtok_r(NULL, " \t\r\n", &save);
+                int found = -1;
+                for (size_t i = 0; name && i < sizeof(_buttons) / sizeof(_buttons[0]); i++) {
+                    if (strcasecmp(name, _buttons[i].name) == 0) found = (int)i;
+                }
+                if (found < 0) {
+                    fprintf(stderr, "%s:%d: unknown button '%s'.\n", path, line_no, name ? name : "");
+                    goto error;
+                }
+                cmd->msg = (can_msg_t){ .id = CANID_WHEEL_BUTTONS, .len = 1, .data = { (uint8_t)_buttons[found].button } };
+            } else {
+                char *id = strtok_r(NULL, " \t\r\n", &save);
+                if (id == NULL) {
+                    fprintf(stderr, "%s:%d: expected 'can <id> [bytes...]'.\n", path, line_no);
+                    goto error;
+                }
+                cmd->msg.id = (uint32_t)strtoul(id, NULL, 16);
+                cmd->msg.id_is_extended = cmd->msg.id > 0x7FF;
+                char *byte;
+                while ((byte = strtok_r(NULL, " \t\r\n", &save)) != NULL && cmd->msg.len < 8) {
+                    cmd->msg.data[cmd->msg.len++] = (uint8_t)strtoul(byte, NULL, 16);
+                }
+            }
+        } else if (strcmp(tok_cmd, "expect") == 0) {
+            char *name = strtok_r(NULL, " \t\r\n", &save);
+            char *min = strtok_r(NULL, " \t\r\n", &save);
+            char *max = strtok_r(NULL, " \t\r\n", &save);
+            cmd->kind = CMD_EXPECT;
+            cmd->target = name ? _find_observable(name) : -1;
+            if (cmd->target < 0 || min == NULL || max == NULL) {
+                fprintf(stderr, "%s:%d: expected 'expect <observable> <min> <max>'.\n", path, line_no);
+                goto error;
+            }
+            cmd->value = strtof(min, NULL);
+            cmd->value_max = strtof(max, NULL);
+        } else if (strcmp(tok_cmd, "end") == 0) {
+            cmd->kind = CMD_END;
+            cycle->end = t;
+            has_end = true;
+        } else {
+            fprintf(stderr, "%s:%d: unknown command '%s'.\n", path, line_no, tok_cmd);
+            goto error;
+        }
+    }
+
+    if (!has_end) {
+        cycle->end = last_t;
+    }
+    fclose(file);
+    return 0;
+
+error:
+    fclose(file);
+    return -1;
+}
+
+/* Per-signal keyframe cursor used to evaluate ramps. */
+typedef struct {
+    uint32_t t0; /* Time of the last keyframe (ms). */
+    float v0;    /* Value at the last keyframe. */
+    uint32_t t1; /* Time of the next keyframe, if it is a ramp. */
+    float v1;    /* Target of the next keyframe, if it is a ramp. */
+    bool ramping;
+} ramp_t;
+
+/* Records a keyframe for a signal, and looks ahead to see if the next one ramps away from it. */
+static void _keyframe(const cycle_t *cycle, size_t next, ramp_t *ramps, signal_t signal, uint32_t t, float value) {
+    ramp_t *ramp = &ramps[signal];
+    *ramp = (ramp_t){ .t0 = t, .v0 = value };
+    for (size_t i = next; i < cycle->count; i++) {
+        const command_t *cmd = &cycle->commands[i];
+        if ((cmd->kind == CMD_SET || cmd->kind == CMD_RAMP) && cmd->target == (int)signal) {
+            ramp->ramping = (cmd->kind == CMD_RAMP) && cmd->t > t;
+            ramp->t1 = cmd->t;
+            ramp->v1 = cmd->value;
+            return;
+        }
+    }
+}
+
+/* =================================== */
+/*                MAIN                 */
+/* =================================== */
+static void _usage(const char *argv0) {
+    fprintf(stderr,
+            "Usage: %s [<cycle>] [--replay <candump log> [--pedals <csv>]] [options]\n"
+            "  --replay <file>          Replay a candump log into the VCU instead of running the vehicle model.\n"
+            "  --pedals <file>          Replay a pedal ADC trace (t_ms,accel1,accel2,brake1,brake2).\n"
+            "  --trace <file>           Write every CAN frame/MQTT message the VCU emits (CSV).\n"
+            "  --golden <file>          Diff the emitted frames/messages against a previous trace.\n"
+            "  --capture-can <file>     Write every frame the VCU receives (candump log).\n"
+            "  --capture-pedals <file>  Write every pedal ADC reading the VCU uses (CSV).\n"
+            "  --budget-us <us>         Fail if the p99 control cycle (pedals_process) compute time exceeds this.\n"
+            "  --states <file>          Write the vehicle/controller state every tick (CSV).\n"
+            "  --verbose                Print the application's info and warning logs.\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    const char *cycle_path = NULL;
+    const char *trace_path = NULL;
+    const char *states_path = NULL;
+    const char *replay_path = NULL;
+    const char *pedals_path = NULL;
+    const char *golden_path = NULL;
+    const char *capture_can_path = NULL;
+    const char *capture_pedals_path = NULL;
+    double budget_us = 0.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--pedals") == 0 && i + 1 < argc) {
+            pedals_path = argv[++i];
+        } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            golden_path = argv[++i];
+        } else if (strcmp(argv[i], "--capture-can") == 0 && i + 1 < argc) {
+            capture_can_path = argv[++i];
+        } else if (strcmp(argv[i], "--capture-pedals") == 0 && i + 1 < argc) {
+            capture_pedals_path = argv[++i];
+        } else if (strcmp(argv[i], "--budget-us") == 0 && i + 1 < argc) {
+            budget_us = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--states") == 0 && i + 1 < argc) {
+            states_path = argv[++i];
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            setenv("SIL_VERBOSE", "1", 1);
+        } else if (argv[i][0] != '-' && cycle_path == NULL) {
+            cycle_path = argv[i];
+        } else {
+            _usage(argv[0]);
+            return 2;
+        }
+    }
+    if ((cycle_path == NULL && replay_path == NULL) || (pedals_path != NULL && replay_path == NULL)) {
+        _usage(argv[0]);
+        return 2;
+    }
+
+    cycle_t cycle = { 0 };
+    if (cycle_path != NULL && _parse_cycle(cycle_path, &cycle) != 0) {
+        return 2;
+    }
+    if (replay_path != NULL) {
+        if (sil_replay_load_can(replay_path) != 0 || (pedals_path != NULL && sil_replay_load_pedals(pedals_path) != 0)) {
+            return 2;
+        }
+        if (cycle_path == NULL || sil_replay_end() > cycle.end) {
+            cycle.end = sil_replay_end();
+        }
+    }
+
+    if ((trace_path != NULL || golden_path != NULL) && sil_recorder_open(trace_path) != 0) {
+        fprintf(stderr, "Failed to open trace file '%s'.\n", trace_path);
+        return 2;
+    }
+    if (sil_capture_open(capture_can_path, capture_pedals_path) != 0) {
+        fprintf(stderr, "Failed to open capture files.\n");
+        return 2;
+    }
+    FILE *states = NULL;
+    if (states_path != NULL) {
+        states = fopen(states_path, "w");
+        if (states == NULL) {
+            fprintf(stderr, "Failed to open states file '%s'.\n", states_path);
+            return 2;
+        }
+        fprintf(states, "t_ms,apps,brake,mph,slip,motor_torque,dc_current,dc_power,torque_scale,func_state\n");
+    }
+
+    sil_gpio_reset();
+    sil_vehicle_init();
+    sil_app_use_plant(replay_path == NULL);
+    if (replay_path != NULL) {
+        sil_sensors()->accel = (vector3_t){ .x = 0.0f, .y = 0.0f, .z = 1000.0f }; /* IMU at rest (mg). */
+    }
+    sil_app_init();
+
+    size_t next = 0;
+    int expectations = 0;
+    int failures = 0;
+    float top_mph = 0.0f;
+
+    /* Every signal starts with an implicit keyframe at t = 0 holding its initial value. */
+    ramp_t ramps[NUM_SIGNALS];
+    for (int s = 0; s < NUM_SIGNALS; s++) {
+        _keyframe(&cycle, 0, ramps, (signal_t)s, 0, _signal_get((signal_t)s));
+    }
+
+    double wall_start = sil_wall_time();
+    while (sil_clock_now() < cycle.end) {
+        uint32_t now = sil_clock_now() + 1; /* Commands apply to the tick about to run. */
+
+        /* Apply due commands (expectations are checked after the tick). */
+        size_t first_expect = next;
+        while (next < cycle.count && cycle.commands[next].t <= now) {
+            command_t *cmd = &cycle.commands[next++];
+            switch (cmd->kind) {
+                case CMD_SET:
+                case CMD_RAMP:
+                    /* A ramp has been interpolated up to here already, so both land exactly on the value. */
+                    _signal_set(cmd->target, cmd->value);
+                    _keyframe(&cycle, next, ramps, cmd->target, now, cmd->value);
+                    break;
+                case CMD_CAN:
+                    sil_can_inject(&cmd->msg);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        for (int s = 0; s < NUM_SIGNALS; s++) {
+            ramp_t *ramp = &ramps[s];
+            if (ramp->ramping) {
+                float frac = (float)(now - ramp->t0) / (float)(ramp->t1 - ramp->t0);
+                _signal_set((signal_t)s, ramp->v0 + frac * (ramp->v1 - ramp->v0));
+            }
+        }
+
+        if (replay_path != NULL) {
+            sil_replay_apply(now);
+        }
+
+        sil_app_tick();
+
+        for (size_t i = first_expect; i < next; i++) {
+            command_t *cmd = &cycle.commands[i];
+            if (cmd->kind != CMD_EXPECT) continue;
+            float value = _observables[cmd->target].read();
+            expectations++;
+            if (!(value >= cmd->value && value <= cmd->value_max)) { /* NAN fails. */
+                failures++;
+                printf("FAIL %s:%d: at %lu ms, %s = %g (expected [%g, %g])\n", cycle_path, cmd->line,
+                       (unsigned long)now, _observables[cmd->target].name, value, cmd->value, cmd->value_max);
+            }
+        }
+
+        float mph = sil_vehicle_mph();
+        if (mph > top_mph) top_mph = mph;
+        if (states != NULL) {
+            fprintf(states, "%lu,%.3f,%.3f,%.3f,%.4f,%.2f,%.2f,%.0f,%.4f,%d\n", (unsigned long)now, sil_sensors()->apps,
+                    sil_sensors()->brake, mph, sil_vehicle()->slip, sil_vehicle()->motor_torque,
+                    sil_vehicle()->dc_current, _obs_dc_power(), tc_get_torque_scale(), get_func_state());
+        }
+    }
+    double wall = sil_wall_time() - wall_start;
+    double sim = cycle.end / 1000.0;
+
+    /* Summary. */
+    const sil_recorder_stats_t *stats = sil_recorder_stats();
+    printf("SIL: %s\n", replay_path != NULL ? replay_path : cycle_path);
+    printf("  simulated %.3f s in %.3f s wall (%.0fx real time)\n", sim, wall, wall > 0 ? sim / wall : 0.0);
+    if (replay_path == NULL) {
+        printf("  distance %.1f m, top speed %.1f mph\n", sil_vehicle()->distance, top_mph);
+    }
+    printf("  emitted %lu CAN frames, %lu MQTT messages\n", (unsigned long)stats->total_frames, (unsigned long)stats->mqtt_messages);
+    if (stats->stream_datagrams > 0) {
+        printf("  TC stream: %lu samples in %lu datagrams, %lu dropped, %lu missing, %lu errors\n",
+               (unsigned long)stats->stream_samples, (unsigned long)stats->stream_datagrams,
+               (unsigned long)stats->stream_dropped, (unsigned long)stats->stream_gap, (unsigned long)stats->stream_errors);
+    }
+    for (uint16_t i = 0; i < stats->num_ids; i++) {
+        printf("    0x%03lX: %lu\n", (unsigned long)stats->frames[i].id, (unsigned long)stats->frames[i].count);
+    }
+    unsigned long drops = can_incoming._dropped + can_outgoing._dropped + faults._dropped + state_transition_queue._dropped + eth_manager._dropped;
+    if (drops) {
+        printf("  queue drops: %lu\n", drops);
+    }
+    printf("  expectations: %d/%d passed\n", expectations - failures, expectations);
+
+    /* Compute time. Host timings are only comparable between runs on the same machine. */
+    static const char *timing_names[SIL_NUM_TIMINGS] = { [SIL_TIMING_TICK] = "tick", [SIL_TIMING_PEDALS] = "control cycle",
+                                                           [SIL_TIMING_TC] = "traction control" };
+    for (int kind = 0; kind < SIL_NUM_TIMINGS; kind++) {
+        sil_timing_t timing = sil_app_timing((sil_timing_kind_t)kind);
+        printf("  %s compute: mean %.2f us, p50 %.2f us, p99 %.2f us, max %.2f us (%lu samples)\n", timing_names[kind],
+               timing.mean_us, timing.p50_us, timing.p99_us, timing.max_us, (unsigned long)timing.count);
+    }
+    if (budget_us > 0.0 && sil_app_timing(SIL_TIMING_PEDALS).p99_us > budget_us) {
+        printf("FAIL control cycle p99 compute time exceeds the %.2f us budget\n", budget_us);
+        failures++;
+    }
+
+    if (golden_path != NULL) {
+        int differences = sil_recorder_diff(golden_path, 10);
+        if (differences != 0) {
+            printf("FAIL output differs from %s (%d lines)\n", golden_path, differences);
+            failures++;
+        } else {
+            printf("  output matches %s\n", golden_path);
+        }
+    }
+
+    sil_capture_close();
+    sil_recorder_close();
+    if (states != NULL) fclose(states);
+    free(cycle.commands);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <string.h>
+#include "sil.h"
+
+/*
+*   Records everything the VCU emits (CAN frames, MQTT messages, TC debug stream datagrams), with the
+*   simulated timestamp, and optionally captures everything it consumes (received frames, pedal ADC
+*   readings) in the formats sil_replay.c reads back.
+*/
+
+static FILE *_trace = NULL;
+static FILE *_capture_can = NULL;
+static FILE *_capture_pedals = NULL;
+static sil_recorder_stats_t _stats;
+
+int sil_recorder_open(const char *path) {
+    _trace = (path != NULL) ? fopen(path, "w+") : tmpfile();
+    if (_trace == NULL) {
+        return -1;
+    }
+    fprintf(_trace, "t_ms,kind,id,len,payload\n");
+    return 0;
+}
+
+void sil_recorder_close(void) {
+    if (_trace != NULL) {
+        fclose(_trace);
+        _trace = NULL;
+    }
+}
+
+static void _count(uint32_t id) {
+    _stats.total_frames++;
+    for (uint16_t i = 0; i < _stats.num_ids; i++) {
+        if (_stats.frames[i].id == id) {
+            _stats.frames[i].count++;
+            return;
+        }
+    }
+    if (_stats.num_ids < SIL_MAX_TRACKED_IDS) {
+        _stats.frames[_stats.num_ids++] = (sil_frame_count_t){ .id = id, .count = 1 };
+    }
+}
+
+void sil_recorder_can(const can_msg_t *msg) {
+    _count(msg->id);
+    if (_trace == NULL) {
+        return;
+    }
+
+    fprintf(_trace, "%lu,can,0x%lX,%u,", (unsigned long)sil_clock_now(), (unsigned long)msg->id, msg->len);
+    for (uint8_t i = 0; i < msg->len && i < 8; i++) {
+        fprintf(_trace, "%02X", msg->data[i]);
+    }
+    fputc('\n', _trace);
+}
+
+void sil_recorder_mqtt(const ethernet_mqtt_message_t *msg) {
+    _stats.mqtt_messages++;
+    if (_trace == NULL) {
+        return;
+    }
+
+    fprintf(_trace, "%lu,mqtt,%s,%u,", (unsigned long)sil_clock_now(), msg->topic, msg->msg.values_count);
+    for (uint8_t i = 0; i < msg->msg.values_count; i++) {
+        fprintf(_trace, "%s%.6g", i ? " " : "", msg->msg.values[i]);
+    }
+    fputc('\n', _trace);
+}
+
+void sil_recorder_udp(const uint8_t *data, uint16_t size) {
+    static uint32_t next_datagram, next_seq;
+    tc_stream_header_t header;
+    if (size < sizeof(header)) {
+        _stats.stream_errors++;
+        return;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != TC_STREAM_MAGIC || header.version != TC_STREAM_VERSION || header.count == 0 ||
+        size != sizeof(header) + header.count * sizeof(tc_stream_sample_t)) {
+        _stats.stream_errors++;
+        return;
+    }
+
+    /* Every sample missing since the last datagram must be accounted for in the drop count, and no
+     * datagram may be missing. */
+    uint32_t gap = header.first_seq - next_seq;
+    if (header.datagram_seq != next_datagram || gap != header.dropped - _stats.stream_dropped) {
+        _stats.stream_errors++;
+    }
+    next_datagram = header.datagram_seq + 1;
+    next_seq = header.first_seq + header.count;
+    _stats.stream_datagrams++;
+    _stats.stream_samples += header.count;
+    _stats.stream_gap += gap;
+    _stats.stream_dropped = header.dropped;
+    memcpy(&_stats.stream_last, data + sizeof(header) + (header.count - 1) * sizeof(tc_stream_sample_t),
+           sizeof(tc_stream_sample_t));
+
+    if (_trace != NULL) {
+        fprintf(_trace, "%lu,udp,%lu,%u,%lu\n", (unsigned long)sil_clock_now(), (unsigned long)header.first_seq,
+                header.count, (unsigned long)header.dropped);
+    }
+}
+
+const sil_recorder_stats_t *sil_recorder_stats(void) {
+    return &_stats;
+}
+
+/* Reads one line, dropping the line ending. Returns false at the end of the file. */
+static bool _read_line(FILE *file, char *line, size_t size) {
+    if (fgets(line, (int)size, file) == NULL) {
+        return false;
+    }
+    line[strcspn(line, "\r\n")] = '\0';
+    return true;
+}
+
+int sil_recorder_diff(const char *golden_path, int max_report) {
+    if (_trace == NULL) {
+        return -1;
+    }
+    FILE *golden = fopen(golden_path, "r");
+    if (golden == NULL) {
+        fprintf(stderr, "Failed to open golden trace '%s'.\n", golden_path);
+        return -1;
+    }
+
+    fflush(_trace);
+    rewind(_trace);
+
+    char actual[512];
+    char expected[512];
+    int differences = 0;
+    for (int line = 1;; line++) {
+        bool has_actual = _read_line(_trace, actual, sizeof(actual));
+        bool has_expected = _read_line(golden, expected, sizeof(expected));
+        if (!has_actual && !has_expected) {
+            break;
+        }
+        if (has_actual && has_expected && strcmp(actual, expected) == 0) {
+            continue;
+        }
+
+        if (differences++ < max_report) {
+            printf("  line %d:\n    golden: %s\n    actual: %s\n", line, has_expected ? expected : "<end of trace>",
+                   has_actual ? actual : "<end of trace>");
+        }
+    }
+
+    fclose(golden);
+    fseek(_trace, 0, SEEK_END);
+    return differences;
+}
+
+int sil_capture_open(const char *can_path, const char *pedals_path) {
+    if (can_path != NULL && (_capture_can = fopen(can_path, "w")) == NULL) {
+        return -1;
+    }
+    if (pedals_path != NULL) {
+        if ((_capture_pedals = fopen(pedals_path, "w")) == NULL) {
+            return -1;
+        }
+        fprintf(_capture_pedals, "t_ms,accel1,accel2,brake1,brake2\n");
+    }
+    return 0;
+}
+
+void sil_capture_close(void) {
+    if (_capture_can != NULL) {
+        fclose(_capture_can);
+        _capture_can = NULL;
+    }
+    if (_capture_pedals != NULL) {
+        fclose(_capture_pedals);
+        _capture_pedals = NULL;
+    }
+}
+
+void sil_capture_can(const can_msg_t *msg) {
+    if (_capture_can == NULL) {
+        return;
+    }
+
+    /* candump log format. */
+    uint32_t now = sil_clock_now();
+    fprintf(_capture_can, "(%lu.%06lu) sil0 ", (unsigned long)(now / 1000), (unsigned long)(now % 1000) * 1000);
+    fprintf(_capture_can, msg->id_is_extended ? "%08lX#" : "%03lX#", (unsigned long)msg->id);
+    for (uint8_t i = 0; i < msg->len && i < 8; i++) {
+        fprintf(_capture_can, "%02X", msg->data[i]);
+    }
+    fputc('\n', _capture_can);
+}
+
+void sil_capture_pedals(const raw_pedal_adc_t *adc) {
+    if (_capture_pedals == NULL) {
+        return;
+    }
+    fprintf(_capture_pedals, "%lu,%u,%u,%u,%u\n", (unsigned long)sil_clock_now(), adc->data[PEDAL_ACCEL1],
+            adc->data[PEDAL_ACCEL2], adc->data[PEDAL_BRAKE1], adc->data[PEDAL_BRAKE2]);
+}
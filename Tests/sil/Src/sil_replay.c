@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sil.h"
+
+/* Open loop replay of a recorded bus log and pedal ADC trace. See sil.h for the file formats. */
+
+typedef struct {
+    uint32_t t;
+    can_msg_t msg;
+} replay_frame_t;
+
+typedef struct {
+    uint32_t t;
+    raw_pedal_adc_t adc;
+} replay_pedals_t;
+
+static replay_frame_t *_frames = NULL;
+static size_t _num_frames = 0;
+static size_t _next_frame = 0;
+
+static replay_pedals_t *_pedals = NULL;
+static size_t _num_pedals = 0;
+static size_t _next_pedals = 0;
+
+static uint32_t _end = 0;
+
+/* Grows a dynamic array by one element. Returns NULL if out of memory. */
+static void *_grow(void **array, size_t *count, size_t *capacity, size_t element_size) {
+    if (*count == *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 1024;
+        void *grown = realloc(*array, new_capacity * element_size);
+        if (grown == NULL) {
+            return NULL;
+        }
+        *array = grown;
+        *capacity = new_capacity;
+    }
+    return (uint8_t *)*array + (*count)++ * element_size;
+}
+
+/* Parses "<id>#<hex data>". Returns false if the frame is malformed (or a CAN FD/remote frame). */
+static bool _parse_frame(const char *text, can_msg_t *msg) {
+    const char *hash = strchr(text, '#');
+    if (hash == NULL || hash == text || hash[1] == '#' || hash[1] == 'R') {
+        return false;
+    }
+
+    char *end;
+    msg->id = (uint32_t)strtoul(text, &end, 16);
+    if (end != hash) {
+        return false;
+    }
+    msg->id_is_extended = (hash - text) > 3; /* candump prints extended IDs with 8 digits. */
+
+    msg->len = 0;
+    for (const char *c = hash + 1; c[0] != '\0' && c[1] != '\0' && msg->len < 8; c += 2) {
+        char byte[3] = { c[0], c[1], '\0' };
+        msg->data[msg->len++] = (uint8_t)strtoul(byte, &end, 16);
+        if (*end != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+int sil_replay_load_can(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open CAN log '%s'.\n", path);
+        return -1;
+    }
+
+    size_t capacity = 0;
+    bool have_base = false;
+    unsigned long long base = 0;
+    char line[256];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_no++;
+        unsigned long long seconds;
+        unsigned long micros;
+        char iface[32];
+        char frame[64];
+        if (line[0] == '\n' || line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, " (%llu.%lu) %31s %63s", &seconds, &micros, iface, frame) != 4) {
+            fprintf(stderr, "%s:%d: expected '(<seconds>) <iface> <id>#<data>'.\n", path, line_no);
+            goto error;
+        }
+
+        /* Timestamps are relative to the whole second the log starts in. */
+        if (!have_base) {
+            base = seconds;
+            have_base = true;
+        }
+        if (seconds < base) {
+            fprintf(stderr, "%s:%d: timestamps must not go backwards.\n", path, line_no);
+            goto error;
+        }
+
+        replay_frame_t *entry = _grow((void **)&_frames, &_num_frames, &capacity, sizeof(replay_frame_t));
+        if (entry == NULL) {
+            fprintf(stderr, "Out of memory loading '%s'.\n", path);
+            goto error;
+        }
+        memset(entry, 0, sizeof(*entry));
+        entry->t = (uint32_t)((seconds - base) * 1000ULL + micros / 1000UL);
+        if (!_parse_frame(frame, &entry->msg)) {
+            fprintf(stderr, "%s:%d: malformed frame '%s'.\n", path, line_no, frame);
+            goto error;
+        }
+        if (_num_frames > 1 && entry->t < _frames[_num_frames - 2].t) {
+            fprintf(stderr, "%s:%d: timestamps must not go backwards.\n", path, line_no);
+            goto error;
+        }
+        if (entry->t > _end) {
+            _end = entry->t;
+        }
+    }
+
+    fclose(file);
+    return 0;
+
+error:
+    fclose(file);
+    return -1;
+}
+
+int sil_replay_load_pedals(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open pedal trace '%s'.\n", path);
+        return -1;
+    }
+
+    size_t capacity = 0;
+    char line[256];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_no++;
+        if (line_no == 1 || line[0] == '\n') {
+            continue; /* Header. */
+        }
+
+        unsigned long t;
+        unsigned int raw[NUM_PEDALS];
+        if (sscanf(line, "%lu,%u,%u,%u,%u", &t, &raw[PEDAL_ACCEL1], &raw[PEDAL_ACCEL2], &raw[PEDAL_BRAKE1], &raw[PEDAL_BRAKE2]) != 5) {
+            fprintf(stderr, "%s:%d: expected 't_ms,accel1,accel2,brake1,brake2'.\n", path, line_no);
+            goto error;
+        }
+        if (_num_pedals > 0 && t < _pedals[_num_pedals - 1].t) {
+            fprintf(stderr, "%s:%d: timestamps must not go backwards.\n", path, line_no);
+            goto error;
+        }
+
+        replay_pedals_t *entry = _grow((void **)&_pedals, &_num_pedals, &capacity, sizeof(replay_pedals_t));
+        if (entry == NULL) {
+            fprintf(stderr, "Out of memory loading '%s'.\n", path);
+            goto error;
+        }
+        entry->t = (uint32_t)t;
+        for (int i = 0; i < NUM_PEDALS; i++) {
+            entry->adc.data[i] = (uint16_t)raw[i];
+        }
+        if (entry->t > _end) {
+            _end = entry->t;
+        }
+    }
+
+    fclose(file);
+    return 0;
+
+error:
+    fclose(file);
+    return -1;
+}
+
+void sil_replay_apply(uint32_t tick) {
+    while (_next_frame < _num_frames && _frames[_next_frame].t <= tick) {
+        sil_can_inject(&_frames[_next_frame++].msg);
+    }
+
+    bool updated = false;
+    while (_next_pedals < _num_pedals && _pedals[_next_pedals].t <= tick) {
+        sil_sensors()->pedal_adc = _pedals[_next_pedals++].adc;
+        updated = true;
+    }
+    if (updated) {
+        sil_sensors()->replay_pedals = true;
+    }
+}
+
+uint32_t sil_replay_end(void) {
+    return _end;
+}
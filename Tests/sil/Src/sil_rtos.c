@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sil.h"
+#include "tx_api.h"
+#include "u_tx_debug.h"
+#include "u_tx_queues.h"
+#include "u_tx_timers.h"
+#include "u_tx_mutex.h"
+#include "u_time.h"
+
+/* Simulated ThreadX kernel: a 1 kHz tick counter, software timers and non-blocking queues. */
+
+static uint32_t _tick = 0;
+static int32_t _offset_us = 0; /* See sil_clock_set_offset_us(). */
+static timer_t *_timers = NULL; /* Every timer passed to timer_init(). */
+
+/* Fires every active timer whose expiry is at or before the current tick. */
+static void _service_timers(void) {
+    for (timer_t *timer = _timers; timer != NULL; timer = timer->_next) {
+        if (!timer->_active || timer->_expiry > _tick) {
+            continue;
+        }
+
+        if (timer->type == PERIODIC) {
+            timer->_expiry += timer->duration;
+        } else {
+            timer->_active = false;
+        }
+
+        /* The callback may restart this timer, so state is updated before calling it. */
+        timer->callback(timer->callback_input);
+    }
+}
+
+uint32_t sil_clock_now(void) {
+    return _tick;
+}
+
+void sil_clock_advance(uint32_t ticks) {
+    for (uint32_t i = 0; i < ticks; i++) {
+        _tick++;
+        _service_timers();
+    }
+}
+
+void sil_clock_set_offset_us(int32_t offset_us) {
+    _offset_us = offset_us;
+}
+
+/* Monotonic time base (u_time.c). The DWT counter is replaced by the simulated clock. */
+#define SIL_CORE_MHZ 250
+
+void time_init(void) {}
+void time_tickCallback(void) {}
+
+uint64_t time_getMicros(void) {
+    return (uint64_t)((int64_t)_tick * 1000 + _offset_us);
+}
+
+uint64_t time_getCycles(void) {
+    return time_getMicros() * SIL_CORE_MHZ;
+}
+
+float time_getElapsedSeconds(uint64_t *since) {
+    uint64_t now = time_getMicros();
+    float elapsed = (*since == 0 || now < *since) ? 0.0f : (now - *since) / 1000000.0f;
+    *since = now;
+    return elapsed;
+}
+
+/* ThreadX services. */
+UINT tx_thread_sleep(ULONG timer_ticks) {
+    sil_clock_advance(timer_ticks);
+    return TX_SUCCESS;
+}
+
+ULONG tx_time_get(void) {
+    return _tick;
+}
+
+/* HAL time base. The HAL tick and the ThreadX tick are both 1 ms on the VCU. */
+uint32_t HAL_GetTick(void) {
+    return _tick;
+}
+
+void HAL_Delay(uint32_t Delay) {
+    sil_clock_advance(Delay);
+}
+
+/* Timers. */
+int timer_init(timer_t *timer) {
+    if (timer == NULL || timer->callback == NULL || timer->duration == 0) {
+        return U_ERROR;
+    }
+
+    /* Only link the timer once, even if a module re-initializes it. */
+    bool linked = false;
+    for (timer_t *t = _timers; t != NULL; t = t->_next) {
+        if (t == timer) {
+            linked = true;
+            break;
+        }
+    }
+    if (!linked) {
+        timer->_next = _timers;
+        _timers = timer;
+    }
+
+    timer->_active = false;
+    if (timer->auto_activate) {
+        return timer_start(timer);
+    }
+    return U_SUCCESS;
+}
+
+int timer_start(timer_t *timer) {
+    if (!timer->_active) {
+        timer->_active = true;
+        timer->_expiry = _tick + timer->duration;
+    }
+    return U_SUCCESS;
+}
+
+int timer_stop(timer_t *timer) {
+    timer->_active = false;
+    return U_SUCCESS;
+}
+
+int timer_reset(timer_t *timer) {
+    timer->_active = false;
+    timer->_expiry = _tick + timer->duration;
+    return U_SUCCESS;
+}
+
+int timer_restart(timer_t *timer) {
+    timer->_active = true;
+    timer->_expiry = _tick + timer->duration;
+    return U_SUCCESS;
+}
+
+int timer_isActive(timer_t *timer, bool *active) {
+    *active = timer->_active;
+    return U_SUCCESS;
+}
+
+/* Queues. */
+uint8_t create_queue(TX_BYTE_POOL *byte_pool, queue_t *queue) {
+    (void)byte_pool;
+    free(queue->_storage);
+    queue->_storage = calloc(queue->capacity, queue->message_size);
+    if (queue->_storage == NULL) {
+        return U_ERROR;
+    }
+    queue->_head = 0;
+    queue->_count = 0;
+    queue->_dropped = 0;
+    return U_SUCCESS;
+}
+
+uint8_t queue_send(queue_t *queue, void *message, UINT wait_time) {
+    (void)wait_time; // Nothing else can drain the queue while we wait, so a full queue is always an error.
+    if (queue->_storage == NULL || queue->_count >= queue->capacity) {
+        queue->_dropped++;
+        return U_ERROR;
+    }
+
+    UINT tail = (queue->_head + queue->_count) % queue->capacity;
+    memcpy(queue->_storage + (size_t)tail * queue->message_size, message, queue->message_size);
+    queue->_count++;
+    return U_SUCCESS;
+}
+
+uint8_t queue_receive(queue_t *queue, void *message, UINT wait_time) {
+    (void)wait_time;
+    if (queue->_storage == NULL || queue->_count == 0) {
+        return U_ERROR;
+    }
+
+    memcpy(message, queue->_storage + (size_t)queue->_head * queue->message_size, queue->message_size);
+    queue->_head = (queue->_head + 1) % queue->capacity;
+    queue->_count--;
+    return U_SUCCESS;
+}
+
+/* Mutexes. */
+uint8_t create_mutex(mutex_t *mutex) {
+    mutex->_owned = 0;
+    return U_SUCCESS;
+}
+
+uint8_t mutex_get(mutex_t *mutex) {
+    mutex->_owned++;
+    return U_SUCCESS;
+}
+
+uint8_t mutex_put(mutex_t *mutex) {
+    if (mutex->_owned == 0) {
+        return U_ERROR;
+    }
+    mutex->_owned--;
+    return U_SUCCESS;
+}
@@ -0,0 +1,216 @@
+#include "sil.h"
+#include "u_tx_debug.h"
+#include "u_adc.h"
+#include "u_pedals.h"
+#include "u_calibration.h"
+#include "u_peripherals.h"
+#include "u_imu_fifo.h"
+#include "u_time.h"
+#include <math.h>
+
+/* Simulated ADC and IMU drivers. They stand in for u_adc.c and u_peripherals.c, and read from sil_sensors(). */
+
+#define APPS_DIVIDER  (3000.0f / (2000.0f + 3000.0f)) /* 2k + 3k divider on the pedal lines. */
+#define BRAKE_V_MIN   0.5f                           /* (Volts). Brake sensor output at rest. */
+#define BRAKE_V_MAX   4.5f                           /* (Volts). Brake sensor output at full pressure. */
+
+static sil_sensors_t _sensors = {
+    .imu_ok = true,
+    .orientation = { .w = 1.0f },
+    .gravity = { .z = 1000.0f }, /* The vehicle model is flat, and never pitches. */
+    .apps1_volts = -1.0f,
+};
+
+/* ADC2's analog watchdogs. Each tick compares the pedal lines against the same windows u_adc.c programs, as the
+ * hardware does on every conversion. AWD2/3's 8-bit resolution isn't modelled. */
+static const struct {
+    uint8_t pedals[2];
+    uint8_t count;
+} _watchdog_pedals[NUM_PEDAL_WATCHDOGS] = {
+    [PEDAL_WATCHDOG_APPS1] = { { PEDAL_ACCEL1 }, 1 },
+    [PEDAL_WATCHDOG_APPS2] = { { PEDAL_ACCEL2 }, 1 },
+    [PEDAL_WATCHDOG_BRAKE] = { { PEDAL_BRAKE1, PEDAL_BRAKE2 }, 2 },
+};
+static bool _watchdog_armed[NUM_PEDAL_WATCHDOGS] = { true, true, true };
+static bool _watchdog_tripped[NUM_PEDAL_WATCHDOGS];
+static uint32_t _watchdog_tick[NUM_PEDAL_WATCHDOGS];
+
+/* The IMU's hardware FIFO. Samples are batched into it as tagged words, and drained through the firmware's
+ * FIFO parser and ring (u_imu_fifo.c) at the watermark, as u_peripherals.c does on the car. */
+static uint8_t _fifo[IMU_FIFO_BURST_MAX * IMU_FIFO_WORD_SIZE];
+static uint16_t _fifo_words = 0;
+static uint8_t _fifo_counter = 0;
+static uint32_t _fifo_sflp_phase = 0; /* Accumulates IMU_FIFO_SFLP_HZ per sample; the SFLP batches every IMU_FIFO_ODR_HZ. */
+
+sil_sensors_t *sil_sensors(void) {
+    return &_sensors;
+}
+
+/* Rounds and clamps a reading to the ADC's 12 bits. */
+static uint16_t _to_adc(float adc) {
+    if (adc < 0.0f) adc = 0.0f;
+    if (adc > 4095.0f) adc = 4095.0f;
+    return (uint16_t)(adc + 0.5f);
+}
+
+/* Converts a sensor voltage (before the divider) into the 12-bit reading u_pedals.c expects. */
+static uint16_t _volts_to_adc(float volts) {
+    return _to_adc(volts * APPS_DIVIDER / MAX_VOLTS * MAX_ADC_VAL_12b);
+}
+
+static float _clamp01(float x) {
+    return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+/* What the pedal lines read right now. */
+static raw_pedal_adc_t _pedal_raw(void) {
+    if (_sensors.replay_pedals) {
+        return _sensors.pedal_adc;
+    }
+
+    float apps = _clamp01(_sensors.apps);
+    float brake = _clamp01(_sensors.brake);
+
+    /* The APPS sensors read what the board's calibration expects for the travel. */
+    raw_pedal_adc_t raw = { 0 };
+    raw.data[PEDAL_ACCEL1] = (_sensors.apps1_volts >= 0.0f) ? _volts_to_adc(_sensors.apps1_volts) : _to_adc(calibration_toRaw(CAL_APPS_1, apps));
+    raw.data[PEDAL_ACCEL2] = _to_adc(calibration_toRaw(CAL_APPS_2, apps));
+    raw.data[PEDAL_BRAKE1] = _volts_to_adc(BRAKE_V_MIN + brake * (BRAKE_V_MAX - BRAKE_V_MIN));
+    raw.data[PEDAL_BRAKE2] = _volts_to_adc(BRAKE_V_MIN + brake * (BRAKE_V_MAX - BRAKE_V_MIN));
+    return raw;
+}
+
+raw_pedal_adc_t adc_getPedalData(void) {
+    _sensors.pedal_adc = _pedal_raw();
+    return _sensors.pedal_adc;
+}
+
+void sil_sensors_adc_step(void) {
+    const uint16_t windows[NUM_PEDAL_WATCHDOGS][2] = {
+        [PEDAL_WATCHDOG_APPS1] = { PEDAL_VOLTS_TO_ADC(APPS1_FAULT_LOW), PEDAL_VOLTS_TO_ADC(APPS1_FAULT_HIGH) },
+        [PEDAL_WATCHDOG_APPS2] = { PEDAL_VOLTS_TO_ADC(APPS2_FAULT_LOW), PEDAL_VOLTS_TO_ADC(APPS2_FAULT_HIGH) },
+        [PEDAL_WATCHDOG_BRAKE] = { PEDAL_VOLTS_TO_ADC(BRAKE_FAULT_LOW), PEDAL_VOLTS_TO_ADC(BRAKE_FAULT_HIGH) },
+    };
+
+    raw_pedal_adc_t raw = _pedal_raw();
+    for (int i = 0; i < NUM_PEDAL_WATCHDOGS; i++) {
+        if (!_watchdog_armed[i]) {
+            continue;
+        }
+        for (int p = 0; p < _watchdog_pedals[i].count; p++) {
+            uint16_t value = raw.data[_watchdog_pedals[i].pedals[p]];
+            if (value < windows[i][0] || value > windows[i][1]) {
+                _watchdog_armed[i] = false;
+                _watchdog_tripped[i] = true;
+                _watchdog_tick[i] = sil_clock_now();
+                break;
+            }
+        }
+    }
+}
+
+bool adc_takePedalWatchdog(pedal_watchdog_t watchdog, uint32_t *tick) {
+    bool tripped = _watchdog_tripped[watchdog];
+    *tick = _watchdog_tick[watchdog];
+    _watchdog_tripped[watchdog] = false;
+    return tripped;
+}
+
+void adc_rearmPedalWatchdog(pedal_watchdog_t watchdog) {
+    _watchdog_armed[watchdog] = true;
+}
+
+raw_efuse_adc_t adc_getEFuseData(void) {
+    return (raw_efuse_adc_t){ 0 };
+}
+
+int imu_getAcceleration(vector3_t *data) {
+    if (!_sensors.imu_ok) {
+        return U_ERROR;
+    }
+    *data = _sensors.accel;
+    return U_SUCCESS;
+}
+
+int imu_getAngularRate(vector3_t *data) {
+    if (!_sensors.imu_ok) {
+        return U_ERROR;
+    }
+    *data = _sensors.gyro;
+    return U_SUCCESS;
+}
+
+/* Converts a reading to the IMU's 16-bit output, saturating at full scale. */
+static int16_t _to_lsb(float value, float scale) {
+    float lsb = value / scale;
+    if (lsb > 32767.0f) lsb = 32767.0f;
+    if (lsb < -32768.0f) lsb = -32768.0f;
+    return (int16_t)(lsb + (lsb < 0.0f ? -0.5f : 0.5f));
+}
+
+/* Converts to an IEEE 754 half-precision float, as the SFLP reports its quaternions. Only handles |value| <= 1. */
+static int16_t _to_half(float value) {
+    uint16_t sign = (value < 0.0f) ? 0x8000 : 0;
+    float magnitude = fabsf(value);
+    if (magnitude < 6.103515625e-05f) {
+        return (int16_t)(sign | (uint16_t)lrintf(magnitude * 16777216.0f)); /* Subnormal: 2^-24 per LSB. */
+    }
+    int exponent;
+    float fraction = frexpf(magnitude, &exponent); /* magnitude = fraction * 2^exponent, fraction in [0.5, 1). */
+    uint32_t mantissa = (uint32_t)lrintf((fraction * 2.0f - 1.0f) * 1024.0f);
+    if (mantissa == 1024) {
+        mantissa = 0;
+        exponent++;
+    }
+    return (int16_t)(sign | (uint16_t)((exponent + 14) << 10) | (uint16_t)mantissa);
+}
+
+/* Appends one tagged word to the FIFO. */
+static void _fifo_push_raw(lsm6dsv_fifo_tag_t tag, const int16_t axes[3]) {
+    uint8_t *word = &_fifo[_fifo_words++ * IMU_FIFO_WORD_SIZE];
+    word[0] = (uint8_t)((tag << 3) | (_fifo_counter << 1));
+    for (int axis = 0; axis < 3; axis++) {
+        word[1 + 2 * axis] = (uint8_t)(axes[axis] & 0xFF);
+        word[2 + 2 * axis] = (uint8_t)((uint16_t)axes[axis] >> 8);
+    }
+}
+
+static void _fifo_push(lsm6dsv_fifo_tag_t tag, const vector3_t *value, float scale) {
+    int16_t axes[3] = { _to_lsb(value->x, scale), _to_lsb(value->y, scale), _to_lsb(value->z, scale) };
+    _fifo_push_raw(tag, axes);
+}
+
+bool sil_sensors_imu_batch(void) {
+    if (!_sensors.imu_ok) {
+        return false;
+    }
+
+    /* The IMU writes the gyroscope word of each period first. Same scales as lsm6dsv_from_fs2000_to_mdps() and lsm6dsv_from_fs2_to_mg(). */
+    _fifo_push(LSM6DSV_GY_NC_TAG, &_sensors.gyro, 70.0f);
+    _fifo_push(LSM6DSV_XL_NC_TAG, &_sensors.accel, 0.061f);
+
+    /* The SFLP's words, at its own rate. The IMU only sends the quaternion's x, y and z, with w made positive. Same scale as lsm6dsv_from_sflp_to_mg(). */
+    _fifo_sflp_phase += IMU_FIFO_SFLP_HZ;
+    if (_fifo_sflp_phase >= IMU_FIFO_ODR_HZ) {
+        _fifo_sflp_phase -= IMU_FIFO_ODR_HZ;
+        const quaternion_t *q = &_sensors.orientation;
+        float sign = (q->w < 0.0f) ? -1.0f : 1.0f;
+        int16_t quaternion[3] = { _to_half(sign * q->x), _to_half(sign * q->y), _to_half(sign * q->z) };
+        _fifo_push_raw(LSM6DSV_SFLP_GAME_ROTATION_VECTOR_TAG, quaternion);
+        _fifo_push(LSM6DSV_SFLP_GRAVITY_VECTOR_TAG, &_sensors.gravity, 0.061f);
+    }
+    _fifo_counter = (_fifo_counter + 1) & 0x3;
+
+    if (_fifo_words < IMU_FIFO_WATERMARK_WORDS) {
+        return false;
+    }
+    imu_fifo_parse(_fifo, _fifo_words, time_getMicros(), IMU_FIFO_ANCHOR_NEWEST);
+    _fifo_words = 0;
+    return true;
+}
+
+/* The SIL drains the FIFO itself (see sil_app.c), so there is never anything to wait for. */
+int imu_waitForSample(imu_sample_t *sample, uint32_t timeout) {
+    (void)timeout;
+    return imu_fifo_pop(sample) ? U_SUCCESS : U_ERROR;
+}
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "sil.h"
+
+/*
+*   Host benchmark and accuracy check for the traction control tire curve lookup.
+*
+*   u_tc.c is compiled into this file so its static lookups can be called directly. The uniform grid
+*   built by tc_init() is checked against the original piecewise curve across (and past) the curve's
+*   slip range, then both lookups are timed over the same random slips. Finally a curve is selected
+*   from the bank and swapped in, and a curve is uploaded (as over the network) and persisted.
+*
+*       sil_tc_bench [--samples <n>] [--tolerance <fx>]
+*
+*   Fails if the grid differs from the piecewise curve by more than the tolerance (normalized force).
+*/
+
+#include "../../../Core/Src/u_tc.c"
+
+#define BENCH_SAMPLES   1000000
+#define BENCH_TOLERANCE 0.005f /* Normalized force. */
+#define BENCH_MARGIN    0.05f  /* Slip checked past each end of the curve. */
+
+/* The rest of the application, as far as u_tc.c is concerned. */
+uint32_t sil_clock_now(void) { return 0; }
+uint32_t HAL_GetTick(void) { return 0; }
+uint64_t time_getMicros(void) { return 0; }
+int32_t dti_get_rpm(void) { return 0; }
+
+void sil_log(sil_log_level_t level, const char *file, int line, const char *format, ...) {
+    (void)level;
+    (void)file;
+    (void)line;
+    (void)format;
+}
+
+/* Normalization the grid applies to the curve. */
+static float _fx_scale(const tire_curve_t *curve) {
+    float fx_peak = 0.0f;
+    for (uint16_t i = 0; i < curve->num_points; i++) {
+        fx_peak = MAX(fx_peak, curve->points[i].fx_norm);
+    }
+    return (fx_peak > 1.0f) ? 1.0f / fx_peak : 1.0f;
+}
+
+int main(int argc, char **argv) {
+    long samples = BENCH_SAMPLES;
+    float tolerance = BENCH_TOLERANCE;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = strtof(argv[++i], NULL);
+        } else {
+            fprintf(stderr, "usage: %s [--samples <n>] [--tolerance <fx>]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (samples < 1) {
+        samples = 1;
+    }
+
+    tc_init();
+    if (!(_tc_state.curve_state & TC_CURVE_LOADED)) {
+        fprintf(stderr, "Tire curve failed to load.\n");
+        return 1;
+    }
+
+    const tc_curve_set_t *set = &_curve_sets[_tc_state.curve_state & TC_CURVE_ACTIVE];
+    const tire_curve_t *curve = &set->curve;
+    const tc_grid_t *grid = &set->grid;
+    float scale = _fx_scale(curve);
+    float slip_lo = curve->points[0].slip_ratio - BENCH_MARGIN;
+    float slip_hi = curve->points[curve->num_points - 1].slip_ratio + BENCH_MARGIN;
+
+    float *slips = malloc(samples * sizeof(float));
+    if (slips == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        return 2;
+    }
+    srand(1);
+    for (long i = 0; i < samples; i++) {
+        slips[i] = slip_lo + (slip_hi - slip_lo) * ((float)rand() / (float)RAND_MAX);
+    }
+
+    /* Accuracy: random slips, plus every breakpoint of the original curve. */
+    double max_error = 0.0, sum_sq = 0.0;
+    float worst_slip = 0.0f;
+    long checked = 0;
+    for (long i = 0; i < samples + curve->num_points; i++) {
+        float slip = (i < samples) ? slips[i] : curve->points[i - samples].slip_ratio;
+        double error = fabs(_lookup_fx(grid, slip) - _lookup_fx_piecewise(curve, slip) * scale);
+        sum_sq += error * error;
+        checked++;
+        if (error > max_error) {
+            max_error = error;
+            worst_slip = slip;
+        }
+    }
+
+    /* Timing: the same slips through both lookups. */
+    volatile float sink = 0.0f;
+    uint64_t start = sil_wall_ns();
+    for (long i = 0; i < samples; i++) {
+        sink += _lookup_fx_piecewise(curve, slips[i]);
+    }
+    double piecewise_ns = (double)(sil_wall_ns() - start) / samples;
+
+    start = sil_wall_ns();
+    for (long i = 0; i < samples; i++) {
+        sink += _lookup_fx(grid, slips[i]);
+    }
+    double grid_ns = (double)(sil_wall_ns() - start) / samples;
+    (void)sink;
+    free(slips);
+
+    printf("Tire curve '%.16s': %u points, slip %.3f to %.3f, resampled to %d grid points.\n", curve->surface_id,
+           curve->num_points, curve->points[0].slip_ratio, curve->points[curve->num_points - 1].slip_ratio,
+           TC_GRID_POINTS);
+    printf("  accuracy: max error %.6f at slip %.4f, rms %.6f (%ld lookups, tolerance %.6f)\n", max_error, worst_slip,
+           sqrt(sum_sq / checked), checked, tolerance);
+    printf("  piecewise (binary search): %.2f ns/lookup\n", piecewise_ns);
+    printf("  uniform grid:              %.2f ns/lookup (%.1fx)\n", grid_ns, piecewise_ns / grid_ns);
+    printf("  peak slip %.4f (peak_lambda %.4f)\n", set->peak_slip, curve->peak_lambda);
+
+    if (max_error > tolerance) {
+        printf("FAIL: grid lookup is outside the tolerance.\n");
+        return 1;
+    }
+
+    /* Curve selection: unknown curves are rejected, a new selection replaces a pending one, and a
+     * selection is only swapped in by tc_process(). */
+    char surface_id[TC_SURFACE_ID_SIZE + 1] = { 0 };
+    memcpy(surface_id, curve->surface_id, TC_SURFACE_ID_SIZE);
+    uint8_t before = _tc_state.curve_state;
+    bool select_ok = tc_select_curve("no_such_surface") == U_ERROR && _tc_state.curve_state == before;
+    select_ok = select_ok && tc_select_curve(surface_id) == U_SUCCESS;
+    select_ok = select_ok && tc_select_curve(surface_id) == U_SUCCESS;
+    select_ok = select_ok && _tc_state.curve_state == (before | TC_CURVE_PENDING);
+    tc_process(NULL);
+    select_ok = select_ok && _tc_state.curve_state == ((before ^ TC_CURVE_ACTIVE) & ~TC_CURVE_PENDING);
+    select_ok = select_ok && strcmp(tc_get_surface_id(), surface_id) == 0;
+    printf("  selection: '%s' %s\n", surface_id, select_ok ? "swapped in" : "FAILED");
+    if (!select_ok) {
+        printf("FAIL: tire curve selection.\n");
+        return 1;
+    }
+
+    /* Upload: a copy of the active curve under a new surface_id. Corrupted copies are rejected without
+     * disturbing the active curve, the good one is swapped in by tc_process(), and once persisted it is
+     * what tc_init() loads at boot. */
+    tire_curve_t upload = _curve_sets[_tc_state.curve_state & TC_CURVE_ACTIVE].curve;
+    memset(upload.surface_id, 0, TC_SURFACE_ID_SIZE);
+    strcpy(upload.surface_id, "uploaded");
+    const uint8_t *blob = (const uint8_t *)&upload;
+    uint32_t crc = _crc32(blob, sizeof(upload));
+
+    tire_curve_t bad_magic = upload;
+    bad_magic.magic ^= 1;
+    tire_curve_t bad_slip = upload;
+    bad_slip.points[1].slip_ratio = bad_slip.points[0].slip_ratio;
+    before = _tc_state.curve_state;
+    bool upload_ok = tc_load_curve(blob, sizeof(upload), crc ^ 1, false) == U_ERROR;
+    upload_ok = upload_ok && tc_load_curve(blob, sizeof(upload) - 1, crc, false) == U_ERROR;
+    upload_ok = upload_ok && tc_load_curve((const uint8_t *)&bad_magic, sizeof(upload), _crc32((const uint8_t *)&bad_magic, sizeof(upload)), false) == U_ERROR;
+    upload_ok = upload_ok && tc_load_curve((const uint8_t *)&bad_slip, sizeof(upload), _crc32((const uint8_t *)&bad_slip, sizeof(upload)), false) == U_ERROR;
+    upload_ok = upload_ok && _tc_state.curve_state == before;
+    printf("  upload: corrupted curves %s\n", upload_ok ? "rejected" : "NOT REJECTED");
+
+    upload_ok = upload_ok && tc_load_curve(blob, sizeof(upload), crc, true) == U_SUCCESS;
+    upload_ok = upload_ok && strcmp(tc_get_surface_id(), surface_id) == 0;
+    tc_process(NULL);
+    upload_ok = upload_ok && strcmp(tc_get_surface_id(), "uploaded") == 0;
+
+    _tc_state.curve_state = 0; /* Reboot. */
+    tc_init();
+    upload_ok = upload_ok && strcmp(tc_get_surface_id(), "uploaded") == 0;
+    upload_ok = upload_ok && tc_select_curve(surface_id) == U_SUCCESS && tc_select_curve("uploaded") == U_SUCCESS;
+    printf("  upload: '%s' %s\n", upload.surface_id, upload_ok ? "swapped in, and loaded at boot" : "FAILED");
+    if (!upload_ok) {
+        printf("FAIL: tire curve upload.\n");
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
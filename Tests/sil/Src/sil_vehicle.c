@@ -0,0 +1,302 @@
+#include <math.h>
+#include <string.h>
+#include "sil.h"
+#include "u_can.h"
+#include "u_dti.h"
+#include "u_emrax.h"
+
+/*
+*   Longitudinal vehicle model used as the SIL plant.
+*
+*   It plays the part of everything on the bus that the VCU listens to: the DTI (ERPM, currents, temps),
+*   the front wheel speed sensors, the MSBs' shock pots and ride height sensors, BMS (current limits, cell
+*   temps, precharge, shutdown) and the Lightning board. The rear axle is driven through a single-speed
+*   reduction and a Pacejka-style tire, so the traction controller sees real wheel slip. Reverse driving
+*   is not modelled (speeds are clamped at 0).
+*/
+
+/* Vehicle parameters. */
+#define SIL_MASS           290.0f  /* (kg). Car + driver. */
+#define SIL_G              9.80665f
+#define SIL_WHEEL_RADIUS   (TIRE_DIAMETER / 2.0f * 0.0254f) /* (m). */
+#define SIL_REAR_STATIC    0.55f   /* Fraction of the weight on the rear axle at rest. */
+#define SIL_CG_HEIGHT      0.28f   /* (m). */
+#define SIL_WHEELBASE      1.53f   /* (m). */
+#define SIL_REAR_INERTIA   0.9f    /* (kg*m^2). Rear wheels + reflected motor inertia, at the wheel. */
+#define SIL_WHEEL_RATE_F   35000.0f /* (N/m). Per wheel, including the tire. */
+#define SIL_WHEEL_RATE_R   40000.0f /* (N/m). */
+#define SIL_SHOCK_STATIC   20.0f   /* (mm). Shock compression at rest, with a 1:1 motion ratio. */
+#define SIL_RIDE_HEIGHT    40.0f   /* (mm). At rest. */
+#define SIL_CDA            1.1f    /* (m^2). Drag area. */
+#define SIL_AIR_DENSITY    1.2f    /* (kg/m^3). */
+#define SIL_CRR            0.015f  /* Rolling resistance coefficient. */
+#define SIL_BRAKE_MAX_G    1.6f    /* Deceleration at full brake pedal (g). */
+#define SIL_BRAKE_REAR     0.35f   /* Fraction of the brake force on the rear axle. */
+#define SIL_PACK_RES       0.12f   /* (Ohm). Pack internal resistance. */
+#define SIL_DRIVE_EFF      0.92f   /* Motor + inverter efficiency. */
+#define SIL_MOTOR_TORQUE_MAX EMRAX_PEAK_TORQUE
+#define SIL_MOTOR_POWER_MAX  (EMRAX_PEAK_POWER * 1000.0f) /* (W). The motor can't make more than peak power. */
+#define SIL_MOTOR_RPM_FADE   (0.95f * EMRAX_LIMITING_SPEED) /* (RPM). Torque fades to zero from here up to the limiting speed. */
+
+/* Magic formula coefficients for the "real" tire (deliberately independent of the TC tire curve). */
+#define SIL_TIRE_B 10.0f
+#define SIL_TIRE_C 1.65f
+#define SIL_TIRE_E 0.97f
+
+#define SIL_SUBSTEPS       10     /* Physics sub-steps per tick (the slip dynamics are stiff at low speed). */
+#define SIL_SLIP_MIN_V     1.0f   /* (m/s). Floor on the slip denominator. */
+#define SIL_CMD_TIMEOUT    100    /* (ticks). The DTI drops the torque target if commands stop. */
+
+/* Broadcast periods (ticks). */
+#define SIL_PERIOD_DTI     10
+#define SIL_PERIOD_DTI_TMP 100
+#define SIL_PERIOD_WHEELS  10
+#define SIL_PERIOD_BMS     100
+#define SIL_PERIOD_CELLS   1000
+#define SIL_PERIOD_LIGHT   100
+#define SIL_PERIOD_MSB     10
+
+static sil_vehicle_t _car;
+
+sil_vehicle_t *sil_vehicle(void) {
+    return &_car;
+}
+
+void sil_vehicle_init(void) {
+    memset(&_car, 0, sizeof(_car));
+    _car.mu = 1.4f;
+    _car.pack_voltage = 500.0f;
+    _car.dc_voltage = _car.pack_voltage;
+    _car.motor_temp = 30.0f;
+    _car.controller_temp = 30.0f;
+    _car.battbox_temp = 25.0f;
+    _car.dcl = 350.0f;
+    _car.ccl = 150.0f;
+    _car.precharge = 0;
+    _car.shutdown_closed = false;
+    _car.bus_alive = true;
+    _car.msb_alive = true;
+    _car.ccl_alive = true;
+    _car.fz_rear = SIL_MASS * SIL_G * SIL_REAR_STATIC;
+}
+
+float sil_vehicle_mph(void) {
+    return _car.v * 2.23694f;
+}
+
+/* Normalized longitudinal tire force for a given slip ratio. */
+static float _tire_fx_norm(float slip) {
+    float bx = SIL_TIRE_B * slip;
+    return sinf(SIL_TIRE_C * atanf(bx - SIL_TIRE_E * (bx - atanf(bx))));
+}
+
+/* Frame helpers. */
+static void _put_be16(uint8_t *dst, int32_t value) {
+    if (value > 32767) value = 32767;
+    if (value < -32768) value = -32768;
+    dst[0] = (uint8_t)((value >> 8) & 0xFF);
+    dst[1] = (uint8_t)(value & 0xFF);
+}
+
+static void _send(uint32_t id, bool extended, const uint8_t *data, uint8_t len) {
+    can_msg_t msg = { .id = id, .id_is_extended = extended, .len = len };
+    memcpy(msg.data, data, len);
+    sil_can_inject(&msg);
+}
+
+static void _publish(uint32_t tick) {
+    float motor_rpm = _car.omega_rear * GEAR_RATIO * 60.0f / (2.0f * (float)M_PI);
+    float front_rpm = (_car.v / SIL_WHEEL_RADIUS) * 60.0f / (2.0f * (float)M_PI);
+
+    if (tick % SIL_PERIOD_DTI == 0) {
+        /* ERPM (int32), duty (x10), input voltage (V). */
+        int32_t erpm = (int32_t)lrintf(motor_rpm * POLE_PAIRS);
+        uint8_t erpm_data[8] = { (uint8_t)(erpm >> 24), (uint8_t)(erpm >> 16), (uint8_t)(erpm >> 8), (uint8_t)erpm };
+        _put_be16(&erpm_data[4], 0);
+        _put_be16(&erpm_data[6], (int32_t)lrintf(_car.dc_voltage));
+        _send(DTI_CANID_ERPM, false, erpm_data, 8);
+
+        /* AC current (x10), DC current (x10). */
+        uint8_t current_data[8] = { 0 };
+        _put_be16(&current_data[0], (int32_t)lrintf(_car.ac_current * 10.0f));
+        _put_be16(&current_data[2], (int32_t)lrintf(_car.dc_current * 10.0f));
+        _send(DTI_CANID_CURRENTS, false, current_data, 8);
+    }
+
+    if (tick % SIL_PERIOD_DTI_TMP == 0) {
+        uint8_t temp_data[8] = { 0 };
+        _put_be16(&temp_data[0], (int32_t)lrintf(_car.controller_temp * 10.0f));
+        _put_be16(&temp_data[2], (int32_t)lrintf(_car.motor_temp * 10.0f));
+        _send(DTI_CANID_TEMPS_FAULT, false, temp_data, 8);
+    }
+
+    if (tick % SIL_PERIOD_WHEELS == 0) {
+        uint8_t wheel_data[4];
+        _put_be16(&wheel_data[0], (int32_t)lrintf(front_rpm));
+        _put_be16(&wheel_data[2], (int32_t)lrintf(front_rpm));
+        _send(CANID_F_RPM, true, wheel_data, 4);
+    }
+
+    if (tick % SIL_PERIOD_MSB == 0 && _car.msb_alive) {
+        /* Quasi-static suspension: each axle's wheels move by its load change over the wheel rates. */
+        float fz_front = SIL_MASS * SIL_G - _car.fz_rear;
+        float travel_f = (fz_front - SIL_MASS * SIL_G * (1.0f - SIL_REAR_STATIC)) / (2.0f * SIL_WHEEL_RATE_F) * 1000.0f;
+        float travel_r = (_car.fz_rear - SIL_MASS * SIL_G * SIL_REAR_STATIC) / (2.0f * SIL_WHEEL_RATE_R) * 1000.0f;
+
+        /* Shock travel (mm) is a little-endian uint32, then the raw ADC reading. Ride height (mm) is a big-endian int16. */
+        uint32_t shock_f = (uint32_t)lrintf(fmaxf(SIL_SHOCK_STATIC + travel_f, 0.0f));
+        uint32_t shock_r = (uint32_t)lrintf(fmaxf(SIL_SHOCK_STATIC + travel_r, 0.0f));
+        uint8_t shock_data[6] = { 0 };
+        memcpy(shock_data, &shock_f, sizeof(shock_f));
+        _send(CANID_FRONT_SHOCKPOT, false, shock_data, 6);
+        memcpy(shock_data, &shock_r, sizeof(shock_r));
+        _send(CANID_BACK_SHOCKPOT, false, shock_data, 6);
+
+        uint8_t height_data[2];
+        _put_be16(height_data, (int32_t)lrintf(SIL_RIDE_HEIGHT - travel_f));
+        _send(CANID_FRONT_RIDE_HEIGHT, false, height_data, 2);
+        _put_be16(height_data, (int32_t)lrintf(SIL_RIDE_HEIGHT - travel_r));
+        _send(CANID_BACK_RIDE_HEIGHT, false, height_data, 2);
+    }
+
+    if (!_car.bus_alive) {
+        return;
+    }
+
+    if (tick % SIL_PERIOD_BMS == 0) {
+        /* DCL and CCL, as the BMS sends them to the DTI: max DC current and max DC brake current commands (A x10). */
+        uint8_t limit_data[2];
+        _put_be16(limit_data, (int32_t)lrintf(_car.dcl * 10.0f));
+        _send(CANID_BMS_DCL_MSG, false, limit_data, 2);
+        if (_car.ccl_alive) {
+            _put_be16(limit_data, (int32_t)lrintf(_car.ccl * 10.0f));
+            _send(CANID_BMS_CCL_MSG, false, limit_data, 2);
+        }
+
+        uint8_t precharge_data[1] = { _car.precharge };
+        _send(CANID_SHEPHERD_PRECHARGE, false, precharge_data, 1);
+
+        uint8_t shutdown_data[1] = { _car.shutdown_closed ? 0x80 : 0x00 };
+        _send(CANID_SHUTDOWN, false, shutdown_data, 1);
+    }
+
+    if (tick % SIL_PERIOD_CELLS == 0) {
+        /* Cell temperatures (x100): high, low and average. Only the average is used by the VCU. */
+        uint8_t cell_data[8] = { 0 };
+        int32_t temp = (int32_t)lrintf(_car.battbox_temp * 100.0f);
+        _put_be16(&cell_data[0], temp);
+        _put_be16(&cell_data[3], temp);
+        _put_be16(&cell_data[6], temp);
+        _send(CANID_BMS_CELL_TEMPS, false, cell_data, 8);
+    }
+
+    if (tick % SIL_PERIOD_LIGHT == 0) {
+        uint8_t light_data[1] = { 0 };
+        _send(CANID_LIGHTNING_PULSE, true, light_data, 1);
+    }
+}
+
+void sil_vehicle_receive(const can_msg_t *msg) {
+    switch (msg->id) {
+        case 0x036: /* AC current target (x10), big endian. */
+            _car.cmd_ac_current = (int16_t)((msg->data[0] << 8) | msg->data[1]) / 10.0f;
+            _car.cmd_brake_current = 0.0f;
+            _car.last_cmd_tick = sil_clock_now();
+            break;
+        case 0x056: /* Brake AC current target (x10), big endian. */
+            _car.cmd_brake_current = (uint16_t)((msg->data[0] << 8) | msg->data[1]) / 10.0f;
+            _car.cmd_ac_current = 0.0f;
+            _car.last_cmd_tick = sil_clock_now();
+            break;
+        case 0x196: /* Drive enable. */
+            _car.drive_enable = msg->data[0] != 0;
+            break;
+        default:
+            break;
+    }
+}
+
+void sil_vehicle_step(void) {
+    const float dt = 0.001f / SIL_SUBSTEPS;
+    const float r = SIL_WHEEL_RADIUS;
+
+    /* Motor torque request, as the DTI would turn it into torque. */
+    bool commanded = _car.drive_enable && (sil_clock_now() - _car.last_cmd_tick) <= SIL_CMD_TIMEOUT;
+    float torque = 0.0f;
+    if (commanded && _car.precharge == 2) {
+        if (_car.cmd_brake_current > 0.0f) {
+            torque = (_car.omega_rear > 0.5f) ? -_car.cmd_brake_current / 1.414f * EMRAX_KT : 0.0f;
+        } else {
+            torque = _car.cmd_ac_current / 1.414f * EMRAX_KT;
+        }
+    }
+    if (torque > SIL_MOTOR_TORQUE_MAX) torque = SIL_MOTOR_TORQUE_MAX;
+    if (torque < -SIL_MOTOR_TORQUE_MAX) torque = -SIL_MOTOR_TORQUE_MAX;
+
+    /* Motor envelope: constant power above base speed, and nothing past the limiting speed. */
+    float omega_motor = _car.omega_rear * GEAR_RATIO;
+    float motor_rpm = omega_motor * 60.0f / (2.0f * (float)M_PI);
+    if (omega_motor > 1.0f && fabsf(torque) * omega_motor > SIL_MOTOR_POWER_MAX) {
+        torque = copysignf(SIL_MOTOR_POWER_MAX / omega_motor, torque);
+    }
+    if (torque > 0.0f && motor_rpm > SIL_MOTOR_RPM_FADE) {
+        float fade = (EMRAX_LIMITING_SPEED - motor_rpm) / (EMRAX_LIMITING_SPEED - SIL_MOTOR_RPM_FADE);
+        torque *= fmaxf(fade, 0.0f);
+    }
+    _car.motor_torque = torque;
+    _car.ac_current = torque / EMRAX_KT * 1.414f;
+
+    float brake_force = sil_sensors()->brake * SIL_BRAKE_MAX_G * SIL_MASS * SIL_G;
+    float ax_sum = 0.0f;
+
+    for (int i = 0; i < SIL_SUBSTEPS; i++) {
+        float v_rear = _car.omega_rear * r;
+        float denom = fmaxf(fmaxf(fabsf(_car.v), fabsf(v_rear)), SIL_SLIP_MIN_V);
+        _car.slip = (v_rear - _car.v) / denom;
+
+        /* Rear normal load with longitudinal weight transfer. */
+        float fz_rear = SIL_MASS * (SIL_G * SIL_REAR_STATIC + _car.ax * SIL_CG_HEIGHT / SIL_WHEELBASE);
+        if (fz_rear < 0.0f) fz_rear = 0.0f;
+        _car.fz_rear = fz_rear;
+        float fx_rear = _car.mu * fz_rear * _tire_fx_norm(_car.slip);
+
+        /* Resistive forces always oppose motion. */
+        float resist = SIL_CRR * SIL_MASS * SIL_G + 0.5f * SIL_AIR_DENSITY * SIL_CDA * _car.v * _car.v;
+        float front_brake = brake_force * (1.0f - SIL_BRAKE_REAR);
+        if (_car.v <= 0.0f) {
+            resist = fminf(resist, fmaxf(fx_rear, 0.0f));
+            front_brake = 0.0f;
+        }
+
+        float ax = (fx_rear - resist - front_brake) / SIL_MASS;
+        float wheel_torque = torque * GEAR_RATIO - fx_rear * r;
+        float rear_brake = brake_force * SIL_BRAKE_REAR * r;
+        if (_car.omega_rear > 0.0f) {
+            wheel_torque -= rear_brake;
+        }
+        float alpha = wheel_torque / SIL_REAR_INERTIA;
+
+        _car.v += ax * dt;
+        _car.omega_rear += alpha * dt;
+        if (_car.v < 0.0f) _car.v = 0.0f;
+        if (_car.omega_rear < 0.0f) _car.omega_rear = 0.0f;
+        _car.ax = ax;
+        _car.distance += _car.v * dt;
+        ax_sum += ax;
+    }
+
+    /* Electrical side. */
+    float p_mech = torque * _car.omega_rear * GEAR_RATIO;
+    float p_elec = (p_mech >= 0.0f) ? p_mech / SIL_DRIVE_EFF : p_mech * SIL_DRIVE_EFF;
+    float v_oc = _car.pack_voltage;
+    /* Solve V = Voc - R*I with P = V*I for the terminal voltage. */
+    float disc = v_oc * v_oc - 4.0f * SIL_PACK_RES * p_elec;
+    _car.dc_voltage = (disc > 0.0f) ? 0.5f * (v_oc + sqrtf(disc)) : 0.5f * v_oc;
+    _car.dc_current = p_elec / _car.dc_voltage;
+
+    /* IMU sees the average acceleration over the tick, plus its bias. */
+    sil_sensors()->accel.x = (ax_sum / SIL_SUBSTEPS) / SIL_G * 1000.0f + _car.ax_bias;
+    sil_sensors()->accel.z = 1000.0f;
+
+    _publish(sil_clock_now());
+}
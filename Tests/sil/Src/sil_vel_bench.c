@@ -0,0 +1,226 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sil.h"
+#include "u_can.h"
+
+/*
+*   Host validation of the traction control velocity estimator.
+*
+*   u_tc.c is compiled into this file so the estimator can be driven directly. Each profile is a
+*   synthetic run at the IMU rate (960 Hz) with front wheel speeds at 100 Hz, both with noise. The
+*   accelerometer has a bias and sees gravity through the chassis pitch (squat under power, dive
+*   under braking). Profiles inject the faults the estimator has to ride through: front wheel lockup,
+*   and IMU and wheel speed dropouts. Fused profiles add the IMU's sensor fusion (SFLP) gravity vector to
+*   each sample, on a grade, as the estimator gets it on the car.
+*
+*       sil_vel_bench [--verbose]
+*
+*   Fails if the estimate is off by more than a profile's limits, or the covariance does not grow
+*   while measurements are missing and shrink again when they return.
+*/
+
+#include "../../../Core/Src/u_tc.c"
+
+#define BENCH_IMU_HZ      960
+#define BENCH_WHEEL_HZ    100
+#define BENCH_CALIB_S     0.5f
+#define BENCH_ACCEL_NOISE 0.3f   /* (m/s^2), 1 sigma. */
+#define BENCH_GYRO_NOISE  0.02f  /* (rad/s). */
+#define BENCH_WHEEL_NOISE 0.15f  /* (m/s). Before the RPM is rounded to an integer. */
+#define BENCH_WHEEL_R     (TIRE_DIAMETER / 2.0f * 0.0254f)
+#define BENCH_PITCH_GAIN  0.004f /* Pitch per m/s^2 of acceleration (rad). Nose up under power. */
+#define BENCH_SFLP_NOISE  2.0f   /* SFLP gravity vector noise (mg). */
+#define BENCH_SFLP_LEAK   0.02f  /* Fraction of a sustained acceleration the SFLP mistakes for gravity. */
+
+/* The rest of the application, as far as u_tc.c is concerned. */
+static uint64_t _now_us;
+static bool _verbose;
+uint32_t sil_clock_now(void) { return (uint32_t)(_now_us / 1000); }
+uint32_t HAL_GetTick(void) { return (uint32_t)(_now_us / 1000); }
+uint64_t time_getMicros(void) { return _now_us; }
+int32_t dti_get_rpm(void) { return 0; }
+
+void sil_log(sil_log_level_t level, const char *file, int line, const char *format, ...) {
+    (void)level;
+    (void)file;
+    (void)line;
+    if (_verbose) {
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        printf("\n");
+    }
+}
+
+/* Gaussian noise (Box-Muller), from a fixed seed so runs are repeatable. */
+static float _noise(float sigma) {
+    float u1 = ((float)rand() + 1.0f) / ((float)RAND_MAX + 2.0f);
+    float u2 = (float)rand() / (float)RAND_MAX;
+    return sigma * sqrtf(-2.0f * logf(u1)) * cosf(2.0f * (float)M_PI * u2);
+}
+
+typedef struct {
+    const char *name;
+    float ax_bias;      /* Accelerometer bias (m/s^2). */
+    float duration;     /* (s). */
+    /* Faults, as [start, end) windows in seconds. An empty window is unused. */
+    float lockup[2];    /* Front wheels read zero (braking lockup). */
+    float imu_out[2];   /* No IMU samples; TC runs on the thread's timeout instead. */
+    float wheel_out[2]; /* No wheel speed messages. */
+    /* Limits. */
+    float max_rms;      /* (m/s). */
+    float max_error;    /* (m/s). */
+    bool fused;         /* Samples carry the SFLP's gravity vector. */
+    float grade;        /* Road grade, nose up (rad). */
+} profile_t;
+
+/* True acceleration: a launch to ~25 m/s, a coast, then hard braking to a stop. */
+static float _true_accel(float t, float v) {
+    if (t < 3.5f) return 9.0f - 0.25f * v;      /* Launch, tailing off with speed. */
+    if (t < 4.5f) return -0.5f;                 /* Lift. */
+    if (v > 0.0f) return -13.0f;                /* Braking. */
+    return 0.0f;
+}
+
+static bool _in(const float window[2], float t) {
+    return t >= window[0] && t < window[1];
+}
+
+/* Runs one profile. Returns whether it passed. */
+static bool _run(const profile_t *p, uint32_t seed) {
+    srand(seed);
+    memset(&_tc_state.vel_estimator, 0, sizeof(_tc_state.vel_estimator));
+    _tc_state.wheel_fresh = false;
+    _tc_state.wheel_stale = false;
+    _tc_state.last_us = 0;
+    _now_us = 0;
+
+    const float dt = 1.0f / BENCH_IMU_HZ;
+    float v = 0.0f, pitch = 0.0f;
+    double sum_sq = 0.0, max_error = 0.0;
+    long n = 0;
+    float var_before_out = NAN, var_out_end = NAN, var_after = NAN;
+    bool gated = true;
+    uint32_t rejected_before = 0;
+    int next_wheel = 0;
+    int steps = (int)((BENCH_CALIB_S + p->duration) * BENCH_IMU_HZ);
+    int calib_steps = (int)(BENCH_CALIB_S * BENCH_IMU_HZ);
+
+    for (int i = 0; i < steps; i++) {
+        _now_us = 1000 + (uint64_t)i * 1000000 / BENCH_IMU_HZ;
+        float t = (i - calib_steps) * dt;
+        float a = (i < calib_steps) ? 0.0f : _true_accel(t, v);
+        float pitch_target = BENCH_PITCH_GAIN * a;
+        float pitch_rate = (pitch_target - pitch) / 0.1f; /* Suspension settles in ~0.1 s. */
+
+        v += a * dt;
+        if (v < 0.0f) v = 0.0f;
+        pitch += pitch_rate * dt;
+
+        /* Wheel speeds at 100 Hz. */
+        if (i >= next_wheel * BENCH_IMU_HZ / BENCH_WHEEL_HZ) {
+            next_wheel++;
+            if (!_in(p->wheel_out, t)) {
+                float v_wheel = _in(p->lockup, t) ? 0.0f : v + _noise(BENCH_WHEEL_NOISE);
+                int16_t rpm = (int16_t)lrintf(v_wheel / BENCH_WHEEL_R * 60.0f / (2.0f * (float)M_PI));
+                can_msg_t msg = { .id = CANID_F_RPM, .len = 4 };
+                msg.data[0] = (uint8_t)(rpm >> 8);
+                msg.data[1] = (uint8_t)rpm;
+                msg.data[2] = (uint8_t)(rpm >> 8);
+                msg.data[3] = (uint8_t)rpm;
+                tc_record_front_rpm(msg);
+            }
+        }
+
+        /* Accelerometer in mg, gyro in mdps, as the LSM6DSV reports them. */
+        imu_sample_t sample = { .time_us = _now_us };
+        float gravity_x = sinf(pitch + p->grade) * 1000.0f;
+        sample.accel.x = (a + p->ax_bias + _noise(BENCH_ACCEL_NOISE)) / G_MPS2 * 1000.0f + gravity_x;
+        sample.gyro.y = (pitch_rate + _noise(BENCH_GYRO_NOISE)) * 180.0f / (float)M_PI * 1000.0f;
+        if (p->fused) {
+            /* The SFLP corrects its tilt with the accelerometer, so it mistakes a little of a sustained acceleration for gravity. */
+            sample.fused = true;
+            sample.gravity.x = gravity_x + BENCH_SFLP_LEAK * a / G_MPS2 * 1000.0f + _noise(BENCH_SFLP_NOISE);
+            sample.gravity.z = cosf(pitch + p->grade) * 1000.0f;
+        }
+        tc_process(_in(p->imu_out, t) ? NULL : &sample);
+
+        tc_velocity_estimate_t est;
+        if (!tc_get_velocity_estimate(&est)) {
+            continue;
+        }
+        double error = fabs(est.velocity - v);
+        sum_sq += error * error;
+        n++;
+        if (error > max_error) max_error = error;
+
+        /* Covariance around the first dropout, and the lockup must be gated. */
+        const float *out = (p->imu_out[1] > p->imu_out[0]) ? p->imu_out : p->wheel_out;
+        if (out[1] > out[0]) {
+            if (t < out[0]) var_before_out = est.covariance[VEL_V][VEL_V];
+            if (_in(out, t)) var_out_end = est.covariance[VEL_V][VEL_V];
+            if (t < out[1] + 0.5f) var_after = est.covariance[VEL_V][VEL_V];
+        }
+        if (_in(p->lockup, t)) {
+            if (t < p->lockup[0] + dt) rejected_before = est.rejected;
+            gated = gated && est.velocity > 0.5f * v;
+        }
+    }
+
+    tc_velocity_estimate_t est;
+    tc_get_velocity_estimate(&est);
+    double rms = n > 0 ? sqrt(sum_sq / n) : INFINITY;
+    bool ok = n > 0 && rms <= p->max_rms && max_error <= p->max_error;
+    printf("  %-15s rms %.3f m/s, max %.3f m/s, bias %.3f m/s^2 (true %.3f), std %.3f m/s, %u rejected",
+           p->name, rms, max_error, est.ax_bias, p->ax_bias, sqrtf(est.covariance[VEL_V][VEL_V]), est.rejected);
+
+    if (p->lockup[1] > p->lockup[0]) {
+        bool lockup_ok = gated && est.rejected > rejected_before;
+        printf(", lockup %s", lockup_ok ? "gated" : "NOT GATED");
+        ok = ok && lockup_ok;
+    }
+    if (!isnan(var_before_out)) {
+        bool cov_ok = var_out_end > 2.0f * var_before_out && var_after < 0.5f * var_out_end;
+        printf(", dropout variance %.4f -> %.4f -> %.4f", var_before_out, var_out_end, var_after);
+        ok = ok && cov_ok;
+    }
+    if (p->fused) {
+        /* Pitch comes straight from the SFLP, so it must follow the grade rather than leak back to level. */
+        bool pitch_ok = fabsf(est.pitch - (pitch + p->grade)) < 0.01f;
+        printf(", pitch %.4f rad (true %.4f)", est.pitch, pitch + p->grade);
+        ok = ok && pitch_ok;
+    }
+    printf(" %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0) {
+            _verbose = true;
+        } else {
+            fprintf(stderr, "usage: %s [--verbose]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    static const profile_t profiles[] = {
+        { "launch+brake", 0.0f, 7.0f, { 0 }, { 0 }, { 0 }, 0.25f, 0.8f },
+        { "biased", 0.4f, 7.0f, { 0 }, { 0 }, { 0 }, 0.25f, 0.8f },
+        { "brake lockup", 0.2f, 7.0f, { 5.0f, 5.3f }, { 0 }, { 0 }, 0.3f, 1.0f },
+        { "imu dropout", 0.2f, 7.0f, { 0 }, { 1.5f, 1.8f }, { 0 }, 0.5f, 3.0f },
+        { "wheel dropout", 0.2f, 7.0f, { 0 }, { 0 }, { 2.0f, 2.5f }, 0.3f, 1.0f },
+        { "fused, grade", 0.2f, 7.0f, { 0 }, { 0 }, { 0 }, 0.25f, 0.8f, true, 0.05f },
+        { "fused, lockup", 0.2f, 7.0f, { 5.0f, 5.3f }, { 0 }, { 0 }, 0.3f, 1.0f, true, 0.05f },
+    };
+
+    printf("Velocity estimator: IMU at %d Hz, wheel speeds at %d Hz.\n", BENCH_IMU_HZ, BENCH_WHEEL_HZ);
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        ok = _run(&profiles[i], 1 + (uint32_t)i) && ok;
+    }
+    printf(ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+/* The SIL build defines __timer_t_defined so the ThreadX timer shim can own timer_t. That breaks
+ * <time.h>, so the host clock lives in its own translation unit that never sees the shim. */
+#undef __timer_t_defined
+#include <stdint.h>
+#include <time.h>
+
+double sil_wall_time(void) {
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+uint64_t sil_wall_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
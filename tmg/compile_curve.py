@@ -0,0 +1,362 @@
+"""
+Compile a tire curve for the VCU offline: clean the points up, optionally fit a magic formula, place
+breakpoints where they matter for a given point budget, and report the error at every step.
+
+    python3 compile_curve.py <input> <output.bin> [--points N] [--fit] [--surface-id ID]
+                             [--max-error PCT] [--report report.txt]
+
+The input is one of:
+  - a saved response from the tire model dashboard (.json), as fetch.py reads it
+  - a CSV of slip,fx rows (.csv), with or without a header
+  - an existing tire_curve_t blob (.bin)
+
+Points are sorted by slip, and points with the same slip are averaged, so the slip ratios in the
+output are strictly increasing, as the VCU requires. With --fit, a Pacejka magic formula
+
+    fx = D sin(C atan(B k - E (B k - atan(B k))))
+
+is fitted to the points, and the curve is built from the formula instead of the raw (noisy) points.
+The coefficients are in the report.
+
+Breakpoints are chosen so the piecewise linear curve through them is as close to the reference (the
+raw points, or the formula) as the budget allows, by minimizing the worst-case error. They bunch up
+around the peak, where the curve bends, and spread out where it is straight. The output is padded to
+a full tire_curve_t, so it can be linked (make_bank.py) or uploaded (upload.py) directly.
+
+The report also gives the error after the VCU resamples the curve onto its uniform lookup grid
+(TC_GRID_POINTS in u_tc.c), which is what traction control actually runs on. --max-error fails the
+build if that error exceeds a percentage of peak force.
+"""
+
+import argparse
+import base64
+import csv
+import json
+import math
+import struct
+import sys
+from pathlib import Path
+
+CURVE_MAGIC = 0x004E4552
+CURVE_VERSION = 1
+HEADER_FORMAT = "<IBH16sf"
+POINT_FORMAT = "<ff"
+POINTS_MAX = 200           # TC_CURVE_POINTS_MAX in u_tc.c
+GRID_POINTS = 256          # TC_GRID_POINTS in u_tc.c
+SURFACE_ID_SIZE = 16
+FIT_SAMPLES = 2001         # Candidate breakpoints when the reference is a fitted formula
+GRAPH_ID = "tire-model-longitudinal-graph"
+
+
+# =================================== #
+#               INPUT                 #
+# =================================== #
+def load_json(path):
+    data = json.loads(Path(path).read_text())
+    series = data["response"][GRAPH_ID]["figure"]["data"][0]
+
+    def values(v):
+        # Plotly sends large arrays as base64 float64 ("bdata").
+        if isinstance(v, dict):
+            raw = base64.b64decode(v["bdata"])
+            return list(struct.unpack("<" + "d" * (len(raw) // 8), raw))
+        return [float(x) for x in v]
+
+    return list(zip(values(series["x"]), values(series["y"])))
+
+
+def load_csv(path):
+    points = []
+    with open(path, newline="") as f:
+        for row in csv.reader(f):
+            if not row or row[0].lstrip().startswith("#"):
+                continue
+            try:
+                points.append((float(row[0]), float(row[1])))
+            except (ValueError, IndexError):
+                if points:
+                    sys.exit(f"{path}: bad row {row}")
+                # Header.
+    return points
+
+
+def load_bin(path):
+    data = Path(path).read_bytes()
+    magic, _, num_points, _, _ = struct.unpack_from(HEADER_FORMAT, data)
+    if magic != CURVE_MAGIC:
+        sys.exit(f"{path}: not a tire curve (magic 0x{magic:08X})")
+    offset = struct.calcsize(HEADER_FORMAT)
+    size = struct.calcsize(POINT_FORMAT)
+    return [struct.unpack_from(POINT_FORMAT, data, offset + i * size) for i in range(num_points)]
+
+
+def clean(points):
+    """Sorts by slip and averages duplicate slips, so slip is strictly increasing."""
+    points = [(s, f) for s, f in points if math.isfinite(s) and math.isfinite(f)]
+    points.sort()
+    merged = []
+    for slip, fx in points:
+        if merged and merged[-1][0] == slip:
+            merged[-1][1].append(fx)
+        else:
+            merged.append((slip, [fx]))
+    cleaned = [(slip, sum(fxs) / len(fxs)) for slip, fxs in merged]
+    if len(cleaned) < 2:
+        sys.exit("a tire curve needs at least 2 distinct slip ratios")
+    return cleaned, len(points) - len(cleaned)
+
+
+# =================================== #
+#            MAGIC FORMULA            #
+# =================================== #
+def pacejka(p, k):
+    b, c, d, e = p
+    bk = b * k
+    return d * math.sin(c * math.atan(bk - e * (bk - math.atan(bk))))
+
+
+def fit_pacejka(points, iterations=200):
+    """Levenberg-Marquardt least squares fit of (B, C, D, E). Returns the coefficients."""
+    # Initial guess: D from the peak, C typical for longitudinal force, B from the slope at the origin.
+    peak_slip, peak_fx = max(points, key=lambda p: abs(p[1]))
+    d = abs(peak_fx)
+    c = 1.65
+    near = sorted(points, key=lambda p: abs(p[0]))[:4]
+    slope = sum(f * s for s, f in near) / max(sum(s * s for s, f in near), 1e-12)
+    b = max(slope / (c * d), 1.0) if slope > 0 else 10.0
+    p = [b, c, d, 0.0]
+
+    def residuals(q):
+        return [pacejka(q, s) - f for s, f in points]
+
+    def cost(r):
+        return sum(x * x for x in r)
+
+    lam = 1e-3
+    r = residuals(p)
+    for _ in range(iterations):
+        # Numerical Jacobian.
+        jac = []
+        for j in range(4):
+            h = 1e-6 * max(abs(p[j]), 1e-3)
+            q = list(p)
+            q[j] += h
+            rq = residuals(q)
+            jac.append([(a - b0) / h for a, b0 in zip(rq, r)])
+        jtj = [[sum(jac[i][n] * jac[j][n] for n in range(len(r))) for j in range(4)] for i in range(4)]
+        jtr = [sum(jac[i][n] * r[n] for n in range(len(r))) for i in range(4)]
+
+        improved = False
+        while lam < 1e12:
+            a = [row[:] for row in jtj]
+            for i in range(4):
+                a[i][i] *= 1.0 + lam
+            step = _solve(a, [-x for x in jtr])
+            if step is None:
+                lam *= 10.0
+                continue
+            q = [x + dx for x, dx in zip(p, step)]
+            rq = residuals(q)
+            if cost(rq) < cost(r):
+                converged = cost(r) - cost(rq) < 1e-12 * max(cost(r), 1e-12)
+                p, r = q, rq
+                lam = max(lam / 10.0, 1e-12)
+                improved = True
+                break
+            lam *= 10.0
+        if not improved or converged:
+            break
+    return p
+
+
+def _solve(a, b):
+    """Gaussian elimination with partial pivoting. Returns None if singular."""
+    n = len(b)
+    m = [row[:] + [b[i]] for i, row in enumerate(a)]
+    for col in range(n):
+        pivot = max(range(col, n), key=lambda i: abs(m[i][col]))
+        if abs(m[pivot][col]) < 1e-18:
+            return None
+        m[col], m[pivot] = m[pivot], m[col]
+        for i in range(col + 1, n):
+            factor = m[i][col] / m[col][col]
+            for j in range(col, n + 1):
+                m[i][j] -= factor * m[col][j]
+    x = [0.0] * n
+    for i in reversed(range(n)):
+        x[i] = (m[i][n] - sum(m[i][j] * x[j] for j in range(i + 1, n))) / m[i][i]
+    return x
+
+
+# =================================== #
+#             BREAKPOINTS             #
+# =================================== #
+def interpolate(points, slip):
+    """Linear interpolation, clamped at the ends, like _lookup_fx_piecewise() in u_tc.c."""
+    if slip <= points[0][0]:
+        return points[0][1]
+    if slip >= points[-1][0]:
+        return points[-1][1]
+    lo, hi = 0, len(points) - 1
+    while hi - lo > 1:
+        mid = (lo + hi) // 2
+        if points[mid][0] <= slip:
+            lo = mid
+        else:
+            hi = mid
+    (s0, f0), (s1, f1) = points[lo], points[hi]
+    return f0 + (f1 - f0) * (slip - s0) / (s1 - s0)
+
+
+def _chord_error(candidates, i, j):
+    (s0, f0), (s1, f1) = candidates[i], candidates[j]
+    worst = 0.0
+    for k in range(i + 1, j):
+        s, f = candidates[k]
+        worst = max(worst, abs(f0 + (f1 - f0) * (s - s0) / (s1 - s0) - f))
+    return worst
+
+
+def _cover(candidates, tolerance):
+    """Greedily takes the longest chord within tolerance from each breakpoint. Returns the indices."""
+    chosen = [0]
+    i = 0
+    last = len(candidates) - 1
+    while i < last:
+        j = i + 1
+        while j < last and _chord_error(candidates, i, j + 1) <= tolerance:
+            j += 1
+        chosen.append(j)
+        i = j
+    return chosen
+
+
+def place_breakpoints(candidates, budget):
+    """The fewest breakpoints, out of the candidates, that keep the worst-case error as low as the
+    budget allows. Binary search on the tolerance, with a greedy cover at each step."""
+    if len(candidates) <= budget:
+        return list(candidates)
+    span = max(f for _, f in candidates) - min(f for _, f in candidates)
+    lo, hi = 0.0, span
+    best = _cover(candidates, hi)
+    for _ in range(40):
+        mid = (lo + hi) / 2.0
+        chosen = _cover(candidates, mid)
+        if len(chosen) <= budget:
+            best, hi = chosen, mid
+        else:
+            lo = mid
+    return [candidates[i] for i in best]
+
+
+# =================================== #
+#               REPORT                #
+# =================================== #
+def grid(points):
+    """The uniform grid _build_grid() resamples the curve onto, as (slip, fx) in the curve's units."""
+    lo, hi = points[0][0], points[-1][0]
+    step = (hi - lo) / (GRID_POINTS - 1)
+    return [(lo + i * step, interpolate(points, lo + i * step)) for i in range(GRID_POINTS)]
+
+
+def error(model, reference, samples):
+    """Max and RMS of model(slip) - reference(slip) over the samples, and the slip of the max."""
+    worst, worst_slip, sum_sq = 0.0, samples[0], 0.0
+    for s in samples:
+        e = model(s) - reference(s)
+        sum_sq += e * e
+        if abs(e) > worst:
+            worst, worst_slip = abs(e), s
+    return worst, math.sqrt(sum_sq / len(samples)), worst_slip
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile a tire curve for the VCU.")
+    parser.add_argument("input", help="dashboard response (.json), slip,fx CSV (.csv) or tire curve (.bin)")
+    parser.add_argument("output", help="tire curve blob to write")
+    parser.add_argument("--points", type=int, default=POINTS_MAX, help=f"breakpoint budget (2 to {POINTS_MAX})")
+    parser.add_argument("--fit", action="store_true", help="build the curve from a fitted magic formula")
+    parser.add_argument("--surface-id", default="tire_model", help="surface_id stored in the curve")
+    parser.add_argument("--max-error", type=float, help="fail if the on-target error exceeds this (%% of peak force)")
+    parser.add_argument("--report", help="also write the report to this file")
+    args = parser.parse_args()
+
+    if not 2 <= args.points <= POINTS_MAX:
+        sys.exit(f"--points must be between 2 and {POINTS_MAX}")
+    surface_id = args.surface_id.encode()
+    if len(surface_id) >= SURFACE_ID_SIZE:
+        sys.exit(f"surface_id '{args.surface_id}' is longer than {SURFACE_ID_SIZE - 1} characters")
+
+    suffix = Path(args.input).suffix.lower()
+    loaders = {".json": load_json, ".csv": load_csv, ".bin": load_bin}
+    if suffix not in loaders:
+        sys.exit(f"{args.input}: unknown input type '{suffix}'")
+    raw, merged = clean(loaders[suffix](args.input))
+
+    report = [f"Input: {args.input}, {len(raw)} points, slip {raw[0][0]:.4f} to {raw[-1][0]:.4f}"]
+    if merged:
+        report.append(f"  {merged} points with a repeated slip ratio were averaged")
+    peak = max(abs(f) for _, f in raw)
+    samples = [s for s, _ in raw]
+
+    def raw_model(s):
+        return interpolate(raw, s)
+
+    def pct(e):
+        return 100.0 * e / peak
+
+    # Reference: the raw points, or the fitted formula.
+    if args.fit:
+        coefficients = fit_pacejka(raw)
+        worst, rms, at = error(lambda s: pacejka(coefficients, s), raw_model, samples)
+        b, c, d, e = coefficients
+        report.append(f"Magic formula fit: B={b:.6g} C={c:.6g} D={d:.6g} E={e:.6g}")
+        report.append(f"  fit vs points: max {worst:.3f} ({pct(worst):.2f}%) at slip {at:.4f}, rms {rms:.3f} ({pct(rms):.2f}%)")
+        lo, hi = raw[0][0], raw[-1][0]
+        candidates = [(lo + (hi - lo) * i / (FIT_SAMPLES - 1),) for i in range(FIT_SAMPLES)]
+        candidates = [(s, pacejka(coefficients, s)) for (s,) in candidates]
+
+        def reference(s):
+            return pacejka(coefficients, s)
+    else:
+        candidates = raw
+        reference = raw_model
+
+    curve = place_breakpoints(candidates, args.points)
+    dense = [c[0] for c in candidates]
+    worst, rms, at = error(lambda s: interpolate(curve, s), reference, dense)
+    report.append(f"Breakpoints: {len(curve)} (budget {args.points})")
+    report.append(f"  curve vs reference: max {worst:.3f} ({pct(worst):.2f}%) at slip {at:.4f}, rms {rms:.3f} ({pct(rms):.2f}%)")
+
+    on_target = grid(curve)
+    worst, rms, at = error(lambda s: interpolate(on_target, s), reference, dense)
+    report.append(f"On-target grid ({GRID_POINTS} points): max {worst:.3f} ({pct(worst):.2f}%) at slip {at:.4f}, rms {rms:.3f} ({pct(rms):.2f}%)")
+    if args.fit:
+        worst_raw, rms_raw, at_raw = error(lambda s: interpolate(on_target, s), raw_model, samples)
+        report.append(f"  vs the raw points: max {worst_raw:.3f} ({pct(worst_raw):.2f}%) at slip {at_raw:.4f}, rms {rms_raw:.3f} ({pct(rms_raw):.2f}%)")
+
+    # peak_lambda is the slip of peak (driving) force, taken from the reference so it does not move
+    # with the breakpoints.
+    driving = [c for c in candidates if c[0] > 0.0] or candidates
+    peak_lambda = max(driving, key=lambda c: c[1])[0]
+    report.append(f"peak_lambda: {peak_lambda:.4f}")
+
+    blob = struct.pack(HEADER_FORMAT, CURVE_MAGIC, CURVE_VERSION, len(curve), surface_id, peak_lambda)
+    for slip, fx in curve:
+        blob += struct.pack(POINT_FORMAT, slip, fx)
+    # The VCU only accepts a full tire_curve_t.
+    blob += bytes(struct.calcsize(POINT_FORMAT) * (POINTS_MAX - len(curve)))
+    Path(args.output).write_bytes(blob)
+    report.append(f"Wrote {args.output} ({len(blob)} bytes)")
+
+    text = "\n".join(report)
+    print(text)
+    if args.report:
+        Path(args.report).write_text(text + "\n")
+
+    if args.max_error is not None and pct(worst) > args.max_error:
+        sys.exit(f"on-target error {pct(worst):.2f}% exceeds --max-error {args.max_error}%")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,68 @@
+"""
+Pack tire curves into a curve bank for the VCU.
+
+    python3 make_bank.py <output.bin> <curve.bin>[:<surface_id>] ...
+
+Each curve is a tire_curve_t blob (see fetch.py). The bank starts with a directory, one entry per
+curve with its surface_id, offset, size and CRC32, followed by the curves themselves. The first
+curve is the one selected at boot. Giving a surface_id overrides the one stored in the curve.
+"""
+
+import struct
+import sys
+import zlib
+from pathlib import Path
+
+BANK_MAGIC = 0x4B4E4254  # "TBNK"
+BANK_VERSION = 1
+BANK_HEADER_FORMAT = "<IBBH"
+BANK_ENTRY_FORMAT = "<16sIII"
+BANK_CURVES_MAX = 16
+
+CURVE_MAGIC = 0x004E4552
+CURVE_HEADER_FORMAT = "<IBH16sf"
+SURFACE_ID_OFFSET = struct.calcsize("<IBH")
+SURFACE_ID_SIZE = 16
+
+
+def load_curve(arg):
+    path, _, surface_id = arg.partition(":")
+    data = bytearray(Path(path).read_bytes())
+    magic = struct.unpack_from("<I", data)[0]
+    if magic != CURVE_MAGIC:
+        sys.exit(f"{path}: not a tire curve (magic 0x{magic:08X})")
+
+    if surface_id:
+        encoded = surface_id.encode()
+        if len(encoded) >= SURFACE_ID_SIZE:
+            sys.exit(f"{path}: surface_id '{surface_id}' is longer than {SURFACE_ID_SIZE - 1} characters")
+        data[SURFACE_ID_OFFSET:SURFACE_ID_OFFSET + SURFACE_ID_SIZE] = encoded.ljust(SURFACE_ID_SIZE, b"\0")
+
+    surface_id = bytes(data[SURFACE_ID_OFFSET:SURFACE_ID_OFFSET + SURFACE_ID_SIZE])
+    return surface_id, bytes(data)
+
+
+def make_bank(curves):
+    ids = [surface_id for surface_id, _ in curves]
+    if len(set(ids)) != len(ids):
+        sys.exit("surface_ids must be unique")
+    if not 1 <= len(curves) <= BANK_CURVES_MAX:
+        sys.exit(f"a bank holds 1 to {BANK_CURVES_MAX} curves")
+
+    offset = struct.calcsize(BANK_HEADER_FORMAT) + len(curves) * struct.calcsize(BANK_ENTRY_FORMAT)
+    directory = struct.pack(BANK_HEADER_FORMAT, BANK_MAGIC, BANK_VERSION, len(curves), 0)
+    blobs = b""
+    for surface_id, data in curves:
+        # Keep every curve 4 byte aligned in flash.
+        padding = (-(offset + len(blobs))) % 4
+        blobs += b"\xff" * padding
+        directory += struct.pack(BANK_ENTRY_FORMAT, surface_id, offset + len(blobs), len(data), zlib.crc32(data))
+        blobs += data
+    return directory + blobs
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+    bank = make_bank([load_curve(arg) for arg in sys.argv[2:]])
+    Path(sys.argv[1]).write_bytes(bank)
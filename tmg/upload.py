@@ -0,0 +1,49 @@
+"""
+Upload a tire curve to the VCU over the network, without rebuilding or reflashing.
+
+    python3 upload.py <vcu_ip> <curve.bin>[:<surface_id>] [--persist]
+
+The curve is a tire_curve_t blob (see fetch.py). The VCU checks it and swaps it in between traction
+control cycles. With --persist it is also written to flash, where it replaces the default curve (and
+any curve in the bank with the same surface_id) at boot. Giving a surface_id overrides the one stored
+in the curve.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import zlib
+
+from make_bank import load_curve
+
+UPLOAD_PORT = 5006
+UPLOAD_MAGIC = 0x50554354  # "TCUP"
+UPLOAD_HEADER_FORMAT = "<IIIB3x"
+UPLOAD_PERSIST = 0x01
+TIMEOUT_S = 5.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Upload a tire curve to the VCU.")
+    parser.add_argument("vcu", help="VCU IP address")
+    parser.add_argument("curve", help="<curve.bin>[:<surface_id>]")
+    parser.add_argument("--persist", action="store_true", help="store the curve in flash, so it survives a reboot")
+    args = parser.parse_args()
+
+    surface_id, data = load_curve(args.curve)
+    flags = UPLOAD_PERSIST if args.persist else 0
+    header = struct.pack(UPLOAD_HEADER_FORMAT, UPLOAD_MAGIC, len(data), zlib.crc32(data), flags)
+
+    with socket.create_connection((args.vcu, UPLOAD_PORT), timeout=TIMEOUT_S) as conn:
+        conn.sendall(header + data)
+        reply = conn.recv(1)
+
+    name = surface_id.rstrip(b"\0").decode(errors="replace")
+    if reply != b"\0":
+        sys.exit(f"VCU rejected tire curve '{name}' (see its log)")
+    print(f"Loaded tire curve '{name}'{' and stored it' if args.persist else ''}.")
+
+
+if __name__ == "__main__":
+    main()